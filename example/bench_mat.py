@@ -0,0 +1,291 @@
+#!/usr/bin/env python
+# Benchmark of the materialization over LUBM1.
+#
+#   ./bench_mat.py run [options]            builds the KB (once) and runs mat
+#                                           under every configuration
+#   ./bench_mat.py diff old.json new.json   compares the reports of two builds
+#
+# Each configuration is a rule set, a mode and a number of threads. The modes
+# are 'seq' (single thread), 'mt' (--multithreaded --nthreads n) and 'inter'
+# (also --interRuleThreads n). The report contains, for each configuration, the
+# runtime of the materialization, the wall time of the process, the peak RSS,
+# the number of derived facts (total and per predicate) and the costliest
+# rules, as written by "vlog mat --matReport".
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import time
+
+EXAMPLE_DIR = os.path.dirname(os.path.abspath(__file__))
+RULES = ['LUBM1_L', 'LUBM1_LE', 'LUBM1_U']
+MODES = ['seq', 'mt', 'inter']
+
+
+def execute(cmd, logfile):
+    # Returns the wall time in ms and the peak RSS in MB of the process
+    with open(logfile, 'a') as log:
+        log.write('$ ' + ' '.join(cmd) + '\n')
+        log.flush()
+        start = time.time()
+        proc = subprocess.Popen(cmd, stdout=log, stderr=subprocess.STDOUT)
+        _, status, usage = os.wait4(proc.pid, 0)
+        wall = (time.time() - start) * 1000
+    proc.returncode = os.WEXITSTATUS(status) if os.WIFEXITED(status) else 1
+    if proc.returncode != 0:
+        raise Exception('Command failed (see ' + logfile + '): ' + ' '.join(cmd))
+    # ru_maxrss is in KB on Linux and in bytes on OSX
+    rss = usage.ru_maxrss / 1024.0
+    if platform.system() == 'Darwin':
+        rss /= 1024.0
+    return wall, rss
+
+
+def median(values):
+    values = sorted(values)
+    return values[len(values) // 2] if values else 0
+
+
+def number(value):
+    # The reports of vlog store all values as strings
+    try:
+        return int(value)
+    except ValueError:
+        return float(value)
+
+
+def git_revision(vlog):
+    try:
+        out = subprocess.check_output(['git', 'rev-parse', 'HEAD'],
+                                      cwd=os.path.dirname(os.path.abspath(vlog)),
+                                      stderr=subprocess.STDOUT)
+        return out.decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return ''
+
+
+def build_kb(args, logfile):
+    kb = os.path.join(args.workdir, 'indexDir')
+    edbconf = os.path.join(args.workdir, 'edb.conf')
+    result = {'path': kb}
+    if args.rebuild or not os.path.exists(kb):
+        subprocess.call(['rm', '-rf', kb])
+        print('Loading ' + args.data + ' ...')
+        wall, rss = execute([args.vlog, 'load', '-i', args.data, '-o', kb],
+                            logfile)
+        result['wall_ms'] = wall
+        result['peak_rss_mb'] = rss
+    with open(edbconf, 'w') as f:
+        f.write('EDB0_predname=TE\n')
+        f.write('EDB0_type=Trident\n')
+        f.write('EDB0_param0=' + os.path.abspath(kb) + '\n')
+    return result, edbconf
+
+
+def get_configurations(args):
+    configs = []
+    for rules in args.rules.split(','):
+        for mode in args.modes.split(','):
+            if mode not in MODES:
+                raise Exception('Unknown mode ' + mode)
+            threads = [1] if mode == 'seq' else \
+                [int(t) for t in args.threads.split(',')]
+            for n in threads:
+                configs.append((rules, mode, n))
+    return configs
+
+
+def run_configuration(args, edbconf, rules, mode, nthreads, logfile):
+    rulesfile = os.path.join(EXAMPLE_DIR, 'dlog', rules + '.dlog')
+    matreport = os.path.join(args.workdir, 'mat.json')
+    cmd = [args.vlog, 'mat', '-e', edbconf, '--rules', rulesfile,
+           '--matReport', matreport, '--matReportRules', str(args.top_rules),
+           '-l', 'info']
+    if mode != 'seq':
+        cmd += ['--multithreaded', '--nthreads', str(nthreads)]
+    if mode == 'inter':
+        cmd += ['--interRuleThreads', str(nthreads)]
+
+    result = {'id': '%s/%s/%d' % (rules, mode, nthreads), 'rules': rules,
+              'mode': mode, 'threads': nthreads, 'wall_ms': [],
+              'runtime_ms': [], 'peak_rss_mb': 0, 'consistent': True}
+    for rep in range(args.reps):
+        print('Running ' + result['id'] + ' (%d/%d) ...' % (rep + 1, args.reps))
+        if os.path.exists(matreport):
+            os.remove(matreport)
+        wall, rss = execute(cmd, logfile)
+        with open(matreport) as f:
+            report = json.load(f)
+        result['wall_ms'].append(wall)
+        result['runtime_ms'].append(number(report['runtime_ms']))
+        result['peak_rss_mb'] = max(result['peak_rss_mb'], rss)
+        predicates = dict((p, number(n)) for p, n in
+                          report.get('predicates', {}).items())
+        derivations = number(report['derivations'])
+        if rep == 0:
+            result['derivations'] = derivations
+            result['iterations'] = number(report['iterations'])
+            result['predicates'] = predicates
+            result['top_rules'] = [dict((k, v if k == 'rule' else number(v))
+                                        for k, v in r.items())
+                                   for r in report.get('top_rules', [])]
+        elif derivations != result['derivations'] or \
+                predicates != result['predicates']:
+            result['consistent'] = False
+    result['runtime_ms_median'] = median(result['runtime_ms'])
+    result['wall_ms_median'] = median(result['wall_ms'])
+    return result
+
+
+def run(args):
+    if not os.path.exists(args.vlog):
+        print('Cannot find the executable ' + args.vlog)
+        return 1
+    if not os.path.exists(args.workdir):
+        os.makedirs(args.workdir)
+    logfile = os.path.join(args.workdir, 'bench.log')
+    if os.path.exists(logfile):
+        os.remove(logfile)
+
+    kb, edbconf = build_kb(args, logfile)
+    report = {'version': 1,
+              'date': time.strftime('%Y-%m-%dT%H:%M:%S'),
+              'host': platform.node(),
+              'platform': platform.platform(),
+              'vlog': os.path.abspath(args.vlog),
+              'revision': git_revision(args.vlog),
+              'reps': args.reps,
+              'load': kb,
+              'runs': []}
+    for rules, mode, nthreads in get_configurations(args):
+        report['runs'].append(run_configuration(args, edbconf, rules, mode,
+                                                nthreads, logfile))
+
+    with open(args.output, 'w') as f:
+        json.dump(report, f, indent=2, sort_keys=True)
+    print('Report written in ' + args.output)
+
+    # The number of derivations must not depend on the configuration
+    ok = True
+    for rules in set(r['rules'] for r in report['runs']):
+        counts = set(r['derivations'] for r in report['runs']
+                     if r['rules'] == rules)
+        if len(counts) > 1:
+            print('Different number of derivations for ' + rules + ': ' +
+                  str(sorted(counts)))
+            ok = False
+    for r in report['runs']:
+        if not r['consistent']:
+            print('The derivations of ' + r['id'] + ' changed across runs')
+            ok = False
+    return 0 if ok else 1
+
+
+def change(old, new):
+    if old == 0:
+        return 0
+    return (new - old) * 100.0 / old
+
+
+def diff(args):
+    with open(args.old) as f:
+        old = json.load(f)
+    with open(args.new) as f:
+        new = json.load(f)
+    oldRuns = dict((r['id'], r) for r in old['runs'])
+
+    print('%-22s %12s %12s %8s %10s %10s %8s  %s' % (
+        'configuration', 'old ms', 'new ms', 'change', 'old MB', 'new MB',
+        'change', 'derivations'))
+    regressions = 0
+    for r in new['runs']:
+        o = oldRuns.pop(r['id'], None)
+        if o is None:
+            print('%-22s only in %s' % (r['id'], args.new))
+            continue
+        time_change = change(o['runtime_ms_median'], r['runtime_ms_median'])
+        rss_change = change(o['peak_rss_mb'], r['peak_rss_mb'])
+        same = o['derivations'] == r['derivations'] and \
+            o['predicates'] == r['predicates']
+        flags = ''
+        if not same:
+            flags += ' DIFFERENT'
+            regressions += 1
+        if time_change > args.threshold:
+            flags += ' SLOWER'
+            regressions += 1
+        elif time_change < -args.threshold:
+            flags += ' faster'
+        if rss_change > args.threshold:
+            flags += ' MORE MEMORY'
+            regressions += 1
+        print('%-22s %12.1f %12.1f %+7.1f%% %10.1f %10.1f %+7.1f%%  %s%s' % (
+            r['id'], o['runtime_ms_median'], r['runtime_ms_median'],
+            time_change, o['peak_rss_mb'], r['peak_rss_mb'], rss_change,
+            'same' if same else '%d -> %d' % (o['derivations'],
+                                              r['derivations']), flags))
+        if not same:
+            for p in sorted(set(o['predicates']) | set(r['predicates'])):
+                before = o['predicates'].get(p, 0)
+                after = r['predicates'].get(p, 0)
+                if before != after:
+                    print('    %s: %d -> %d' % (p, before, after))
+    for id in sorted(oldRuns):
+        print('%-22s only in %s' % (id, args.old))
+    return 1 if regressions > 0 else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Benchmark of the materialization over LUBM1')
+    sub = parser.add_subparsers(dest='command')
+
+    p = sub.add_parser('run', help='run the benchmark')
+    p.add_argument('--vlog', default=os.path.join(EXAMPLE_DIR, '..', 'vlog'),
+                   help='vlog executable (default ../vlog)')
+    p.add_argument('--data', default=os.path.join(EXAMPLE_DIR, 'ttl'),
+                   help='directory with the triples to load (default ttl)')
+    p.add_argument('--workdir', default=os.path.join(EXAMPLE_DIR, 'bench'),
+                   help='directory for the KB, the logs and the temporary '
+                   'files (default bench)')
+    p.add_argument('--rebuild', action='store_true',
+                   help='load the KB again also if it exists')
+    p.add_argument('--rules', default=','.join(RULES),
+                   help='comma-separated rule sets in dlog (default all)')
+    p.add_argument('--modes', default=','.join(MODES),
+                   help='comma-separated modes: seq, mt, inter (default all)')
+    p.add_argument('--threads', default='2,4,8',
+                   help='comma-separated numbers of threads for mt and inter '
+                   '(default 2,4,8)')
+    p.add_argument('--reps', type=int, default=3,
+                   help='runs of each configuration (default 3)')
+    p.add_argument('--top-rules', type=int, default=10,
+                   help='number of costliest rules in the report (default 10)')
+    p.add_argument('--output', '-o', default='bench_mat.json',
+                   help='report file (default bench_mat.json)')
+
+    p = sub.add_parser('diff', help='compare two reports')
+    p.add_argument('old')
+    p.add_argument('new')
+    p.add_argument('--threshold', type=float, default=10,
+                   help='percentage of change of the runtime or of the '
+                   'memory that is reported as a regression (default 10)')
+
+    args = parser.parse_args()
+    if args.command == 'run':
+        if args.reps <= 0:
+            parser.error('--reps must be positive')
+        return run(args)
+    elif args.command == 'diff':
+        return diff(args)
+    parser.print_help()
+    return 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
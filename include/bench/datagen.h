@@ -0,0 +1,61 @@
+#ifndef _BENCH_DATAGEN_H
+#define _BENCH_DATAGEN_H
+
+#include <vlog/concepts.h>
+#include <vlog/segment.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Synthetic relations for the microbenchmarks. A relation is stored column by
+ * column, like the tables of the reasoner. The values are drawn from
+ * [1, domain] either uniformly or from a Zipf distribution (the value k has
+ * probability proportional to 1/k), which resembles the frequencies of the
+ * predicates and of the classes in an RDF graph.
+ */
+class BenchData {
+public:
+    typedef enum {UNIFORM, SKEWED} Distribution;
+
+    typedef std::vector<std::vector<Term_t>> Columns;
+
+private:
+    //Inverse of the cumulative distribution, used to draw skewed values
+    class ZipfSampler {
+    private:
+        std::vector<double> cdf;
+
+    public:
+        ZipfSampler(const Term_t domain);
+
+        Term_t next(std::mt19937_64 &random) const;
+    };
+
+public:
+    static std::string getName(const Distribution distr);
+
+    //The rows are sorted (lexicographically by column) if sorted is true,
+    //otherwise they are in random order. They can contain duplicates.
+    static Columns generate(const size_t nrows, const uint8_t arity,
+                            const Distribution distr, const bool sorted,
+                            const Term_t domain, const uint64_t seed);
+
+    static void sort(Columns &columns);
+
+    static void sortAndUnique(Columns &columns);
+
+    //Replaces a fraction of the rows with random rows of another relation,
+    //so that the two relations overlap
+    static void overlap(Columns &columns, const Columns &other,
+                        const double fraction, const uint64_t seed);
+
+    static std::vector<const std::vector<Term_t> *> getPointers(
+        const Columns &columns);
+
+    static std::shared_ptr<const Segment> toSegment(const Columns &columns);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef _BENCH_HARNESS_H
+#define _BENCH_HARNESS_H
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * A microbenchmark times run() over data that is built by setup(), so that
+ * the cost of the generators is not measured. prepare() is called before
+ * every run (also not timed) to reset the state that run() consumes, e.g.,
+ * the buffers of a join processor.
+ */
+class Benchmark {
+public:
+    virtual std::string getName() const = 0;
+
+    virtual void setup() = 0;
+
+    virtual void prepare() {
+    }
+
+    virtual void run() = 0;
+
+    //Number of input rows of a run, used to compute the throughput
+    virtual size_t getNRows() const = 0;
+
+    //Number of output rows of the last run. It is printed so that runs that
+    //produce different results are not compared by mistake
+    virtual size_t getNOutput() = 0;
+
+    virtual ~Benchmark() {
+    }
+};
+
+struct BenchResult {
+    std::string name;
+    size_t nrows;
+    size_t noutput;
+    int reps;
+    double minMsec;
+    double medianMsec;
+    double meanMsec;
+};
+
+class BenchRunner {
+private:
+    const int warmup;
+    const int reps;
+
+public:
+    BenchRunner(const int warmup, const int reps) : warmup(warmup),
+        reps(reps) {
+    }
+
+    BenchResult run(Benchmark &bench);
+
+    //One tab-separated line per benchmark, so that the outputs of two
+    //commits can be compared with diff or a spreadsheet
+    static void printHeader(std::ostream &out);
+
+    static void print(const BenchResult &result, std::ostream &out);
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef _BENCH_KERNELS_H
+#define _BENCH_KERNELS_H
+
+#include <bench/harness.h>
+
+#include <memory>
+#include <vector>
+
+/*
+ * Microbenchmarks of the kernels of the forward chaining: the merge join,
+ * the filtered hash join, the sort of a segment, the removal of the
+ * derivations that already exist and the consolidation of the derivations
+ * in the table of the head. They only use in-memory tables, so no Trident KB
+ * is needed.
+ */
+class KernelBenchmarks {
+public:
+    //nrows is the size of the input relations. nthreads is passed to the
+    //kernels that can run in parallel (-1 to run them sequentially)
+    static void create(const size_t nrows, const uint64_t seed,
+                       const int nthreads,
+                       std::vector<std::unique_ptr<Benchmark>> &out);
+};
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef _QUERY_SERVER_H
+#define _QUERY_SERVER_H
+
+#include <vlog/concepts.h>
+#include <vlog/edb.h>
+#include <vlog/reasoner.h>
+#include <vlog/seminaiver.h>
+
+#include <dblayer.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Answers queries received over a local socket (and optionally a TCP port,
+ * bound to the loopback address unless another one is given),
+ * keeping the EDB layer, the program and (optionally) a full materialization
+ * loaded across queries. A text request is a line:
+ *
+ *   LITERAL <literal>   e.g. LITERAL TI(A,<http://www.w3.org/...#type>,B)
+ *   SPARQL <query>      the query must be on a single line
+ *
+ * The answer of a literal query contains one line per row, with the terms
+ * separated by tabs. The answer of a SPARQL query is one line with the same
+ * JSON object that is returned by the web interface. An answer ends with the
+ * line "OK <rows> <msec>". A request that fails is answered with the line
+ * "ERROR <message>". A literal with a predicate or a constant that is not in
+ * the program or in the KB fails, instead of being added to the program.
+ *
+ * A binary request starts with the byte BINARY_MAGIC and carries a batch of
+ * literals whose constants are term IDs. All integers are little endian:
+ *
+ *   request  := 0xB1 uint32:length payload
+ *   payload  := uint8:flags uint32:nqueries query*
+ *   query    := uint16:len predicate-name uint8:arity term*
+ *   term     := uint8:0 uint64:term-id | uint8:1 uint8:variable-id
+ *
+ * The variables are numbered from 1. If bit 0 of the flags is set, the answers contain the text of the terms as
+ * well. Otherwise only the IDs are returned and the dictionary is not used:
+ *
+ *   response := uint32:length uint8:status uint32:nanswers answer*
+ *   answer   := uint8:0 uint8:ncolumns uint64:nrows column* text*
+ *             | uint8:1 uint16:len message
+ *   column   := uint64:term-id * nrows
+ *   text     := (uint32:len bytes) * nrows, one per column
+ *
+ * The status is 0 if the batch was executed, 1 if it was refused because
+ * the server is busy and 2 if the request is malformed or one of its
+ * predicates is unknown or has a different arity. An answer that would make
+ * the response longer than 4GB is replaced by an error message.
+ *
+ * The requests are executed by a fixed pool of workers; the queries of a
+ * batch are executed one after the other by the same worker. When maxQueued
+ * requests are already waiting or running, a new one is refused with
+ * "ERROR busy" (or with the status 1), so that the latency of the admitted
+ * ones stays bounded.
+ */
+class QueryServer {
+private:
+    //Requests longer than this are refused
+    static const size_t MAX_REQUEST_SIZE = 1024 * 1024;
+    //The length of a binary response is stored in 32 bits
+    static const size_t MAX_RESPONSE_SIZE = 0xFFFFFFFFul;
+    static const uint8_t BINARY_MAGIC = 0xB1;
+    static const uint8_t BINARY_DECODE = 1;
+
+    //Accepts both the local and the TCP connections
+    typedef boost::asio::basic_socket_acceptor<boost::asio::generic::stream_protocol>
+    Acceptor;
+
+    EDBLayer &edb;
+    //Only read while the server runs, so the workers share it without a lock
+    Program &program;
+    //Materialization used to answer the literals with IDB predicates. It
+    //can be NULL
+    std::shared_ptr<SemiNaiver> sn;
+    Reasoner &reasoner;
+    DBLayer &sparqlLayer;
+
+    boost::asio::io_service io;
+    std::vector<std::unique_ptr<Acceptor>> acceptors;
+    std::string path;
+
+    const int nworkers;
+    const size_t maxQueued;
+    std::atomic<size_t> nqueued;
+    boost::asio::io_service workers;
+    std::unique_ptr<boost::asio::io_service::work> workersWork;
+    boost::thread_group workerThreads;
+
+    //Reading the materialization can update the caches of its tables
+    boost::mutex matMutex;
+    //Used to evaluate the literals one at a time if the EDB layer cannot be
+    //queried by several threads
+    boost::mutex edbMutex;
+    //The runtime of RDF3X and the caches of the layers are not thread-safe
+    boost::mutex sparqlMutex;
+
+    class Connection: public boost::enable_shared_from_this<Connection> {
+    private:
+        QueryServer *server;
+        Acceptor &acceptor;
+        boost::asio::streambuf request;
+        std::string response;
+
+        //Calls the handler once the buffer contains at least n bytes
+        void readAtLeast(const size_t n,
+                         void (Connection::*handler)(const boost::system::error_code &,
+                                 std::size_t));
+        void peekHandler(const boost::system::error_code &err,
+                         std::size_t bytes);
+        void binaryHeaderHandler(const boost::system::error_code &err,
+                                 std::size_t bytes);
+        void binaryFrameHandler(const boost::system::error_code &err,
+                                std::size_t bytes);
+
+        bool admit();
+        void write();
+        void execute(const std::string line);
+        void executeBatch(const std::string payload);
+        void writeHandler(const boost::system::error_code &err,
+                          std::size_t bytes);
+
+    public:
+        boost::asio::generic::stream_protocol::socket socket;
+
+        Connection(boost::asio::io_service &io, QueryServer *server,
+                   Acceptor &acceptor) :
+            server(server), acceptor(acceptor), request(MAX_REQUEST_SIZE),
+            socket(io) {
+        }
+
+        void read();
+        void readHandler(const boost::system::error_code &err,
+                         std::size_t bytes);
+        void acceptHandler(const boost::system::error_code &err);
+    };
+
+    void listen(const boost::asio::generic::stream_protocol::endpoint &endpoint);
+
+    void connect(Acceptor &acceptor);
+
+    //Computes the answers of the literal, one row after the other
+    void evaluate(Literal &literal, std::vector<Term_t> &rows,
+                  uint8_t &ncolumns);
+
+    void answerLiteral(const std::string &query, std::string &response,
+                       long &nrows);
+
+    void answerBatch(const std::string &payload, std::string &response);
+
+    void answerSPARQL(const std::string &query, std::string &response,
+                      long &nrows);
+
+public:
+    QueryServer(EDBLayer &edb, Program &program,
+                std::shared_ptr<SemiNaiver> sn, Reasoner &reasoner,
+                DBLayer &sparqlLayer, int nworkers, size_t maxQueued);
+
+    //Blocks until stop() is called. If port is not 0, the queries are also
+    //received on that TCP port of address, which should be the loopback
+    //unless the network is trusted
+    void run(std::string path, int port, std::string address);
+
+    void stop();
+};
+
+#endif
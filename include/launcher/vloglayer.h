@@ -1,6 +1,7 @@
 #ifndef _VLOG_LAUNCHER_H
 #define _VLOG_LAUNCHER_H
 
+#include <memory>
 #include <unordered_map>
 
 #include <vlog/edb.h>
@@ -8,26 +9,72 @@
 
 #include <dblayer.hpp>
 
+#include <boost/thread/shared_mutex.hpp>
+
 class VLogLayer : public DBLayer {
     private:
+        //Estimates used to plan the SPARQL queries. The variables in the
+        //patterns are numbered by position
+        struct Statistics {
+            unordered_map<VTuple, double, hash_VTuple> idbCardinalities;
+            boost::shared_mutex mutex;
+            string file;
+            bool modified;
+
+            Statistics() : modified(false) {}
+        };
+
         EDBLayer &edb;
         Program &p;
-        Reasoner reasoner;
+        //The reasoner and the estimates are shared with the layers returned
+        //by newWorkerLayer
+        std::shared_ptr<Reasoner> reasoner;
         const Predicate predQueries;
         const Predicate edbPredName;
+        //The text returned by lookupById. It is the only state of the layer
+        //that changes while a query is executed
         char tmpText[MAX_TERM_SIZE];
         unordered_map<VTuple, double, hash_VTuple> edbCardinalities;
-        unordered_map<VTuple, double, hash_VTuple> idbCardinalities;
+        std::shared_ptr<Statistics> stats;
         void init();
 
+        std::string getStatisticsHeader();
+
+        explicit VLogLayer(VLogLayer &shared) : edb(shared.edb), p(shared.p),
+        reasoner(shared.reasoner), predQueries(shared.predQueries),
+        edbPredName(shared.edbPredName), stats(shared.stats) {
+        }
+
     public:
         VLogLayer(EDBLayer &edb, Program &p, uint64_t threshold,
                 string predname, string edbpredname) : edb(edb), p(p),
-        reasoner(threshold), predQueries(p.getPredicate(predname)),
-        edbPredName(p.getPredicate(edbpredname)) {
+        reasoner(new Reasoner(threshold)), predQueries(p.getPredicate(predname)),
+        edbPredName(p.getPredicate(edbpredname)), stats(new Statistics()) {
             init();
         }
 
+        //Returns a layer that shares the reasoner and the estimates with this
+        //one, so that another thread can execute queries at the same time
+        std::unique_ptr<VLogLayer> newWorkerLayer() {
+            return std::unique_ptr<VLogLayer>(new VLogLayer(*this));
+        }
+
+        //The estimates are loaded from the file, and stored there when the
+        //layer is destroyed. They are discarded if the KB or the rules have
+        //changed since they were stored.
+        void loadStatistics(const std::string &file);
+
+        void saveStatistics();
+
+        //Estimates the patterns without constants, and those with constants
+        //in the columns of the EDB table with at most maxDistinct values, so
+        //that planning the first queries does not wait for the reasoner
+        void warmStatistics(const size_t maxDistinct);
+
+        Reasoner &getReasoner() {
+            return *reasoner;
+        }
+
         bool lookup(const std::string& text,
                 ::Type::ID type,
                 unsigned subType,
@@ -83,6 +130,13 @@ class VLogLayer : public DBLayer {
         std::unique_ptr<DBLayer::Scan> getScan(const DBLayer::DataOrder order,
                 const DBLayer::Aggr_t aggr,
                 DBLayer::Hint *hint);
+
+        ~VLogLayer() {
+            //The last layer that shares the estimates stores them
+            if (stats.use_count() == 1) {
+                saveStatistics();
+            }
+        }
 };
 
 #endif
@@ -6,8 +6,13 @@
 #include <vlog/edb.h>
 #include <vlog/concepts.h>
 #include <vlog/reasoner.h>
+#include <vlog/trident/tupletableblockitr.h>
 
 class VLogScan : public DBLayer::Scan {
+public:
+    //Rows copied at once from the answers of the reasoner
+    static const size_t BLOCK_SIZE = 1024;
+
 private:
     const DBLayer::DataOrder order;
     const DBLayer::Aggr_t aggr;
@@ -22,6 +27,17 @@ private:
 
     std::unique_ptr<TupleIterator> iterator;
 
+    //Without aggregations, the rows are read in blocks of columns instead
+    //of calling the iterator for every value
+    TupleTableBlockItr *blockItr;
+    Term_t block[3][BLOCK_SIZE];
+    size_t blockSize;
+    size_t blockPos;
+    //Whether the scan is on a row
+    bool current;
+
+    void fillBlock();
+
     Literal getLiteral(DBLayer::DataOrder order, uint64_t first, bool constrained1,
                        uint64_t second, bool constrained2, uint64_t third,
                        bool constrained3);
@@ -35,7 +51,8 @@ public:
              Program &p,
              Reasoner *r) : order(order), aggr(aggr),
         hint(hint), layer(layer),
-        p(p), r(r), predQuery(predQuery) {
+        p(p), r(r), predQuery(predQuery), blockItr(NULL), blockSize(0),
+        blockPos(0), current(false) {
         switch (order) {
         case DBLayer::Order_No_Order_SPO:
         case DBLayer::Order_Subject_Predicate_Object:
@@ -0,0 +1,96 @@
+#ifndef _ALGO_COSTS_H
+#define _ALGO_COSTS_H
+
+#include <boost/thread/mutex.hpp>
+
+#include <random>
+#include <string>
+#include <unordered_map>
+
+typedef enum {TOPDOWN, MAGIC} ReasoningMode;
+
+/*
+ * Observed runtimes of the queries answered with QSQ-R and with magic sets,
+ * grouped by the shape of the query: predicate, adornment and order of
+ * magnitude of the number of bindings. Once the algorithm chosen by the
+ * estimate was measured on a shape, the next queries of that shape run with
+ * the other one until it is measured too. From then on, the faster one is
+ * chosen instead of relying on the estimate. A fraction of the queries (the
+ * exploration rate) runs with the algorithm that was measured less, so that
+ * the costs follow the changes of the KB. The costs can be stored in a text
+ * file, where the predicates are identified by name.
+ */
+class AlgoCosts {
+public:
+    struct Shape {
+        std::string pred;
+        uint8_t adornment;
+        uint8_t bindings;
+
+        Shape(const std::string &pred, const uint8_t adornment,
+              const uint8_t bindings) : pred(pred), adornment(adornment),
+            bindings(bindings) {
+        }
+
+        bool operator==(const Shape &other) const {
+            return adornment == other.adornment && bindings == other.bindings &&
+                   pred == other.pred;
+        }
+    };
+
+private:
+    //Runs of each algorithm before its cost is trusted
+    static const uint64_t MIN_RUNS = 2;
+    //The average runtime is computed over (at most) the last runs
+    static const uint64_t WINDOW = 50;
+
+    struct Cost {
+        uint64_t runs[2];
+        double msec[2];
+
+        Cost() {
+            runs[TOPDOWN] = runs[MAGIC] = 0;
+            msec[TOPDOWN] = msec[MAGIC] = 0;
+        }
+    };
+
+    struct ShapeHasher {
+        size_t operator()(const Shape &s) const {
+            return std::hash<std::string>()(s.pred) ^ ((s.adornment << 8) + s.bindings);
+        }
+    };
+
+    std::unordered_map<Shape, Cost, ShapeHasher> costs;
+    boost::mutex mutex;
+    std::minstd_rand random;
+    double exploration;
+    bool modified;
+
+public:
+    AlgoCosts() : exploration(0), modified(false) {
+    }
+
+    //nbindings is the number of tuples of bindings, if any
+    static Shape getShape(const std::string &pred, const uint8_t adornment,
+                          const size_t nbindings);
+
+    //Fraction of the queries in [0, 1] that are used to measure the algorithm
+    //with fewer runs. The default is 0.
+    void setExploration(const double rate);
+
+    //Returns false if the estimate should choose, i.e., if neither
+    //algorithm was measured enough on the shape
+    bool choose(const Shape &shape, ReasoningMode &mode);
+
+    void record(const Shape &shape, const ReasoningMode mode, const double msec);
+
+    bool isModified() {
+        return modified;
+    }
+
+    void load(const std::string &file);
+
+    void save(const std::string &file);
+};
+
+#endif
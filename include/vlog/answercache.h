@@ -0,0 +1,140 @@
+#ifndef _ANSWER_CACHE_H
+#define _ANSWER_CACHE_H
+
+#include <vlog/concepts.h>
+
+#include <boost/thread/mutex.hpp>
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class EDBLayer;
+
+/*
+ * Answers of the queries to the reasoner, kept across queries. The key is the
+ * literal of the query where the bindings are replaced by constants if there
+ * is only one of them, with the variables renamed in order of appearance.
+ * The answers always contain all the fields of the literal, so that they can
+ * be projected or sorted as each query needs.
+ *
+ * A query that is not in the cache can still be answered by filtering the
+ * answers of a more general literal, i.e., one with variables in place of
+ * some constants. The entries are evicted in LRU order when their total size,
+ * including the bindings in the keys, exceeds the budget. A budget of 0
+ * disables the cache.
+ */
+class AnswerCache {
+public:
+    struct Answers {
+        const uint8_t sizeRow;
+        std::vector<Term_t> rows;
+
+        Answers(const uint8_t sizeRow) : sizeRow(sizeRow) {
+        }
+
+        size_t getNRows() const {
+            return sizeRow == 0 ? 0 : rows.size() / sizeRow;
+        }
+
+        const Term_t *getRow(const size_t i) const {
+            return &rows[i * sizeRow];
+        }
+
+        size_t getBytes() const {
+            return sizeof(Answers) + rows.size() * sizeof(Term_t);
+        }
+    };
+
+private:
+    //Generalizations are only tried on literals with few constants
+    static const uint8_t MAX_GENERALIZED_CONSTS = 8;
+
+    struct Key {
+        PredId_t pred;
+        VTuple pattern;
+        //Positions in the literal and sorted rows of the bindings
+        std::vector<uint8_t> posBindings;
+        std::vector<Term_t> bindings;
+
+        Key(PredId_t pred, const VTuple &pattern) : pred(pred), pattern(pattern) {
+        }
+
+        bool operator==(const Key &other) const {
+            return pred == other.pred && pattern == other.pattern &&
+                   posBindings == other.posBindings && bindings == other.bindings;
+        }
+    };
+
+    struct KeyHasher {
+        size_t operator()(const Key &k) const;
+    };
+
+    typedef std::list<std::pair<Key, std::shared_ptr<const Answers>>> Entries;
+
+    boost::mutex mutex;
+    Entries entries;
+    std::unordered_map<Key, Entries::iterator, KeyHasher> index;
+    size_t budget;
+    //Size of the answers and of the bindings in the keys
+    size_t usedBytes;
+    size_t hits, subsumedHits, misses;
+    //Incremented whenever the cache is emptied
+    uint64_t generation;
+
+    //The answers are only valid for the program and the EDB layer they were
+    //computed on
+    const Program *program;
+    const EDBLayer *layer;
+    int nrules;
+
+    static VTuple normalize(const VTuple &t);
+
+    static Key getKey(const Literal &query,
+                      const std::vector<uint8_t> *posBindings,
+                      const std::vector<Term_t> *bindings);
+
+    static std::shared_ptr<const Answers> filter(const Answers &general,
+            const Key &key);
+
+    static size_t getBytes(const Key &key, const Answers &answers);
+
+    std::shared_ptr<const Answers> find(const Key &key);
+
+    //Answers of the most specific literal in the cache that is more general
+    //than key, or NULL
+    std::shared_ptr<const Answers> findGeneral(const Key &key);
+
+    void evict();
+
+    void insert(const Key &key, std::shared_ptr<const Answers> answers);
+
+public:
+    AnswerCache() : budget(0), usedBytes(0), hits(0), subsumedHits(0),
+        misses(0), generation(0), program(NULL), layer(NULL), nrules(0) {
+    }
+
+    bool isEnabled() {
+        return budget > 0;
+    }
+
+    void setBudget(const size_t bytes);
+
+    //Drops all the answers if they were computed on another program or layer
+    void setSource(const Program &program, const EDBLayer &layer);
+
+    //posBindings are the positions of the bindings in the literal. Returns
+    //NULL if no entry can answer the query
+    std::shared_ptr<const Answers> get(const Literal &query,
+                                       const std::vector<uint8_t> *posBindings,
+                                       const std::vector<Term_t> *bindings);
+
+    void put(const Literal &query, const std::vector<uint8_t> *posBindings,
+             const std::vector<Term_t> *bindings,
+             std::shared_ptr<const Answers> answers);
+
+    void clear();
+};
+
+#endif
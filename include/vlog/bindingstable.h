@@ -6,7 +6,11 @@
 
 #include <unordered_set>
 #include <functional>
+#include <cstdint>
+#include <atomic>
 #include <boost/functional/hash.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/log/trivial.hpp>
 
 struct BindingsRow {
     uint8_t size;
@@ -19,83 +23,84 @@ struct BindingsRow {
     bool operator==(const BindingsRow &other) const;
 };
 
+//Mixes the bits of a value (finalizer of MurmurHash3)
+inline uint64_t mixBindingsHash(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb3f99fd2cd53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
 struct hash_BindingsRow {
     size_t operator()(const BindingsRow &x) const {
-	size_t hash = 0;
-        for (uint8_t i = 0; i < x.size; ++i) {
-	    hash = (hash + (324723947 + x.row[i])) ^93485734985;
-	}
-	return hash;
-	/*
-        uint64_t h = 0;
-        std::hash<uint64_t> hashf;
+        uint64_t hash = x.size;
         for (uint8_t i = 0; i < x.size; ++i) {
-	    h = (h << 16) ^ ((h & 0xffff000000000000) >> 48);
-	    h = h ^ x.row[i];
-	}
-	return hashf(h);
-	*/
-	/*
-	size_t v = 0;
-        for (uint8_t i = 0; i < x.size; ++i) {
-	    boost::hash_combine(v, (uint32_t) x.row[i]);
+            hash = mixBindingsHash(hash ^ (uint64_t) x.row[i]);
         }
-        return v;
-	*/
-	/*
-        std::hash<uint64_t> hashf;
-	size_t h = 0;
-        for (uint8_t i = 0; i < x.size; ++i) {
-	    h += hashf(x.row[i]);
-	}
-	return h;
-	*/
+        return hash;
     }
 };
 
+//Number of rows of the first fragment of a RawBindings
+#define RAW_BINDINGS_FIRST_ROWS 64
+
+/*
+ * Arena of rows of fixed size. Every fragment is twice as large as the
+ * previous one, so that small tables use little memory and large tables need
+ * few allocations. The rows never move.
+ */
 class RawBindings {
 private:
     const uint8_t sizeArray;
-    const size_t sizeFrag;
     std::vector<Term_t*> arrays;
-    int arraysIdx;
-    Term_t *array;
-    size_t currentOffset;
+    size_t nrows;
+    Term_t *next;
+    size_t rowsLeft;
+
+    static int getFragment(const size_t row) {
+        return 63 - __builtin_clzll(row / RAW_BINDINGS_FIRST_ROWS + 1);
+    }
+
+    static size_t getFirstRow(const int fragment) {
+        return RAW_BINDINGS_FIRST_ROWS * ((((size_t) 1) << fragment) - 1);
+    }
+
 public:
-    RawBindings(uint8_t sizeArray) : sizeArray(sizeArray), sizeFrag(sizeArray * 1000) {
-        array = new Term_t[sizeFrag];
-        arrays.push_back(array);
-        currentOffset = 0;
-        arraysIdx = 0;
+    RawBindings(uint8_t sizeArray) : sizeArray(sizeArray), nrows(0),
+        next(NULL), rowsLeft(0) {
     }
 
     Term_t *newRow() {
-        if (currentOffset + sizeArray > sizeFrag) {
-            arraysIdx++;
-            Term_t *newArray = NULL;
-            if (arraysIdx == arrays.size()) {
-                newArray = new Term_t[sizeFrag];
-                arrays.push_back(newArray);
-            } else {
-                newArray = arrays[arraysIdx];
+        if (rowsLeft == 0) {
+            const int fragment = getFragment(nrows);
+            rowsLeft = ((size_t) RAW_BINDINGS_FIRST_ROWS) << fragment;
+            if (fragment == arrays.size()) {
+                arrays.push_back(new Term_t[rowsLeft * sizeArray]);
             }
-            currentOffset = 0;
-            array = newArray;
+            next = arrays[fragment];
         }
-        currentOffset += sizeArray;
-        return array + currentOffset - sizeArray;
+        Term_t *row = next;
+        next += sizeArray;
+        rowsLeft--;
+        nrows++;
+        return row;
     }
 
-    Term_t *getOffset(size_t idx) {
-        int seg = idx / sizeFrag;
-        int mod = idx % sizeFrag;
-        return arrays[seg] + mod;
+    Term_t *getRow(const size_t row) const {
+        const int fragment = getFragment(row);
+        return arrays[fragment] + (row - getFirstRow(fragment)) * sizeArray;
     }
 
+    uint8_t getSizeRow() const {
+        return sizeArray;
+    }
+
+    //The fragments are reused
     void clear() {
-        currentOffset = 0;
-        arraysIdx = 0;
-        array = arrays[0];
+        nrows = 0;
+        rowsLeft = 0;
     }
 
     ~RawBindings() {
@@ -105,15 +110,121 @@ public:
     }
 };
 
+/*
+ * Set of the distinct rows of a RawBindings. It is an open-addressing table
+ * with linear probing, whose slots contain the hash and the index of a row.
+ * Collisions are resolved by comparing the rows in the arena.
+ */
+class BindingsRowSet {
+private:
+    struct Slot {
+        uint32_t hash;
+        //Index of the row + 1. 0 marks an empty slot
+        uint32_t row;
+    };
+
+    std::vector<Slot> slots;
+    size_t mask;
+    size_t count;
+
+    void grow() {
+        std::vector<Slot> oldSlots(slots.size() * 2);
+        oldSlots.swap(slots);
+        mask = slots.size() - 1;
+        for (const auto &slot : oldSlots) {
+            if (slot.row != 0) {
+                size_t pos = slot.hash & mask;
+                while (slots[pos].row != 0) {
+                    pos = (pos + 1) & mask;
+                }
+                slots[pos] = slot;
+            }
+        }
+    }
+
+public:
+    BindingsRowSet() : slots(16), mask(15), count(0) {
+        for (auto &slot : slots) {
+            slot.row = 0;
+        }
+    }
+
+    //Adds the row with index idx of the arena, unless an equal row is
+    //already in the set
+    bool insert(const RawBindings &rows, const size_t idx) {
+        if (idx >= UINT32_MAX) {
+            BOOST_LOG_TRIVIAL(error) << "Too many bindings";
+            throw 10;
+        }
+        const uint8_t sizeRow = rows.getSizeRow();
+        const Term_t *row = rows.getRow(idx);
+        const uint32_t hash = (uint32_t) hash_BindingsRow()(BindingsRow(sizeRow, row));
+        size_t pos = hash & mask;
+        while (slots[pos].row != 0) {
+            if (slots[pos].hash == hash) {
+                const Term_t *other = rows.getRow(slots[pos].row - 1);
+                uint8_t i = 0;
+                while (i < sizeRow && row[i] == other[i]) {
+                    i++;
+                }
+                if (i == sizeRow) {
+                    return false;
+                }
+            }
+            pos = (pos + 1) & mask;
+        }
+        slots[pos].hash = hash;
+        slots[pos].row = (uint32_t) (idx + 1);
+        count++;
+        //Keep the load factor below 0.7
+        if (count * 10 > slots.size() * 7) {
+            grow();
+        }
+        return true;
+    }
+
+    //Used by tables with no columns, which contain at most the empty row
+    bool insertEmpty() {
+        if (count > 0) {
+            return false;
+        }
+        count = 1;
+        return true;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    void clear() {
+        for (auto &slot : slots) {
+            slot.row = 0;
+        }
+        count = 0;
+    }
+};
+
 class BindingsTable {
 private:
-    std::unordered_set<BindingsRow, hash_BindingsRow> uniqueElements;
+    BindingsRowSet uniqueElements;
     RawBindings *rawBindings;
     Term_t *currentRow;
 
     size_t nPosToCopy;
     size_t *posToCopy;
 
+    //Only the tables shared by the threads of a parallel QSQR are locked
+    bool concurrent;
+    boost::mutex mutex;
+    std::atomic<size_t> *counter;
+
+    boost::unique_lock<boost::mutex> lock() {
+        if (concurrent) {
+            return boost::unique_lock<boost::mutex>(mutex);
+        }
+        return boost::unique_lock<boost::mutex>();
+    }
+
     struct FieldsSorter {
 
         uint8_t fields[SIZETUPLE];
@@ -135,7 +246,9 @@ private:
         }
     };
 
-    void insertIfNotExists(Term_t const * const cr);
+    bool insertIfNotExists(Term_t const * const cr);
+
+    void init();
 public:
     BindingsTable(uint8_t sizeAdornment, uint8_t adornment);
 
@@ -156,7 +269,8 @@ public:
 
     void addTuple(const uint64_t *t, const uint8_t *posToCopy);
 
-    void addRawTuple(Term_t *row);
+    //Returns true if the tuple was not in the table
+    bool addRawTuple(Term_t *row);
 
     std::vector<Term_t> getProjection(std::vector<uint8_t> pos);
 
@@ -172,6 +286,16 @@ public:
     TupleTable *filter(const Literal &l, const std::vector<uint8_t> *posToFilter,
                        const std::vector<Term_t> *valuesToFilter);
 
+    //Lock the table in every access, because it is shared by several threads
+    void setConcurrent(const bool concurrent) {
+        this->concurrent = concurrent;
+    }
+
+    //The counter is incremented for every new tuple
+    void setCounter(std::atomic<size_t> *counter) {
+        this->counter = counter;
+    }
+
     size_t getSizeTuples() {
         return nPosToCopy;
     }
@@ -0,0 +1,41 @@
+#ifndef _CATALOG_FILE_H
+#define _CATALOG_FILE_H
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * Text file where a catalog of statistics is stored, one entry per line with
+ * tab-separated fields. The first line can identify what the statistics were
+ * computed on (e.g., a signature of the KB), so that stale files are ignored.
+ *
+ * Reading never fails on a corrupted file: the lines with the wrong number of
+ * fields or with invalid values are skipped with a warning. Writing replaces
+ * the file only once the new content is complete.
+ */
+class CatalogFile {
+public:
+    //Parses the fields of a line. It can throw a std::exception (e.g., the
+    //ones of std::stoull) if a value is invalid. Returns false if the entry
+    //is ignored for another reason (e.g., it refers to an unknown predicate)
+    typedef std::function<bool(const std::vector<std::string> &fields)> Parser;
+
+    //Writes the lines of the entries
+    typedef std::function<void(std::ostream &out)> Writer;
+
+    //Returns false if the file exists but its first line does not match the
+    //header (if header is not empty). count is the number of entries parsed
+    static bool read(const std::string &file, const std::string &header,
+                     const size_t nfields, Parser parse, size_t &count);
+
+    //Returns false if the file could not be written
+    static bool write(const std::string &file, const std::string &header,
+                      Writer writeEntries);
+
+    static std::vector<std::string> split(const std::string &text,
+                                          const char separator);
+};
+
+#endif
@@ -387,6 +387,21 @@ public:
 
     PredId_t getPredicateID(std::string &p, const uint8_t card);
 
+    //Does not add the predicate if it is unknown, in which case it returns
+    //false. card is 0 if the arity of the predicate is not known yet.
+    bool lookupPredicate(const std::string &p, PredId_t &id, uint8_t &card);
+
+    //Returns the known predicate with this name and arity. Fails (throws
+    //10) if it is unknown or has another arity. Does not change the program.
+    Predicate getKnownPredicate(const std::string &p, const uint8_t card,
+                                const uint8_t adornment);
+
+    //Like parseLiteral, but does not change the program, so that it can be
+    //called while other threads read it. The variables are numbered by
+    //their order in the literal. Unknown predicates and constants are
+    //rejected (throws 10).
+    Literal parseQueryLiteral(const std::string &literal);
+
     std::string getPredicateName(const PredId_t id);
 
     Predicate getPredicate(std::string &p);
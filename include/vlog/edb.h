@@ -10,12 +10,19 @@
 #include <vlog/edbtable.h>
 #include <vlog/edbiterator.h>
 #include <vlog/edbconf.h>
+#include <vlog/lrucache.h>
+#include <vlog/edbstats.h>
 
 #include <kognac/factory.h>
 
+#include <boost/thread/mutex.hpp>
+
 #include <vector>
 #include <map>
 
+// Default number of terms kept by each cache of the dictionary lookups
+#define EDB_DICT_CACHE_SIZE (1 << 18)
+
 class Column;
 class EDBMemIterator : public EDBIterator {
 private:
@@ -26,23 +33,33 @@ private:
     bool isIgnoreAllowed = true;
     PredId_t predid;
 
-    std::vector<Term_t>::iterator oneColumn;
-    std::vector<Term_t>::iterator endOneColumn;
+    const Term_t *oneColumn;
+    const Term_t *endOneColumn;
 
-    std::vector<std::pair<Term_t, Term_t>>::iterator pointerEqualFieldsNext;
-    std::vector<std::pair<Term_t, Term_t>>::iterator twoColumns;
-    std::vector<std::pair<Term_t, Term_t>>::iterator endTwoColumns;
+    const std::pair<Term_t, Term_t> *pointerEqualFieldsNext;
+    const std::pair<Term_t, Term_t> *twoColumns;
+    const std::pair<Term_t, Term_t> *endTwoColumns;
+
+    //Relations with three or more columns
+    const Term_t *rows;
+    const Term_t *endRows;
+    const Term_t *nextRow;
+    std::vector<std::pair<uint8_t, uint8_t>> repeatedFields;
 
 public:
     EDBMemIterator() {}
 
-    void init1(PredId_t id, std::vector<Term_t>*, const bool c1, const Term_t vc1);
+    void init1(PredId_t id, const SortedArray<Term_t>*, const bool c1, const Term_t vc1);
 
     void init2(PredId_t id, const bool defaultSorting,
-               std::vector<std::pair<Term_t, Term_t>>*, const bool c1,
+               const SortedArray<std::pair<Term_t, Term_t>>*, const bool c1,
                const Term_t vc1, const bool c2, const Term_t vc2,
                const bool equalFields);
 
+    void initN(PredId_t id, const uint8_t nfields, const Term_t *begin,
+               const Term_t *end,
+               const std::vector<std::pair<uint8_t, uint8_t>> &repeatedFields);
+
     void skipDuplicatedFirstColumn();
 
     bool hasNext();
@@ -75,11 +92,32 @@ private:
     Dictionary predDictionary;
     std::map<PredId_t, EDBInfoTable> dbPredicates;
 
+    //The iterators over the temporary relations can be requested by several
+    //threads (e.g., by the parallel QSQR evaluation)
     Factory<EDBMemIterator> memItrFactory;
+    boost::mutex memItrMutex;
     IndexedTupleTable *tmpRelations[MAX_NPREDS];
 
+    //Dictionary used by all the in-memory tables
+    std::shared_ptr<Dictionary> inmemoryDict;
+
+    //Recently decoded and encoded terms
+    LRUCache<uint64_t, string> textCache;
+    LRUCache<string, uint64_t> numberCache;
+
+    //Memoized cardinalities of the EDB tables, stored in statsFile
+    EDBStats stats;
+    string statsFile;
+    string statsSignature;
+    //Set by analyze, so that also the patterns with constants are stored
+    bool persistStats;
+
+    const bool multithreaded;
+
     void addTridentTable(const EDBConf::Table &tableConf, bool multithreaded);
 
+    void addInmemoryTable(const EDBConf::Table &tableConf);
+
 #ifdef MYSQL
     void addMySQLTable(const EDBConf::Table &tableConf);
 #endif
@@ -90,12 +128,30 @@ private:
     void addMAPITable(const EDBConf::Table &tableConf);
 #endif
 
+    EDBMemIterator *getMemIterator();
+
+    void releaseMemIterator(EDBMemIterator *itr);
+
+    void loadStats(EDBConf &conf);
+
+    //Versions of the tables (see EDBTable::getVersion), which change with
+    //the KB
+    string computeStatsSignature();
+
+    EDBMemIterator *getTmpIterator(IndexedTupleTable *rel,
+                                   const Literal &query,
+                                   const std::vector<uint8_t> &fields);
+
 public:
-    EDBLayer(EDBConf &conf, bool multithreaded) {
+    EDBLayer(EDBConf &conf, bool multithreaded) :
+        textCache(EDB_DICT_CACHE_SIZE), numberCache(EDB_DICT_CACHE_SIZE),
+        persistStats(false), multithreaded(multithreaded) {
         const std::vector<EDBConf::Table> tables = conf.getTables();
         for (const auto &table : tables) {
             if (table.type == "Trident") {
                 addTridentTable(table, multithreaded);
+            } else if (table.type == "INMEMORY") {
+                addInmemoryTable(table);
 #ifdef MYSQL
             } else if (table.type == "MySQL") {
                 addMySQLTable(table);
@@ -117,6 +173,13 @@ public:
         for (int i = 0; i < MAX_NPREDS; ++i) {
             tmpRelations[i] = NULL;
         }
+
+        loadStats(conf);
+    }
+
+    //The tables can be queried by several threads at the same time
+    bool isMultithreaded() const {
+        return multithreaded;
     }
 
     void addTmpRelation(Predicate &pred, IndexedTupleTable *table);
@@ -190,6 +253,18 @@ public:
 
     bool getDictText(const uint64_t id, char *text);
 
+    //Decode many IDs with as few lookups as possible. Returns false if some
+    //IDs were not found (their text is left empty)
+    bool getDictTexts(const std::vector<uint64_t> &ids,
+                      std::vector<string> &texts);
+
+    //Number of terms kept by each of the caches of the dictionary. 0
+    //disables the caches.
+    void setDictCacheSize(const size_t size) {
+        textCache.setCapacity(size);
+        numberCache.setCapacity(size);
+    }
+
     Predicate getDBPredicate(int idx);
 
     std::shared_ptr<EDBTable> getEDBTable(PredId_t id) {
@@ -212,7 +287,22 @@ public:
 
     void releaseIterator(EDBIterator *itr);
 
+    //Compute the cardinalities of all the EDB tables, of their columns, and
+    //of the patterns with a constant in a column with at most maxDistinct
+    //values. The statistics are then stored next to the KB.
+    void analyze(const size_t maxDistinct);
+
+    //Store the statistics that were computed so far
+    void saveStats();
+
+    //Identifies the content of the KB when the layer was opened. Other
+    //statistics computed on the KB can use it to detect that it changed.
+    const string &getStatsSignature() const {
+        return statsSignature;
+    }
+
     ~EDBLayer() {
+        saveStats();
         for (int i = 0; i < MAX_NPREDS; ++i) {
             if (tmpRelations[i] != NULL) {
                 delete tmpRelations[i];
@@ -17,15 +17,20 @@ public:
 
 private:
     std::vector<Table> tables;
+    string path;
 
     void parse(string f);
 
 public:
 
-    EDBConf(string f) {
+    EDBConf(string f) : path(f) {
         parse(f);
     }
 
+    const string &getPath() const {
+        return path;
+    }
+
     const std::vector<Table> &getTables() {
         return tables;
     }
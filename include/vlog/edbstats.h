@@ -0,0 +1,96 @@
+#ifndef _EDB_STATS_H
+#define _EDB_STATS_H
+
+#include <vlog/concepts.h>
+#include <vlog/support.h>
+
+#include <boost/thread/shared_mutex.hpp>
+
+#include <string>
+#include <unordered_map>
+
+/*
+ * Catalog of the cardinalities of the EDB tables. The entries are keyed by
+ * the pattern of a literal, i.e., its predicate and its constants, while the
+ * names of the variables only matter when they are repeated. The catalog can
+ * be stored in a text file, where the predicates are identified by name.
+ *
+ * The catalog keeps at most MAX_ENTRIES entries. Only the patterns without
+ * constants and the entries computed by "analyze" are stored in the file,
+ * together with a signature of the KB: if the KB changes, the file is dropped.
+ */
+class EDBStats {
+public:
+    //Kinds of statistics. A value >= 0 is the number of distinct values in
+    //that position (see getCardinalityColumn).
+    static const int CARDINALITY = -1;
+    static const int ESTIMATE = -2;
+
+    static const size_t MAX_ENTRIES = 1000000;
+
+private:
+    struct Key {
+        PredId_t pred;
+        int kind;
+        VTuple pattern;
+
+        Key(PredId_t pred, int kind, const VTuple &pattern) : pred(pred),
+            kind(kind), pattern(pattern) {
+        }
+
+        bool operator==(const Key &other) const {
+            return pred == other.pred && kind == other.kind &&
+                   pattern == other.pattern;
+        }
+    };
+
+    struct KeyHasher {
+        size_t operator()(const Key &k) const {
+            return hash_VTuple()(k.pattern) ^ (k.pred * 31 + k.kind);
+        }
+    };
+
+    struct Entry {
+        uint64_t value;
+        //Stored in the file
+        bool persistent;
+    };
+
+    std::unordered_map<Key, Entry, KeyHasher> entries;
+    boost::shared_mutex mutex;
+    bool modified;
+    bool full;
+
+    static Key getKey(const Literal &query, const int kind);
+
+    void insert(const Key &key, const Entry &entry);
+
+public:
+    EDBStats() : modified(false), full(false) {
+    }
+
+    bool get(const Literal &query, const int kind, uint64_t &value);
+
+    //The entries of patterns with constants are stored in the file only if
+    //persistent is true
+    void put(const Literal &query, const int kind, const uint64_t value,
+             const bool persistent = false);
+
+    size_t size();
+
+    void clear();
+
+    bool isModified() {
+        return modified;
+    }
+
+    //Entries of predicates that are not in the dictionary are skipped. The
+    //file is removed if it was computed on a KB with a different signature.
+    void load(const std::string &file, const std::string &signature,
+              Dictionary &predicates);
+
+    void save(const std::string &file, const std::string &signature,
+              Dictionary &predicates);
+};
+
+#endif
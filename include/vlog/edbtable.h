@@ -48,7 +48,35 @@ public:
 
     virtual bool getDictText(const uint64_t id, char *text) = 0;
 
+    //Decode many IDs at once. Returns false if some IDs were not found
+    //(their text is left empty). Tables that can do better than one lookup
+    //per ID should override it.
+    virtual bool getDictTexts(const std::vector<uint64_t> &ids,
+                              std::vector<string> &texts) {
+        char text[MAX_TERM_SIZE];
+        bool allFound = true;
+        texts.clear();
+        for (const auto id : ids) {
+            if (getDictText(id, text)) {
+                texts.push_back(string(text));
+            } else {
+                texts.push_back("");
+                allFound = false;
+            }
+        }
+        return allFound;
+    }
+
     virtual uint64_t getNTerms() = 0;
+
+    //Identifies the version of the content of the table, so that the stored
+    //statistics can be dropped when the table changes. It must be cheap to
+    //compute (no scans or queries). Tables that cannot tell, like remote
+    //databases, return an empty string: their statistics are refreshed only
+    //by analyze.
+    virtual string getVersion() {
+        return "";
+    }
 };
 
 
@@ -4,40 +4,117 @@
 #include <vlog/qsqquery.h>
 #include <trident/model/table.h>
 
+#include <boost/thread/mutex.hpp>
+
 #include <vector>
+#include <memory>
+#include <atomic>
 #include <algorithm>
 #include <google/dense_hash_set>
 
 typedef google::dense_hash_set<Term_t, std::hash<Term_t>, std::equal_to<Term_t>> GoogleSet;
 
+//Sorted values of a relation. They are either owned by the array, or stored
+//in a memory mapping that is owned by the table.
+template<typename T>
+class SortedArray {
+private:
+    std::vector<T> values;
+    const T *first;
+    const T *last;
+
+public:
+    SortedArray() : first(NULL), last(NULL) {
+    }
+
+    //Takes the content of v
+    void assign(std::vector<T> &v) {
+        values.swap(v);
+        first = values.data();
+        last = first + values.size();
+    }
+
+    void adopt(const T *begin, const size_t n) {
+        values.clear();
+        first = begin;
+        last = begin + n;
+    }
+
+    const T *begin() const {
+        return first;
+    }
+
+    const T *end() const {
+        return last;
+    }
+
+    const T *data() const {
+        return first;
+    }
+
+    size_t size() const {
+        return last - first;
+    }
+};
+
 class IndexedTupleTable {
 
+public:
+    //Copy of a relation with three or more columns. The rows keep the
+    //original order of the columns, but they are sorted by the columns in
+    //fields.
+    struct Permutation {
+        std::vector<uint8_t> fields;
+        SortedArray<Term_t> rows;
+    };
+
 private:
     const uint8_t sizeTuple;
-    std::vector<Term_t> *singleColumn;
+    SortedArray<Term_t> *singleColumn;
+
+    SortedArray<std::pair<Term_t, Term_t>> *twoColumn1;
+    SortedArray<std::pair<Term_t, Term_t>> *twoColumn2;
+
+    //Mapping with the values of the table (see writeMapping). It is NULL if
+    //the table owns copies of the values.
+    char *mapping;
+    size_t mappingSize;
+
+    //Permutations of the relations with three or more columns. They are
+    //created when a query needs them, except for the first permutation,
+    //which sorts by all the columns in order.
+    std::vector<std::unique_ptr<Permutation>> permutations;
+    size_t nrows;
 
-    std::vector<std::pair<Term_t, Term_t>> *twoColumn1;
-    std::unique_ptr<GoogleSet> setColumn1;
-    std::vector<std::pair<Term_t, Term_t>> *twoColumn2;
-    std::unique_ptr<GoogleSet> setColumn2;
+    //Distinct values of every column, created on first use. They can be
+    //read without locking, since concurrent queries check them often.
+    std::vector<std::atomic<GoogleSet*>> columnSets;
+    boost::mutex mutex;
 
-    TupleTable *spo;
-    TupleTable *pos;
-    TupleTable *osp;
+    const Permutation *getPermutation(const std::vector<uint8_t> &fields,
+                                      const uint8_t nfixed);
 
-    std::unique_ptr<GoogleSet> fillSet(std::vector<Term_t> &v) {
+    GoogleSet *getColumnSet(const uint8_t colid);
+
+    void init();
+
+    //get(i, j) returns the value of the ith row in the jth column
+    template<typename Get>
+    void load(Get get);
+
+    std::unique_ptr<GoogleSet> fillSet(const SortedArray<Term_t> &v) {
         std::unique_ptr<GoogleSet> ptr1(new GoogleSet());
         ptr1->set_empty_key((Term_t) -1);
-        for (std::vector<Term_t>::iterator itr = v.begin(); itr != v.end(); ++itr) {
+        for (const Term_t *itr = v.begin(); itr != v.end(); ++itr) {
             ptr1->insert(*itr);
         }
         return ptr1;
     }
 
-    std::unique_ptr<GoogleSet> fillSet(std::vector<std::pair<Term_t, Term_t>> &v, const uint8_t pos) {
+    std::unique_ptr<GoogleSet> fillSet(const SortedArray<std::pair<Term_t, Term_t>> &v, const uint8_t pos) {
         std::unique_ptr<GoogleSet> ptr1(new GoogleSet());
         ptr1->set_empty_key((Term_t) -1);
-        for (std::vector<std::pair<Term_t, Term_t>>::iterator itr = v.begin(); itr != v.end(); ++itr) {
+        for (const std::pair<Term_t, Term_t> *itr = v.begin(); itr != v.end(); ++itr) {
             if (pos == 0) {
                 ptr1->insert(itr->first);
             } else {
@@ -50,13 +127,25 @@ private:
 public:
     IndexedTupleTable(TupleTable *table);
 
+    //Uses the values written by writeMapping without copying them. The table
+    //unmaps the mapping when it is destroyed.
+    IndexedTupleTable(char *mapping, const size_t size);
+
+    //A mapping contains the arity and the number of rows (64 bits each),
+    //followed by the values sorted as the table keeps them: the column, the
+    //two sortings of the pairs, or the rows of the first permutation.
+    static size_t getMappingSize(const uint8_t sizeTuple, const size_t nrows);
+
+    //mapping must have getMappingSize bytes
+    static void writeMapping(TupleTable *table, char *mapping);
+
     ~IndexedTupleTable();
 
     uint8_t getSizeTuple() const {
         return sizeTuple;
     }
 
-    std::vector<Term_t> *getSingleColumn() {
+    const SortedArray<Term_t> *getSingleColumn() {
         return singleColumn;
     }
 
@@ -66,81 +155,37 @@ public:
         } else if (sizeTuple == 2) {
             return twoColumn1->size();
         } else {
-            return spo->getNRows();
+            return nrows;
         }
     }
 
     size_t size(uint8_t colid) {
-	if (colid == 0) {
-	    if (setColumn1 == NULL) {
-		if (sizeTuple == 1) {
-		    setColumn1 = fillSet(*singleColumn);
-		} else {
-                    setColumn1 = fillSet(*twoColumn1, 0);
-		}
-	    }
-	    return setColumn1->size();
-	} else {
-	    if (setColumn2 == NULL) {
-		setColumn2 = fillSet(*twoColumn1, 1);
-	    }
-	    return setColumn2->size();
-	}
+        return getColumnSet(colid)->size();
     }
 
     bool exists(const Term_t value) {
 	assert(sizeTuple == 1);
-        if (setColumn1 == NULL) {
-            setColumn1 = fillSet(*singleColumn);
-        }
-        return setColumn1->find(value) != setColumn1->end();
+        GoogleSet *set = getColumnSet(0);
+        return set->find(value) != set->end();
     }
 
     bool exists(const uint8_t colid, const Term_t value) {
-        if (sizeTuple == 1) {
-            return exists(value);
-        } else if (sizeTuple == 2) {
-            if (colid == 0) {
-                if (setColumn1 == NULL) {
-                    setColumn1 = fillSet(*twoColumn1, 0);
-                }
-                return setColumn1->find(value) != setColumn1->end();
-
-                /*for (std::vector<std::pair<Term_t, Term_t>>::iterator itr = twoColumn1->begin();
-                        itr != twoColumn1->end(); ++itr) {
-                    if (itr->first > value) {
-                        return false;
-                    } else if (itr->first == value) {
-                        return true;
-                    }
-                }*/
-            } else {
-                if (setColumn2 == NULL) {
-                    setColumn2 = fillSet(*twoColumn1, 1);
-                }
-                return setColumn2->find(value) != setColumn2->end();
-
-                /*for (std::vector<std::pair<Term_t, Term_t>>::iterator itr = twoColumn2->begin();
-                        itr != twoColumn2->end(); ++itr) {
-                    if (itr->second > value) {
-                        return false;
-                    } else if (itr->second == value) {
-                        return true;
-                    }
-                }*/
-            }
-            return false;
-        } else {
-            //not supported
-            throw 10;
-        }
+        GoogleSet *set = getColumnSet(colid);
+        return set->find(value) != set->end();
     }
 
-    std::vector<std::pair<Term_t, Term_t>> *getTwoColumn1() {
+    //Returns the rows of a relation with three or more columns that have the
+    //given values in the given positions. The rows are sorted by the
+    //constant positions first, and then by the fields in sortFields.
+    void getRows(const std::vector<std::pair<uint8_t, Term_t>> &constants,
+                 const std::vector<uint8_t> &sortFields,
+                 const Term_t *&begin, const Term_t *&end);
+
+    const SortedArray<std::pair<Term_t, Term_t>> *getTwoColumn1() {
         return twoColumn1;
     }
 
-    std::vector<std::pair<Term_t, Term_t>> *getTwoColumn2() {
+    const SortedArray<std::pair<Term_t, Term_t>> *getTwoColumn2() {
         return twoColumn2;
     }
 };
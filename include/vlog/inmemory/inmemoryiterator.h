@@ -0,0 +1,54 @@
+#ifndef _INMEMORYITERATOR_H
+#define _INMEMORYITERATOR_H
+
+#include <vlog/edbiterator.h>
+#include <vlog/concepts.h>
+#include <vlog/consts.h>
+
+#include <memory>
+#include <vector>
+
+class InmemoryIterator : public EDBIterator {
+private:
+    PredId_t predid;
+
+    const Term_t * const *columns;
+    std::shared_ptr<const std::vector<size_t>> idx;
+    size_t current;
+    size_t nextIdx;
+    size_t end;
+
+    std::vector<std::pair<uint8_t, uint8_t>> repeated;
+
+    bool hasNextChecked;
+    bool hasNextValue;
+    bool isFirst;
+    bool skipDuplicatedFirst;
+    int posFirstVar;
+
+public:
+    InmemoryIterator(const Term_t * const *columns,
+                     std::shared_ptr<const std::vector<size_t>> idx,
+                     const size_t start, const size_t end,
+                     const Literal &query,
+                     const std::vector<uint8_t> &order);
+
+    bool hasNext();
+
+    void next();
+
+    void clear();
+
+    void skipDuplicatedFirstColumn();
+
+    PredId_t getPredicateID() {
+        return predid;
+    }
+
+    Term_t getElementAt(const uint8_t p);
+
+    ~InmemoryIterator() {
+    }
+};
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef _INMEMORY_TABLE_H
+#define _INMEMORY_TABLE_H
+
+#include <vlog/inmemory/inmemoryiterator.h>
+#include <vlog/column.h>
+#include <vlog/edbtable.h>
+#include <vlog/support.h>
+
+#include <boost/thread/mutex.hpp>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+/*
+ * EDB table that keeps the content of one or more delimited (CSV/TSV) files
+ * in main memory. The files are parsed in parallel, all strings are encoded
+ * with a dictionary, and the table is stored column by column. The sorted
+ * permutations that are needed by getSortedIterator are created on demand
+ * and kept for later use.
+ *
+ * In CSV files, a field can be enclosed in double quotes (a quote inside it
+ * is written twice) to contain commas, but not newlines. A field that starts
+ * with a quote and does not end with one, e.g. "abc"@en, is read verbatim.
+ * Empty fields are not supported, since the empty string cannot be encoded.
+ */
+class InmemoryTable : public EDBTable {
+private:
+    const PredId_t predid;
+    uint8_t arity;
+    size_t nrows;
+    //The columns are either loaded in ownedColumns or provided by a subclass
+    std::vector<Term_t> ownedColumns[SIZETUPLE];
+    const Term_t *columns[SIZETUPLE];
+
+    //Dictionary shared among all the in-memory tables of the EDB layer
+    std::shared_ptr<Dictionary> dict;
+
+    //Sizes and modification times of the loaded files
+    string version;
+
+    //Row indices sorted by a permutation of the columns
+    std::map<std::vector<uint8_t>, std::shared_ptr<const std::vector<size_t>>> sortedIdxs;
+    boost::mutex mutex;
+
+    void load(const std::vector<string> &files, const string &separator);
+
+    std::vector<uint8_t> getSortOrder(const Literal &query,
+                                      const std::vector<uint8_t> &posFields) const;
+
+    std::shared_ptr<const std::vector<size_t>> getSortedIdx(
+                const std::vector<uint8_t> &order);
+
+    std::pair<size_t, size_t> getRange(const Literal &query,
+                                       const std::vector<uint8_t> &order,
+                                       const std::vector<size_t> &idx) const;
+
+    InmemoryIterator *getInmemoryIterator(const Literal &query,
+                                          const std::vector<uint8_t> &posFields);
+
+    bool exists(const Literal &query);
+
+    static char getSeparator(const string &file, const string &param);
+
+protected:
+    //Used by the subclasses that store the columns elsewhere. They must
+    //call setColumns before the table is used.
+    InmemoryTable(PredId_t predid);
+
+    void setColumns(const uint8_t arity, const size_t nrows,
+                    const Term_t * const *columns);
+
+public:
+    InmemoryTable(PredId_t predid, string repository, string tablename,
+                  string separator, std::shared_ptr<Dictionary> dict);
+
+    uint8_t getArity() const {
+        return arity;
+    }
+
+    std::vector<std::shared_ptr<Column>> checkNewIn(const Literal &l1,
+                                      std::vector<uint8_t> &posInL1,
+                                      const Literal &l2,
+                                      std::vector<uint8_t> &posInL2);
+
+    std::vector<std::shared_ptr<Column>> checkNewIn(
+                                          std::vector <
+                                          std::shared_ptr<Column >> &checkValues,
+                                          const Literal &l2,
+                                          std::vector<uint8_t> &posInL2);
+
+    std::shared_ptr<Column> checkIn(
+        std::vector<Term_t> &values,
+        const Literal &l2,
+        uint8_t posInL2,
+        size_t &sizeOutput);
+
+    void query(QSQQuery *query, TupleTable *outputTable,
+               std::vector<uint8_t> *posToFilter,
+               std::vector<Term_t> *valuesToFilter);
+
+    size_t estimateCardinality(const Literal &query);
+
+    size_t getCardinality(const Literal &query);
+
+    size_t getCardinalityColumn(const Literal &query, uint8_t posColumn);
+
+    bool isEmpty(const Literal &query, std::vector<uint8_t> *posToFilter,
+                 std::vector<Term_t> *valuesToFilter);
+
+    EDBIterator *getIterator(const Literal &query);
+
+    EDBIterator *getSortedIterator(const Literal &query,
+                                   const std::vector<uint8_t> &fields);
+
+    void releaseIterator(EDBIterator *itr);
+
+    bool getDictNumber(const char *text, const size_t sizeText,
+                       uint64_t &id);
+
+    bool getDictText(const uint64_t id, char *text);
+
+    uint64_t getNTerms();
+
+    string getVersion() {
+        return version;
+    }
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef _LRU_CACHE_H
+#define _LRU_CACHE_H
+
+#include <boost/thread/mutex.hpp>
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Default number of independent shards of a LRUCache
+#define LRU_CACHE_SHARDS 16
+
+/*
+ * Thread-safe cache that evicts the least recently used entries. The keys are
+ * spread over independent shards, each with its own lock, so that concurrent
+ * lookups seldom contend. A cache with capacity 0 stores nothing.
+ */
+template<typename K, typename V, typename H = std::hash<K>>
+class LRUCache {
+private:
+    typedef std::list<std::pair<K, V>> Entries;
+
+    struct Shard {
+        boost::mutex mutex;
+        //The most recently used entry is the first one
+        Entries entries;
+        std::unordered_map<K, typename Entries::iterator, H> index;
+        size_t capacity;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    H hasher;
+
+    Shard &getShard(const K &key) {
+        const size_t h = hasher(key);
+        //The maps in the shards use the same hash function
+        return *shards[(h ^ (h >> 17)) % shards.size()];
+    }
+
+public:
+    LRUCache(const size_t capacity, const size_t nshards = LRU_CACHE_SHARDS) {
+        for (size_t i = 0; i < nshards; ++i) {
+            shards.push_back(std::unique_ptr<Shard>(new Shard()));
+        }
+        setCapacity(capacity);
+    }
+
+    //Existing entries are evicted lazily
+    void setCapacity(const size_t capacity) {
+        const size_t perShard = (capacity + shards.size() - 1) / shards.size();
+        for (auto &shard : shards) {
+            boost::mutex::scoped_lock lock(shard->mutex);
+            shard->capacity = perShard;
+        }
+    }
+
+    bool get(const K &key, V &value) {
+        Shard &shard = getShard(key);
+        boost::mutex::scoped_lock lock(shard.mutex);
+        auto itr = shard.index.find(key);
+        if (itr == shard.index.end()) {
+            return false;
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, itr->second);
+        value = itr->second->second;
+        return true;
+    }
+
+    void put(const K &key, const V &value) {
+        Shard &shard = getShard(key);
+        boost::mutex::scoped_lock lock(shard.mutex);
+        if (shard.capacity == 0) {
+            return;
+        }
+        auto itr = shard.index.find(key);
+        if (itr != shard.index.end()) {
+            itr->second->second = value;
+            shard.entries.splice(shard.entries.begin(), shard.entries,
+                                 itr->second);
+            return;
+        }
+        while (shard.index.size() >= shard.capacity) {
+            shard.index.erase(shard.entries.back().first);
+            shard.entries.pop_back();
+        }
+        shard.entries.push_front(std::make_pair(key, value));
+        shard.index.insert(std::make_pair(key, shard.entries.begin()));
+    }
+
+    void clear() {
+        for (auto &shard : shards) {
+            boost::mutex::scoped_lock lock(shard->mutex);
+            shard->index.clear();
+            shard->entries.clear();
+        }
+    }
+};
+
+#endif
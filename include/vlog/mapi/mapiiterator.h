@@ -1,51 +1,36 @@
 #ifndef _MAPIITERATOR_H
 #define _MAPIITERATOR_H
 
-#include <vlog/edbiterator.h>
+#include <vlog/sqliterator.h>
 #include <vlog/concepts.h>
 #include <vlog/consts.h>
 
 #include <monetdb/mapi.h>
 
-class MAPIIterator : public EDBIterator {
+class MAPITable;
+class MAPIIterator : public SQLIterator {
 private:
-    PredId_t predid;
-
-    bool hasNextChecked;
-    bool hasNextValue;
-    bool isFirst;
-    bool skipDuplicatedFirst;
-    int posFirstVar;
     int columns;
     uint64_t *values;
     MapiHdl handle = NULL;
 
+    void init(Mapi con, string sqlQuery);
+
+protected:
+    size_t fetchRows(std::vector<std::vector<Term_t>> &columns,
+                     const size_t maxRows);
+
 public:
-    MAPIIterator(Mapi con,
-                  string tableName,
+    MAPIIterator(MAPITable *table,
                   const Literal &query,
-                  const std::vector<string> &fieldsTable,
                   const std::vector<uint8_t> *sortingFieldsIdx);
 
-    MAPIIterator(Mapi con,
+    MAPIIterator(MAPITable *table,
 	    string sqlquery,
-	    const std::vector<string> &fieldsTable,
 	    const Literal &query);
 
-    bool hasNext();
-
-    void next();
-
     void clear();
 
-    void skipDuplicatedFirstColumn();
-
-    PredId_t getPredicateID() {
-        return predid;
-    }
-
-    Term_t getElementAt(const uint8_t p);
-
     ~MAPIIterator();
 };
 
@@ -6,22 +6,45 @@
 
 #include <monetdb/mapi.h>
 
+#include <memory>
+
 class MAPITable : public SQLTable {
 private:
-    Mapi con;
+    //A connection of the pool with its prepared statements. The parameters
+    //are bound by address, so the objects must not move.
+    struct Connection {
+        Mapi con;
+        MapiHdl dictTextHdl;
+        MapiHdl dictNumberHdl;
+        uint64_t dictTextParam;
+        char dictNumberParam[MAX_TERM_SIZE];
+        int dictNumberParamSize;
+    };
+    std::vector<std::unique_ptr<Connection>> cons;
+
+    static void checkPrepared(Mapi dbh, MapiHdl hdl);
+
+protected:
+    void executeUpdate(const string &sqlQuery);
+
+    EDBIterator *executeQuery(const string &sqlQuery, const Literal &query);
+
+    void executeDictQuery(const string &sqlQuery,
+                          std::vector<std::pair<uint64_t, string>> &output);
 
 public:
     MAPITable(string host, int port, string user, string pwd, string dbname,
-	                           string tablename, string tablefields);
+	                           string tablename, string tablefields,
+	                           size_t fetchSize, size_t poolSize);
+
+    Mapi getConnection(const size_t idx) {
+        return cons[idx]->con;
+    }
 
     static MapiHdl doquery(Mapi dbh, string q);
     
     static void update(Mapi dbh, string q);
 
-    void query(QSQQuery *query, TupleTable *outputTable,
-               std::vector<uint8_t> *posToFilter,
-               std::vector<Term_t> *valuesToFilter);
-
     size_t getCardinality(const Literal &query);
 
     size_t getCardinalityColumn(const Literal &query, uint8_t posColumn);
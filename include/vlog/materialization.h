@@ -12,10 +12,24 @@ class Materialization {
 
 private:
     bool repeatPrematerialization;
+    bool inProcess;
     std::vector<Literal> prematerializedLiterals;
     std::vector<Literal> edbLiterals;
 
     static bool evaluateQueryThreadedVersion(EDBLayer *kb,
+            Program *p,
+            QSQQuery *q,
+            IndexedTupleTable **output,
+            long timeoutMicros);
+
+    //Used when the results of a forked query cannot be shared
+    static bool evaluateQueryWithoutFork(EDBLayer *kb,
+            Program *p,
+            QSQQuery *q,
+            IndexedTupleTable **output,
+            long timeoutMicros);
+
+    static bool evaluateQueryInProcess(EDBLayer *kb,
             Program *p,
             QSQQuery *q,
             TupleTable **output,
@@ -24,11 +38,28 @@ private:
     bool execMatQuery(Literal &l, bool timeout, EDBLayer &kb,
                       Program &p, int &predIdx, long timeoutMicros);
 
+    void storeMatQuery(Literal &l, IndexedTupleTable *output, EDBLayer &kb,
+                       Program &p, int &predIdx);
+
+    //Evaluates all the literals at the same time, then stores the results
+    //and rewrites the program. Returns the number of successful queries.
+    int execMatQueriesInProcess(std::vector<Literal> &literals, bool timeout,
+                                EDBLayer &kb, Program &p, int &predIdx,
+                                long timeoutMicros,
+                                std::vector<Literal> &failedQueries);
+
     bool cardIsTooLarge(const Literal &lit, Program &p, EDBLayer &layer);
 
 public:
 
-    Materialization() : repeatPrematerialization(false) {}
+    Materialization() : repeatPrematerialization(false), inProcess(false) {}
+
+    //In-process mode: the queries run concurrently in this process (if the
+    //EDB layer is multithreaded) and are cancelled when they time out.
+    //Otherwise, a query with a timeout runs in a forked process.
+    void setInProcess(const bool inProcess) {
+        this->inProcess = inProcess;
+    }
 
     void loadLiteralsFromFile(Program &p, std::string filePath);
 
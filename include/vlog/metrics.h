@@ -0,0 +1,78 @@
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <boost/chrono.hpp>
+
+#include <atomic>
+#include <ostream>
+#include <string>
+
+/*
+ * Distribution of durations over fixed buckets, in seconds, as in the
+ * histograms of Prometheus.
+ */
+class Histogram {
+private:
+    static const int NBUCKETS = 12;
+    static const double bounds[NBUCKETS];
+
+    //The last bucket counts the observations above all bounds
+    std::atomic<uint64_t> counts[NBUCKETS + 1];
+    std::atomic<uint64_t> sumMicros;
+
+public:
+    Histogram();
+
+    void observe(const double sec);
+
+    void write(std::ostream &out, const std::string &name,
+               const std::string &labels) const;
+};
+
+/*
+ * Counters of the materialization, of the joins and of the queries, shared
+ * by all the instances of the reasoner in the process. They are updated with
+ * relaxed atomic operations, so that they can always be collected. write()
+ * prints them in the text exposition format of Prometheus.
+ */
+class Metrics {
+public:
+    typedef enum {JOIN_VERIFICATIVE, JOIN_TWO_TO_ONE, JOIN_HASH, JOIN_MERGE,
+                  N_JOIN_ALGOS
+                 } JoinAlgo;
+
+    std::atomic<uint64_t> rulesExecuted;
+    std::atomic<uint64_t> rulesProductive;
+    std::atomic<uint64_t> derivations;
+    std::atomic<uint64_t> joins[N_JOIN_ALGOS];
+    std::atomic<uint64_t> joinMicros[N_JOIN_ALGOS];
+    std::atomic<uint64_t> retainMicros;
+    std::atomic<uint64_t> consolidationMicros;
+
+    //Queries answered by the reasoner, with QSQ-R and with magic sets
+    Histogram reasonerLatency[2];
+    //SPARQL queries received by the web interface
+    Histogram sparqlLatency;
+
+private:
+    Metrics();
+
+public:
+    static Metrics &get();
+
+    static void add(std::atomic<uint64_t> &counter, const uint64_t value) {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    static void addTime(std::atomic<uint64_t> &counter,
+                        const boost::chrono::duration<double> &sec) {
+        add(counter, (uint64_t) (sec.count() * 1000000));
+    }
+
+    static void writeHeader(std::ostream &out, const std::string &name,
+                            const std::string &type, const std::string &help);
+
+    void write(std::ostream &out) const;
+};
+
+#endif
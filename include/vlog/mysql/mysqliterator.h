@@ -1,7 +1,7 @@
 #ifndef _MYSQLITERATOR_H
 #define _MYSQLITERATOR_H
 
-#include <vlog/edbiterator.h>
+#include <vlog/sqliterator.h>
 #include <vlog/concepts.h>
 #include <vlog/consts.h>
 
@@ -12,44 +12,29 @@
 #include <cppconn/resultset.h>
 #include <cppconn/statement.h>
 
-class MySQLIterator : public EDBIterator {
+class MySQLTable;
+class MySQLIterator : public SQLIterator {
 private:
-    PredId_t predid;
-
-    bool hasNextChecked;
-    bool hasNextValue;
-    bool isFirst;
-    bool skipDuplicatedFirst;
-    int posFirstVar;
-
     sql::Statement *stmt;
     sql::ResultSet *res;
 
+    void init(sql::Connection *con, string sqlQuery);
+
+protected:
+    size_t fetchRows(std::vector<std::vector<Term_t>> &columns,
+                     const size_t maxRows);
+
 public:
-    MySQLIterator(sql::Connection *con,
-                  string tableName,
+    MySQLIterator(MySQLTable *table,
                   const Literal &query,
-                  const std::vector<string> &fieldsTable,
                   const std::vector<uint8_t> *sortingFieldsIdx);
 
-    MySQLIterator(sql::Connection *con,
+    MySQLIterator(MySQLTable *table,
                   string sqlQuery,
                   const Literal &query);
 
-    bool hasNext();
-
-    void next();
-
     void clear();
 
-    void skipDuplicatedFirstColumn();
-
-    PredId_t getPredicateID() {
-        return predid;
-    }
-
-    Term_t getElementAt(const uint8_t p);
-
     ~MySQLIterator();
 };
 
@@ -10,6 +10,7 @@
 #include <cppconn/exception.h>
 #include <cppconn/resultset.h>
 #include <cppconn/statement.h>
+#include <cppconn/prepared_statement.h>
 
 #define MYSQLCALL(stat) \
     try { \
@@ -26,15 +27,26 @@
 class MySQLTable : public SQLTable {
 private:
     sql::Driver *driver;
-    sql::Connection *con;
+    std::vector<sql::Connection *> cons;
+    std::vector<sql::PreparedStatement *> dictTextStmts;
+    std::vector<sql::PreparedStatement *> dictNumberStmts;
+
+protected:
+    void executeUpdate(const string &sqlQuery);
+
+    EDBIterator *executeQuery(const string &sqlQuery, const Literal &query);
+
+    void executeDictQuery(const string &sqlQuery,
+                          std::vector<std::pair<uint64_t, string>> &output);
 
 public:
     MySQLTable(string host, string user, string pwd, string dbname,
-               string tablename, string tablefields);
+               string tablename, string tablefields, size_t fetchSize,
+               size_t poolSize);
 
-    void query(QSQQuery *query, TupleTable *outputTable,
-               std::vector<uint8_t> *posToFilter,
-               std::vector<Term_t> *valuesToFilter);
+    sql::Connection *getConnection(const size_t idx) {
+        return cons[idx];
+    }
 
     size_t getCardinality(const Literal &query);
 
@@ -55,13 +67,7 @@ public:
 
     uint64_t getNTerms();
 
-    ~MySQLTable() {
-        if (con) {
-	    con->close();
-            delete con;
-	    con = NULL;
-	}
-    }
+    ~MySQLTable();
 };
 
 #endif
@@ -1,7 +1,7 @@
 #ifndef _ODBCITERATOR_H
 #define _ODBCITERATOR_H
 
-#include <vlog/edbiterator.h>
+#include <vlog/sqliterator.h>
 #include <vlog/concepts.h>
 #include <vlog/consts.h>
 
@@ -9,46 +9,44 @@
 #include <sqltypes.h>
 #include <sqlext.h>
 
-class ODBCIterator : public EDBIterator {
+/*
+ * The columns are bound to arrays of rowSetSize values, so that every call to
+ * SQLFetch returns a whole row set, which is copied column by column in the
+ * buffers of the iterator.
+ */
+class ODBCTable;
+class ODBCIterator : public SQLIterator {
 private:
-    PredId_t predid;
-
-    bool hasNextChecked;
-    bool hasNextValue;
-    bool isFirst;
-    bool skipDuplicatedFirst;
-    int posFirstVar;
     SQLSMALLINT columns;
+    //Column-wise bound arrays: the values of column i start at
+    //i * rowSetSize
     SQLLEN *indicator;
     SQLUBIGINT *values;
+    SQLULEN rowSetSize;
+    SQLULEN rowsFetched;
+    //Rows of the current row set that were already returned
+    SQLULEN rowsConsumed;
+    bool noMoreData;
 
     SQLHANDLE stmt;
 
+    void init(SQLHANDLE con, string sqlQuery);
+
+protected:
+    size_t fetchRows(std::vector<std::vector<Term_t>> &columns,
+                     const size_t maxRows);
+
 public:
-    ODBCIterator(SQLHANDLE con,
-                  string tableName,
+    ODBCIterator(ODBCTable *table,
                   const Literal &query,
-                  const std::vector<string> &fieldsTable,
                   const std::vector<uint8_t> *sortingFieldsIdx);
 
-    ODBCIterator(SQLHANDLE con,
+    ODBCIterator(ODBCTable *table,
 	    string sqlquery,
 	    const Literal &query);
 
-    bool hasNext();
-
-    void next();
-
     void clear();
 
-    void skipDuplicatedFirstColumn();
-
-    PredId_t getPredicateID() {
-        return predid;
-    }
-
-    Term_t getElementAt(const uint8_t p);
-
     ~ODBCIterator();
 };
 
@@ -11,17 +11,28 @@
 class ODBCTable : public SQLTable {
 private:
     SQLHANDLE env;
-    SQLHANDLE con;
+    std::vector<SQLHANDLE> cons;
+    std::vector<SQLHANDLE> dictTextStmts;
+    std::vector<SQLHANDLE> dictNumberStmts;
+
+protected:
+    void executeUpdate(const string &sqlQuery);
+
+    EDBIterator *executeQuery(const string &sqlQuery, const Literal &query);
+
+    void executeDictQuery(const string &sqlQuery,
+                          std::vector<std::pair<uint64_t, string>> &output);
 
 public:
     ODBCTable(string user, string pwd, string dbname,
-               string tablename, string tablefields);
+               string tablename, string tablefields, size_t fetchSize,
+               size_t poolSize);
 
-    static void check(SQLRETURN rc, string msg);
+    SQLHANDLE getConnection(const size_t idx) {
+        return cons[idx];
+    }
 
-    void query(QSQQuery *query, TupleTable *outputTable,
-               std::vector<uint8_t> *posToFilter,
-               std::vector<Term_t> *valuesToFilter);
+    static void check(SQLRETURN rc, string msg);
 
     size_t getCardinality(const Literal &query);
 
@@ -13,6 +13,11 @@
 
 #include <trident/model/table.h>
 
+#include <boost/chrono.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <atomic>
 #include <vector>
 
 class TupleTable;
@@ -21,6 +26,49 @@ class RuleExecutor;
 #define QSQR_EVAL 0
 #define QSQR_EST 1
 
+//In parallel mode, only the queries up to this depth evaluate their rules in
+//parallel. Deeper queries use the stack of tasks of their thread.
+#define QSQR_PARALLEL_DEPTH 4
+
+//Thrown by an evaluation that was cancelled
+#define QSQR_CANCELLED 32769
+
+/*
+ * Asks an evaluation to stop, either explicitly or once a deadline has
+ * passed. QSQR checks it between the steps of the evaluation and throws
+ * QSQR_CANCELLED.
+ */
+class CancelToken {
+private:
+    std::atomic<bool> cancelled;
+    const bool hasDeadline;
+    const boost::chrono::steady_clock::time_point deadline;
+
+public:
+    CancelToken() : cancelled(false), hasDeadline(false) {
+    }
+
+    CancelToken(const long timeoutMicros) : cancelled(false),
+        hasDeadline(true), deadline(boost::chrono::steady_clock::now() +
+                                    boost::chrono::microseconds(timeoutMicros)) {
+    }
+
+    void cancel() {
+        cancelled = true;
+    }
+
+    bool isCancelled() {
+        if (cancelled.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        if (hasDeadline && boost::chrono::steady_clock::now() >= deadline) {
+            cancelled = true;
+            return true;
+        }
+        return false;
+    }
+};
+
 #ifndef RECURSIVE_QSQR
 
 class QSQR;
@@ -62,37 +110,103 @@ private:
     BindingsTable **answers[MAX_NPREDS];
     RuleExecutor ***rules[MAX_NPREDS];
 
-    //const Timeout * timeout;
+    //Guards the creation of the tables and the rules above
+    boost::mutex tablesMutex;
+
+    //Number of tuples in all the answer tables
+    std::atomic<size_t> nAnswers;
+
+    //The rules of a query can be evaluated by several threads
+    bool parallel;
+
+    CancelToken *cancelToken;
 
 #ifndef RECURSIVE_QSQR
-    std::vector<QSQR_Task> tasks;
+    //Tasks to execute and depth of the query that created them. In parallel
+    //mode every evaluation of a rule has its own.
+    struct Worker {
+        std::vector<QSQR_Task> tasks;
+        int depth;
+        //Evaluation that started this one, or NULL
+        Worker *parent;
+        //Answers produced by this evaluation and by the nested ones
+        std::atomic<size_t> nAnswers;
+
+        Worker(int depth, Worker *parent) : depth(depth), parent(parent),
+            nAnswers(0) {
+        }
+    };
+    Worker root;
+    boost::thread_specific_ptr<Worker> currentWorker;
+
+    static void noCleanup(Worker *worker) {
+    }
+
+    Worker *getWorker() {
+        Worker *worker = parallel ? currentWorker.get() : NULL;
+        return worker != NULL ? worker : &root;
+    }
+
     void processTask(QSQR_Task &task);
+
+    void processTasks(Worker *worker);
+
+    void evaluateParallel(Predicate &pred, BindingsTable *inputTable,
+                          size_t offsetInput, bool repeat);
 #endif
 
 
-    size_t calculateAllAnswers();
+    //In parallel mode, an evaluation only counts its own answers, so that it
+    //is not repeated because of the answers of the concurrent ones. The
+    //query is repeated anyway until no answer is added to any table.
+    size_t calculateAllAnswers() {
+#ifndef RECURSIVE_QSQR
+        Worker *worker = parallel ? currentWorker.get() : NULL;
+        if (worker != NULL) {
+            return worker->nAnswers.load();
+        }
+#endif
+        return nAnswers.load();
+    }
 
-    void createRules(Predicate &pred);
+    RuleExecutor **createRules(Predicate &pred);
 
 public:
     QSQR(EDBLayer &layer, Program *program) : layer(layer),
-        program(program) {
+        program(program), nAnswers(0), parallel(false)
+#ifndef RECURSIVE_QSQR
+        , root(0, NULL), currentWorker(noCleanup)
+#endif
+    {
         for (int i = 0; i < MAX_NPREDS; ++i) {
             inputs[i] = NULL;
             answers[i] = NULL;
             rules[i] = NULL;
         }
-        //timeout = NULL;
+        cancelToken = NULL;
     }
 
-    /*void raiseIfExpired() {
-        if (timeout != NULL)
-            timeout->raiseIfExpired();
-    }*/
+    //The parallel mode requires a multithreaded EDB layer. The default is
+    //false.
+    void setParallel(const bool parallel) {
+        this->parallel = parallel;
+    }
+
+    //The token is checked during the evaluation. NULL if the evaluation
+    //cannot be cancelled, which is the default.
+    void setCancelToken(CancelToken *token) {
+        cancelToken = token;
+    }
+
+    void raiseIfCancelled() {
+        if (cancelToken != NULL && cancelToken->isCancelled()) {
+            throw QSQR_CANCELLED;
+        }
+    }
 
 #ifndef RECURSIVE_QSQR
     void pushTask(QSQR_Task &task) {
-        tasks.push_back(task);
+        getWorker()->tasks.push_back(task);
     }
 #endif
 
@@ -114,6 +228,17 @@ public:
         return getAnswerTable(literal->getPredicate(), literal->getPredicate().getAdorment());
     }
 
+    //Called after n new tuples were added to the answer tables
+    void addAnswers(const size_t n) {
+#ifndef RECURSIVE_QSQR
+        if (n > 0 && parallel) {
+            for (Worker *w = currentWorker.get(); w != NULL; w = w->parent) {
+                w->nAnswers += n;
+            }
+        }
+#endif
+    }
+
     size_t estimate(int depth, Predicate &pred, BindingsTable *inputTable/*, size_t offsetInput*/);
 
 #ifdef LINEAGE
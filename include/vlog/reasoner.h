@@ -1,6 +1,8 @@
 #ifndef REASONER_H
 #define REASONER_H
 
+#include <vlog/algocosts.h>
+#include <vlog/answercache.h>
 #include <vlog/concepts.h>
 #include <vlog/edb.h>
 #include <vlog/fctable.h>
@@ -11,16 +13,50 @@
 
 #include <trident/sparql/query.h>
 
+#include <boost/thread/mutex.hpp>
+
+#include <unordered_map>
+
 #define QUERY_MAT 0
 #define QUERY_ONDEM 1
 
-typedef enum {TOPDOWN, MAGIC} ReasoningMode;
-
 class Reasoner {
 private:
 
     const uint64_t threshold;
 
+    //Answers of previous queries
+    AnswerCache answers;
+
+    //Rewriting of the program for a query, which only depends on the
+    //predicate and the adornment of the query
+    struct MagicProgram {
+        std::shared_ptr<Program> adornedProgram;
+        std::shared_ptr<Program> magicProgram;
+        std::pair<PredId_t, PredId_t> inputOutputRelIDs;
+        //Never run. It only keeps the rules with their execution plans
+        std::unique_ptr<SemiNaiver> plans;
+    };
+    std::unordered_map<uint64_t, std::shared_ptr<const MagicProgram>> magicPrograms;
+    boost::mutex magicProgramsMutex;
+    const Program *magicSource;
+    const EDBLayer *magicLayer;
+    int magicSourceRules;
+
+    std::shared_ptr<const MagicProgram> getMagicProgram(Literal &query,
+            EDBLayer &layer, Program &program);
+
+    //Observed runtimes of the two algorithms
+    AlgoCosts costs;
+    std::string costsFile;
+
+    //Whether QSQ-R evaluates the rules of a query in parallel
+    bool parallelQSQR;
+
+    AlgoCosts::Shape getShape(Literal &query, std::vector<uint8_t> *posBindings,
+                              std::vector<Term_t> *valueBindings,
+                              Program &program);
+
     void cleanBindings(std::vector<Term_t> &bindings, std::vector<uint8_t> * posJoins,
                        TupleTable *input);
 
@@ -60,9 +96,47 @@ private:
                                            bool returnOnlyVars,
                                            std::vector<uint8_t> *sortByFields);
 
+    TupleIterator *getMagicOrTopDownIterator(Literal &query,
+            std::vector<uint8_t> * posJoins,
+            std::vector<Term_t> *possibleValuesJoins,
+            EDBLayer &layer, Program &program,
+            bool returnOnlyVars,
+            std::vector<uint8_t> *sortByFields);
+
+    //Computes the answers with all the fields of the literal, or reuses those
+    //in the cache
+    std::shared_ptr<const AnswerCache::Answers> getAnswers(Literal &query,
+            std::vector<uint8_t> * posJoins,
+            std::vector<Term_t> *possibleValuesJoins,
+            EDBLayer &layer, Program &program);
+
 public:
 
-    Reasoner(const uint64_t threshold) : threshold(threshold) {}
+    Reasoner(const uint64_t threshold) : threshold(threshold),
+        magicSource(NULL), magicLayer(NULL), magicSourceRules(0),
+        parallelQSQR(false) {}
+
+    //Memory (in bytes) used to keep the answers of the queries across calls to
+    //getIterator. The default is 0, i.e., nothing is kept.
+    void setAnswerCacheBudget(const size_t bytes) {
+        answers.setBudget(bytes);
+    }
+
+    //The runtimes of the algorithms are loaded from the file, and stored
+    //there when the reasoner is destroyed
+    void loadCosts(const std::string &file) {
+        costsFile = file;
+        costs.load(file);
+    }
+
+    void setExploration(const double rate) {
+        costs.setExploration(rate);
+    }
+
+    //Only used on multithreaded EDB layers. The default is false.
+    void setParallelQSQR(const bool parallel) {
+        parallelQSQR = parallel;
+    }
 
     size_t estimate(Literal &query, std::vector<uint8_t> *posBindings,
                     std::vector<Term_t> *valueBindings, EDBLayer &layer,
@@ -95,6 +169,9 @@ public:
     //static int materializationOrOnDemand(const uint64_t matThreshold, std::vector<std::shared_ptr<SPARQLOperator>> &patterns);
 
     ~Reasoner() {
+        if (costsFile != "" && costs.isModified()) {
+            costs.save(costsFile);
+        }
     }
 };
 #endif
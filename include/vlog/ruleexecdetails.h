@@ -23,6 +23,9 @@ struct RuleExecutionDetails {
 
     RuleExecutionDetails(Rule rule, size_t ruleid) : rule(rule), ruleid(ruleid) {}
 
+    //The plans of the copy point to its own body literals
+    RuleExecutionDetails(const RuleExecutionDetails &other);
+
     void createExecutionPlans();
 
     void calculateNVarsInHeadFromEDB();
@@ -40,11 +40,27 @@ struct StatsSizeIDB {
     long derivation;
 };
 
+//Cost of a rule summed over all its executions
+struct StatsRuleCost {
+    const Rule *rule;
+    size_t executions;
+    //Executions that derived new facts
+    size_t productive;
+    double timems;
+};
+
+struct StatsSizePredicate {
+    string name;
+    size_t rows;
+    uint8_t card;
+};
+
 typedef std::unordered_map<std::string, FCTable*> EDBCache;
 class ResultJoinProcessor;
 class SemiNaiver {
 private:
     std::vector<RuleExecutionDetails> edbRuleset;
+    bool rulesPrepared;
     bool opt_intersect;
     bool opt_filtering;
     bool multithreaded;
@@ -54,6 +70,8 @@ private:
 
     std::vector<FCBlock> listDerivations;
     std::vector<StatsRule> statsRuleExecution;
+    //One entry per execution of a rule, in all the calls to run()
+    std::vector<StatIteration> costRules;
 
 
 #ifdef WEBINTERFACE
@@ -144,6 +162,14 @@ public:
 
     void run(size_t lastIteration, size_t iteration);
 
+    //Creates the execution plans of the rules. It is done by run() if it was
+    //not called before
+    void prepareRules();
+
+    //Replaces the rules with those of another instance, together with their
+    //plans. Both instances must use the same program.
+    void copyPreparedRules(const SemiNaiver &other);
+
     void storeOnFiles(std::string path, const bool decompress,
                       const int minLevel);
 
@@ -191,6 +217,16 @@ public:
 
     size_t getCurrentIteration();
 
+    //Sorted by decreasing time
+    std::vector<StatsRuleCost> getRuleCosts() const;
+
+    //With the web interface, it skips the predicate that is being derived
+    std::vector<StatsSizePredicate> getSizePredicates();
+
+    int getNThreads() {
+        return nthreads;
+    }
+
 #ifdef WEBINTERFACE
     string getCurrentRule();
 
@@ -0,0 +1,113 @@
+#ifndef _SQLITERATOR_H
+#define _SQLITERATOR_H
+
+#include <vlog/edbiterator.h>
+#include <vlog/concepts.h>
+#include <vlog/consts.h>
+
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <vector>
+
+class SQLTable;
+
+// Default number of rows that are fetched at once from the database
+#define SQL_DEFAULT_FETCH_SIZE 4096
+
+/*
+ * Base class of the iterators over SQL tables. A background thread reads the
+ * result of the query in batches of fetchSize rows, decoding them column by
+ * column, while the consumer reads the previous batch (double buffering).
+ * The subclasses only need to execute the query and implement fetchRows.
+ * The iterator keeps a connection of the pool of the table until it is
+ * cleared. hasNext reads ahead one row, so next copies it in currentValues,
+ * where getElementAt reads it.
+ */
+class SQLIterator : public EDBIterator {
+private:
+    struct Batch {
+        std::vector<std::vector<Term_t>> columns;
+        size_t nrows;
+        bool last;
+    };
+
+    Batch batches[2];
+    bool ready[2];
+    int currentBatch;
+    size_t currentRow;
+    bool started;
+
+    boost::thread fetcher;
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool stop;
+    bool failed;
+    bool fetching;
+
+    //Row returned by the last call to next
+    std::vector<Term_t> currentValues;
+    bool hasNextChecked;
+    bool hasNextValue;
+    bool isFirst;
+    bool skipDuplicatedFirst;
+    Term_t lastFirstVar;
+
+    void fetchLoop();
+
+    bool nextRow();
+
+    //Value of the row read ahead by hasNext
+    Term_t getNextElementAt(const uint8_t p) {
+        return batches[currentBatch].columns[p][currentRow];
+    }
+
+protected:
+    PredId_t predid;
+    //Connection of the pool of the table used by this iterator
+    SQLTable *table;
+    size_t connection;
+    bool holdsConnection;
+    //Protects the connection, which is shared with the table
+    boost::recursive_mutex *conMutex;
+    int posFirstVar;
+    const size_t fetchSize;
+
+    void initPosFirstVar(const Literal &query,
+                         const std::vector<uint8_t> *sortingFieldIdx);
+
+    //Must be called by the subclass once the query is executed
+    void startFetching(const uint8_t ncolumns);
+
+    //Must be called by the subclass before the statement is released
+    void stopFetching();
+
+    //Must be called by the subclass after the statement is released
+    void releaseConnection();
+
+    //Append at most maxRows rows to columns. Returns the number of rows
+    //that were read. It is invoked by the background thread.
+    virtual size_t fetchRows(std::vector<std::vector<Term_t>> &columns,
+                             const size_t maxRows) = 0;
+
+public:
+    SQLIterator(const Literal &query, SQLTable *table);
+
+    bool hasNext();
+
+    void next();
+
+    void skipDuplicatedFirstColumn();
+
+    PredId_t getPredicateID() {
+        return predid;
+    }
+
+    Term_t getElementAt(const uint8_t p);
+
+    virtual ~SQLIterator();
+};
+
+#endif
@@ -2,14 +2,110 @@
 #define _SQL_TABLE_H
 
 #include <vlog/column.h>
-#include <vlog/sqltable.h>
+#include <vlog/edbtable.h>
 #include <vlog/edbiterator.h>
+#include <vlog/sqliterator.h>
+
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <memory>
+
+// If the number of tuples to filter is larger than this, they are bulk-loaded
+// into a temporary table instead of being listed in the query
+#define TEMP_TABLE_THRESHOLD (2*3*4*5*7*11)
+
+// Maximum number of values listed in a single IN-list or multi-row INSERT
+#define SQL_BATCH_SIZE 1000
+
+// Default number of connections per table
+#define SQL_DEFAULT_POOL_SIZE 1
+
+// Seconds a thread waits for a free connection before failing. The other
+// threads may be waiting for this one, e.g., with a pool of one connection.
+#define SQL_POOL_TIMEOUT 60
 
 class SQLTable : public EDBTable {
+private:
+    //Connection pool. A thread keeps the same connection as long as it
+    //holds it (also through its iterators), so that it sees its own
+    //temporary tables and does not deadlock on a second checkout.
+    boost::mutex poolMutex;
+    boost::condition_variable poolCond;
+    std::vector<size_t> freeConnections;
+    std::vector<int> refCounts;
+    std::vector<boost::thread::id> owners;
+    //Serialize the use of every connection, which is shared with the
+    //background threads of the iterators
+    std::vector<std::unique_ptr<boost::recursive_mutex>> conMutexes;
+
+protected:
+    //Number of rows fetched at once by the iterators
+    size_t fetchSize;
+
+    //Checks out a connection for the current thread. If exclusive is true, it
+    //also gets exclusive access to it.
+    class PooledConnection {
+    private:
+        SQLTable *table;
+    public:
+        const size_t idx;
+    private:
+        boost::unique_lock<boost::recursive_mutex> lock;
+    public:
+        PooledConnection(SQLTable *table, bool exclusive = true);
+
+        ~PooledConnection();
+    };
+
+    //Must be called by the subclasses after they opened the connections
+    void initPool(const size_t poolSize);
+
+    //Execute a statement that does not return any result
+    virtual void executeUpdate(const string &sqlQuery) = 0;
+
+    //Execute a query that returns all the fields of the table
+    virtual EDBIterator *executeQuery(const string &sqlQuery,
+                                      const Literal &query) = 0;
+
+    //Execute a query that returns pairs (id, text)
+    virtual void executeDictQuery(const string &sqlQuery,
+                                  std::vector<std::pair<uint64_t, string>> &output) = 0;
+
+    string getConditions(const Literal &query);
+
+    void loadTempTable(const uint8_t nfields, const std::vector<Term_t> &tuples);
+
+    string tempTableToSQLQuery(const std::vector<uint8_t> &posToFilter);
+
+    static string filterToSQLQuery(const std::vector<string> &fields,
+                                   std::vector<Term_t>::const_iterator begin,
+                                   std::vector<Term_t>::const_iterator end);
+
+    static std::vector<Term_t> uniqueTuples(const std::vector<Term_t> &values,
+                                            const uint8_t nfields);
+
 public:
     string tablename;
     std::vector<string> fieldTables;
 
+    SQLTable() : fetchSize(SQL_DEFAULT_FETCH_SIZE) {
+    }
+
+    size_t getFetchSize() const {
+        return fetchSize;
+    }
+
+    size_t checkoutConnection();
+
+    void releaseConnection(const size_t idx);
+
+    boost::recursive_mutex *getConnectionMutex(const size_t idx) {
+        return conMutexes[idx].get();
+    }
+
     std::vector<std::shared_ptr<Column>> checkNewIn(const Literal &l1,
             std::vector<uint8_t> &posInL1,
             const Literal &l2,
@@ -27,15 +123,35 @@ public:
         uint8_t posInL2,
         size_t &sizeOutput);
 
+    void query(QSQQuery *query, TupleTable *outputTable,
+               std::vector<uint8_t> *posToFilter,
+               std::vector<Term_t> *valuesToFilter);
+
+    //Decode many IDs with a few IN-list queries. Returns false if some IDs
+    //were not found (their text is left empty)
+    bool getDictTexts(const std::vector<uint64_t> &ids,
+                      std::vector<string> &texts);
+
     void releaseIterator(EDBIterator *itr);
 
     size_t estimateCardinality(const Literal &query);
 
+    //Summary of the content of the table (number of rows and range of every
+    //field). Used to detect whether a local copy of the table is stale.
+    string getSignature();
+
     static string literalConstraintsToSQLQuery(const Literal &query,
                                     const std::vector<string> &fieldTables);
 
     static string repeatedToSQLQuery(const Literal &query,
                                     const std::vector<string> &fieldTables);
+
+    //Query that returns the tuples matching the literal, sorted by the
+    //variables in sortingFieldIdx (if not NULL)
+    static string selectToSQLQuery(const string &tablename,
+                                   const Literal &query,
+                                   const std::vector<string> &fieldTables,
+                                   const std::vector<uint8_t> *sortingFieldIdx);
 };
 
 
@@ -0,0 +1,65 @@
+#ifndef _SQL_TABLE_CACHE_H
+#define _SQL_TABLE_CACHE_H
+
+#include <vlog/inmemory/inmemorytable.h>
+#include <vlog/sqltable.h>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <memory>
+#include <vector>
+
+/*
+ * Local snapshot of a remote SQL table. The rows are downloaded once, sorted
+ * by all the fields, and stored column by column in a directory of the cache
+ * that is derived from the source of the table. Later runs memory-map the
+ * columns, unless the signature of the remote table (number of rows and
+ * range of every field) has changed in the meantime.
+ *
+ * Iterators, joins and cardinalities are computed locally. Only the
+ * dictionary lookups are still sent to the database.
+ */
+class SQLTableCache : public InmemoryTable {
+private:
+    std::shared_ptr<SQLTable> table;
+    std::vector<boost::iostreams::mapped_file_source> files;
+    //Signature of the remote table when the cache was checked
+    string signature;
+
+    bool isValid(const string &dir, const string &key,
+                 const string &signature, size_t &nrows);
+
+    void snapshot(const string &dir, const string &key,
+                  const string &signature);
+
+    void map(const string &dir, const size_t nrows);
+
+public:
+    //source identifies the database that contains the table
+    SQLTableCache(PredId_t predid, std::shared_ptr<SQLTable> table,
+                  string cacheDir, string source);
+
+    bool getDictNumber(const char *text, const size_t sizeText,
+                       uint64_t &id) {
+        return table->getDictNumber(text, sizeText, id);
+    }
+
+    bool getDictText(const uint64_t id, char *text) {
+        return table->getDictText(id, text);
+    }
+
+    bool getDictTexts(const std::vector<uint64_t> &ids,
+                      std::vector<string> &texts) {
+        return table->getDictTexts(ids, texts);
+    }
+
+    uint64_t getNTerms() {
+        return table->getNTerms();
+    }
+
+    string getVersion() {
+        return signature;
+    }
+};
+
+#endif
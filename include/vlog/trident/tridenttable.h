@@ -6,6 +6,10 @@
 #include <vlog/edbtable.h>
 
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <memory>
+#include <vector>
 
 #include <trident/kb/kb.h>
 #include <trident/kb/querier.h>
@@ -28,14 +32,49 @@ class TridentTable: public EDBTable {
 
 private:
 
+    //A querier with its own lock and iterator factory. In multithreaded mode
+    //every thread gets its own, so that the threads do not contend. The lock
+    //is only needed when an iterator is released by another thread.
+    struct QuerierSlot {
+        Querier *q;
+        boost::mutex mutex;
+        Factory<TridentIterator> kbItrFactory;
+
+        QuerierSlot(Querier *q) : q(q) {
+        }
+
+        ~QuerierSlot() {
+            delete q;
+        }
+    };
+
+    //All the slots of the table. The first one is used in single-threaded
+    //mode. The slots of the threads that exited are reused by the new ones.
+    struct SlotPool {
+        std::vector<std::unique_ptr<QuerierSlot>> slots;
+        std::vector<QuerierSlot*> freeSlots;
+        boost::mutex mutex;
+    };
+
+    //Slot of a thread. When the thread exits, the slot goes back to the pool
+    //if the table still exists.
+    struct ThreadSlot {
+        std::weak_ptr<SlotPool> pool;
+        QuerierSlot *slot;
+    };
+
+    const string kbDir;
     KB *kb;
-    Querier *q;
     DictMgmt *dict;
-    Factory<TridentIterator> kbItrFactory;
-    boost::mutex mutex;
     bool multithreaded;
+    std::shared_ptr<SlotPool> pool;
+    boost::thread_specific_ptr<ThreadSlot> threadSlot;
+
+    static void releaseThreadSlot(ThreadSlot *threadSlot);
 
-    TridentIterator *getTridentIter();
+    QuerierSlot *getSlot();
+
+    TridentIterator *getTridentIter(QuerierSlot *slot);
 
     std::vector<std::shared_ptr<Column>> performAntiJoin(const Literal &l1,
                                       std::vector<uint8_t> &pos1, const Literal &l2,
@@ -66,10 +105,12 @@ private:
 
 
 public:
-    TridentTable(string kbDir, bool multithreaded) {
+    TridentTable(string kbDir, bool multithreaded) : kbDir(kbDir),
+        pool(new SlotPool()), threadSlot(releaseThreadSlot) {
         KBConfig config;
         kb = new KB(kbDir.c_str(), true, false, true, config);
-        q = kb->query();
+        pool->slots.push_back(std::unique_ptr<QuerierSlot>(
+                                  new QuerierSlot(kb->query())));
         dict = kb->getDictMgmt();
         this->multithreaded = multithreaded;
     }
@@ -97,7 +138,7 @@ public:
                std::vector<Term_t> *valuesToFilter);
 
     Querier *getQuerier() {
-        return q;
+        return pool->slots[0]->q;
     }
 
     KB *getKB() {
@@ -125,10 +166,14 @@ public:
 
     uint64_t getNTerms();
 
+    //Size and last modification time of the files of the KB
+    string getVersion();
+
     void releaseIterator(EDBIterator *itr);
 
     ~TridentTable() {
-        delete q;
+        //The queriers must be deleted before the KB
+        pool.reset();
         delete kb;
     }
 
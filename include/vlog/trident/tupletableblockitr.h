@@ -0,0 +1,34 @@
+#ifndef _TUPLETABLE_BLOCK_ITR
+#define _TUPLETABLE_BLOCK_ITR
+
+#include <vlog/concepts.h>
+
+#include <trident/model/table.h>
+#include <trident/sparql/query.h>
+
+#include <memory>
+
+/*
+ * Iterator over the answers computed by the reasoner. Besides the row by row
+ * interface of TupleTableItr, it can copy the rows in blocks, column by
+ * column, directly from the table. The two interfaces have separate
+ * positions and should not be mixed.
+ */
+class TupleTableBlockItr : public TupleTableItr {
+private:
+    std::shared_ptr<TupleTable> table;
+    size_t blockRow;
+
+public:
+    TupleTableBlockItr(std::shared_ptr<TupleTable> table) :
+        TupleTableItr(table), table(table), blockRow(0) {
+    }
+
+    //Copies at most maxRows rows in the columns: columns[i] receives the
+    //values of the position positions[i]. Returns the number of copied rows,
+    //which is 0 once all the rows were returned.
+    size_t nextBlock(const uint8_t *positions, const uint8_t ncolumns,
+                     Term_t **columns, const size_t maxRows);
+};
+
+#endif
@@ -26,7 +26,9 @@
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
+#include <atomic>
 #include <map>
+#include <vector>
 
 class VLogLayer;
 class TridentLayer;
@@ -50,11 +52,42 @@ private:
     boost::asio::ip::tcp::acceptor acceptor;
     boost::asio::ip::tcp::resolver resolver;
 
-    bool isActive;
+    //The connections are served by nthreads threads, while the requests are
+    //executed by nworkers threads, so that a long query does not block the
+    //pages and the statistics requested by the other clients
+    int nthreads;
+    int nworkers;
+    boost::thread_group ioThreads;
+    boost::asio::io_service workers;
+    std::unique_ptr<boost::asio::io_service::work> workersWork;
+    boost::thread_group workerThreads;
+
+    //Requests that read the KB can run concurrently, while /setup replaces it
+    boost::shared_mutex kbMutex;
+
+    //The layers keep the state of the query they execute (the querier of
+    //Trident, the text returned by the lookups), so every worker that
+    //executes a query takes its own. The VLog layers share the reasoner and
+    //the estimates with vloglayer. They are dropped by /setup.
+    struct QueryLayers {
+        std::unique_ptr<VLogLayer> vloglayer;
+        std::unique_ptr<TridentLayer> tridentlayer;
+    };
+    std::vector<std::unique_ptr<QueryLayers>> freeLayers;
+    boost::mutex layersMutex;
+
+    //Must be called with a lock on kbMutex
+    std::unique_ptr<QueryLayers> getQueryLayers();
+
+    void releaseQueryLayers(std::unique_ptr<QueryLayers> layers);
+
+    std::atomic<int> nactive;
+    std::atomic<uint64_t> busyMicros;
     string edbFile;
     string webport;
 
     map<string, string> cachehtml;
+    boost::mutex cachehtmlMutex;
 
     class Server: public boost::enable_shared_from_this<Server> {
     private:
@@ -64,10 +97,20 @@ private:
         std::ostringstream ss;
         std::unique_ptr<char[]> data_;
 
+        std::string page;
+        bool isjson;
+        bool ismetrics;
+        bool keepAlive;
+
+        void read();
+        void processRequest();
+        void writeResponse();
+
     public:
         boost::asio::ip::tcp::socket socket;
         Server(boost::asio::io_service &io, WebInterface *inter):
-            inter(inter), socket(io) {
+            inter(inter), isjson(false), ismetrics(false), keepAlive(false),
+            socket(io) {
             data_ = std::unique_ptr<char[]>(new char[4096]);
         }
         void writeHandler(const boost::system::error_code &err, std::size_t bytes);
@@ -86,6 +129,9 @@ public:
     WebInterface(std::shared_ptr<SemiNaiver> sn, string htmlfiles,
                  string cmdArgs, string edbfile);
 
+    //Must be called before start
+    void setNThreads(int nthreads, int nworkers);
+
     void start(string address, string port);
 
     void connect();
@@ -96,18 +142,22 @@ public:
 
     string getPage(string page);
 
+    //Telemetry in the text format of Prometheus
+    string getMetrics();
+
     long getDurationExecMs();
 
     void setActive() {
-        isActive = true;
+        nactive++;
     }
 
     void setInactive() {
-        isActive = false;
+        nactive--;
     }
 
     void join() {
         t.join();
+        ioThreads.join_all();
     }
 
     std::shared_ptr<SemiNaiver> getSemiNaiver() {
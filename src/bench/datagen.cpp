@@ -0,0 +1,145 @@
+#include <bench/datagen.h>
+#include <vlog/column.h>
+
+#include <algorithm>
+#include <numeric>
+
+BenchData::ZipfSampler::ZipfSampler(const Term_t domain) {
+    cdf.reserve(domain);
+    double sum = 0;
+    for (Term_t k = 1; k <= domain; ++k) {
+        sum += 1.0 / k;
+        cdf.push_back(sum);
+    }
+    for (auto &v : cdf) {
+        v /= sum;
+    }
+}
+
+Term_t BenchData::ZipfSampler::next(std::mt19937_64 &random) const {
+    const double p = std::uniform_real_distribution<double>(0, 1)(random);
+    auto itr = std::lower_bound(cdf.begin(), cdf.end(), p);
+    if (itr == cdf.end()) {
+        itr--;
+    }
+    return (Term_t) (itr - cdf.begin()) + 1;
+}
+
+std::string BenchData::getName(const Distribution distr) {
+    return distr == UNIFORM ? "uniform" : "skewed";
+}
+
+BenchData::Columns BenchData::generate(const size_t nrows, const uint8_t arity,
+                                       const Distribution distr,
+                                       const bool sorted,
+                                       const Term_t domain,
+                                       const uint64_t seed) {
+    std::mt19937_64 random(seed);
+    std::uniform_int_distribution<Term_t> uniform(1, domain);
+    std::unique_ptr<ZipfSampler> zipf;
+    if (distr == SKEWED) {
+        zipf = std::unique_ptr<ZipfSampler>(new ZipfSampler(domain));
+    }
+
+    Columns columns(arity);
+    for (uint8_t i = 0; i < arity; ++i) {
+        columns[i].reserve(nrows);
+        for (size_t j = 0; j < nrows; ++j) {
+            columns[i].push_back(distr == UNIFORM ? uniform(random) :
+                                 zipf->next(random));
+        }
+    }
+    if (sorted) {
+        sort(columns);
+    }
+    return columns;
+}
+
+void BenchData::sort(Columns &columns) {
+    if (columns.empty()) {
+        return;
+    }
+    const size_t nrows = columns[0].size();
+    std::vector<size_t> order(nrows);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&columns](const size_t a,
+    const size_t b) {
+        for (const auto &column : columns) {
+            if (column[a] != column[b]) {
+                return column[a] < column[b];
+            }
+        }
+        return false;
+    });
+    for (auto &column : columns) {
+        std::vector<Term_t> sortedColumn(nrows);
+        for (size_t i = 0; i < nrows; ++i) {
+            sortedColumn[i] = column[order[i]];
+        }
+        column.swap(sortedColumn);
+    }
+}
+
+void BenchData::sortAndUnique(Columns &columns) {
+    sort(columns);
+    if (columns.empty() || columns[0].empty()) {
+        return;
+    }
+    const size_t nrows = columns[0].size();
+    size_t last = 0;
+    for (size_t i = 1; i < nrows; ++i) {
+        bool same = true;
+        for (const auto &column : columns) {
+            if (column[i] != column[last]) {
+                same = false;
+                break;
+            }
+        }
+        if (!same) {
+            last++;
+            for (auto &column : columns) {
+                column[last] = column[i];
+            }
+        }
+    }
+    for (auto &column : columns) {
+        column.resize(last + 1);
+    }
+}
+
+void BenchData::overlap(Columns &columns, const Columns &other,
+                        const double fraction, const uint64_t seed) {
+    std::mt19937_64 random(seed);
+    const size_t nrows = columns.empty() ? 0 : columns[0].size();
+    const size_t nother = other.empty() ? 0 : other[0].size();
+    if (nother > 0) {
+        std::uniform_int_distribution<size_t> pick(0, nother - 1);
+        const size_t ncopied = (size_t) (nrows * fraction);
+        for (size_t i = 0; i < ncopied; ++i) {
+            const size_t row = pick(random);
+            for (size_t j = 0; j < columns.size(); ++j) {
+                columns[j][i] = other[j][row];
+            }
+        }
+    }
+}
+
+std::vector<const std::vector<Term_t> *> BenchData::getPointers(
+    const Columns &columns) {
+    std::vector<const std::vector<Term_t> *> out;
+    for (const auto &column : columns) {
+        out.push_back(&column);
+    }
+    return out;
+}
+
+std::shared_ptr<const Segment> BenchData::toSegment(const Columns &columns) {
+    std::vector<std::shared_ptr<Column>> segColumns;
+    for (const auto &column : columns) {
+        std::vector<Term_t> copy = column;
+        segColumns.push_back(std::shared_ptr<Column>(
+                                 new InmemoryColumn(copy, true)));
+    }
+    return std::shared_ptr<const Segment>(new Segment(
+            (uint8_t) segColumns.size(), segColumns));
+}
@@ -0,0 +1,59 @@
+#include <bench/harness.h>
+
+#include <boost/chrono.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <iomanip>
+
+namespace timens = boost::chrono;
+
+BenchResult BenchRunner::run(Benchmark &bench) {
+    BOOST_LOG_TRIVIAL(info) << "Running " << bench.getName();
+    bench.setup();
+    for (int i = 0; i < warmup; ++i) {
+        bench.prepare();
+        bench.run();
+    }
+
+    std::vector<double> times;
+    for (int i = 0; i < reps; ++i) {
+        bench.prepare();
+        timens::steady_clock::time_point start = timens::steady_clock::now();
+        bench.run();
+        timens::duration<double> sec = timens::steady_clock::now() - start;
+        times.push_back(sec.count() * 1000);
+    }
+
+    BenchResult result;
+    result.name = bench.getName();
+    result.nrows = bench.getNRows();
+    result.noutput = bench.getNOutput();
+    result.reps = reps;
+    result.minMsec = result.medianMsec = result.meanMsec = 0;
+    if (!times.empty()) {
+        std::sort(times.begin(), times.end());
+        result.minMsec = times.front();
+        result.medianMsec = times[times.size() / 2];
+        double sum = 0;
+        for (const auto t : times) {
+            sum += t;
+        }
+        result.meanMsec = sum / times.size();
+    }
+    return result;
+}
+
+void BenchRunner::printHeader(std::ostream &out) {
+    out << "benchmark\trows\toutput\treps\tmin_ms\tmedian_ms\tmean_ms\tMrows/s" << std::endl;
+}
+
+void BenchRunner::print(const BenchResult &result, std::ostream &out) {
+    const double throughput = result.medianMsec > 0 ?
+                              result.nrows / (result.medianMsec * 1000) : 0;
+    out << result.name << "\t" << result.nrows << "\t" << result.noutput <<
+        "\t" << result.reps << std::fixed << std::setprecision(3) << "\t" <<
+        result.minMsec << "\t" << result.medianMsec << "\t" <<
+        result.meanMsec << "\t" << throughput << std::endl;
+    out.unsetf(std::ios::fixed);
+}
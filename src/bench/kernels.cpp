@@ -0,0 +1,447 @@
+#include <bench/kernels.h>
+#include <bench/datagen.h>
+
+#include <vlog/fcinttable.h>
+#include <vlog/fctable.h>
+#include <vlog/filterhashjoin.h>
+#include <vlog/joinprocessor.h>
+#include <vlog/resultjoinproc.h>
+#include <vlog/segment.h>
+
+#include <limits>
+
+static std::string getArityName(const uint8_t arity) {
+    return "a" + std::to_string(arity);
+}
+
+//Literal of an anonymous IDB predicate with only variables
+static Literal getLiteral(const uint8_t arity) {
+    VTuple t(arity);
+    for (uint8_t i = 0; i < arity; ++i) {
+        t.set(VTerm(i + 1, 0), i);
+    }
+    return Literal(Predicate(0, 0, IDB, arity), t);
+}
+
+/*
+ * R(X,Y..) and S(X,Z..) sorted by X, joined on the first column. The output
+ * contains X and the other columns of both sides. S is always uniform, so
+ * that the size of the output stays close to the size of the input also if
+ * R is skewed.
+ */
+class MergeJoinBenchmark : public Benchmark {
+private:
+    const size_t nrows;
+    const uint64_t seed;
+    const uint8_t arity;
+    const BenchData::Distribution distr;
+
+    BenchData::Columns r, s;
+    std::vector<std::pair<uint8_t, uint8_t>> posFromFirst, posFromSecond;
+    std::unique_ptr<InterTableJoinProcessor> output;
+
+public:
+    MergeJoinBenchmark(const size_t nrows, const uint64_t seed,
+                       const uint8_t arity,
+                       const BenchData::Distribution distr) :
+        nrows(nrows), seed(seed), arity(arity), distr(distr) {
+    }
+
+    std::string getName() const {
+        return "mergejoin/" + BenchData::getName(distr) + "/" +
+               getArityName(arity);
+    }
+
+    void setup() {
+        r = BenchData::generate(nrows, arity, distr, true, nrows, seed);
+        s = BenchData::generate(nrows, arity, BenchData::UNIFORM, true, nrows,
+                                seed + 1);
+        posFromFirst.push_back(std::make_pair(0, 0));
+        for (uint8_t i = 1; i < arity; ++i) {
+            posFromFirst.push_back(std::make_pair(i, i));
+            posFromSecond.push_back(std::make_pair(arity - 1 + i, i));
+        }
+    }
+
+    void prepare() {
+        output = std::unique_ptr<InterTableJoinProcessor>(
+                     new InterTableJoinProcessor(2 * arity - 1, posFromFirst,
+                             posFromSecond, -1));
+    }
+
+    void run() {
+        std::vector<uint8_t> fields1, fields2;
+        fields1.push_back(0);
+        fields2.push_back(0);
+        Output out(output.get(), NULL);
+        JoinExecutor::do_merge_join_classicalgo(BenchData::getPointers(r), 0,
+                                                nrows, BenchData::getPointers(s), 0, nrows, fields1, fields2, 0,
+                                                NULL, &out);
+    }
+
+    size_t getNRows() const {
+        return 2 * nrows;
+    }
+
+    size_t getNOutput() {
+        output->consolidate(true);
+        std::shared_ptr<const FCInternalTable> table = output->getTable();
+        return table == NULL ? 0 : table->getNRows();
+    }
+};
+
+/*
+ * The hash join of the forward chaining: the rows of L(X,Y) are kept in a
+ * hash map on X and, for every key, the rows of S(k,Z) are combined with the
+ * rows of L with the same key. As in JoinExecutor::hashjoin, FilterHashJoin
+ * is called once per key, on a table that contains only the rows of S with
+ * that key.
+ */
+class HashJoinBenchmark : public Benchmark {
+private:
+    struct Key {
+        size_t start, end;
+        std::vector<FilterHashJoinBlock> tables;
+    };
+
+    const size_t nrows;
+    const uint64_t seed;
+    const BenchData::Distribution distr;
+
+    std::vector<Term_t> mapValues;
+    JoinHashMap map;
+    DoubleJoinHashMap doublemap;
+    std::vector<std::shared_ptr<const FCInternalTable>> tables;
+    std::vector<Key> keys;
+    std::unique_ptr<Literal> literal;
+    std::vector<std::pair<uint8_t, uint8_t>> posFromFirst, posFromSecond;
+    std::unique_ptr<InterTableJoinProcessor> output;
+
+public:
+    HashJoinBenchmark(const size_t nrows, const uint64_t seed,
+                      const BenchData::Distribution distr) :
+        nrows(nrows), seed(seed), distr(distr) {
+    }
+
+    std::string getName() const {
+        return "hashjoin/" + BenchData::getName(distr) + "/" +
+               getArityName(2);
+    }
+
+    void setup() {
+        const Term_t domain = std::max<Term_t>(nrows / 16, 1);
+        BenchData::Columns l = BenchData::generate(nrows, 2, distr, true,
+                               domain, seed);
+        BenchData::Columns s = BenchData::generate(nrows / 4, 2,
+                               BenchData::UNIFORM, false, domain, seed + 1);
+        BenchData::sortAndUnique(s);
+
+        map.set_empty_key(std::numeric_limits<Term_t>::max());
+        for (size_t i = 0; i < l[0].size(); ++i) {
+            const Term_t key = l[0][i];
+            mapValues.push_back(key);
+            mapValues.push_back(l[1][i]);
+            auto itr = map.find(key);
+            if (itr == map.end()) {
+                map.insert(std::make_pair(key, std::make_pair(2 * i, 2 * i + 2)));
+            } else {
+                itr->second.second = 2 * i + 2;
+            }
+        }
+
+        size_t i = 0;
+        while (i < s[0].size()) {
+            const Term_t key = s[0][i];
+            BenchData::Columns values(1);
+            for (; i < s[0].size() && s[0][i] == key; ++i) {
+                values[0].push_back(s[1][i]);
+            }
+            auto itr = map.find(key);
+            if (itr != map.end()) {
+                tables.push_back(std::shared_ptr<const FCInternalTable>(
+                                     new InmemoryFCInternalTable((uint8_t) 1,
+                                             (size_t) 0, true,
+                                             BenchData::toSegment(values))));
+                Key k;
+                k.start = itr->second.first;
+                k.end = itr->second.second;
+                FilterHashJoinBlock block;
+                block.table = tables.back().get();
+                block.iteration = 0;
+                k.tables.push_back(block);
+                keys.push_back(k);
+            }
+        }
+
+        //The literal S(k,Z), with the key bound
+        VTuple t(2);
+        t.set(VTerm(0, 1), 0);
+        t.set(VTerm(1, 0), 1);
+        literal = std::unique_ptr<Literal>(new Literal(
+                                               Predicate(0, 0, IDB, 2), t));
+        //The output is (Y,Z)
+        posFromFirst.push_back(std::make_pair(0, 1));
+        posFromSecond.push_back(std::make_pair(1, 0));
+    }
+
+    void prepare() {
+        output = std::unique_ptr<InterTableJoinProcessor>(
+                     new InterTableJoinProcessor(2, posFromFirst,
+                             posFromSecond, -1));
+    }
+
+    void run() {
+        int processedTables = 0;
+        for (const auto &key : keys) {
+            FilterHashJoin exec(output.get(), &map, &doublemap, &mapValues, 2,
+                                1, 0, 0, literal.get(), true, false, NULL, 0,
+                                NULL, NULL);
+            exec.run(key.tables, true, key.start, key.end,
+                     std::vector<uint8_t>(), processedTables, NULL, NULL);
+        }
+    }
+
+    size_t getNRows() const {
+        return nrows + nrows / 4;
+    }
+
+    size_t getNOutput() {
+        output->consolidate(true);
+        std::shared_ptr<const FCInternalTable> table = output->getTable();
+        return table == NULL ? 0 : table->getNRows();
+    }
+};
+
+class SortBenchmark : public Benchmark {
+private:
+    const size_t nrows;
+    const uint64_t seed;
+    const uint8_t arity;
+    const BenchData::Distribution distr;
+    const bool sorted;
+    const int nthreads;
+
+    std::shared_ptr<const Segment> segment;
+    std::shared_ptr<const Segment> result;
+
+public:
+    SortBenchmark(const size_t nrows, const uint64_t seed,
+                  const uint8_t arity, const BenchData::Distribution distr,
+                  const bool sorted, const int nthreads) :
+        nrows(nrows), seed(seed), arity(arity), distr(distr),
+        sorted(sorted), nthreads(nthreads) {
+    }
+
+    std::string getName() const {
+        return std::string("sortBy/") + BenchData::getName(distr) + "/" +
+               (sorted ? "sorted" : "unsorted") + "/" + getArityName(arity);
+    }
+
+    void setup() {
+        segment = BenchData::toSegment(BenchData::generate(nrows, arity,
+                                       distr, sorted, nrows, seed));
+    }
+
+    void prepare() {
+        result = std::shared_ptr<const Segment>();
+    }
+
+    void run() {
+        if (nthreads > 1) {
+            result = segment->sortBy(NULL, nthreads, false);
+        } else {
+            result = segment->sortBy(NULL);
+        }
+    }
+
+    size_t getNRows() const {
+        return nrows;
+    }
+
+    size_t getNOutput() {
+        return result == NULL ? 0 : result->getNRows();
+    }
+};
+
+/*
+ * Removes from a set of new derivations the ones that already exist. Half of
+ * the new rows are copies of existing rows.
+ */
+class RetainBenchmark : public Benchmark {
+private:
+    const size_t nrows;
+    const uint64_t seed;
+    const uint8_t arity;
+    const BenchData::Distribution distr;
+    const int nthreads;
+
+    std::shared_ptr<const Segment> segment;
+    std::shared_ptr<const FCInternalTable> existing;
+    std::shared_ptr<const Segment> result;
+
+public:
+    RetainBenchmark(const size_t nrows, const uint64_t seed,
+                    const uint8_t arity, const BenchData::Distribution distr,
+                    const int nthreads) :
+        nrows(nrows), seed(seed), arity(arity), distr(distr),
+        nthreads(nthreads) {
+    }
+
+    std::string getName() const {
+        return "retain/" + BenchData::getName(distr) + "/" +
+               getArityName(arity);
+    }
+
+    void setup() {
+        const Term_t domain = 4 * nrows;
+        BenchData::Columns old = BenchData::generate(nrows, arity, distr,
+                                 false, domain, seed);
+        BenchData::sortAndUnique(old);
+        BenchData::Columns fresh = BenchData::generate(nrows, arity, distr,
+                                   false, domain, seed + 1);
+        BenchData::overlap(fresh, old, 0.5, seed + 2);
+        BenchData::sortAndUnique(fresh);
+        existing = std::shared_ptr<const FCInternalTable>(
+                       new InmemoryFCInternalTable(arity, (size_t) 0, true,
+                               BenchData::toSegment(old)));
+        segment = BenchData::toSegment(fresh);
+    }
+
+    void prepare() {
+        result = std::shared_ptr<const Segment>();
+    }
+
+    void run() {
+        std::shared_ptr<const Segment> seg = segment;
+        result = SegmentInserter::retain(seg, existing, false, nthreads);
+    }
+
+    size_t getNRows() const {
+        return segment->getNRows() + existing->getNRows();
+    }
+
+    size_t getNOutput() {
+        return result == NULL ? 0 : result->getNRows();
+    }
+};
+
+/*
+ * Consolidation of the derivations of a rule in the table of the head: the
+ * derivations (unsorted, with duplicates, half of them already in the table)
+ * are sorted, the existing ones are removed and the rest is added to the
+ * table as a new block.
+ */
+class ConsolidateBenchmark : public Benchmark {
+private:
+    const size_t nrows;
+    const uint64_t seed;
+    const uint8_t arity;
+    const BenchData::Distribution distr;
+    const int nthreads;
+
+    std::unique_ptr<Literal> head;
+    std::shared_ptr<const FCInternalTable> existing;
+    BenchData::Columns derivations;
+    std::vector<std::pair<uint8_t, uint8_t>> posFromFirst, posFromSecond;
+    std::vector<FCBlock> listDerivations;
+    std::unique_ptr<FCTable> table;
+    std::unique_ptr<FinalTableJoinProcessor> output;
+
+public:
+    ConsolidateBenchmark(const size_t nrows, const uint64_t seed,
+                         const uint8_t arity,
+                         const BenchData::Distribution distr,
+                         const int nthreads) :
+        nrows(nrows), seed(seed), arity(arity), distr(distr),
+        nthreads(nthreads) {
+    }
+
+    std::string getName() const {
+        return "consolidate/" + BenchData::getName(distr) + "/" +
+               getArityName(arity);
+    }
+
+    void setup() {
+        const Term_t domain = 4 * nrows;
+        BenchData::Columns old = BenchData::generate(nrows, arity, distr,
+                                 false, domain, seed);
+        BenchData::sortAndUnique(old);
+        existing = std::shared_ptr<const FCInternalTable>(
+                       new InmemoryFCInternalTable(arity, (size_t) 0, true,
+                               BenchData::toSegment(old)));
+        derivations = BenchData::generate(nrows, arity, distr, false, domain,
+                                          seed + 1);
+        BenchData::overlap(derivations, old, 0.5, seed + 2);
+        head = std::unique_ptr<Literal>(new Literal(getLiteral(arity)));
+        for (uint8_t i = 0; i < arity; ++i) {
+            posFromFirst.push_back(std::make_pair(i, i));
+        }
+    }
+
+    void prepare() {
+        output = std::unique_ptr<FinalTableJoinProcessor>();
+        listDerivations.clear();
+        table = std::unique_ptr<FCTable>(new FCTable(NULL, arity));
+        table->add(existing, *head, NULL, 0, 1, true, nthreads);
+        output = std::unique_ptr<FinalTableJoinProcessor>(
+                     new FinalTableJoinProcessor(posFromFirst, posFromSecond,
+                             listDerivations, table.get(), *head, NULL, 0, 2,
+                             true, nthreads));
+        const std::vector<const std::vector<Term_t> *> columns =
+            BenchData::getPointers(derivations);
+        const std::vector<const std::vector<Term_t> *> none;
+        for (size_t i = 0; i < nrows; ++i) {
+            output->processResults(0, columns, i, none, 0, false);
+        }
+    }
+
+    void run() {
+        output->consolidate(true);
+    }
+
+    size_t getNRows() const {
+        return nrows;
+    }
+
+    size_t getNOutput() {
+        return table->getNRows(2);
+    }
+};
+
+void KernelBenchmarks::create(const size_t nrows, const uint64_t seed,
+                              const int nthreads,
+                              std::vector<std::unique_ptr<Benchmark>> &out) {
+    const BenchData::Distribution distrs[] = {BenchData::UNIFORM,
+                                              BenchData::SKEWED
+                                             };
+    for (const auto distr : distrs) {
+        for (uint8_t arity = 1; arity <= 3; ++arity) {
+            out.push_back(std::unique_ptr<Benchmark>(new MergeJoinBenchmark(
+                              nrows, seed, arity, distr)));
+        }
+    }
+    for (const auto distr : distrs) {
+        out.push_back(std::unique_ptr<Benchmark>(new HashJoinBenchmark(
+                          nrows, seed, distr)));
+    }
+    for (const auto distr : distrs) {
+        for (uint8_t arity = 1; arity <= 3; ++arity) {
+            out.push_back(std::unique_ptr<Benchmark>(new SortBenchmark(
+                              nrows, seed, arity, distr, false, nthreads)));
+            out.push_back(std::unique_ptr<Benchmark>(new SortBenchmark(
+                              nrows, seed, arity, distr, true, nthreads)));
+        }
+    }
+    for (const auto distr : distrs) {
+        for (uint8_t arity = 1; arity <= 3; ++arity) {
+            out.push_back(std::unique_ptr<Benchmark>(new RetainBenchmark(
+                              nrows, seed, arity, distr, nthreads)));
+        }
+    }
+    for (const auto distr : distrs) {
+        for (uint8_t arity = 1; arity <= 3; ++arity) {
+            out.push_back(std::unique_ptr<Benchmark>(new ConsolidateBenchmark(
+                              nrows, seed, arity, distr, nthreads)));
+        }
+    }
+}
@@ -0,0 +1,105 @@
+//Microbenchmarks of the kernels of VLog. They run on synthetic data, so
+//they do not need a Trident KB.
+#include <bench/harness.h>
+#include <bench/kernels.h>
+
+//Boost
+#include <boost/log/trivial.hpp>
+#include <boost/log/utility/setup/console.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/program_options.hpp>
+
+//TBB
+#include <tbb/task_scheduler_init.h>
+
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+namespace logging = boost::log;
+namespace po = boost::program_options;
+
+bool initParams(int argc, const char** argv, po::variables_map &vm) {
+    po::options_description options("Options");
+    options.add_options()("help,h", "produce help message.");
+    options.add_options()("filter", po::value<string>()->default_value(""),
+            "run only the benchmarks whose name contains this string (e.g. mergejoin/skewed).");
+    options.add_options()("list", "print the names of the benchmarks and exit.");
+    options.add_options()("rows", po::value<long>()->default_value(1000000),
+            "number of rows of the input relations.");
+    options.add_options()("reps", po::value<int>()->default_value(5),
+            "number of timed runs of each benchmark.");
+    options.add_options()("warmup", po::value<int>()->default_value(1),
+            "number of runs of each benchmark before the timed ones.");
+    options.add_options()("seed", po::value<long>()->default_value(42),
+            "seed of the generators of the data.");
+    options.add_options()("nthreads", po::value<int>()->default_value(1),
+            "threads used by the kernels that can run in parallel.");
+    options.add_options()("logLevel", po::value<logging::trivial::severity_level>(),
+            "Set the log level (accepted values: trace, debug, info, warning, error, fatal). Default is warning.");
+
+    po::store(po::command_line_parser(argc, argv).options(options).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        cout << "Usage: " << argv[0] << " [options]" << endl << endl;
+        cout << options << endl;
+        return false;
+    }
+    if (vm["rows"].as<long>() <= 0 || vm["reps"].as<int>() <= 0 ||
+            vm["warmup"].as<int>() < 0) {
+        cout << "The number of rows and of runs must be positive" << endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, const char** argv) {
+    po::variables_map vm;
+    if (!initParams(argc, argv, vm)) {
+        return EXIT_FAILURE;
+    }
+
+    //The kernels log at the debug level in their inner loops
+    logging::trivial::severity_level level =
+        vm.count("logLevel") ?
+        vm["logLevel"].as<logging::trivial::severity_level>() :
+        logging::trivial::warning;
+    logging::add_console_log(std::cerr);
+    logging::core::get()->set_filter(logging::trivial::severity >= level);
+
+    int nthreads = vm["nthreads"].as<int>();
+    if (nthreads <= 1) {
+        nthreads = -1;
+    }
+    tbb::task_scheduler_init init(nthreads > 1 ? nthreads : 2);
+
+    std::vector<std::unique_ptr<Benchmark>> benchmarks;
+    KernelBenchmarks::create((size_t) vm["rows"].as<long>(),
+                             (uint64_t) vm["seed"].as<long>(), nthreads,
+                             benchmarks);
+
+    const string filter = vm["filter"].as<string>();
+    if (vm.count("list")) {
+        for (const auto &bench : benchmarks) {
+            if (bench->getName().find(filter) != string::npos) {
+                cout << bench->getName() << endl;
+            }
+        }
+        return EXIT_SUCCESS;
+    }
+
+    BenchRunner runner(vm["warmup"].as<int>(), vm["reps"].as<int>());
+    BenchRunner::printHeader(cout);
+    for (auto &bench : benchmarks) {
+        if (bench->getName().find(filter) == string::npos) {
+            continue;
+        }
+        BenchResult result = runner.run(*bench);
+        BenchRunner::print(result, cout);
+        //Release the data before generating the next one
+        bench.reset();
+    }
+    return EXIT_SUCCESS;
+}
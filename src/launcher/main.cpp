@@ -10,6 +10,7 @@
 
 //Used to load a Trident KB
 #include <launcher/vloglayer.h>
+#include <launcher/queryserver.h>
 #include <trident/loader.h>
 #include <kognac/utils.h>
 
@@ -37,6 +38,8 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/program_options.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
 // #include <boost/sort/spreadsort/integer_sort.hpp>
 
 //TBB
@@ -83,8 +86,10 @@ void printHelp(const char *programName, po::options_description &desc) {
     cout << "query\t\t execute a SPARQL query." << endl;
     cout << "queryLiteral\t\t execute a Literal query." << endl;
     cout << "server\t\t starts in server mode." << endl;
+    cout << "serve\t\t answer the queries received on a local socket." << endl;
     cout << "load\t\t load a Trident KB." << endl;
-    cout << "lookup\t\t lookup for values in the dictionary." << endl << endl;
+    cout << "lookup\t\t lookup for values in the dictionary." << endl;
+    cout << "analyze\t\t compute the statistics of the EDB tables." << endl << endl;
 
     cout << desc << endl;
 }
@@ -107,7 +112,8 @@ bool checkParams(po::variables_map &vm, int argc, const char** argv,
     }
 
     if (cmd != "help" && cmd != "query" && cmd != "lookup" && cmd != "load" && cmd != "queryLiteral"
-            && cmd != "mat" && cmd != "rulesgraph" && cmd != "server") {
+            && cmd != "mat" && cmd != "rulesgraph" && cmd != "server" && cmd != "serve"
+            && cmd != "analyze") {
         printErrorMsg(
                 (string("The command \"") + cmd + string("\" is unknown.")).c_str());
         return false;
@@ -200,6 +206,28 @@ bool checkParams(po::variables_map &vm, int argc, const char** argv,
                 return false;
             }
 
+        } else if (cmd == "serve") {
+            string path = vm["rules"].as<string>();
+            if (path != "" && !fs::exists(path)) {
+                printErrorMsg((string("The rule file '") +
+                            path + string("' does not exists")).c_str());
+                return false;
+            }
+            if (vm["serveWorkers"].as<int>() < 1 || vm["serveMaxQueued"].as<int>() < 1) {
+                printErrorMsg("The number of workers and of queued queries must be at least 1");
+                return false;
+            }
+            if (vm["servePort"].as<int>() < 0 || vm["servePort"].as<int>() > 65535) {
+                printErrorMsg("The port must be between 0 and 65535");
+                return false;
+            }
+            boost::system::error_code ec;
+            boost::asio::ip::address::from_string(vm["serveAddress"].as<string>(), ec);
+            if (ec) {
+                printErrorMsg((string("The address '") +
+                            vm["serveAddress"].as<string>() + string("' is not valid")).c_str());
+                return false;
+            }
         } else if (cmd == "mat") {
             string path = vm["rules"].as<string>();
             if (path != "" && !fs::exists(path)) {
@@ -222,6 +250,16 @@ bool initParams(int argc, const char** argv, po::variables_map &vm) {
             "Activate reasoning during query answering using the rules defined at this path. It is REQUIRED in case the command is <mat>. Default is '' (disabled).");
     query_options.add_options()("reasoningThreshold", po::value<long>()->default_value(1000000),
             "This parameter sets a threshold to estimate the reasoning cost of a pattern. This cost can be broadly associated to the cardinality of the pattern. It is used to choose either TopDown or Magic evalution. Default is 1000000 (1M).");
+    query_options.add_options()("answerCache", po::value<long>()->default_value(0),
+            "Memory (in MB) used to keep the answers of the queries to the reasoner, so that later queries can reuse them. Default is 0 (disabled).");
+    query_options.add_options()("algoCosts", po::value<string>()->default_value(""),
+            "File where the observed runtimes of magic and top-down evaluation are kept across runs. They are used to choose the algorithm instead of reasoningThreshold. Default is '' (runtimes are not stored).");
+    query_options.add_options()("sparqlStats", po::value<string>()->default_value(""),
+            "File where the estimated cardinalities of the SPARQL patterns are kept across runs. Default is '' (estimates are not stored).");
+    query_options.add_options()("warmStats", po::value<long>()->default_value(0),
+            "Estimate at startup the cardinalities of the SPARQL patterns with constants in the columns with at most this number of distinct values. Default is 0 (disabled).");
+    query_options.add_options()("exploration", po::value<double>()->default_value(0),
+            "Fraction of the queries that are evaluated with the algorithm that was measured less, to keep its runtime up to date. Both algorithms are measured on every kind of query anyway. Default is 0.");
     query_options.add_options()("matThreshold", po::value<long>()->default_value(10000000),
             "In case reasoning is activated, this parameter sets a threshold above which a full materialization is performed before we execute the query. Default is 10000000 (10M).");
     query_options.add_options()("automat",
@@ -230,8 +268,12 @@ bool initParams(int argc, const char** argv, po::variables_map &vm) {
             "Timeout used during automatic prematerialization (in microseconds). Default is 1000000 (i.e. one second per query)");
     query_options.add_options()("premat", po::value<string>()->default_value(""),
             "Pre-materialize the atoms in the file passed as argument. Default is '' (disabled).");
+    query_options.add_options()("prematInProcess",
+            "Run the queries of the pre-materialization in this process, concurrently if run multithreaded, instead of forking a process for each query.");
     query_options.add_options()("multithreaded",
-            "Run multithreaded (currently only supported for <mat>).");
+            "Run multithreaded (supported for <mat>, and for the top-down evaluation of <query> and <queryLiteral> together with --parallelQSQR).");
+    query_options.add_options()("parallelQSQR",
+            "Evaluate the rules of the top-down queries in parallel. Only used together with --multithreaded, or with <serve>, where every worker then starts its own parallel tasks.");
     query_options.add_options()("nthreads", po::value<int>()->default_value(tbb::task_scheduler_init::default_num_threads() / 2),
             string("Set maximum number of threads to use when run in multithreaded mode. Default is " + to_string(tbb::task_scheduler_init::default_num_threads() / 2)).c_str());
     query_options.add_options()("interRuleThreads", po::value<int>()->default_value(0),
@@ -250,11 +292,19 @@ bool initParams(int argc, const char** argv, po::variables_map &vm) {
             "Explain the query instead of executing it. Default is false.");
     query_options.add_options()("decompressmat", po::value<bool>()->default_value(false),
             "Decompress the results of the materialization when we write it to a file. Default is false.");
+    query_options.add_options()("matReport", po::value<string>()->default_value(""),
+            "Write the runtime, the peak memory, the number of derivations of each predicate and the costliest rules of <mat> in this JSON file. Default is '' (disable).");
+    query_options.add_options()("matReportRules", po::value<int>()->default_value(20),
+            "Number of rules listed in the report of <mat>, starting from the costliest. Default is 20");
 
 #ifdef WEBINTERFACE
     query_options.add_options()("webinterface", po::value<bool>()->default_value(false),
             "Start a web interface to monitor the execution. Default is false.");
     query_options.add_options()("port", po::value<int>()->default_value(8080), "Port to use for the web interface. Default is 8080");
+    query_options.add_options()("webThreads", po::value<int>()->default_value(2),
+            "Number of threads that serve the connections to the web interface. Default is 2");
+    query_options.add_options()("webWorkers", po::value<int>()->default_value(4),
+            "Number of threads that execute the requests to the web interface. Default is 4");
 #endif
 
     query_options.add_options()("no-filtering",
@@ -285,8 +335,28 @@ bool initParams(int argc, const char** argv, po::variables_map &vm) {
             "Textual term to search")("number,n", po::value<long>(),
                 "Numeric term to search");
 
+    po::options_description analyze_options("Options for <analyze>");
+    analyze_options.add_options()("maxDistinct",
+            po::value<long>()->default_value(1000),
+            "Compute the cardinality of every value of the columns with at most this number of distinct values. Default is 1000.");
+
+    po::options_description serve_options("Options for <serve> (together with those for <query>)");
+    serve_options.add_options()("socket", po::value<string>()->default_value("vlog.sock"),
+            "Path of the local socket where the queries are received. Default is 'vlog.sock'.");
+    serve_options.add_options()("servePort", po::value<int>()->default_value(0),
+            "TCP port where the queries are also received. Default is 0 (only the local socket is used).");
+    serve_options.add_options()("serveAddress", po::value<string>()->default_value("127.0.0.1"),
+            "Address where the TCP port is bound. The queries are not authenticated: use an address reachable from other hosts (e.g., 0.0.0.0) only on trusted networks. Default is '127.0.0.1'.");
+    serve_options.add_options()("serveWorkers", po::value<int>()->default_value(4),
+            "Number of queries that are executed concurrently. Default is 4.");
+    serve_options.add_options()("serveMaxQueued", po::value<int>()->default_value(64),
+            "Maximum number of queries that are queued or running. Further queries are refused. Default is 64.");
+    serve_options.add_options()("fullmat",
+            "Compute the full materialization at startup, and use it to answer the literal queries.");
+
     po::options_description cmdline_options("Parameters");
-    cmdline_options.add(query_options).add(lookup_options).add(load_options);
+    cmdline_options.add(query_options).add(lookup_options).add(load_options)
+        .add(analyze_options).add(serve_options);
     cmdline_options.add_options()("logLevel,l", po::value<logging::trivial::severity_level>(),
             "Set the log level (accepted values: trace, debug, info, warning, error, fatal). Default is info.");
 
@@ -364,11 +434,59 @@ void startServer(int argc,
             new WebInterface(NULL, pathExec + "/webinterface",
                 flattenAllArgs(argc, argv),
                 vm["edb"].as<string>()));
+    webint->setNThreads(vm["webThreads"].as<int>(), vm["webWorkers"].as<int>());
     webint->start("0.0.0.0", to_string(port));
     BOOST_LOG_TRIVIAL(info) << "Server is launched at 0.0.0.0:" << to_string(port);
     webint->join();
 }
 
+void writeMatReport(SemiNaiver &sn, po::variables_map &vm,
+        const string &pathRules, const double runtimems) {
+    namespace pt = boost::property_tree;
+    pt::ptree report;
+    report.put("rules", pathRules);
+    report.put("multithreaded", !vm["multithreaded"].empty());
+    report.put("nthreads", sn.getNThreads());
+    report.put("interRuleThreads", vm["multithreaded"].empty() ? 0 :
+            vm["interRuleThreads"].as<int>());
+    report.put("runtime_ms", runtimems);
+    report.put("iterations", sn.getCurrentIteration());
+    report.put("max_memory_mb", Utils::get_max_mem());
+
+    size_t derivations = 0;
+    pt::ptree predicates;
+    for (const auto &pred : sn.getSizePredicates()) {
+        predicates.put(pt::ptree::path_type(pred.name, '\0'), pred.rows);
+        derivations += pred.rows;
+    }
+    report.put("derivations", derivations);
+    report.add_child("predicates", predicates);
+
+    pt::ptree rules;
+    const std::vector<StatsRuleCost> costs = sn.getRuleCosts();
+    const size_t nrules = std::min(costs.size(),
+            (size_t) std::max(vm["matReportRules"].as<int>(), 0));
+    for (size_t i = 0; i < nrules; ++i) {
+        pt::ptree rule;
+        rule.put("rule", costs[i].rule->tostring(sn.getProgram(),
+                    &sn.getEDBLayer()));
+        rule.put("executions", costs[i].executions);
+        rule.put("productive", costs[i].productive);
+        rule.put("time_ms", costs[i].timems);
+        rules.push_back(std::make_pair("", rule));
+    }
+    report.add_child("top_rules", rules);
+
+    const string file = vm["matReport"].as<string>();
+    std::ofstream out(file);
+    if (!out.good()) {
+        BOOST_LOG_TRIVIAL(error) << "Cannot write the report in " << file;
+        throw 10;
+    }
+    pt::write_json(out, report);
+    BOOST_LOG_TRIVIAL(info) << "Report of the materialization written in " << file;
+}
+
 void launchFullMat(int argc,
         const char** argv,
         string pathExec,
@@ -385,6 +503,7 @@ void launchFullMat(int argc,
             //Automatic prematerialization
             timens::system_clock::time_point start = timens::system_clock::now();
             Materialization mat;
+            mat.setInProcess(!vm["prematInProcess"].empty());
             mat.guessLiteralsFromRules(p, db);
             mat.getAndStorePrematerialization(db, p, true,
                     vm["timeoutPremat"].as<int>());
@@ -395,6 +514,7 @@ void launchFullMat(int argc,
         } else if (vm["premat"].as<string>() != "") {
             timens::system_clock::time_point start = timens::system_clock::now();
             Materialization mat;
+            mat.setInProcess(!vm["prematInProcess"].empty());
             mat.loadLiteralsFromFile(p, vm["premat"].as<string>());
             mat.getAndStorePrematerialization(db, p, false, ~0l);
             boost::chrono::duration<double> sec = boost::chrono::system_clock::now()
@@ -430,6 +550,8 @@ void launchFullMat(int argc,
                         flattenAllArgs(argc, argv),
                         vm["edb"].as<string>()));
             int port = vm["port"].as<int>();
+            webint->setNThreads(vm["webThreads"].as<int>(),
+                    vm["webWorkers"].as<int>());
             webint->start("localhost", to_string(port));
         }
 #endif
@@ -440,6 +562,9 @@ void launchFullMat(int argc,
         boost::chrono::duration<double> sec = boost::chrono::system_clock::now() - start;
         BOOST_LOG_TRIVIAL(info) << "Runtime materialization = " << sec.count() * 1000 << " milliseconds";
         sn->printCountAllIDBs();
+        if (vm["matReport"].as<string>() != "") {
+            writeMatReport(*sn, vm, pathRules, sec.count() * 1000);
+        }
 
         if (vm["storemat_path"].as<string>() != "") {
             timens::system_clock::time_point start = timens::system_clock::now();
@@ -474,6 +599,54 @@ void launchFullMat(int argc,
     }
 }
 
+void setupReasoner(Reasoner &reasoner, po::variables_map &vm) {
+    reasoner.setAnswerCacheBudget((size_t) vm["answerCache"].as<long>() << 20);
+    if (vm["algoCosts"].as<string>() != "") {
+        reasoner.loadCosts(vm["algoCosts"].as<string>());
+    }
+    reasoner.setExploration(vm["exploration"].as<double>());
+    reasoner.setParallelQSQR(!vm["parallelQSQR"].empty());
+}
+
+void setupLayer(VLogLayer &layer, po::variables_map &vm) {
+    setupReasoner(layer.getReasoner(), vm);
+    if (vm["sparqlStats"].as<string>() != "") {
+        layer.loadStatistics(vm["sparqlStats"].as<string>());
+    }
+    if (vm["warmStats"].as<long>() > 0) {
+        layer.warmStatistics((size_t) vm["warmStats"].as<long>());
+    }
+}
+
+void prematerialize(EDBLayer &edb, Program &p, po::variables_map &vm) {
+    if (!vm["automat"].empty()) {
+        //Automatic prematerialization
+        timens::system_clock::time_point start = timens::system_clock::now();
+        Materialization *mat = new Materialization();
+        mat->setInProcess(!vm["prematInProcess"].empty());
+        mat->guessLiteralsFromRules(p, edb);
+        mat->getAndStorePrematerialization(edb, p, true,
+                vm["timeoutPremat"].as<int>());
+        delete mat;
+        boost::chrono::duration<double> sec = boost::chrono::system_clock::now()
+            - start;
+        BOOST_LOG_TRIVIAL(info) << "Runtime pre-materialization = " <<
+            sec.count() * 1000 << " milliseconds";
+    } else if (vm["premat"].as<string>() != "") {
+        timens::system_clock::time_point start = timens::system_clock::now();
+        Materialization *mat = new Materialization();
+        mat->setInProcess(!vm["prematInProcess"].empty());
+        mat->loadLiteralsFromFile(p, vm["premat"].as<string>());
+        mat->getAndStorePrematerialization(edb, p, false, ~0l);
+        p.sortRulesByIDBPredicates();
+        delete mat;
+        boost::chrono::duration<double> sec = boost::chrono::system_clock::now()
+            - start;
+        BOOST_LOG_TRIVIAL(info) << "Runtime pre-materialization = " <<
+            sec.count() * 1000 << " milliseconds";
+    }
+}
+
 void execSPARQLQuery(EDBLayer &edb, po::variables_map &vm) {
     //Parse the rules and create a program
     Program p(edb.getNTerms(), &edb);
@@ -485,30 +658,7 @@ void execSPARQLQuery(EDBLayer &edb, po::variables_map &vm) {
 
     //Set up the ruleset and perform the pre-materialization if necessary
     if (pathRules != "") {
-        if (!vm["automat"].empty()) {
-            //Automatic prematerialization
-            timens::system_clock::time_point start = timens::system_clock::now();
-            Materialization *mat = new Materialization();
-            mat->guessLiteralsFromRules(p, edb);
-            mat->getAndStorePrematerialization(edb, p, true,
-                    vm["timeoutPremat"].as<int>());
-            delete mat;
-            boost::chrono::duration<double> sec = boost::chrono::system_clock::now()
-                - start;
-            BOOST_LOG_TRIVIAL(info) << "Runtime pre-materialization = " <<
-                sec.count() * 1000 << " milliseconds";
-        } else if (vm["premat"].as<string>() != "") {
-            timens::system_clock::time_point start = timens::system_clock::now();
-            Materialization *mat = new Materialization();
-            mat->loadLiteralsFromFile(p, vm["premat"].as<string>());
-            mat->getAndStorePrematerialization(edb, p, false, ~0l);
-            p.sortRulesByIDBPredicates();
-            delete mat;
-            boost::chrono::duration<double> sec = boost::chrono::system_clock::now()
-                - start;
-            BOOST_LOG_TRIVIAL(info) << "Runtime pre-materialization = " <<
-                sec.count() * 1000 << " milliseconds";
-        }
+        prematerialize(edb, p, vm);
     }
 
     DBLayer *db = NULL;
@@ -529,7 +679,9 @@ void execSPARQLQuery(EDBLayer &edb, po::variables_map &vm) {
 	    p.readFromFile(pathRules);
 	    p.sortRulesByIDBPredicates();
 	}
-	db = new VLogLayer(edb, p, vm["reasoningThreshold"].as<long>(), "TI", "TE");
+	VLogLayer *vloglayer = new VLogLayer(edb, p, vm["reasoningThreshold"].as<long>(), "TI", "TE");
+	setupLayer(*vloglayer, vm);
+	db = vloglayer;
     }
     string queryFileName = vm["query"].as<string>();
     // Parse the query
@@ -647,30 +799,7 @@ void execLiteralQuery(EDBLayer &edb, po::variables_map &vm) {
 
     //Set up the ruleset and perform the pre-materialization if necessary
     if (pathRules != "") {
-        if (!vm["automat"].empty()) {
-            //Automatic prematerialization
-            timens::system_clock::time_point start = timens::system_clock::now();
-            Materialization *mat = new Materialization();
-            mat->guessLiteralsFromRules(p, edb);
-            mat->getAndStorePrematerialization(edb, p, true,
-                    vm["timeoutPremat"].as<int>());
-            delete mat;
-            boost::chrono::duration<double> sec = boost::chrono::system_clock::now()
-                - start;
-            BOOST_LOG_TRIVIAL(info) << "Runtime pre-materialization = " <<
-                sec.count() * 1000 << " milliseconds";
-        } else if (vm["premat"].as<string>() != "") {
-            timens::system_clock::time_point start = timens::system_clock::now();
-            Materialization *mat = new Materialization();
-            mat->loadLiteralsFromFile(p, vm["premat"].as<string>());
-            mat->getAndStorePrematerialization(edb, p, false, ~0l);
-            p.sortRulesByIDBPredicates();
-            delete mat;
-            boost::chrono::duration<double> sec = boost::chrono::system_clock::now()
-                - start;
-            BOOST_LOG_TRIVIAL(info) << "Runtime pre-materialization = " <<
-                sec.count() * 1000 << " milliseconds";
-        }
+        prematerialize(edb, p, vm);
     }
 
     /*
@@ -706,6 +835,7 @@ void execLiteralQuery(EDBLayer &edb, po::variables_map &vm) {
     Literal literal = p.parseLiteral(query);
     boost::chrono::system_clock::time_point startQ1 = boost::chrono::system_clock::now();
     Reasoner reasoner(vm["reasoningThreshold"].as<long>());
+    setupReasoner(reasoner, vm);
     TupleIterator *iter = reasoner.getIterator(literal, NULL, NULL, edb, p, true, NULL);
     int sz = iter->getTupleSize();
     long count = 0;
@@ -766,6 +896,61 @@ void execLiteralQuery(EDBLayer &edb, po::variables_map &vm) {
     // delete db;
 }
 
+void serve(EDBLayer &edb, po::variables_map &vm) {
+    //Load the program once for all the queries
+    Program p(edb.getNTerms(), &edb);
+    string pathRules = vm["rules"].as<string>();
+    if (pathRules != "") {
+        p.readFromFile(pathRules);
+        p.sortRulesByIDBPredicates();
+        prematerialize(edb, p, vm);
+    }
+
+    std::shared_ptr<SemiNaiver> sn;
+    if (!vm["fullmat"].empty() && pathRules != "") {
+        int nthreads = vm["nthreads"].as<int>();
+        int interRuleThreads = vm["interRuleThreads"].as<int>();
+        if (vm["multithreaded"].empty()) {
+            nthreads = -1;
+            interRuleThreads = 0;
+        }
+        sn = Reasoner::fullMaterialization(edb, &p,
+                vm["no-intersect"].empty(),
+                vm["no-filtering"].empty(),
+                ! vm["multithreaded"].empty(),
+                nthreads,
+                interRuleThreads,
+                ! vm["shufflerules"].empty());
+    }
+
+    Reasoner reasoner(vm["reasoningThreshold"].as<long>());
+    setupReasoner(reasoner, vm);
+
+    DBLayer *db = NULL;
+    if (pathRules == "") {
+        PredId_t p = edb.getFirstEDBPredicate();
+        string typedb = edb.getTypeEDBPredicate(p);
+        if (typedb == "Trident") {
+            auto edbTable = edb.getEDBTable(p);
+            KB *kb = ((TridentTable*)edbTable.get())->getKB();
+            TridentLayer *tridentlayer = new TridentLayer(*kb);
+            tridentlayer->disableBifocalSampling();
+            db = tridentlayer;
+        }
+    }
+    if (db == NULL) {
+        VLogLayer *vloglayer = new VLogLayer(edb, p, vm["reasoningThreshold"].as<long>(), "TI", "TE");
+        setupLayer(*vloglayer, vm);
+        db = vloglayer;
+    }
+
+    QueryServer server(edb, p, sn, reasoner, *db,
+            vm["serveWorkers"].as<int>(), vm["serveMaxQueued"].as<int>());
+    server.run(vm["socket"].as<string>(), vm["servePort"].as<int>(),
+            vm["serveAddress"].as<string>());
+    delete db;
+}
+
 int main(int argc, const char** argv) {
 
     //Init params
@@ -841,6 +1026,11 @@ int main(int argc, const char** argv) {
         EDBLayer *layer = new EDBLayer(conf, false);
         lookup(*layer, vm);
         delete layer;
+    } else if (cmd == "analyze") {
+        EDBConf conf(edbFile);
+        EDBLayer *layer = new EDBLayer(conf, false);
+        layer->analyze(vm["maxDistinct"].as<long>());
+        delete layer;
     } else if (cmd == "mat") {
         EDBConf conf(edbFile);
         EDBLayer *layer = new EDBLayer(conf, ! vm["multithreaded"].empty());
@@ -971,6 +1161,12 @@ int main(int argc, const char** argv) {
         delete loader;
     } else if (cmd == "server") {
         startServer(argc, argv, full_path.string(), vm);
+    } else if (cmd == "serve") {
+        EDBConf conf(edbFile);
+        //The workers of the server query the tables at the same time
+        EDBLayer *layer = new EDBLayer(conf, true);
+        serve(*layer, vm);
+        delete layer;
     }
     boost::chrono::duration<double> sec = boost::chrono::system_clock::now() - start;
     BOOST_LOG_TRIVIAL(info) << "Runtime = " << sec.count() * 1000 << " milliseconds";
@@ -0,0 +1,503 @@
+#include <launcher/queryserver.h>
+
+#include <vlog/webinterface.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include <sstream>
+#include <unistd.h>
+
+QueryServer::QueryServer(EDBLayer &edb, Program &program,
+                         std::shared_ptr<SemiNaiver> sn, Reasoner &reasoner,
+                         DBLayer &sparqlLayer, int nworkers, size_t maxQueued) :
+    edb(edb), program(program), sn(sn), reasoner(reasoner),
+    sparqlLayer(sparqlLayer),
+    nworkers(nworkers < 1 ? 1 : nworkers),
+    maxQueued(maxQueued < 1 ? 1 : maxQueued), nqueued(0) {
+}
+
+void QueryServer::listen(const boost::asio::generic::stream_protocol::endpoint &endpoint) {
+    std::unique_ptr<Acceptor> acceptor(
+        new Acceptor(io));
+    acceptor->open(endpoint.protocol());
+    if (endpoint.protocol().family() != AF_UNIX) {
+        acceptor->set_option(boost::asio::socket_base::reuse_address(true));
+    }
+    acceptor->bind(endpoint);
+    acceptor->listen();
+    acceptors.push_back(std::move(acceptor));
+}
+
+void QueryServer::run(std::string path, int port, std::string address) {
+    this->path = path;
+    //Remove the socket left by a previous run
+    ::unlink(path.c_str());
+    listen(boost::asio::local::stream_protocol::endpoint(path));
+    if (port != 0) {
+        listen(boost::asio::ip::tcp::endpoint(
+                   boost::asio::ip::address::from_string(address), port));
+    }
+
+    workersWork = std::unique_ptr<boost::asio::io_service::work>(
+                      new boost::asio::io_service::work(workers));
+    for (int i = 0; i < nworkers; ++i) {
+        workerThreads.create_thread([this]() {
+            workers.run();
+        });
+    }
+
+    boost::asio::signal_set signals(io, SIGINT, SIGTERM);
+    signals.async_wait([this](const boost::system::error_code & err, int signal) {
+        if (!err) {
+            stop();
+        }
+    });
+
+    for (auto &acceptor : acceptors) {
+        connect(*acceptor);
+    }
+    BOOST_LOG_TRIVIAL(info) << "Accepting queries on " << path <<
+                            (port != 0 ? " and on " + address + ":" + std::to_string(port) : "")
+                            << " with " << nworkers << " workers";
+    io.run();
+
+    workersWork.reset();
+    workerThreads.join_all();
+    ::unlink(path.c_str());
+    BOOST_LOG_TRIVIAL(info) << "The server is stopped";
+}
+
+void QueryServer::stop() {
+    BOOST_LOG_TRIVIAL(info) << "Stopping the server ...";
+    for (auto &acceptor : acceptors) {
+        acceptor->close();
+    }
+    io.stop();
+    workers.stop();
+}
+
+void QueryServer::connect(Acceptor &acceptor) {
+    boost::shared_ptr<Connection> conn(new Connection(io, this, acceptor));
+    acceptor.async_accept(conn->socket,
+                          boost::bind(&Connection::acceptHandler, conn,
+                                      boost::asio::placeholders::error));
+}
+
+void QueryServer::Connection::acceptHandler(const boost::system::error_code &err) {
+    if (acceptor.is_open()) {
+        server->connect(acceptor);
+    }
+    if (!err) {
+        read();
+    }
+}
+
+void QueryServer::Connection::readAtLeast(const size_t n,
+        void (Connection::*handler)(const boost::system::error_code &, std::size_t)) {
+    if (request.size() >= n) {
+        (this->*handler)(boost::system::error_code(), 0);
+    } else {
+        boost::asio::async_read(socket, request,
+                                boost::asio::transfer_exactly(n - request.size()),
+                                boost::bind(handler, shared_from_this(),
+                                            boost::asio::placeholders::error,
+                                            boost::asio::placeholders::bytes_transferred));
+    }
+}
+
+void QueryServer::Connection::read() {
+    //The first byte tells whether the request is binary or a line of text
+    readAtLeast(1, &Connection::peekHandler);
+}
+
+void QueryServer::Connection::peekHandler(const boost::system::error_code &err,
+        std::size_t bytes) {
+    if (err) {
+        return;
+    }
+    const uint8_t first = *boost::asio::buffer_cast<const uint8_t*>(request.data());
+    if (first == BINARY_MAGIC) {
+        readAtLeast(5, &Connection::binaryHeaderHandler);
+    } else {
+        boost::asio::async_read_until(socket, request, '\n',
+                                      boost::bind(&Connection::readHandler, shared_from_this(),
+                                              boost::asio::placeholders::error,
+                                              boost::asio::placeholders::bytes_transferred));
+    }
+}
+
+static uint64_t getUInt(const uint8_t *buffer, const int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; --i) {
+        value = (value << 8) + buffer[i];
+    }
+    return value;
+}
+
+static void putUInt(std::string &out, uint64_t value, const int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out.push_back((char) (value & 0xFF));
+        value >>= 8;
+    }
+}
+
+void QueryServer::Connection::binaryHeaderHandler(
+    const boost::system::error_code &err, std::size_t bytes) {
+    if (err) {
+        return;
+    }
+    const size_t length = getUInt(boost::asio::buffer_cast<const uint8_t*>(
+                                      request.data()) + 1, 4);
+    if (length + 5 > MAX_REQUEST_SIZE) {
+        BOOST_LOG_TRIVIAL(warning) << "Closing a connection that sent a request of more than " << MAX_REQUEST_SIZE << " bytes";
+        socket.close();
+        return;
+    }
+    readAtLeast(length + 5, &Connection::binaryFrameHandler);
+}
+
+void QueryServer::Connection::binaryFrameHandler(
+    const boost::system::error_code &err, std::size_t bytes) {
+    if (err) {
+        return;
+    }
+    const char *data = boost::asio::buffer_cast<const char*>(request.data());
+    const size_t length = getUInt((const uint8_t*) data + 1, 4);
+    std::string payload(data + 5, length);
+    request.consume(length + 5);
+
+    if (!admit()) {
+        response.clear();
+        putUInt(response, 5, 4);
+        putUInt(response, 1, 1);
+        putUInt(response, 0, 4);
+        write();
+        return;
+    }
+    server->workers.post(boost::bind(&Connection::executeBatch,
+                                     shared_from_this(), payload));
+}
+
+bool QueryServer::Connection::admit() {
+    if (server->nqueued.fetch_add(1) >= server->maxQueued) {
+        server->nqueued--;
+        return false;
+    }
+    return true;
+}
+
+void QueryServer::Connection::write() {
+    boost::asio::async_write(socket, boost::asio::buffer(response),
+                             boost::bind(&Connection::writeHandler, shared_from_this(),
+                                         boost::asio::placeholders::error,
+                                         boost::asio::placeholders::bytes_transferred));
+}
+
+void QueryServer::Connection::readHandler(const boost::system::error_code &err,
+        std::size_t bytes) {
+    if (err == boost::asio::error::not_found) {
+        BOOST_LOG_TRIVIAL(warning) << "Closing a connection that sent a request of more than " << MAX_REQUEST_SIZE << " bytes";
+        socket.close();
+        return;
+    } else if (err) {
+        //The client has closed the connection
+        return;
+    }
+
+    std::istream is(&request);
+    std::string line;
+    std::getline(is, line);
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    if (line.empty()) {
+        read();
+        return;
+    }
+
+    //Admission control
+    if (!admit()) {
+        response = "ERROR busy\n";
+        write();
+        return;
+    }
+    server->workers.post(boost::bind(&Connection::execute, shared_from_this(),
+                                     line));
+}
+
+void QueryServer::Connection::execute(const std::string line) {
+    boost::chrono::system_clock::time_point start = boost::chrono::system_clock::now();
+    response.clear();
+    long nrows = 0;
+    try {
+        if (boost::starts_with(line, "LITERAL ")) {
+            server->answerLiteral(line.substr(8), response, nrows);
+        } else if (boost::starts_with(line, "SPARQL ")) {
+            server->answerSPARQL(line.substr(7), response, nrows);
+        } else {
+            throw 10;
+        }
+        boost::chrono::duration<double> sec = boost::chrono::system_clock::now() - start;
+        response += "OK " + std::to_string(nrows) + " " +
+                    std::to_string(sec.count() * 1000) + "\n";
+    } catch (int e) {
+        BOOST_LOG_TRIVIAL(warning) << "Failed request: " << line;
+        response = "ERROR cannot answer the request (code " + std::to_string(e) + ")\n";
+    }
+    server->nqueued--;
+    write();
+}
+
+void QueryServer::Connection::executeBatch(const std::string payload) {
+    response.clear();
+    //Leave room for the length of the response
+    putUInt(response, 0, 4);
+    try {
+        server->answerBatch(payload, response);
+    } catch (int e) {
+        BOOST_LOG_TRIVIAL(warning) << "Failed binary request of " << payload.size() << " bytes";
+        response.resize(4);
+        putUInt(response, 2, 1);
+        putUInt(response, 0, 4);
+    }
+    const size_t length = response.size() - 4;
+    for (int i = 0; i < 4; ++i) {
+        response[i] = (char) ((length >> (8 * i)) & 0xFF);
+    }
+    server->nqueued--;
+    write();
+}
+
+void QueryServer::Connection::writeHandler(const boost::system::error_code &err,
+        std::size_t bytes) {
+    if (err) {
+        socket.close();
+        return;
+    }
+    response.clear();
+    read();
+}
+
+static void writeTerm(EDBLayer &edb, const uint64_t value,
+                      std::ostringstream &out) {
+    char supportText[MAX_TERM_SIZE];
+    if (edb.getDictText(value, supportText)) {
+        out << supportText;
+    } else {
+        out << value;
+    }
+}
+
+void QueryServer::evaluate(Literal &literal, std::vector<Term_t> &rows,
+                           uint8_t &ncolumns) {
+    if (sn && literal.getPredicate().getType() == IDB) {
+        //Read the answers from the materialization
+        FCIterator itr;
+        {
+            boost::mutex::scoped_lock lock(matMutex);
+            itr = sn->getTable(literal, 0, (size_t) - 1);
+        }
+        ncolumns = literal.getNVars();
+        while (!itr.isEmpty()) {
+            std::shared_ptr<const FCInternalTable> table = itr.getCurrentTable();
+            FCInternalTableItr *itrTable = table->getIterator();
+            ncolumns = itrTable->getNColumns();
+            while (itrTable->hasNext()) {
+                itrTable->next();
+                for (uint8_t i = 0; i < ncolumns; ++i) {
+                    rows.push_back(itrTable->getCurrentValue(i));
+                }
+            }
+            table->releaseIterator(itrTable);
+            itr.moveNextCount();
+        }
+    } else {
+        boost::unique_lock<boost::mutex> lock(edbMutex, boost::defer_lock);
+        if (!edb.isMultithreaded()) {
+            lock.lock();
+        }
+        std::unique_ptr<TupleIterator> iter(reasoner.getIterator(literal,
+                                            NULL, NULL, edb, program, true, NULL));
+        ncolumns = (uint8_t) iter->getTupleSize();
+        while (iter->hasNext()) {
+            iter->next();
+            for (uint8_t i = 0; i < ncolumns; ++i) {
+                rows.push_back(iter->getElementAt(i));
+            }
+        }
+    }
+}
+
+void QueryServer::answerLiteral(const std::string &query,
+                                std::string &response, long &nrows) {
+    //The names come from the clients, so they are not added to the program
+    Literal literal = program.parseQueryLiteral(query);
+
+    std::vector<Term_t> rows;
+    uint8_t ncolumns = 0;
+    evaluate(literal, rows, ncolumns);
+    std::ostringstream out;
+    for (size_t i = 0; ncolumns > 0 && i < rows.size(); i += ncolumns) {
+        for (uint8_t j = 0; j < ncolumns; ++j) {
+            if (j != 0) {
+                out << "\t";
+            }
+            writeTerm(edb, rows[i + j], out);
+        }
+        out << "\n";
+        nrows++;
+    }
+    response = out.str();
+}
+
+//Reads the fields of a binary request, failing if it is too short
+class PayloadReader {
+private:
+    const uint8_t *data;
+    const size_t size;
+    size_t pos;
+
+public:
+    PayloadReader(const std::string &payload) :
+        data((const uint8_t*) payload.data()), size(payload.size()), pos(0) {
+    }
+
+    uint64_t get(const int bytes) {
+        if (pos + bytes > size) {
+            BOOST_LOG_TRIVIAL(error) << "The binary request is truncated";
+            throw 10;
+        }
+        const uint64_t value = getUInt(data + pos, bytes);
+        pos += bytes;
+        return value;
+    }
+
+    std::string getString(const size_t len) {
+        if (pos + len > size) {
+            BOOST_LOG_TRIVIAL(error) << "The binary request is truncated";
+            throw 10;
+        }
+        std::string value((const char*) data + pos, len);
+        pos += len;
+        return value;
+    }
+};
+
+void QueryServer::answerBatch(const std::string &payload,
+                              std::string &response) {
+    PayloadReader reader(payload);
+    const uint8_t flags = reader.get(1);
+    const uint32_t nqueries = reader.get(4);
+
+    //Parse the whole batch before executing any query
+    std::vector<Literal> literals;
+    for (uint32_t q = 0; q < nqueries; ++q) {
+        std::string pred = reader.getString(reader.get(2));
+        const uint8_t arity = reader.get(1);
+        if (arity == 0 || arity > SIZETUPLE) {
+            BOOST_LOG_TRIVIAL(error) << "Unsupported arity " << (int) arity;
+            throw 10;
+        }
+        VTuple tuple(arity);
+        for (uint8_t i = 0; i < arity; ++i) {
+            const uint8_t kind = reader.get(1);
+            if (kind == 0) {
+                tuple.set(VTerm(0, reader.get(8)), i);
+            } else if (kind == 1) {
+                const uint8_t var = reader.get(1);
+                if (var == 0) {
+                    BOOST_LOG_TRIVIAL(error) << "The variables are numbered from 1";
+                    throw 10;
+                }
+                tuple.set(VTerm(var, 0), i);
+            } else {
+                BOOST_LOG_TRIVIAL(error) << "Unknown kind of term " << (int) kind;
+                throw 10;
+            }
+        }
+        //The names come from the clients, so they are not added to the program
+        Predicate predicate = program.getKnownPredicate(pred, arity,
+                              Predicate::calculateAdornment(tuple));
+        literals.push_back(Literal(predicate, tuple));
+    }
+
+    putUInt(response, 0, 1);
+    putUInt(response, nqueries, 4);
+    std::vector<Term_t> rows;
+    char supportText[MAX_TERM_SIZE];
+    for (auto &literal : literals) {
+        rows.clear();
+        uint8_t ncolumns = 0;
+        try {
+            evaluate(literal, rows, ncolumns);
+        } catch (int e) {
+            const std::string msg = "cannot answer the query (code " +
+                                    std::to_string(e) + ")";
+            putUInt(response, 1, 1);
+            putUInt(response, msg.size(), 2);
+            response += msg;
+            continue;
+        }
+        const size_t nrows = ncolumns > 0 ? rows.size() / ncolumns : 0;
+        const size_t start = response.size();
+        putUInt(response, 0, 1);
+        putUInt(response, ncolumns, 1);
+        putUInt(response, nrows, 8);
+        //The rows are returned column by column
+        for (uint8_t j = 0; j < ncolumns; ++j) {
+            for (size_t i = 0; i < nrows; ++i) {
+                putUInt(response, rows[i * ncolumns + j], 8);
+            }
+        }
+        if (flags & BINARY_DECODE) {
+            for (uint8_t j = 0; j < ncolumns; ++j) {
+                for (size_t i = 0; i < nrows; ++i) {
+                    const Term_t value = rows[i * ncolumns + j];
+                    std::string text;
+                    if (edb.getDictText(value, supportText)) {
+                        text = supportText;
+                    } else {
+                        text = std::to_string(value);
+                    }
+                    putUInt(response, text.size(), 4);
+                    response += text;
+                }
+            }
+        }
+        //The length of the response must fit in its header
+        if (response.size() - 4 > MAX_RESPONSE_SIZE) {
+            response.resize(start);
+            const std::string msg = "the answer is too large (" +
+                                    std::to_string(nrows) + " rows)";
+            putUInt(response, 1, 1);
+            putUInt(response, msg.size(), 2);
+            response += msg;
+        }
+    }
+}
+
+void QueryServer::answerSPARQL(const std::string &query,
+                               std::string &response, long &nrows) {
+    boost::property_tree::ptree pt;
+    boost::property_tree::ptree vars;
+    boost::property_tree::ptree bindings;
+    boost::property_tree::ptree stats;
+    {
+        boost::mutex::scoped_lock lock(sparqlMutex);
+        WebInterface::execSPARQLQuery(query, false, edb.getNTerms(),
+                                      sparqlLayer, false, true, &vars, &bindings, &stats);
+    }
+    pt.add_child("head.vars", vars);
+    pt.add_child("results.bindings", bindings);
+    pt.add_child("stats", stats);
+    std::ostringstream buf;
+    //The compact format ends with a newline
+    boost::property_tree::write_json(buf, pt, false);
+    response = buf.str();
+    nrows = bindings.size();
+}
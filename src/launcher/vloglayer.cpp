@@ -1,7 +1,12 @@
 #include <launcher/vloglayer.h>
 #include <launcher/vlogscan.h>
+#include <vlog/catalogfile.h>
+
+#include <boost/chrono.hpp>
 
 #include <cmath>
+#include <sstream>
+#include <stdexcept>
 
 // #define TEST_LUBM
 
@@ -339,26 +344,161 @@ double VLogLayer::getJoinSelectivity(bool value1L,
 uint64_t VLogLayer::getCardinality(uint64_t c1,
         uint64_t c2,
         uint64_t c3) {
+    //Distinct variables, otherwise the pattern would require equal values
     VTuple tuple(3);
     tuple.set(VTerm(~c1 ? 0 : 1, c1), 0);
-    tuple.set(VTerm(~c2 ? 0 : 1, c2), 1);
-    tuple.set(VTerm(~c3 ? 0 : 1, c3), 2);
+    tuple.set(VTerm(~c2 ? 0 : 2, c2), 1);
+    tuple.set(VTerm(~c3 ? 0 : 3, c3), 2);
     return getCardinality(tuple);
 }
 
 uint64_t VLogLayer::getCardinality(VTuple tuple) {
-    auto got = idbCardinalities.find(tuple);
-    double costImplicit;
+    {
+        boost::shared_lock<boost::shared_mutex> lock(stats->mutex);
+        auto got = stats->idbCardinalities.find(tuple);
+        if (got != stats->idbCardinalities.end()) {
+            return (uint64_t) got->second;
+        }
+    }
     Literal idbquery(Predicate(predQueries,
                      Predicate::calculateAdornment(tuple)), tuple);
+    double costImplicit = reasoner->estimate(idbquery, NULL, NULL, edb, this->p);
+    boost::unique_lock<boost::shared_mutex> lock(stats->mutex);
+    stats->idbCardinalities[tuple] = costImplicit;
+    stats->modified = true;
+    return (uint64_t) costImplicit;
+}
 
-    if (got == idbCardinalities.end()) {
-        costImplicit = reasoner.estimate(idbquery, NULL, NULL, edb, this->p);
-        idbCardinalities[tuple] = costImplicit;
-    } else {
-        costImplicit = got->second;
+std::string VLogLayer::getStatisticsHeader() {
+    //The estimates depend on the KB and on the rules
+    std::ostringstream header;
+    header << edb.getStatsSignature() << "\t" << std::hex <<
+           std::hash<std::string>()(p.tostring());
+    return header.str();
+}
+
+void VLogLayer::loadStatistics(const std::string &file) {
+    stats->file = file;
+    size_t count = 0;
+    boost::unique_lock<boost::shared_mutex> lock(stats->mutex);
+    //Format: pattern <TAB> estimate
+    const bool valid = CatalogFile::read(file, getStatisticsHeader(), 2,
+    [&](const std::vector<std::string> &fields) {
+        const std::vector<std::string> terms = CatalogFile::split(fields[0], ',');
+        if (terms.size() != 3) {
+            throw std::invalid_argument("pattern");
+        }
+        VTuple tuple(3);
+        for (uint8_t i = 0; i < 3; ++i) {
+            if (!terms[i].empty() && terms[i][0] == '?') {
+                tuple.set(VTerm((uint8_t) std::stoi(terms[i].substr(1)), ~0ul), i);
+            } else {
+                tuple.set(VTerm(0, std::stoull(terms[i])), i);
+            }
+        }
+        stats->idbCardinalities[tuple] = std::stod(fields[1]);
+        return true;
+    }, count);
+    if (!valid) {
+        BOOST_LOG_TRIVIAL(info) << "Ignoring the statistics in " << file << " because the KB or the rules have changed";
+        return;
     }
-    return (uint64_t) costImplicit;
+    stats->modified = false;
+    BOOST_LOG_TRIVIAL(debug) << "Loaded " << count << " estimates from " << file;
+}
+
+void VLogLayer::saveStatistics() {
+    if (stats->file == "" || !stats->modified) {
+        return;
+    }
+    boost::unique_lock<boost::shared_mutex> lock(stats->mutex);
+    const bool written = CatalogFile::write(stats->file, getStatisticsHeader(),
+    [&](std::ostream &out) {
+        for (const auto &entry : stats->idbCardinalities) {
+            for (uint8_t i = 0; i < 3; ++i) {
+                if (i > 0) {
+                    out << ",";
+                }
+                const VTerm t = entry.first.get(i);
+                if (t.isVariable()) {
+                    out << "?" << (int) t.getId();
+                } else {
+                    out << t.getValue();
+                }
+            }
+            out << "\t" << entry.second << std::endl;
+        }
+    });
+    if (!written) {
+        BOOST_LOG_TRIVIAL(warning) << "Cannot write the statistics in " << stats->file;
+        return;
+    }
+    stats->modified = false;
+    BOOST_LOG_TRIVIAL(debug) << "Stored " << stats->idbCardinalities.size() << " estimates in " << stats->file;
+}
+
+void VLogLayer::warmStatistics(const size_t maxDistinct) {
+    boost::chrono::system_clock::time_point start = boost::chrono::system_clock::now();
+    getCardinality(~0ul, ~0ul, ~0ul);
+
+    //Patterns with one constant, and with two constants if the second
+    //column also has few values once the first one is fixed
+    VTuple all(3);
+    for (uint8_t i = 0; i < 3; ++i) {
+        all.set(VTerm(i + 1, 0), i);
+    }
+    const Literal allEDB(Predicate(edbPredName, 0), all);
+    for (uint8_t pos = 0; pos < 3; ++pos) {
+        if (edb.getCardinalityColumn(allEDB, pos) > maxDistinct) {
+            continue;
+        }
+        std::vector<uint8_t> fields(1, pos);
+        EDBIterator *itr = edb.getSortedIterator(allEDB, fields);
+        bool first = true;
+        Term_t prev = 0;
+        while (itr->hasNext()) {
+            itr->next();
+            const Term_t v = itr->getElementAt(pos);
+            if (!first && v == prev) {
+                continue;
+            }
+            first = false;
+            prev = v;
+            uint64_t consts[3] = {~0ul, ~0ul, ~0ul};
+            consts[pos] = v;
+            getCardinality(consts[0], consts[1], consts[2]);
+
+            VTuple t = all;
+            t.set(VTerm(0, v), pos);
+            const Literal oneConst(Predicate(edbPredName,
+                                             Predicate::calculateAdornment(t)), t);
+            for (uint8_t pos2 = pos + 1; pos2 < 3; ++pos2) {
+                if (edb.getCardinalityColumn(oneConst, pos2) > maxDistinct) {
+                    continue;
+                }
+                std::vector<uint8_t> fields2(1, pos2);
+                EDBIterator *itr2 = edb.getSortedIterator(oneConst, fields2);
+                bool first2 = true;
+                Term_t prev2 = 0;
+                while (itr2->hasNext()) {
+                    itr2->next();
+                    const Term_t v2 = itr2->getElementAt(pos2);
+                    if (!first2 && v2 == prev2) {
+                        continue;
+                    }
+                    first2 = false;
+                    prev2 = v2;
+                    consts[pos2] = v2;
+                    getCardinality(consts[0], consts[1], consts[2]);
+                }
+                consts[pos2] = ~0ul;
+                edb.releaseIterator(itr2);
+            }
+        }
+        edb.releaseIterator(itr);
+    }
+    boost::chrono::duration<double> sec = boost::chrono::system_clock::now() - start;
+    BOOST_LOG_TRIVIAL(info) << "Estimated " << stats->idbCardinalities.size() << " patterns in " << sec.count() * 1000 << " milliseconds";
 }
 
 uint64_t VLogLayer::getCardinality() {
@@ -371,7 +511,7 @@ std::unique_ptr<DBLayer::Scan> VLogLayer::getScan(const DBLayer::DataOrder order
     //DataOrder is ignored
     return std::unique_ptr<DBLayer::Scan>(new VLogScan(order, aggr, hint,
                 predQueries,
-                edb, p, &reasoner));
+                edb, p, reasoner.get()));
 }
 
 void VLogLayer::init() {
@@ -379,6 +519,7 @@ void VLogLayer::init() {
     // Pre-initialize the cache with the exact cardinalities for lubm_125.
     // All cardinality requests as they are asked while running q1-q14 are here.
 
+    unordered_map<VTuple, double, hash_VTuple> &idbCardinalities = stats->idbCardinalities;
     VTuple t(3);
     VTerm v1(1, ~0ul);
     VTerm v2(2, ~0ul);
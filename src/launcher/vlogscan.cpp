@@ -2,16 +2,25 @@
 
 
 uint64_t VLogScan::getValue1() {
+    if (blockItr != NULL) {
+        return block[0][blockPos];
+    }
     return iterator->getElementAt(value1_index);
 }
 
 uint64_t VLogScan::getValue2() {
     assert(aggr != DBLayer::Aggr_t::AGGR_SKIP_2LAST);
+    if (blockItr != NULL) {
+        return block[1][blockPos];
+    }
     return iterator->getElementAt(value2_index);
 }
 
 uint64_t VLogScan::getValue3() {
     assert(aggr == DBLayer::Aggr_t::AGGR_NO);
+    if (blockItr != NULL) {
+        return block[2][blockPos];
+    }
     return iterator->getElementAt(value3_index);
 }
 
@@ -20,12 +29,28 @@ uint64_t VLogScan::getCount() {
     return it->count();
 }
 
+void VLogScan::fillBlock() {
+    const uint8_t positions[3] = {value1_index, value2_index, value3_index};
+    Term_t *columns[3] = {block[0], block[1], block[2]};
+    blockSize = blockItr->nextBlock(positions, 3, columns, BLOCK_SIZE);
+    blockPos = 0;
+}
+
 bool VLogScan::next() {
+    if (blockItr != NULL) {
+        if (++blockPos == blockSize) {
+            fillBlock();
+        }
+        current = blockPos < blockSize;
+        return current;
+    }
     if (iterator->hasNext()) {
         iterator->next();
         // BOOST_LOG_TRIVIAL(debug) << "Iterator = " << iterator.get() << ", value3 = " << getValue3();
+        current = true;
         return true;
     }
+    current = false;
     return false;
 }
 
@@ -125,6 +150,8 @@ bool VLogScan::first(uint64_t first, bool constrained1, uint64_t second, bool co
         break;
     }
 
+    blockItr = NULL;
+    current = false;
     if (keypos != NULL) {
 	assert(keys != NULL);
 	if (keys->size() == 0) {
@@ -137,8 +164,17 @@ bool VLogScan::first(uint64_t first, bool constrained1, uint64_t second, bool co
                                     false, &sortByFields);
     iterator = std::unique_ptr<TupleIterator>(tmpitr);
 
+    if (iterator && aggr == DBLayer::Aggr_t::AGGR_NO) {
+        blockItr = dynamic_cast<TupleTableBlockItr*>(iterator.get());
+        if (blockItr != NULL) {
+            fillBlock();
+            current = blockSize > 0;
+            return current;
+        }
+    }
     if (iterator && iterator->hasNext()) {
         iterator->next();
+        current = true;
         return true;
 
     }
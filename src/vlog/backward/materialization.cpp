@@ -8,11 +8,16 @@
 #include <boost/thread.hpp>
 #include <boost/tokenizer.hpp>
 
+#include <tbb/parallel_for.h>
+
+#include <atomic>
 #include <fstream>
 #include <string>
 #include <unistd.h>
 #include <signal.h>
 
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
@@ -146,12 +151,8 @@ void Materialization::guessLiteralsFromRules(Program &p, EDBLayer &layer) {
 #endif
 }
 
-int *myPipe;
-
 void alrmHandler(int signal) {
     BOOST_LOG_TRIVIAL(debug) << "Got alarm signal";
-    // close(myPipe[0]);
-    // close(myPipe[1]);
     BOOST_LOG_TRIVIAL(debug) << "Exiting ...";
     exit(1);
 }
@@ -159,18 +160,26 @@ void alrmHandler(int signal) {
 bool Materialization::evaluateQueryThreadedVersion(EDBLayer *kb,
         Program *p,
         QSQQuery *q,
-        TupleTable **output,
+        IndexedTupleTable **output,
         long timeoutMicros) {
-    //Create a pipe between the two processes
-    int pipeID[2];
-    pipe(pipeID);
+    //The child writes the results in an anonymous memory file, which it
+    //resizes to the results, in the layout of IndexedTupleTable. The parent
+    //maps the file and the table keeps the mapping.
+    int fd = -1;
+#ifdef MFD_CLOEXEC
+    fd = memfd_create("vlog-premat", 0);
+#endif
+    if (fd == -1) {
+        BOOST_LOG_TRIVIAL(warning) << "Cannot create the memory file for the results of the query. Evaluate it in the process";
+        return evaluateQueryWithoutFork(kb, p, q, output, timeoutMicros);
+    }
+
     //Fork the process.
     pid_t pid = fork();
 
     int status;
     if (pid == (pid_t) 0) { //Child
         QSQR *qsqr = new QSQR(*kb, p);
-        myPipe = &pipeID[0];
         // if (signal(SIGALRM, alrmHandler) == SIG_ERR) {
         // Could not set alarm signal handler
         // exit(1);
@@ -181,25 +190,21 @@ bool Materialization::evaluateQueryThreadedVersion(EDBLayer *kb,
         //After the query is computed, I don't care anymore of the alarm
         signal(SIGALRM, SIG_IGN);
 
-        //Copy the output to the parent process
-        close(pipeID[0]);
-        //Serialize TupleTable
-        char buffer[24];
-        //First write the row size and n of rows
-        Utils::encode_int(buffer, 0, tmpTable->getSizeRow());
-        Utils::encode_int(buffer, 4, tmpTable->getNRows());
-        write(pipeID[1], buffer, 8);
-
-        //Write the bindings, one after the other
-        const size_t rowSize = tmpTable->getSizeRow();
-        for (size_t i = 0; i < tmpTable->getNRows(); ++i) {
-            const uint64_t *row = tmpTable->getRow(i);
-            for (size_t j = 0; j < rowSize; ++j) {
-                Utils::encode_long(buffer, 8 * j, row[j]);
-            }
-            write(pipeID[1], buffer, 8 * rowSize);
+        const size_t size = IndexedTupleTable::getMappingSize(
+                                (uint8_t) tmpTable->getSizeRow(),
+                                tmpTable->getNRows());
+        if (ftruncate(fd, (off_t) size) != 0) {
+            BOOST_LOG_TRIVIAL(warning) << "Cannot resize the memory file for the results of the query";
+            exit(EXIT_FAILURE);
         }
-        close(pipeID[1]);
+        char *shared = (char*) mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED, fd, 0);
+        if (shared == MAP_FAILED) {
+            BOOST_LOG_TRIVIAL(warning) << "Cannot map the memory file for the results of the query";
+            exit(EXIT_FAILURE);
+        }
+        IndexedTupleTable::writeMapping(tmpTable, shared);
+        munmap(shared, size);
 	delete qsqr;
 
         exit(EXIT_SUCCESS);
@@ -209,39 +214,83 @@ bool Materialization::evaluateQueryThreadedVersion(EDBLayer *kb,
     } else { //Parent
         while (waitpid(pid, &status, 0) != pid) {
         }
-        close(pipeID[1]);
+        bool success = false;
+        bool fallback = false;
         //Check the status flag
         if (WIFEXITED(status)) {
             if (WEXITSTATUS(status) == 0) {
-                //Query terminated with success
-                //Read tuple table
-                char buffer[24];
-                //Read rowsize and n. of rows
-                read(pipeID[0], buffer, 8);
-                const size_t rowSize = Utils::decode_int(buffer, 0);
-                const size_t nRows = Utils::decode_int(buffer, 4);
-                *output = new TupleTable(rowSize);
-                uint64_t row[3];
-                for (size_t i = 0; i < nRows; ++i) {
-                    read(pipeID[0], buffer, 8 * rowSize);
-                    for (size_t j = 0; j < rowSize; ++j) {
-                        row[j] = Utils::decode_long(buffer, j * 8);
-                    }
-                    (*output)->addRow(row);
+                //Query terminated with success. The values are already
+                //sorted, so the table uses them as they are.
+                struct stat st;
+                uint64_t header[2];
+                if (fstat(fd, &st) != 0 ||
+                        pread(fd, header, sizeof(header), 0) != sizeof(header) ||
+                        header[0] == 0 || header[0] > SIZETUPLE ||
+                        IndexedTupleTable::getMappingSize((uint8_t) header[0],
+                                header[1]) != (size_t) st.st_size) {
+                    BOOST_LOG_TRIVIAL(warning) << "The results of the query are incomplete";
+                    close(fd);
+                    return false;
+                }
+                const size_t size = (size_t) st.st_size;
+                char *shared = (char*) mmap(NULL, size, PROT_READ,
+                                            MAP_SHARED, fd, 0);
+                if (shared == MAP_FAILED) {
+                    BOOST_LOG_TRIVIAL(warning) << "Cannot map the results of the query. Evaluate it in the process";
+                    fallback = true;
+                } else {
+                    *output = new IndexedTupleTable(shared, size);
+                    success = true;
                 }
-                close(pipeID[0]);
-                return true;
             }
-            close(pipeID[0]);
-            return false;
         } else {
-            close(pipeID[0]);
             //Process was terminated
             if (!WIFSIGNALED(status) || (WTERMSIG(status) != SIGALRM)) {
                 BOOST_LOG_TRIVIAL(warning) << "The process terminated with a weird return code";
             }
-            return false;
         }
+        //The mapping keeps the memory file alive
+        close(fd);
+        if (fallback) {
+            return evaluateQueryWithoutFork(kb, p, q, output, timeoutMicros);
+        }
+        return success;
+    }
+    return true;
+}
+
+bool Materialization::evaluateQueryWithoutFork(EDBLayer *kb,
+        Program *p,
+        QSQQuery *q,
+        IndexedTupleTable **output,
+        long timeoutMicros) {
+    TupleTable *table = NULL;
+    if (!evaluateQueryInProcess(kb, p, q, &table, timeoutMicros)) {
+        return false;
+    }
+    *output = new IndexedTupleTable(table);
+    delete table;
+    return true;
+}
+
+bool Materialization::evaluateQueryInProcess(EDBLayer *kb,
+        Program *p,
+        QSQQuery *q,
+        TupleTable **output,
+        long timeoutMicros) {
+    QSQR qsqr(*kb, p);
+    std::unique_ptr<CancelToken> token;
+    if (timeoutMicros > 0) {
+        token = std::unique_ptr<CancelToken>(new CancelToken(timeoutMicros));
+        qsqr.setCancelToken(token.get());
+    }
+    try {
+        *output = qsqr.evaluateQuery(QSQR_EVAL, q, NULL, NULL, true);
+    } catch (int v) {
+        if (v != QSQR_CANCELLED) {
+            throw v;
+        }
+        return false;
     }
     return true;
 }
@@ -253,13 +302,15 @@ bool Materialization::execMatQuery(Literal &l, bool timeout, EDBLayer &kb,
     QSQQuery q(l);
     BOOST_LOG_TRIVIAL(debug) << "Getting query " << l.tostring(&p, &kb);
     timens::system_clock::time_point start = timens::system_clock::now();
-    TupleTable *output = NULL;
+    IndexedTupleTable *output = NULL;
 
     if (!timeout || timeoutMicros == 0) {
         QSQR *qsqr = new QSQR(kb, &p);
-        output = qsqr->evaluateQuery(QSQR_EVAL, &q, NULL, NULL,
-                                     true);
+        TupleTable *table = qsqr->evaluateQuery(QSQR_EVAL, &q, NULL, NULL,
+                                                true);
         delete qsqr;
+        output = new IndexedTupleTable(table);
+        delete table;
     } else {
         failed = !evaluateQueryThreadedVersion(&kb, &p, &q,
                                                &output,
@@ -273,38 +324,115 @@ bool Materialization::execMatQuery(Literal &l, bool timeout, EDBLayer &kb,
                                  " failed after " <<
                                  sec.count() * 1000 << " ms";
     } else { // Not failed
-        BOOST_LOG_TRIVIAL(debug) << "Got " << output->getNRows() <<
+        BOOST_LOG_TRIVIAL(debug) << "Got " << output->getNTuples() <<
                                  " results in " << sec.count() *
                                  1000 << " ms";
-        IndexedTupleTable *idxOutput = new IndexedTupleTable(output);
-        VTuple newTuple(l.getNVars());
-        int j = 0;
-        for (int i = 0; i < l.getTupleSize(); ++i) {
-            if (l.getTermAtPos(i).isVariable()) {
-                newTuple.set(l.getTermAtPos(i), j);
-                j++;
-            }
+        storeMatQuery(l, output, kb, p, predIdx);
+    }
+    return failed;
+}
+
+void Materialization::storeMatQuery(Literal &l, IndexedTupleTable *output,
+                                    EDBLayer &kb, Program &p, int &predIdx) {
+    VTuple newTuple(l.getNVars());
+    int j = 0;
+    for (int i = 0; i < l.getTupleSize(); ++i) {
+        if (l.getTermAtPos(i).isVariable()) {
+            newTuple.set(l.getTermAtPos(i), j);
+            j++;
         }
-        std::string predName = std::string("TSP") + std::to_string(predIdx)
-                               + std::string("E");
+    }
+    std::string predName = std::string("TSP") + std::to_string(predIdx)
+                           + std::string("E");
+    try {
+        PredId_t pi = p.getPredicateID(predName, (uint8_t) newTuple.getSize());
+        Predicate newPred(pi, 0, EDB, (uint8_t) newTuple.getSize());
+        edbLiterals.push_back(Literal(newPred, newTuple));
+        predIdx++;
+
+        Predicate pred = edbLiterals.back().getPredicate();
+        BOOST_LOG_TRIVIAL(debug) << "Add results to relation " <<
+                                 p.getPredicateName(pred.getId());
+        kb.addTmpRelation(pred, output);
+    } catch (int v) {
+        delete output;
+        throw v;
+    }
+}
+
+int Materialization::execMatQueriesInProcess(std::vector<Literal> &literals,
+        bool timeout, EDBLayer &kb, Program &p, int &predIdx,
+        long timeoutMicros, std::vector<Literal> &failedQueries) {
+    const long micros = timeout ? timeoutMicros : 0;
+    std::vector<TupleTable*> outputs(literals.size(), NULL);
+    //Not a vector<bool>, which cannot be written concurrently
+    std::vector<char> failed(literals.size(), 0);
+    //TBB does not propagate the error codes thrown by the tasks, so the
+    //first one is stored here and thrown after all the tasks are finished
+    std::atomic<int> error(0);
+    auto evaluate = [&](const size_t i) {
+        if (error.load() != 0) {
+            failed[i] = 1;
+            return;
+        }
+        QSQQuery q(literals[i]);
+        timens::system_clock::time_point start = timens::system_clock::now();
         try {
-            PredId_t pi = p.getPredicateID(predName, (uint8_t) newTuple.getSize());
-            Predicate newPred(pi, 0, EDB, (uint8_t) newTuple.getSize());
-            edbLiterals.push_back(Literal(newPred, newTuple));
-            predIdx++;
-
-            Predicate pred = edbLiterals.back().getPredicate();
-            BOOST_LOG_TRIVIAL(debug) << "Add results to relation " <<
-                                     p.getPredicateName(pred.getId());
-            kb.addTmpRelation(pred, idxOutput);
-            delete output;
+            failed[i] = !evaluateQueryInProcess(&kb, &p, &q, &outputs[i], micros);
         } catch (int v) {
-            delete output;
-            throw v;
+            int expected = 0;
+            error.compare_exchange_strong(expected, v);
+            failed[i] = 1;
+            return;
         }
+        boost::chrono::duration<double> sec =
+            boost::chrono::system_clock::now() - start;
+        if (failed[i]) {
+            BOOST_LOG_TRIVIAL(debug) << "Query " << literals[i].tostring(&p, &kb) <<
+                                     " failed after " << sec.count() * 1000 << " ms";
+        } else {
+            BOOST_LOG_TRIVIAL(debug) << "Got " << outputs[i]->getNRows() <<
+                                     " results for " << literals[i].tostring(&p, &kb) <<
+                                     " in " << sec.count() * 1000 << " ms";
+        }
+    };
+    //Only a multithreaded EDB layer can be queried concurrently
+    if (kb.isMultithreaded()) {
+        tbb::parallel_for((size_t) 0, literals.size(), evaluate);
+    } else {
+        for (size_t i = 0; i < literals.size(); ++i) {
+            evaluate(i);
+        }
+    }
+    if (error.load() != 0) {
+        for (size_t i = 0; i < literals.size(); ++i) {
+            delete outputs[i];
+        }
+        throw error.load();
+    }
 
+    //The program and the EDB layer change only after all the evaluations
+    int successQueries = 0;
+    for (size_t i = 0; i < literals.size(); ++i) {
+        if (failed[i]) {
+            failedQueries.push_back(literals[i]);
+            continue;
+        }
+        try {
+            IndexedTupleTable *output = new IndexedTupleTable(outputs[i]);
+            delete outputs[i];
+            outputs[i] = NULL;
+            storeMatQuery(literals[i], output, kb, p, predIdx);
+        } catch (int v) {
+            for (size_t j = i + 1; j < literals.size(); ++j) {
+                delete outputs[j];
+            }
+            throw v;
+        }
+        rewriteLiteralInProgram(literals[i], edbLiterals.back(), kb, p);
+        successQueries++;
     }
-    return failed;
+    return successQueries;
 }
 
 void Materialization::getAndStorePrematerialization(EDBLayer & kb, Program & p,
@@ -313,14 +441,19 @@ void Materialization::getAndStorePrematerialization(EDBLayer & kb, Program & p,
     std::vector<Literal> failedQueries;
     int successQueries = 0;
     // try {
-    for (std::vector<Literal>::iterator itr =  prematerializedLiterals.begin();
-            itr != prematerializedLiterals.end(); ++itr) {
-        bool failed = execMatQuery(*itr, timeout, kb, p, predIdx, timeoutMicros);
-        if (!failed) {
-            rewriteLiteralInProgram(*itr, edbLiterals.back(), kb, p);
-            successQueries++;
-        } else {
-            failedQueries.push_back(*itr);
+    if (inProcess) {
+        successQueries = execMatQueriesInProcess(prematerializedLiterals,
+                         timeout, kb, p, predIdx, timeoutMicros, failedQueries);
+    } else {
+        for (std::vector<Literal>::iterator itr =  prematerializedLiterals.begin();
+                itr != prematerializedLiterals.end(); ++itr) {
+            bool failed = execMatQuery(*itr, timeout, kb, p, predIdx, timeoutMicros);
+            if (!failed) {
+                rewriteLiteralInProgram(*itr, edbLiterals.back(), kb, p);
+                successQueries++;
+            } else {
+                failedQueries.push_back(*itr);
+            }
         }
     }
 
@@ -330,14 +463,20 @@ void Materialization::getAndStorePrematerialization(EDBLayer & kb, Program & p,
                                  " queries";
         bool success = false;
         std::vector<Literal> newFailedQueries;
-        for (auto &el : failedQueries) {
-            bool failed = execMatQuery(el, timeout, kb, p, predIdx,
-                                       timeoutMicros);
-            if (!failed) {
-                rewriteLiteralInProgram(el, edbLiterals.back(), kb, p);
-                success = true;
-            } else {
-                newFailedQueries.push_back(el);
+        if (inProcess) {
+            success = execMatQueriesInProcess(failedQueries, timeout, kb, p,
+                                              predIdx, timeoutMicros,
+                                              newFailedQueries) > 0;
+        } else {
+            for (auto &el : failedQueries) {
+                bool failed = execMatQuery(el, timeout, kb, p, predIdx,
+                                           timeoutMicros);
+                if (!failed) {
+                    rewriteLiteralInProgram(el, edbLiterals.back(), kb, p);
+                    success = true;
+                } else {
+                    newFailedQueries.push_back(el);
+                }
             }
         }
         if (!success) {
@@ -5,11 +5,14 @@
 #include <trident/model/table.h>
 #include <trident/iterators/arrayitr.h>
 
+#include <tbb/task_group.h>
+
 #include <cstring>
 #include <unordered_map>
 
 BindingsTable *QSQR::getInputTable(const Predicate pred) {
-    //raiseIfExpired();
+    raiseIfCancelled();
+    boost::mutex::scoped_lock lock(tablesMutex);
     BindingsTable **table = inputs[pred.getId()];
     if (table == NULL) {
         const uint8_t maxAdornments = (uint8_t)pow(2, pred.getCardinality());
@@ -20,12 +23,14 @@ BindingsTable *QSQR::getInputTable(const Predicate pred) {
     }
     if (table[pred.getAdorment()] == NULL) {
         table[pred.getAdorment()] = new BindingsTable(pred.getCardinality(), pred.getAdorment());
+        table[pred.getAdorment()]->setConcurrent(parallel);
     }
     return table[pred.getAdorment()];
 }
 
 BindingsTable *QSQR::getAnswerTable(const Predicate pred, uint8_t adornment) {
-    //raiseIfExpired();
+    raiseIfCancelled();
+    boost::mutex::scoped_lock lock(tablesMutex);
     BindingsTable **table = answers[pred.getId()];
     if (table == NULL) {
         const uint8_t maxAdornments = (uint8_t)pow(2, pred.getCardinality());
@@ -36,6 +41,8 @@ BindingsTable *QSQR::getAnswerTable(const Predicate pred, uint8_t adornment) {
     }
     if (table[adornment] == NULL) {
         table[adornment] = new BindingsTable(pred.getCardinality());
+        table[adornment]->setConcurrent(parallel);
+        table[adornment]->setCounter(&nAnswers);
     }
     return table[adornment];
 }
@@ -83,20 +90,6 @@ void QSQR::deallocateAllRules() {
     }
 }
 
-size_t QSQR::calculateAllAnswers() {
-    size_t total = 0;
-    for (int i = 0; i < MAX_NPREDS; ++i) {
-        if (answers[i] != NULL) {
-            for (uint32_t j = 0; j < sizePreds[i]; ++j) {
-                if (answers[i][j] != NULL) {
-                    total += answers[i][j]->getNTuples();
-                }
-            }
-        }
-    }
-    return total;
-}
-
 void QSQR::cleanAllInputs() {
     for (int i = 0; i < MAX_NPREDS; ++i) {
         if (inputs[i] != NULL) {
@@ -109,8 +102,9 @@ void QSQR::cleanAllInputs() {
     }
 }
 
-void QSQR::createRules(Predicate &pred) {
+RuleExecutor **QSQR::createRules(Predicate &pred) {
     //check if the adorned rules are created. If not, then create them.
+    boost::mutex::scoped_lock lock(tablesMutex);
     if (rules[pred.getId()] == NULL) {
         const uint16_t maxAdornments = (uint16_t)pow(2, pred.getCardinality());
         rules[pred.getId()] = new RuleExecutor**[maxAdornments];
@@ -130,6 +124,7 @@ void QSQR::createRules(Predicate &pred) {
             m++;
         }
     }
+    return rules[pred.getId()][pred.getAdorment()];
 }
 
 size_t QSQR::estimate(int depth, Predicate &pred, BindingsTable *inputTable/*, size_t offsetInput*/) {
@@ -198,7 +193,9 @@ void QSQR::evaluate(Predicate &pred, BindingsTable *inputTable,
 #else
     createRules(pred);
     size_t sz = program->getAllRulesByPredicate(pred.getId())->size();
-    if (sz > 0) {
+    if (parallel && sz > 1 && getWorker()->depth < QSQR_PARALLEL_DEPTH) {
+        evaluateParallel(pred, inputTable, offsetInput, repeat);
+    } else if (sz > 0) {
 	QSQR_Task task(QSQR_TaskType::QUERY, pred);
 	task.currentRuleIndex = 1;
 	task.inputTable = inputTable;
@@ -213,6 +210,57 @@ void QSQR::evaluate(Predicate &pred, BindingsTable *inputTable,
 }
 
 #ifndef RECURSIVE_QSQR
+void QSQR::evaluateParallel(Predicate &pred, BindingsTable *inputTable,
+                            size_t offsetInput, bool repeat) {
+    RuleExecutor **executors = createRules(pred);
+    const size_t nrules = program->getAllRulesByPredicate(pred.getId())->size();
+    Worker *parent = parallel ? currentWorker.get() : NULL;
+    const int depth = getWorker()->depth + 1;
+    size_t totalAnswers;
+    do {
+        totalAnswers = calculateAllAnswers();
+        //Every rule is evaluated with its own stack of tasks. Idle threads
+        //steal the rules of other queries. TBB does not propagate the error
+        //codes (e.g., QSQR_CANCELLED), so the first one is thrown after wait.
+        std::atomic<int> error(0);
+        tbb::task_group group;
+        for (size_t i = 0; i < nrules; ++i) {
+            RuleExecutor *exec = executors[i];
+            group.run([this, exec, inputTable, offsetInput, depth, parent,
+            &error]() {
+                //The thread may be waiting for another evaluation
+                Worker worker(depth, parent);
+                Worker *previous = currentWorker.get();
+                currentWorker.reset(&worker);
+                try {
+                    exec->evaluate(inputTable, offsetInput, this, layer);
+                    processTasks(&worker);
+                } catch (int v) {
+                    int expected = 0;
+                    error.compare_exchange_strong(expected, v);
+                } catch (...) {
+                    currentWorker.reset(previous);
+                    throw;
+                }
+                currentWorker.reset(previous);
+            });
+        }
+        group.wait();
+        if (error.load() != 0) {
+            throw error.load();
+        }
+    } while (repeat && calculateAllAnswers() > totalAnswers);
+}
+
+void QSQR::processTasks(Worker *worker) {
+    while (worker->tasks.size() > 0) {
+        raiseIfCancelled();
+        QSQR_Task task = worker->tasks.back();
+        worker->tasks.pop_back();
+        processTask(task);
+    }
+}
+
 void QSQR::processTask(QSQR_Task &task) {
     switch (task.type) {
     case QUERY: {
@@ -308,7 +356,7 @@ TupleTable *QSQR::evaluateQuery(int evaluateOrEstimate, QSQQuery *query,
                 //Add all possible literals
                 std::vector<Term_t>::iterator itr = possibleValuesJoins->begin();
                 while (itr != possibleValuesJoins->end()) {
-                    //raiseIfExpired();
+                    raiseIfCancelled();
                     for (uint8_t j = 0; j < posJoins->size(); ++j) {
                         tuple[posJoins->at(j)] = *itr;
                         itr++;
@@ -316,7 +364,7 @@ TupleTable *QSQR::evaluateQuery(int evaluateOrEstimate, QSQQuery *query,
                     inputTable->addTuple(tuple);
                 }
 
-                //raiseIfExpired();
+                raiseIfCancelled();
                 totalAnswers = calculateAllAnswers();
 
                 if (evaluateOrEstimate == QSQR_EVAL) {
@@ -324,12 +372,7 @@ TupleTable *QSQR::evaluateQuery(int evaluateOrEstimate, QSQQuery *query,
 #ifndef RECURSIVE_QSQR
                     //evaluate in this case is not recursive. Process the tasks
                     //until the queue is empty
-                    while (tasks.size() > 0) {
-                        // BOOST_LOG_TRIVIAL(debug) << "Task size=" << tasks.size();
-                        QSQR_Task task = tasks.back();
-                        tasks.pop_back();
-                        processTask(task);
-                    }
+                    processTasks(&root);
 #endif
 
                 } else {
@@ -351,12 +394,7 @@ TupleTable *QSQR::evaluateQuery(int evaluateOrEstimate, QSQQuery *query,
 #ifndef RECURSIVE_QSQR
                     //evaluate in this case is not recursive. Process the tasks
                     //until the queue is empty
-                    while (tasks.size() > 0) {
-                        //BOOST_LOG_TRIVIAL(debug) << "Task size=" << tasks.size();
-                        QSQR_Task task = tasks.back();
-                        tasks.pop_back();
-                        processTask(task);
-                    }
+                    processTasks(&root);
 #endif
 
                 } else { //ESTIMATE
@@ -378,10 +416,10 @@ TupleTable *QSQR::evaluateQuery(int evaluateOrEstimate, QSQQuery *query,
         BindingsTable *answer = getAnswerTable(l->getPredicate(), adornment);
 
         if (returnOnlyVars) {
-            //raiseIfExpired();
+            raiseIfCancelled();
             return answer->projectAndFilter(*l, posJoins, possibleValuesJoins);
         } else {
-            //raiseIfExpired();
+            raiseIfCancelled();
             return answer->filter(*l, posJoins, possibleValuesJoins);
         }
     }
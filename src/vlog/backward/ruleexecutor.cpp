@@ -598,14 +598,18 @@ void RuleExecutor::copyLastRelInAnswers(QSQR *qsqr,
             }
         }
 
+        size_t nNew = 0;
         for (size_t i = 0; i < nTuples; ++i) {
             const Term_t *supplRow = lastSupplRelation->getTuple(i);
             for (uint8_t j = 0; j < nvars; ++j) {
                 tuple[posVars[j]] = supplRow[projectionLastSuppl
                                              [j]];
             }
-            answer->addRawTuple(tuple);
+            if (answer->addRawTuple(tuple)) {
+                nNew++;
+            }
         }
+        qsqr->addAnswers(nNew);
     }
 
     //Delete supplRelations
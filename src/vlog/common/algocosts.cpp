@@ -0,0 +1,111 @@
+#include <vlog/algocosts.h>
+#include <vlog/catalogfile.h>
+
+#include <boost/log/trivial.hpp>
+
+#include <vector>
+
+AlgoCosts::Shape AlgoCosts::getShape(const std::string &pred,
+                                     const uint8_t adornment,
+                                     const size_t nbindings) {
+    //Number of bits of the number of bindings
+    uint8_t bindings = 0;
+    for (size_t n = nbindings; n > 0; n >>= 1) {
+        bindings++;
+    }
+    return Shape(pred, adornment, bindings);
+}
+
+void AlgoCosts::setExploration(const double rate) {
+    boost::mutex::scoped_lock lock(mutex);
+    exploration = rate;
+}
+
+bool AlgoCosts::choose(const Shape &shape, ReasoningMode &mode) {
+    boost::mutex::scoped_lock lock(mutex);
+    Cost cost;
+    auto itr = costs.find(shape);
+    if (itr != costs.end()) {
+        cost = itr->second;
+    }
+
+    if (exploration > 0 &&
+            std::uniform_real_distribution<double>(0, 1)(random) < exploration) {
+        mode = cost.runs[MAGIC] < cost.runs[TOPDOWN] ? MAGIC : TOPDOWN;
+        if (cost.runs[MAGIC] == cost.runs[TOPDOWN]) {
+            mode = random() % 2 == 0 ? MAGIC : TOPDOWN;
+        }
+        BOOST_LOG_TRIVIAL(debug) << "Exploring the algorithm " << (mode == MAGIC ? "magic" : "QSQ-R");
+        return true;
+    }
+
+    //The estimate always picks the same algorithm for a shape: once it was
+    //measured, measure the other one too, so that they can be compared
+    if (cost.runs[TOPDOWN] >= MIN_RUNS && cost.runs[MAGIC] < MIN_RUNS) {
+        mode = MAGIC;
+        BOOST_LOG_TRIVIAL(debug) << "Measuring the algorithm magic";
+        return true;
+    }
+    if (cost.runs[MAGIC] >= MIN_RUNS && cost.runs[TOPDOWN] < MIN_RUNS) {
+        mode = TOPDOWN;
+        BOOST_LOG_TRIVIAL(debug) << "Measuring the algorithm QSQ-R";
+        return true;
+    }
+
+    if (cost.runs[TOPDOWN] >= MIN_RUNS && cost.runs[MAGIC] >= MIN_RUNS) {
+        mode = cost.msec[TOPDOWN] <= cost.msec[MAGIC] ? TOPDOWN : MAGIC;
+        BOOST_LOG_TRIVIAL(debug) << "Observed costs: QSQ-R " << cost.msec[TOPDOWN] << "ms, magic " << cost.msec[MAGIC] << "ms";
+        return true;
+    }
+    return false;
+}
+
+void AlgoCosts::record(const Shape &shape, const ReasoningMode mode,
+                       const double msec) {
+    boost::mutex::scoped_lock lock(mutex);
+    Cost &cost = costs[shape];
+    cost.runs[mode]++;
+    const uint64_t n = cost.runs[mode] < WINDOW ? cost.runs[mode] : WINDOW;
+    cost.msec[mode] += (msec - cost.msec[mode]) / n;
+    modified = true;
+}
+
+void AlgoCosts::load(const std::string &file) {
+    size_t count = 0;
+    boost::mutex::scoped_lock lock(mutex);
+    //Format: predicate <TAB> adornment <TAB> bindings <TAB> runs QSQ-R
+    //<TAB> msec QSQ-R <TAB> runs magic <TAB> msec magic
+    CatalogFile::read(file, "", 7, [&](const std::vector<std::string> &fields) {
+        const Shape shape(fields[0], (uint8_t) std::stoi(fields[1]),
+                          (uint8_t) std::stoi(fields[2]));
+        Cost cost;
+        cost.runs[TOPDOWN] = std::stoull(fields[3]);
+        cost.msec[TOPDOWN] = std::stod(fields[4]);
+        cost.runs[MAGIC] = std::stoull(fields[5]);
+        cost.msec[MAGIC] = std::stod(fields[6]);
+        costs[shape] = cost;
+        return true;
+    }, count);
+    modified = false;
+    BOOST_LOG_TRIVIAL(debug) << "Loaded the costs of " << count << " query shapes from " << file;
+}
+
+void AlgoCosts::save(const std::string &file) {
+    boost::mutex::scoped_lock lock(mutex);
+    const bool written = CatalogFile::write(file, "", [&](std::ostream &out) {
+        for (const auto &entry : costs) {
+            const Shape &shape = entry.first;
+            const Cost &cost = entry.second;
+            out << shape.pred << "\t" << (int) shape.adornment << "\t" <<
+                (int) shape.bindings << "\t" << cost.runs[TOPDOWN] << "\t" <<
+                cost.msec[TOPDOWN] << "\t" << cost.runs[MAGIC] << "\t" <<
+                cost.msec[MAGIC] << std::endl;
+        }
+    });
+    if (!written) {
+        BOOST_LOG_TRIVIAL(warning) << "Cannot write the costs in " << file;
+        return;
+    }
+    modified = false;
+    BOOST_LOG_TRIVIAL(debug) << "Stored the costs of " << costs.size() << " query shapes in " << file;
+}
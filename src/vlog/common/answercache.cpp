@@ -0,0 +1,299 @@
+#include <vlog/answercache.h>
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+
+size_t AnswerCache::KeyHasher::operator()(const Key &k) const {
+    size_t hash = hash_VTuple()(k.pattern) ^ (k.pred * 31);
+    for (const auto pos : k.posBindings) {
+        hash = hash * 31 + pos;
+    }
+    for (const auto value : k.bindings) {
+        hash = hash * 31 + value;
+    }
+    return hash;
+}
+
+VTuple AnswerCache::normalize(const VTuple &t) {
+    //Rename the variables in order of appearance
+    VTuple pattern(t.getSize());
+    uint8_t vars[SIZETUPLE];
+    uint8_t nvars = 0;
+    for (uint8_t i = 0; i < t.getSize(); ++i) {
+        const VTerm term = t.get(i);
+        if (term.isVariable()) {
+            uint8_t j = 0;
+            while (j < nvars && vars[j] != term.getId()) {
+                j++;
+            }
+            if (j == nvars) {
+                vars[nvars++] = term.getId();
+            }
+            pattern.set(VTerm(j + 1, 0), i);
+        } else {
+            pattern.set(VTerm(0, term.getValue()), i);
+        }
+    }
+    return pattern;
+}
+
+AnswerCache::Key AnswerCache::getKey(const Literal &query,
+                                     const std::vector<uint8_t> *posBindings,
+                                     const std::vector<Term_t> *bindings) {
+    VTuple t = query.getTuple();
+    if (posBindings == NULL || posBindings->empty() || bindings == NULL) {
+        return Key(query.getPredicate().getId(), normalize(t));
+    }
+
+    const size_t sizeRow = posBindings->size();
+    const size_t nrows = bindings->size() / sizeRow;
+    if (nrows == 1) {
+        //A single binding is the same as a query with constants
+        for (size_t i = 0; i < sizeRow; ++i) {
+            t.set(VTerm(0, bindings->at(i)), posBindings->at(i));
+        }
+        return Key(query.getPredicate().getId(), normalize(t));
+    }
+
+    Key key(query.getPredicate().getId(), normalize(t));
+    key.posBindings = *posBindings;
+    std::vector<std::vector<Term_t>> rows;
+    for (size_t i = 0; i < nrows; ++i) {
+        rows.push_back(std::vector<Term_t>(bindings->begin() + i * sizeRow,
+                                           bindings->begin() + (i + 1) * sizeRow));
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    for (const auto &row : rows) {
+        key.bindings.insert(key.bindings.end(), row.begin(), row.end());
+    }
+    return key;
+}
+
+static bool containsBinding(const std::vector<Term_t> &bindings,
+                            const size_t sizeRow, const Term_t *value) {
+    //The rows of the bindings are sorted
+    size_t begin = 0;
+    size_t end = bindings.size() / sizeRow;
+    while (begin < end) {
+        const size_t middle = (begin + end) / 2;
+        const Term_t *row = &bindings[middle * sizeRow];
+        int cmp = 0;
+        for (size_t i = 0; i < sizeRow && cmp == 0; ++i) {
+            if (row[i] < value[i]) {
+                cmp = -1;
+            } else if (row[i] > value[i]) {
+                cmp = 1;
+            }
+        }
+        if (cmp == 0) {
+            return true;
+        } else if (cmp < 0) {
+            begin = middle + 1;
+        } else {
+            end = middle;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<const AnswerCache::Answers> AnswerCache::filter(
+    const Answers &general, const Key &key) {
+    uint8_t posConsts[SIZETUPLE];
+    Term_t consts[SIZETUPLE];
+    uint8_t nconsts = 0;
+    //Positions that must be equal because of a repeated variable
+    std::vector<std::pair<uint8_t, uint8_t>> repeated =
+        key.pattern.getRepeatedVars();
+    for (uint8_t i = 0; i < key.pattern.getSize(); ++i) {
+        const VTerm t = key.pattern.get(i);
+        if (!t.isVariable()) {
+            posConsts[nconsts] = i;
+            consts[nconsts++] = t.getValue();
+        }
+    }
+    const size_t sizeBindings = key.posBindings.size();
+    Term_t binding[SIZETUPLE];
+
+    std::shared_ptr<Answers> output(new Answers(general.sizeRow));
+    const size_t nrows = general.getNRows();
+    for (size_t i = 0; i < nrows; ++i) {
+        const Term_t *row = general.getRow(i);
+        bool ok = true;
+        for (uint8_t j = 0; j < nconsts && ok; ++j) {
+            ok = row[posConsts[j]] == consts[j];
+        }
+        for (size_t j = 0; j < repeated.size() && ok; ++j) {
+            ok = row[repeated[j].first] == row[repeated[j].second];
+        }
+        if (ok && sizeBindings > 0) {
+            for (size_t j = 0; j < sizeBindings; ++j) {
+                binding[j] = row[key.posBindings[j]];
+            }
+            ok = containsBinding(key.bindings, sizeBindings, binding);
+        }
+        if (ok) {
+            output->rows.insert(output->rows.end(), row, row + general.sizeRow);
+        }
+    }
+    return output;
+}
+
+std::shared_ptr<const AnswerCache::Answers> AnswerCache::find(const Key &key) {
+    auto itr = index.find(key);
+    if (itr == index.end()) {
+        return std::shared_ptr<const Answers>();
+    }
+    entries.splice(entries.begin(), entries, itr->second);
+    return itr->second->second;
+}
+
+size_t AnswerCache::getBytes(const Key &key, const Answers &answers) {
+    //The bindings of the key can be as many as the answers
+    return answers.getBytes() + key.posBindings.size() +
+           key.bindings.size() * sizeof(Term_t);
+}
+
+void AnswerCache::evict() {
+    while (usedBytes > budget) {
+        usedBytes -= getBytes(entries.back().first, *entries.back().second);
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+void AnswerCache::insert(const Key &key, std::shared_ptr<const Answers> answers) {
+    const size_t bytes = getBytes(key, *answers);
+    if (bytes > budget) {
+        return;
+    }
+    auto itr = index.find(key);
+    if (itr != index.end()) {
+        usedBytes -= getBytes(key, *itr->second->second);
+        entries.erase(itr->second);
+        index.erase(itr);
+    }
+    entries.push_front(std::make_pair(key, answers));
+    index.insert(std::make_pair(key, entries.begin()));
+    usedBytes += bytes;
+    evict();
+}
+
+void AnswerCache::setBudget(const size_t bytes) {
+    boost::mutex::scoped_lock lock(mutex);
+    budget = bytes;
+    evict();
+}
+
+void AnswerCache::setSource(const Program &program, const EDBLayer &layer) {
+    boost::mutex::scoped_lock lock(mutex);
+    //Rules can be added to a program, e.g., by the prematerialization
+    if (this->program != &program || this->layer != &layer ||
+            nrules != program.getNRules()) {
+        if (!entries.empty()) {
+            BOOST_LOG_TRIVIAL(debug) << "The program has changed. Dropping " << entries.size() << " cached answers";
+        }
+        entries.clear();
+        index.clear();
+        usedBytes = 0;
+        generation++;
+        this->program = &program;
+        this->layer = &layer;
+        nrules = program.getNRules();
+    }
+}
+
+std::shared_ptr<const AnswerCache::Answers> AnswerCache::findGeneral(
+    const Key &key) {
+    //Look for a literal with variables in place of some constants, starting
+    //from the most specific ones. These never have bindings.
+    uint8_t posConsts[SIZETUPLE];
+    uint8_t nconsts = 0;
+    uint8_t nextVar = 1;
+    for (uint8_t i = 0; i < key.pattern.getSize(); ++i) {
+        const VTerm t = key.pattern.get(i);
+        if (t.isVariable()) {
+            nextVar = std::max(nextVar, (uint8_t) (t.getId() + 1));
+        } else {
+            posConsts[nconsts++] = i;
+        }
+    }
+    if (nconsts > MAX_GENERALIZED_CONSTS) {
+        return std::shared_ptr<const Answers>();
+    }
+    const uint8_t firstVars = key.posBindings.empty() ? 1 : 0;
+    for (uint8_t nvars = firstVars; nvars <= nconsts; ++nvars) {
+        for (uint32_t mask = 0; mask < (1u << nconsts); ++mask) {
+            if (__builtin_popcount(mask) != nvars) {
+                continue;
+            }
+            VTuple general = key.pattern;
+            uint8_t var = nextVar;
+            for (uint8_t j = 0; j < nconsts; ++j) {
+                if (mask & (1u << j)) {
+                    general.set(VTerm(var++, 0), posConsts[j]);
+                }
+            }
+            std::shared_ptr<const Answers> generalAnswers =
+                find(Key(key.pred, normalize(general)));
+            if (generalAnswers != NULL) {
+                return generalAnswers;
+            }
+        }
+    }
+    return std::shared_ptr<const Answers>();
+}
+
+std::shared_ptr<const AnswerCache::Answers> AnswerCache::get(
+    const Literal &query, const std::vector<uint8_t> *posBindings,
+    const std::vector<Term_t> *bindings) {
+    const Key key = getKey(query, posBindings, bindings);
+    std::shared_ptr<const Answers> generalAnswers;
+    uint64_t generation;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        std::shared_ptr<const Answers> answers = find(key);
+        if (answers != NULL) {
+            hits++;
+            BOOST_LOG_TRIVIAL(debug) << "Answers found in the cache (hits=" << hits << ")";
+            return answers;
+        }
+        generalAnswers = findGeneral(key);
+        if (generalAnswers == NULL) {
+            misses++;
+            return generalAnswers;
+        }
+        generation = this->generation;
+    }
+
+    //The general answers can be many: other threads can use the cache while
+    //they are filtered
+    std::shared_ptr<const Answers> answers = filter(*generalAnswers, key);
+    boost::mutex::scoped_lock lock(mutex);
+    //The cache was not emptied in the meantime
+    if (generation == this->generation) {
+        insert(key, answers);
+    }
+    subsumedHits++;
+    BOOST_LOG_TRIVIAL(debug) << "Answers filtered from a more general query in the cache (hits=" << subsumedHits << ")";
+    return answers;
+}
+
+void AnswerCache::put(const Literal &query,
+                      const std::vector<uint8_t> *posBindings,
+                      const std::vector<Term_t> *bindings,
+                      std::shared_ptr<const Answers> answers) {
+    const Key key = getKey(query, posBindings, bindings);
+    boost::mutex::scoped_lock lock(mutex);
+    insert(key, answers);
+    BOOST_LOG_TRIVIAL(debug) << "Cached " << answers->getNRows() << " answers. The cache contains " << entries.size() << " entries (" << usedBytes << " bytes)";
+}
+
+void AnswerCache::clear() {
+    boost::mutex::scoped_lock lock(mutex);
+    entries.clear();
+    index.clear();
+    usedBytes = 0;
+    generation++;
+}
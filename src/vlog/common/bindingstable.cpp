@@ -2,7 +2,6 @@
 #include <trident/model/table.h>
 
 Term_t const * const EMPTY_TUPLE = {0};
-BindingsRow EMPTY_ROW(0, EMPTY_TUPLE);
 
 bool BindingsRow::operator==(const BindingsRow &other) const {
     if (size == other.size) {
@@ -18,8 +17,13 @@ bool BindingsRow::operator==(const BindingsRow &other) const {
     return false;
 }
 
+void BindingsTable::init() {
+    concurrent = false;
+    counter = NULL;
+}
+
 BindingsTable::BindingsTable(uint8_t sizeAdornment, uint8_t adornment) {
-    uniqueElements.max_load_factor(0.75);
+    init();
     //Mark positions to copy
     std::vector<int> pc;
     for (int i = 0; i < sizeAdornment; ++i) {
@@ -46,7 +50,7 @@ BindingsTable::BindingsTable(uint8_t sizeAdornment, uint8_t adornment) {
 }
 
 BindingsTable::BindingsTable(size_t sizeTuple) {
-    uniqueElements.max_load_factor(0.75);
+    init();
     nPosToCopy = sizeTuple;
     if (nPosToCopy > 0) {
         rawBindings = new RawBindings((uint8_t) sizeTuple);
@@ -59,7 +63,7 @@ BindingsTable::BindingsTable(size_t sizeTuple) {
 }
 
 BindingsTable::BindingsTable(uint8_t npc, std::vector<int> pc) {
-    uniqueElements.max_load_factor(0.75);
+    init();
     this->nPosToCopy = npc;
     if (nPosToCopy > 0) {
         this->posToCopy = new size_t[nPosToCopy];
@@ -75,24 +79,25 @@ BindingsTable::BindingsTable(uint8_t npc, std::vector<int> pc) {
     }
 }
 
-void BindingsTable::insertIfNotExists(Term_t const * const cr) {
+bool BindingsTable::insertIfNotExists(Term_t const * const cr) {
+    bool inserted;
     if (cr == EMPTY_TUPLE) {
-        uniqueElements.insert(EMPTY_ROW);
-        return;
+        inserted = uniqueElements.insertEmpty();
+    } else {
+        //cr is the next row of the arena
+        inserted = uniqueElements.insert(*rawBindings, uniqueElements.size());
+        if (inserted) {
+            currentRow = rawBindings->newRow();
+        }
     }
-    BindingsRow row((uint8_t) nPosToCopy, cr);
-    /*
-    std::unordered_set<BindingsRow, hash_BindingsRow>::iterator itr = uniqueElements.find(row);
-    if (itr == uniqueElements.end()) {
-        uniqueElements.insert(row);
-    */
-    std::pair<std::unordered_set<BindingsRow, hash_BindingsRow>::iterator, bool> result = uniqueElements.insert(row);
-    if (result.second) {
-        currentRow = rawBindings->newRow();
+    if (inserted && counter != NULL) {
+        (*counter)++;
     }
+    return inserted;
 }
 
 void BindingsTable::addTuple(const Literal *t) {
+    boost::unique_lock<boost::mutex> guard = lock();
     if (nPosToCopy == 0) {
         insertIfNotExists(EMPTY_TUPLE);
     } else {
@@ -105,6 +110,7 @@ void BindingsTable::addTuple(const Literal *t) {
 
 #if ! TERM_IS_UINT64
 void BindingsTable::addTuple(const uint64_t *t) {
+    boost::unique_lock<boost::mutex> guard = lock();
     if (nPosToCopy == 0) {
         insertIfNotExists(EMPTY_TUPLE);
     } else {
@@ -117,6 +123,7 @@ void BindingsTable::addTuple(const uint64_t *t) {
 #endif
 
 void BindingsTable::addTuple(const Term_t *t) {
+    boost::unique_lock<boost::mutex> guard = lock();
     if (nPosToCopy == 0) {
         insertIfNotExists(EMPTY_TUPLE);
     } else {
@@ -129,6 +136,7 @@ void BindingsTable::addTuple(const Term_t *t) {
 
 void BindingsTable::addTuple(const uint64_t *t1, const uint8_t sizeT1,
                              const uint64_t *t2, const uint8_t sizeT2) {
+    boost::unique_lock<boost::mutex> guard = lock();
     if (nPosToCopy == 0) {
         insertIfNotExists(EMPTY_TUPLE);
     } else {
@@ -144,6 +152,7 @@ void BindingsTable::addTuple(const uint64_t *t1, const uint8_t sizeT1,
 }
 
 void BindingsTable::addTuple(const uint64_t *t, const uint8_t *positions) {
+    boost::unique_lock<boost::mutex> guard = lock();
     if (nPosToCopy == 0) {
         insertIfNotExists(EMPTY_TUPLE);
     } else {
@@ -154,18 +163,20 @@ void BindingsTable::addTuple(const uint64_t *t, const uint8_t *positions) {
     }
 }
 
-void BindingsTable::addRawTuple(Term_t *r) {
+bool BindingsTable::addRawTuple(Term_t *r) {
+    boost::unique_lock<boost::mutex> guard = lock();
     if (nPosToCopy == 0) {
-        insertIfNotExists(EMPTY_TUPLE);
+        return insertIfNotExists(EMPTY_TUPLE);
     } else {
         for (int i = 0; i < nPosToCopy; ++i) {
             currentRow[i] = r[i];
         }
-        insertIfNotExists(currentRow);
+        return insertIfNotExists(currentRow);
     }
 }
 
 void BindingsTable::clear() {
+    boost::unique_lock<boost::mutex> guard = lock();
     uniqueElements.clear();
     if (nPosToCopy > 0) {
         rawBindings->clear();
@@ -174,9 +185,10 @@ void BindingsTable::clear() {
 }
 
 TupleTable *BindingsTable::sortBy(std::vector<uint8_t> &fields) {
+    boost::unique_lock<boost::mutex> guard = lock();
     std::vector<BindingsRow> rowsToSort;
     for (size_t i = 0; i < uniqueElements.size(); ++i) {
-        BindingsRow row((uint8_t) nPosToCopy, rawBindings->getOffset(i * nPosToCopy));
+        BindingsRow row((uint8_t) nPosToCopy, rawBindings->getRow(i));
         rowsToSort.push_back(row);
     }
     FieldsSorter sorter(fields);
@@ -193,6 +205,7 @@ TupleTable *BindingsTable::sortBy(std::vector<uint8_t> &fields) {
 
 TupleTable *BindingsTable::projectAndFilter(const Literal &l, const std::vector<uint8_t> *posToFilter,
         const std::vector<Term_t> *valuesToFilter) {
+    boost::unique_lock<boost::mutex> guard = lock();
     uint8_t vars[SIZETUPLE];
     uint8_t consts[SIZETUPLE];
     uint8_t nconsts = 0;
@@ -211,7 +224,7 @@ TupleTable *BindingsTable::projectAndFilter(const Literal &l, const std::vector<
     bool warn_done = false;
 #endif
     for (size_t i = 0; i < uniqueElements.size(); ++i) {
-        Term_t *row = rawBindings->getOffset(i * nPosToCopy);
+        Term_t *row = rawBindings->getRow(i);
         bool ok = true;
         for (uint8_t j = 0; j < nconsts; ++j) {
             if (row[consts[j]] != l.getTermAtPos(consts[j]).getValue()) {
@@ -263,6 +276,7 @@ TupleTable *BindingsTable::projectAndFilter(const Literal &l, const std::vector<
 
 TupleTable *BindingsTable::filter(const Literal &l, const std::vector<uint8_t> *posToFilter,
                                   const std::vector<Term_t> *valuesToFilter) {
+    boost::unique_lock<boost::mutex> guard = lock();
 
     Term_t consts[SIZETUPLE];
     uint8_t posConsts[SIZETUPLE];
@@ -288,7 +302,7 @@ TupleTable *BindingsTable::filter(const Literal &l, const std::vector<uint8_t> *
     bool warn_done = false;
 #endif
     for (size_t i = 0; i < uniqueElements.size(); ++i) {
-        Term_t *row = rawBindings->getOffset(i * nPosToCopy);
+        Term_t *row = rawBindings->getRow(i);
 
         bool ok = true;
         for (uint8_t j = 0; j < nconsts; ++j) {
@@ -344,10 +358,11 @@ TupleTable *BindingsTable::filter(const Literal &l, const std::vector<uint8_t> *
 }
 
 std::vector<Term_t> BindingsTable::getProjection(std::vector<uint8_t> pos) {
+    boost::unique_lock<boost::mutex> guard = lock();
     size_t size = uniqueElements.size();
     std::vector<Term_t> outputVector;
     for (int i = 0; i < size; ++i) {
-        Term_t *startTuple = rawBindings->getOffset(i * nPosToCopy);
+        Term_t *startTuple = rawBindings->getRow(i);
         for (std::vector<uint8_t>::iterator itr = pos.begin(); itr != pos.end();
                 ++itr) {
             outputVector.push_back(*(startTuple + *itr));
@@ -358,13 +373,14 @@ std::vector<Term_t> BindingsTable::getProjection(std::vector<uint8_t> pos) {
 }
 
 std::vector<Term_t> BindingsTable::getUniqueSortedProjection(std::vector<uint8_t> pos) {
+    boost::unique_lock<boost::mutex> guard = lock();
     size_t size = uniqueElements.size();
     std::vector<Term_t> outputVector;
 
     if (pos.size() == 1) {
         const uint8_t p = pos[0];
         for (int i = 0; i < size; ++i) {
-            Term_t *startTuple = rawBindings->getOffset(i * nPosToCopy);
+            Term_t *startTuple = rawBindings->getRow(i);
             outputVector.push_back(startTuple[p]);
         }
         sort(outputVector.begin(), outputVector.end());
@@ -374,7 +390,7 @@ std::vector<Term_t> BindingsTable::getUniqueSortedProjection(std::vector<uint8_t
         const uint8_t p1 = pos[0];
         const uint8_t p2 = pos[1];
         for (int i = 0; i < size; ++i) {
-            Term_t *startTuple = rawBindings->getOffset(i * nPosToCopy);
+            Term_t *startTuple = rawBindings->getRow(i);
             pairs.push_back(make_pair(startTuple[p1], startTuple[p2]));
         }
         sort(pairs.begin(), pairs.end());
@@ -389,7 +405,7 @@ std::vector<Term_t> BindingsTable::getUniqueSortedProjection(std::vector<uint8_t
     } else {
         //not yet supported. TODO
         for (int i = 0; i < size; ++i) {
-            Term_t *startTuple = rawBindings->getOffset(i * nPosToCopy);
+            Term_t *startTuple = rawBindings->getRow(i);
             for (std::vector<uint8_t>::iterator itr = pos.begin(); itr != pos.end();
                     ++itr) {
                 outputVector.push_back(*(startTuple + *itr));
@@ -403,20 +419,23 @@ std::vector<Term_t> BindingsTable::getUniqueSortedProjection(std::vector<uint8_t
 }
 
 const Term_t *BindingsTable::getTuple(size_t idx) {
+    boost::unique_lock<boost::mutex> guard = lock();
     if (rawBindings == NULL)
         return EMPTY_TUPLE;
     else
-        return rawBindings->getOffset(idx * nPosToCopy);
+        return rawBindings->getRow(idx);
 }
 
 size_t BindingsTable::getNTuples() {
+    boost::unique_lock<boost::mutex> guard = lock();
     return uniqueElements.size();
 }
 
 void BindingsTable::print() {
+    boost::unique_lock<boost::mutex> guard = lock();
     size_t size = uniqueElements.size();
     for (int i = 0; i < size; ++i) {
-        Term_t *startTuple = rawBindings->getOffset(i * nPosToCopy);
+        Term_t *startTuple = rawBindings->getRow(i);
         for (int j = 0; j < nPosToCopy; ++j)
             cout << startTuple[j] << " ";
         cout << endl;
@@ -425,12 +444,7 @@ void BindingsTable::print() {
 
 #ifdef DEBUG
 void BindingsTable::statistics() {
-    /*
-    size_t nbuckets = uniqueElements.bucket_count();
-    for (size_t i = 0; i < nbuckets; i++) {
-	BOOST_LOG_TRIVIAL(debug) << "Size bucket " << i << ": " << uniqueElements.bucket_size(i);
-    }
-    */
+    BOOST_LOG_TRIVIAL(debug) << "Distinct bindings: " << uniqueElements.size();
 }
 #endif
 
@@ -0,0 +1,73 @@
+#include <vlog/catalogfile.h>
+
+#include <boost/log/trivial.hpp>
+#include <boost/filesystem.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace fs = boost::filesystem;
+
+bool CatalogFile::read(const std::string &file, const std::string &header,
+                       const size_t nfields, Parser parse, size_t &count) {
+    count = 0;
+    if (!fs::exists(file)) {
+        return true;
+    }
+    std::ifstream ifs(file);
+    std::string line;
+    if (header != "" && (!std::getline(ifs, line) || line != "#\t" + header)) {
+        return false;
+    }
+    while (std::getline(ifs, line)) {
+        const std::vector<std::string> fields = split(line, '\t');
+        bool valid = fields.size() == nfields;
+        if (valid) {
+            try {
+                if (parse(fields)) {
+                    count++;
+                }
+            } catch (const std::exception &e) {
+                valid = false;
+            }
+        }
+        if (!valid) {
+            BOOST_LOG_TRIVIAL(warning) << "Ignoring malformed line in " << file << ": " << line;
+        }
+    }
+    return true;
+}
+
+bool CatalogFile::write(const std::string &file, const std::string &header,
+                        Writer writeEntries) {
+    //Write a new file and replace the old one
+    const std::string tmpFile = file + ".tmp";
+    {
+        std::ofstream ofs(tmpFile, std::ios::trunc);
+        if (!ofs.good()) {
+            return false;
+        }
+        if (header != "") {
+            ofs << "#\t" << header << std::endl;
+        }
+        writeEntries(ofs);
+        if (!ofs.good()) {
+            return false;
+        }
+    }
+    boost::system::error_code ec;
+    fs::rename(tmpFile, file, ec);
+    return !ec;
+}
+
+std::vector<std::string> CatalogFile::split(const std::string &text,
+        const char separator) {
+    std::vector<std::string> fields;
+    std::stringstream ss(text);
+    std::string field;
+    while (std::getline(ss, field, separator)) {
+        fields.push_back(field);
+    }
+    return fields;
+}
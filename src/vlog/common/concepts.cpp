@@ -8,6 +8,7 @@
 #include <boost/log/trivial.hpp>
 #include <boost/tokenizer.hpp>
 
+#include <algorithm>
 #include <cctype>
 #include <stdlib.h>
 #include <fstream>
@@ -751,6 +752,108 @@ PredId_t Program::getPredicateID(std::string & p, const uint8_t card) {
     return predid;
 }
 
+bool Program::lookupPredicate(const std::string &p, PredId_t &id,
+                              uint8_t &card) {
+    //The empty string is the empty key of the dictionary
+    if (p.empty()) {
+        return false;
+    }
+    auto itr = dictPredicates.getMap().find(p);
+    if (itr == dictPredicates.getMap().end()) {
+        return false;
+    }
+    id = (PredId_t) itr->second;
+    auto itrCard = cardPredicates.find(id);
+    card = itrCard == cardPredicates.end() ? 0 : itrCard->second;
+    return true;
+}
+
+Predicate Program::getKnownPredicate(const std::string &p,
+                                     const uint8_t card,
+                                     const uint8_t adornment) {
+    PredId_t id;
+    uint8_t knownCard;
+    if (!lookupPredicate(p, id, knownCard)) {
+        BOOST_LOG_TRIVIAL(error) << "Unknown predicate '" << p << "'";
+        throw 10;
+    }
+    if (knownCard == 0) {
+        //The predicate does not appear in the rules
+        if (!Predicate::isEDB(p) || kb == NULL) {
+            BOOST_LOG_TRIVIAL(error) << "Unknown predicate '" << p << "'";
+            throw 10;
+        }
+        knownCard = kb->getDBPredicate(id).getCardinality();
+    }
+    if (knownCard != card) {
+        BOOST_LOG_TRIVIAL(error) << "The predicate " << p << " has arity " << (int) knownCard;
+        throw 10;
+    }
+    return Predicate(id, adornment, Predicate::isEDB(p) ? EDB : IDB, card);
+}
+
+Literal Program::parseQueryLiteral(const std::string &l) {
+    size_t posBeginTuple = l.find("(");
+    if (posBeginTuple == std::string::npos || l.back() != ')') {
+        BOOST_LOG_TRIVIAL(error) << "Malformed literal " << l;
+        throw 10;
+    }
+    std::string predicate = l.substr(0, posBeginTuple);
+    std::string tuple = l.substr(posBeginTuple + 1,
+                                 l.size() - posBeginTuple - 2);
+
+    std::vector<VTerm> t;
+    std::vector<std::string> vars;
+    while (tuple.size() > 0) {
+        size_t posTerm = tuple.find(",");
+        std::string term;
+        if (posTerm != std::string::npos) {
+            term = tuple.substr(0, posTerm);
+            tuple = tuple.substr(posTerm + 1, std::string::npos);
+        } else {
+            term = tuple;
+            tuple = "";
+        }
+        if (term.empty() || t.size() == SIZETUPLE) {
+            BOOST_LOG_TRIVIAL(error) << "Malformed literal " << l;
+            throw 10;
+        }
+
+        if (std::isupper(term.at(0))) {
+            auto itr = std::find(vars.begin(), vars.end(), term);
+            if (itr == vars.end()) {
+                vars.push_back(term);
+                itr = vars.end() - 1;
+            }
+            t.push_back(VTerm((uint8_t) (itr - vars.begin() + 1), 0));
+        } else {
+            term = rewriteRDFOWLConstants(term);
+            uint64_t dictTerm;
+            if (!kb->getDictNumber(term.c_str(), term.size(), dictTerm)) {
+                auto itr = additionalConstants.getMap().find(term);
+                if (itr == additionalConstants.getMap().end()) {
+                    BOOST_LOG_TRIVIAL(error) << "Unknown constant " << term;
+                    throw 10;
+                }
+                dictTerm = itr->second;
+            }
+            t.push_back(VTerm(0, dictTerm));
+        }
+    }
+    if (t.empty()) {
+        BOOST_LOG_TRIVIAL(error) << "Malformed literal " << l;
+        throw 10;
+    }
+
+    VTuple t1((uint8_t) t.size());
+    for (uint8_t i = 0; i < t.size(); ++i) {
+        t1.set(t[i], i);
+    }
+    Predicate pred = getKnownPredicate(predicate, (uint8_t) t.size(),
+                                       Predicate::calculateAdornment(t1));
+    return Literal(pred, t1);
+}
+
 std::string Program::getPredicateName(const PredId_t id) {
     return dictPredicates.getRawValue(id);
 }
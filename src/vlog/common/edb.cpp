@@ -4,6 +4,7 @@
 #include <vlog/column.h>
 
 #include <vlog/trident/tridenttable.h>
+#include <vlog/inmemory/inmemorytable.h>
 #ifdef MYSQL
 #include <vlog/mysql/mysqltable.h>
 #endif
@@ -13,12 +14,17 @@
 #ifdef MAPI
 #include <vlog/mapi/mapitable.h>
 #endif
+#if defined(MYSQL) || defined(ODBC) || defined(MAPI)
+#include <vlog/sqltablecache.h>
+#endif
 
 #include <boost/log/trivial.hpp>
 #include <boost/filesystem.hpp>
 
 #include <unordered_map>
+#include <algorithm>
 #include <climits>
+#include <cstring>
 
 void EDBLayer::addTridentTable(const EDBConf::Table &tableConf, bool multithreaded) {
     EDBInfoTable infot;
@@ -36,6 +42,59 @@ void EDBLayer::addTridentTable(const EDBConf::Table &tableConf, bool multithread
     BOOST_LOG_TRIVIAL(debug) << "Inserted " << pn << " with number " << infot.id;
 }
 
+void EDBLayer::addInmemoryTable(const EDBConf::Table &tableConf) {
+    EDBInfoTable infot;
+    const string pn = tableConf.predname;
+    if (tableConf.params.size() < 2) {
+        BOOST_LOG_TRIVIAL(error) << "An INMEMORY table requires a directory and a table name. Check the edb.conf file.";
+        throw 10;
+    }
+    if (!inmemoryDict) {
+        //IDs start from 0, so that getNTerms returns the largest ID + 1
+        inmemoryDict = std::shared_ptr<Dictionary>(new Dictionary((uint64_t) 0));
+    }
+    infot.id = (PredId_t) predDictionary.getOrAdd(pn);
+    infot.type = tableConf.type;
+    const string separator = tableConf.params.size() > 2 ? tableConf.params[2] : "";
+    InmemoryTable *table = new InmemoryTable(infot.id, tableConf.params[0],
+            tableConf.params[1], separator, inmemoryDict);
+    infot.arity = table->getArity();
+    infot.manager = std::shared_ptr<EDBTable>(table);
+    dbPredicates.insert(make_pair(infot.id, infot));
+    BOOST_LOG_TRIVIAL(debug) << "Inserted " << pn << " with number " << infot.id;
+}
+
+#if defined(MYSQL) || defined(ODBC) || defined(MAPI)
+//The number of rows fetched at once and the number of connections are
+//optional parameters of SQL tables
+static size_t getSizeParam(const EDBConf::Table &tableConf, const int idxParam,
+                           const size_t defaultValue) {
+    if (tableConf.params.size() > idxParam) {
+        size_t value = (size_t) strtol(tableConf.params[idxParam].c_str(), NULL, 10);
+        if (value > 0) {
+            return value;
+        }
+        BOOST_LOG_TRIVIAL(warning) << "Ignoring invalid value \"" <<
+            tableConf.params[idxParam] << "\" for the parameter " << idxParam <<
+            " of " << tableConf.predname;
+    }
+    return defaultValue;
+}
+
+//The last optional parameter of SQL tables is a directory where a local copy
+//of the table is kept. source identifies the database (but not the user).
+static std::shared_ptr<EDBTable> cacheSQLTable(const EDBConf::Table &tableConf,
+        const int idxParam, PredId_t predid, SQLTable *table,
+        const string &source) {
+    std::shared_ptr<SQLTable> sqlTable(table);
+    if (tableConf.params.size() > idxParam && tableConf.params[idxParam] != "") {
+        return std::shared_ptr<EDBTable>(new SQLTableCache(predid, sqlTable,
+                                         tableConf.params[idxParam], source));
+    }
+    return sqlTable;
+}
+#endif
+
 #ifdef MYSQL
 void EDBLayer::addMySQLTable(const EDBConf::Table &tableConf) {
     EDBInfoTable infot;
@@ -43,9 +102,13 @@ void EDBLayer::addMySQLTable(const EDBConf::Table &tableConf) {
     infot.id = (PredId_t) predDictionary.getOrAdd(pn);
     infot.arity = 3;
     infot.type = tableConf.type;
-    infot.manager = std::shared_ptr<EDBTable>(new MySQLTable(tableConf.params[0],
+    MySQLTable *table = new MySQLTable(tableConf.params[0],
                 tableConf.params[1], tableConf.params[2], tableConf.params[3],
-                tableConf.params[4], tableConf.params[5]));
+                tableConf.params[4], tableConf.params[5],
+                getSizeParam(tableConf, 6, SQL_DEFAULT_FETCH_SIZE),
+                getSizeParam(tableConf, 7, SQL_DEFAULT_POOL_SIZE));
+    infot.manager = cacheSQLTable(tableConf, 8, infot.id, table,
+                                  "mysql://" + tableConf.params[0] + "/" + tableConf.params[3]);
     dbPredicates.insert(make_pair(infot.id, infot));
 }
 #endif
@@ -57,9 +120,13 @@ void EDBLayer::addODBCTable(const EDBConf::Table &tableConf) {
     infot.id = (PredId_t) predDictionary.getOrAdd(pn);
     infot.arity = 3;
     infot.type = tableConf.type;
-    infot.manager = std::shared_ptr<EDBTable>(new ODBCTable(tableConf.params[0],
+    ODBCTable *table = new ODBCTable(tableConf.params[0],
                 tableConf.params[1], tableConf.params[2], tableConf.params[3],
-                tableConf.params[4]));
+                tableConf.params[4],
+                getSizeParam(tableConf, 5, SQL_DEFAULT_FETCH_SIZE),
+                getSizeParam(tableConf, 6, SQL_DEFAULT_POOL_SIZE));
+    infot.manager = cacheSQLTable(tableConf, 7, infot.id, table,
+                                  "odbc://" + tableConf.params[2]);
     dbPredicates.insert(make_pair(infot.id, infot));
 }
 #endif
@@ -71,13 +138,68 @@ void EDBLayer::addMAPITable(const EDBConf::Table &tableConf) {
     infot.id = (PredId_t) predDictionary.getOrAdd(pn);
     infot.arity = 3;
     infot.type = tableConf.type;
-    infot.manager = std::shared_ptr<EDBTable>(new MAPITable(tableConf.params[0],
+    MAPITable *table = new MAPITable(tableConf.params[0],
                 (int) strtol(tableConf.params[1].c_str(), NULL, 10), tableConf.params[2], tableConf.params[3],
-                tableConf.params[4], tableConf.params[5], tableConf.params[6]));
+                tableConf.params[4], tableConf.params[5], tableConf.params[6],
+                getSizeParam(tableConf, 7, SQL_DEFAULT_FETCH_SIZE),
+                getSizeParam(tableConf, 8, SQL_DEFAULT_POOL_SIZE));
+    infot.manager = cacheSQLTable(tableConf, 9, infot.id, table,
+                                  "monetdb://" + tableConf.params[0] + ":" +
+                                  tableConf.params[1] + "/" + tableConf.params[4]);
     dbPredicates.insert(make_pair(infot.id, infot));
 }
 #endif
 
+//Positions and values of the constants of the literal
+static std::vector<std::pair<uint8_t, Term_t>> getConstants(const Literal &l) {
+    std::vector<std::pair<uint8_t, Term_t>> constants;
+    for (uint8_t i = 0; i < l.getTupleSize(); ++i) {
+        if (!l.getTermAtPos(i).isVariable()) {
+            constants.push_back(std::make_pair(i, l.getTermAtPos(i).getValue()));
+        }
+    }
+    return constants;
+}
+
+static bool hasEqualFields(const Term_t *row,
+                           const std::vector<std::pair<uint8_t, uint8_t>> &repeated) {
+    for (const auto &r : repeated) {
+        if (row[r.first] != row[r.second]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Calls process on the rows of a relation with three or more columns that
+//match the literal and one of the tuples in valuesToFilter, until process
+//returns false
+template<typename F>
+static void scanTmpRelation(IndexedTupleTable *rel, const Literal &l,
+                            std::vector<uint8_t> *posToFilter,
+                            std::vector<Term_t> *valuesToFilter, F process) {
+    const std::vector<std::pair<uint8_t, uint8_t>> repeated = l.getRepeatedVars();
+    std::vector<std::pair<uint8_t, Term_t>> constants = getConstants(l);
+    const size_t nconstants = constants.size();
+    const size_t nfilters = posToFilter == NULL ? 0 : posToFilter->size();
+    const size_t ntuples = nfilters == 0 ? 1 : valuesToFilter->size() / nfilters;
+    const std::vector<uint8_t> noSort;
+    for (size_t i = 0; i < ntuples; ++i) {
+        constants.resize(nconstants);
+        for (size_t j = 0; j < nfilters; ++j) {
+            constants.push_back(std::make_pair(posToFilter->at(j),
+                                               valuesToFilter->at(i * nfilters + j)));
+        }
+        const Term_t *begin, *end;
+        rel->getRows(constants, noSort, begin, end);
+        for (; begin != end; begin += rel->getSizeTuple()) {
+            if (hasEqualFields(begin, repeated) && !process(begin)) {
+                return;
+            }
+        }
+    }
+}
+
 void EDBLayer::query(QSQQuery *query, TupleTable *outputTable,
                      std::vector<uint8_t> *posToFilter,
                      std::vector<Term_t> *valuesToFilter) {
@@ -115,7 +237,7 @@ void EDBLayer::query(QSQQuery *query, TupleTable *outputTable,
                 }
             } else {
                 //Copy all values
-                for (std::vector <Term_t>::iterator itr = rel->getSingleColumn()->begin();
+                for (const Term_t *itr = rel->getSingleColumn()->begin();
                         itr != rel->getSingleColumn()->end(); ++itr) {
                     row[0] = *itr;
                     outputTable->addRow(row);
@@ -127,7 +249,7 @@ void EDBLayer::query(QSQQuery *query, TupleTable *outputTable,
             const uint8_t nRepeatedVars = query->getNRepeatedVars();
             uint64_t row[2];
             if (posToFilter == NULL || posToFilter->size() == 0) {
-                for (std::vector<std::pair<Term_t, Term_t>>::iterator
+                for (const std::pair<Term_t, Term_t> *
                         itr = rel->getTwoColumn1()->begin();
                         itr != rel->getTwoColumn1()->end(); ++itr) {
                     bool valid = true;
@@ -168,11 +290,11 @@ void EDBLayer::query(QSQQuery *query, TupleTable *outputTable,
 		if (! sorted) {
 		    std::sort(filterValues.begin(), filterValues.end());
 		}
-                std::vector<std::pair<Term_t, Term_t>> *pairs;
+                const SortedArray<std::pair<Term_t, Term_t>> *pairs;
                 bool inverted = posToFilter->at(0) != 0;
                 if (!inverted) {
                     pairs = rel->getTwoColumn1();
-                    std::vector<std::pair<Term_t, Term_t>>::iterator itr1 = pairs->begin();
+                    const std::pair<Term_t, Term_t> *itr1 = pairs->begin();
                     std::vector<Term_t>::iterator itr2 = filterValues.begin();
                     while (itr1 != pairs->end() && itr2 != filterValues.end()) {
                         while (itr1 != pairs->end() && itr1->first < *itr2) {
@@ -208,7 +330,7 @@ void EDBLayer::query(QSQQuery *query, TupleTable *outputTable,
                     }
                 } else {
                     pairs = rel->getTwoColumn2();
-                    std::vector<std::pair<Term_t, Term_t>>::iterator itr1 = pairs->begin();
+                    const std::pair<Term_t, Term_t> *itr1 = pairs->begin();
                     std::vector<Term_t>::iterator itr2 = filterValues.begin();
                     while (itr1 != pairs->end() && itr2 != filterValues.end()) {
                         while (itr1 != pairs->end() && itr1->second < *itr2) {
@@ -271,7 +393,7 @@ void EDBLayer::query(QSQQuery *query, TupleTable *outputTable,
 		if (! sorted) {
 		    std::sort(filterValues.begin(), filterValues.end());
 		}
-                std::vector<std::pair<Term_t, Term_t>> *pairs;
+                const SortedArray<std::pair<Term_t, Term_t>> *pairs;
                 bool inverted = posToFilter->at(0) != 0;
                 if (!inverted) {
                     pairs = rel->getTwoColumn1();
@@ -305,9 +427,14 @@ void EDBLayer::query(QSQQuery *query, TupleTable *outputTable,
             }
             break;
         }
-        default:
-            BOOST_LOG_TRIVIAL(error) << "This should not happen";
-            throw 10;
+        default: {
+            scanTmpRelation(rel, *query->getLiteral(), posToFilter,
+            valuesToFilter, [outputTable](const Term_t * row) {
+                outputTable->addRow(row);
+                return true;
+            });
+            break;
+        }
         }
     }
     // BOOST_LOG_TRIVIAL(debug) << "result size = " << outputTable->getNRows();
@@ -337,13 +464,15 @@ EDBIterator *EDBLayer::getIterator(const Literal &query) {
         EDBMemIterator *itr;
         switch (size) {
         case 1:
-            itr = memItrFactory.get();
+            itr = getMemIterator();
             itr->init1(predid, rel->getSingleColumn(), c1, vc1);
             return itr;
         case 2:
-            itr = memItrFactory.get();
+            itr = getMemIterator();
             itr->init2(predid, c1, rel->getTwoColumn1(), c1, vc1, c2, vc2, equalFields);
             return itr;
+        default:
+            return getTmpIterator(rel, query, std::vector<uint8_t>());
         }
     }
     throw 10;
@@ -358,7 +487,6 @@ EDBIterator *EDBLayer::getSortedIterator(const Literal &query,
         auto p = dbPredicates.find(predid);
         return p->second.manager->getSortedIterator(query, fields);
     } else {
-        assert(literal->getTupleSize() <= 2);
         bool equalFields = false;
         if (query.hasRepeatedVars()) {
             equalFields = true;
@@ -380,11 +508,11 @@ EDBIterator *EDBLayer::getSortedIterator(const Literal &query,
         EDBMemIterator *itr;
         switch (size) {
         case 1:
-            itr = memItrFactory.get();
+            itr = getMemIterator();
             itr->init1(predid, rel->getSingleColumn(), c1, vc1);
             return itr;
         case 2:
-            itr = memItrFactory.get();
+            itr = getMemIterator();
             if (c1) {
                 itr->init2(predid, true, rel->getTwoColumn1(), c1, vc1, c2, vc2, equalFields);
             } else {
@@ -400,18 +528,46 @@ EDBIterator *EDBLayer::getSortedIterator(const Literal &query,
                 }
             }
             return itr;
+        default:
+            return getTmpIterator(rel, query, fields);
         }
     }
     throw 10;
 }
 
+EDBMemIterator *EDBLayer::getMemIterator() {
+    boost::mutex::scoped_lock lock(memItrMutex);
+    return memItrFactory.get();
+}
+
+void EDBLayer::releaseMemIterator(EDBMemIterator *itr) {
+    boost::mutex::scoped_lock lock(memItrMutex);
+    memItrFactory.release(itr);
+}
+
+EDBMemIterator *EDBLayer::getTmpIterator(IndexedTupleTable *rel,
+        const Literal &query, const std::vector<uint8_t> &fields) {
+    const Term_t *begin, *end;
+    rel->getRows(getConstants(query), fields, begin, end);
+    EDBMemIterator *itr = getMemIterator();
+    itr->initN(query.getPredicate().getId(), rel->getSizeTuple(), begin, end,
+               query.getRepeatedVars());
+    return itr;
+}
+
 size_t EDBLayer::getCardinalityColumn(const Literal &query,
                                       uint8_t posColumn) {
     const Literal *literal = &query;
     PredId_t predid = literal->getPredicate().getId();
     if (dbPredicates.count(predid)) {
+        uint64_t card;
+        if (stats.get(query, posColumn, card)) {
+            return card;
+        }
         auto p = dbPredicates.find(predid);
-        return p->second.manager->getCardinalityColumn(query, posColumn);
+        card = p->second.manager->getCardinalityColumn(query, posColumn);
+        stats.put(query, posColumn, card, persistStats);
+        return card;
     } else {
         // throw 10;
         IndexedTupleTable *rel = tmpRelations[predid];
@@ -423,8 +579,14 @@ size_t EDBLayer::getCardinality(const Literal &query) {
     const Literal *literal = &query;
     PredId_t predid = literal->getPredicate().getId();
     if (dbPredicates.count(predid)) {
+        uint64_t card;
+        if (stats.get(query, EDBStats::CARDINALITY, card)) {
+            return card;
+        }
         auto p = dbPredicates.find(predid);
-        return p->second.manager->getCardinality(query);
+        card = p->second.manager->getCardinality(query);
+        stats.put(query, EDBStats::CARDINALITY, card, persistStats);
+        return card;
     } else {
         IndexedTupleTable *rel = tmpRelations[predid];
         if (literal->getNVars() == literal->getTupleSize()) {
@@ -448,24 +610,33 @@ size_t EDBLayer::getCardinality(const Literal &query) {
         EDBMemIterator *itr = NULL;
         switch (size) {
         case 1:
-            itr = memItrFactory.get();
+            itr = getMemIterator();
             itr->init1(predid, rel->getSingleColumn(), c1, vc1);
             break;
         case 2:
-            itr = memItrFactory.get();
+            itr = getMemIterator();
 	    if (c1 || ! c2) {
 		itr->init2(predid, c1, rel->getTwoColumn1(), c1, vc1, c2, vc2, equalFields);
 	    } else {
 		itr->init2(predid, c1, rel->getTwoColumn2(), c1, vc1, c2, vc2, equalFields);
 	    }
             break;
+        default:
+            if (!equalFields) {
+                //All the rows in the range match
+                const Term_t *begin, *end;
+                rel->getRows(getConstants(query), std::vector<uint8_t>(), begin, end);
+                return (end - begin) / size;
+            }
+            itr = getTmpIterator(rel, query, std::vector<uint8_t>());
+            break;
         }
 	size_t count = 0;
 	while (itr->hasNext()) {
 	    count++;
 	    itr->next();
 	}
-        memItrFactory.release(itr);
+        releaseMemIterator(itr);
 	return count;
     }
 }
@@ -474,8 +645,14 @@ size_t EDBLayer::estimateCardinality(const Literal &query) {
     const Literal *literal = &query;
     PredId_t predid = literal->getPredicate().getId();
     if (dbPredicates.count(predid)) {
+        uint64_t card;
+        if (stats.get(query, EDBStats::ESTIMATE, card)) {
+            return card;
+        }
         auto p = dbPredicates.find(predid);
-        return p->second.manager->estimateCardinality(query);
+        card = p->second.manager->estimateCardinality(query);
+        stats.put(query, EDBStats::ESTIMATE, card, persistStats);
+        return card;
     } else {
         // if (literal->getNVars() != literal->getTupleSize()) {
         //     BOOST_LOG_TRIVIAL(debug) << "Estimate is not very precise";
@@ -494,6 +671,15 @@ bool EDBLayer::isEmpty(const Literal &query, std::vector<uint8_t> *posToFilter,
         return p->second.manager->isEmpty(query, posToFilter, valuesToFilter);
     } else {
         IndexedTupleTable *rel = tmpRelations[predid];
+        if (rel->getSizeTuple() > 2) {
+            bool empty = true;
+            scanTmpRelation(rel, *literal, posToFilter, valuesToFilter,
+            [&empty](const Term_t * row) {
+                empty = false;
+                return false;
+            });
+            return empty;
+        }
         assert(literal->getTupleSize() <= 2);
 	/*
 	if (posToFilter != NULL) {
@@ -538,7 +724,7 @@ bool EDBLayer::isEmpty(const Literal &query, std::vector<uint8_t> *posToFilter,
             } else {
                 //Check all rows where two columns are equal
                 assert(literal->getTupleSize() == 2);
-                for (std::vector<std::pair<Term_t, Term_t>>::iterator itr =
+                for (const std::pair<Term_t, Term_t> *itr =
                             rel->getTwoColumn1()->begin(); itr != rel->getTwoColumn1()->end();
                         ++itr) {
                     if (itr->first == itr->second) {
@@ -586,7 +772,7 @@ void EDBLayer::releaseIterator(EDBIterator * itr) {
         auto p = dbPredicates.find(itr->getPredicateID());
         return p->second.manager->releaseIterator(itr);
     } else {
-        memItrFactory.release((EDBMemIterator*)itr);
+        releaseMemIterator((EDBMemIterator*)itr);
     }
 }
 
@@ -636,21 +822,76 @@ std::shared_ptr<Column> EDBLayer::checkIn(
 
 bool EDBLayer::getDictNumber(const char *text, const size_t sizeText, uint64_t &id) {
     if (dbPredicates.size() > 0) {
+        const string key(text, sizeText);
+        if (numberCache.get(key, id)) {
+            return true;
+        }
         //Get the number from the first edb table
-        return dbPredicates.begin()->second.manager->
-               getDictNumber(text, sizeText, id);
+        if (dbPredicates.begin()->second.manager->
+                getDictNumber(text, sizeText, id)) {
+            numberCache.put(key, id);
+            return true;
+        }
     }
     return false;
 }
 
 bool EDBLayer::getDictText(const uint64_t id, char *text) {
     if (dbPredicates.size() > 0) {
+        string value;
+        if (textCache.get(id, value)) {
+            memcpy(text, value.c_str(), value.size() + 1);
+            return true;
+        }
         //Get the number from the first edb table
-        return dbPredicates.begin()->second.manager->getDictText(id, text);
+        if (dbPredicates.begin()->second.manager->getDictText(id, text)) {
+            textCache.put(id, string(text));
+            return true;
+        }
     }
     return false;
 }
 
+bool EDBLayer::getDictTexts(const std::vector<uint64_t> &ids,
+                            std::vector<string> &texts) {
+    texts.clear();
+    texts.resize(ids.size());
+    if (dbPredicates.size() == 0) {
+        return ids.empty();
+    }
+
+    //Only the distinct IDs that are not cached are sent to the table
+    std::vector<uint64_t> missing;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (!textCache.get(ids[i], texts[i])) {
+            missing.push_back(ids[i]);
+        }
+    }
+    if (missing.empty()) {
+        return true;
+    }
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+    std::vector<string> decoded;
+    dbPredicates.begin()->second.manager->getDictTexts(missing, decoded);
+    for (size_t i = 0; i < missing.size(); ++i) {
+        if (decoded[i] != "") {
+            textCache.put(missing[i], decoded[i]);
+        }
+    }
+
+    bool allFound = true;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (texts[i] == "") {
+            const size_t pos = std::lower_bound(missing.begin(), missing.end(),
+                                                ids[i]) - missing.begin();
+            texts[i] = decoded[pos];
+            allFound = allFound && texts[i] != "";
+        }
+    }
+    return allFound;
+}
+
 uint64_t EDBLayer::getNTerms() {
     if (dbPredicates.size() > 0) {
         //Get the number from the first edb table
@@ -659,6 +900,93 @@ uint64_t EDBLayer::getNTerms() {
     return 0;
 }
 
+void EDBLayer::loadStats(EDBConf &conf) {
+    //The statistics are stored in the directory of the KB or, if the first
+    //table is not a Trident KB, next to the configuration file
+    const std::vector<EDBConf::Table> &tables = conf.getTables();
+    if (!tables.empty() && tables[0].type == "Trident") {
+        statsFile = tables[0].params[0] + "/edbstats";
+    } else {
+        statsFile = conf.getPath() + ".stats";
+    }
+    statsSignature = computeStatsSignature();
+    stats.load(statsFile, statsSignature, predDictionary);
+}
+
+string EDBLayer::computeStatsSignature() {
+    //Ordered by name, so that it does not depend on the IDs
+    std::map<string, string> versions;
+    for (const auto &el : dbPredicates) {
+        versions[predDictionary.getRawValue(el.first)] =
+            el.second.manager->getVersion();
+    }
+    string signature;
+    for (const auto &el : versions) {
+        if (!signature.empty()) {
+            signature += ",";
+        }
+        signature += el.first + "=" + el.second;
+    }
+    return signature;
+}
+
+void EDBLayer::saveStats() {
+    if (statsFile != "" && stats.isModified()) {
+        stats.save(statsFile, statsSignature, predDictionary);
+    }
+}
+
+void EDBLayer::analyze(const size_t maxDistinct) {
+    stats.clear();
+    persistStats = true;
+    for (const auto &el : dbPredicates) {
+        const EDBInfoTable &info = el.second;
+        const string name = predDictionary.getRawValue(info.id);
+        VTuple t(info.arity);
+        for (uint8_t i = 0; i < info.arity; ++i) {
+            t.set(VTerm(i + 1, 0), i);
+        }
+        const Predicate pred(info.id, 0, EDB, info.arity);
+        const Literal all(pred, t);
+        const size_t card = getCardinality(all);
+        estimateCardinality(all);
+        BOOST_LOG_TRIVIAL(info) << "Table " << name << ": " << card << " rows";
+
+        for (uint8_t pos = 0; pos < info.arity; ++pos) {
+            const size_t distinct = getCardinalityColumn(all, pos);
+            BOOST_LOG_TRIVIAL(info) << "Table " << name << ", column " <<
+                                    (int) pos << ": " << distinct << " distinct values";
+            if (distinct > maxDistinct || info.arity == 1) {
+                continue;
+            }
+            //Cardinalities of the patterns with a constant in pos
+            std::vector<uint8_t> fields;
+            fields.push_back(pos);
+            EDBIterator *itr = getSortedIterator(all, fields);
+            bool first = true;
+            Term_t prev = 0;
+            while (itr->hasNext()) {
+                itr->next();
+                const Term_t v = itr->getElementAt(pos);
+                if (!first && v == prev) {
+                    continue;
+                }
+                first = false;
+                prev = v;
+                VTuple tc = t;
+                tc.set(VTerm(0, v), pos);
+                const Literal l(pred, tc);
+                getCardinality(l);
+                estimateCardinality(l);
+            }
+            releaseIterator(itr);
+        }
+    }
+    persistStats = false;
+    BOOST_LOG_TRIVIAL(info) << "Computed " << stats.size() << " statistics";
+    saveStats();
+}
+
 Predicate EDBLayer::getDBPredicate(int idPredicate) {
     if (!dbPredicates.count(idPredicate)) {
         throw 10; //cannot happen
@@ -667,7 +995,7 @@ Predicate EDBLayer::getDBPredicate(int idPredicate) {
     return Predicate(idPredicate, 0, EDB, info.arity);
 }
 
-void EDBMemIterator::init1(PredId_t id, std::vector<Term_t>* v, const bool c1, const Term_t vc1) {
+void EDBMemIterator::init1(PredId_t id, const SortedArray<Term_t>* v, const bool c1, const Term_t vc1) {
     predid = id;
     nfields = 1;
     oneColumn = v->begin();
@@ -675,19 +1003,20 @@ void EDBMemIterator::init1(PredId_t id, std::vector<Term_t>* v, const bool c1, c
 
     if (c1) {
         //Search for the value.
-        std::pair<std::vector<Term_t>::iterator, std::vector<Term_t>::iterator> bounds
+        std::pair<const Term_t*, const Term_t*> bounds
             = std::equal_range(v->begin(), v->end(), vc1);
         oneColumn = bounds.first;
         endOneColumn = bounds.second;
     }
 
     isFirst = true;
+    isNextCheck = false;
     hasFirst = oneColumn != endOneColumn;
     ignoreSecondColumn = false;
     isIgnoreAllowed = false;
 }
 
-void EDBMemIterator::init2(PredId_t id, const bool defaultSorting, std::vector<std::pair<Term_t, Term_t>>* v, const bool c1,
+void EDBMemIterator::init2(PredId_t id, const bool defaultSorting, const SortedArray<std::pair<Term_t, Term_t>>* v, const bool c1,
                            const Term_t vc1, const bool c2, const Term_t vc2,
                            const bool equalFields) {
     predid = id;
@@ -742,9 +1071,25 @@ void EDBMemIterator::init2(PredId_t id, const bool defaultSorting, std::vector<s
     }
 
     isFirst = true;
+    isNextCheck = false;
     hasFirst = twoColumns != endTwoColumns;
 }
 
+void EDBMemIterator::initN(PredId_t id, const uint8_t nfields,
+                           const Term_t *begin, const Term_t *end,
+                           const std::vector<std::pair<uint8_t, uint8_t>> &repeatedFields) {
+    predid = id;
+    this->nfields = nfields;
+    rows = begin;
+    endRows = end;
+    this->repeatedFields = repeatedFields;
+    equalFields = false;
+    ignoreSecondColumn = false;
+    isIgnoreAllowed = false;
+    isNextCheck = false;
+    isFirst = true;
+}
+
 void EDBMemIterator::skipDuplicatedFirstColumn() {
     if (isIgnoreAllowed)
         ignoreSecondColumn = true;
@@ -752,6 +1097,18 @@ void EDBMemIterator::skipDuplicatedFirstColumn() {
 }
 
 bool EDBMemIterator::hasNext() {
+    if (nfields > 2) {
+        //Move to the next row where the repeated fields are equal
+        if (!isNextCheck) {
+            nextRow = isFirst ? rows : rows + nfields;
+            while (nextRow != endRows && !hasEqualFields(nextRow, repeatedFields)) {
+                nextRow += nfields;
+            }
+            isNextCheck = true;
+        }
+        return nextRow != endRows;
+    }
+
     if (equalFields) {
         //Move to the first line where both columns are equal
         if (!isNextCheck) {
@@ -811,7 +1168,15 @@ bool EDBMemIterator::hasNext() {
 }
 
 void EDBMemIterator::next() {
-    if (equalFields) {
+    if (nfields > 2) {
+        if (!isNextCheck) {
+            hasNext();
+        }
+        rows = nextRow;
+        isFirst = false;
+        isNextCheck = false;
+        return;
+    } else if (equalFields) {
         isFirst = false;
         twoColumns = pointerEqualFieldsNext;
         isNextCheck = false;
@@ -836,6 +1201,8 @@ void EDBMemIterator::next() {
 Term_t EDBMemIterator::getElementAt(const uint8_t p) {
     if (nfields == 1) {
         return *oneColumn;
+    } else if (nfields > 2) {
+        return rows[p];
     } else {
         if (p == 0) {
             return twoColumns->first;
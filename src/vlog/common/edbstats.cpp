@@ -0,0 +1,161 @@
+#include <vlog/edbstats.h>
+#include <vlog/catalogfile.h>
+
+#include <boost/log/trivial.hpp>
+#include <boost/filesystem.hpp>
+
+#include <stdexcept>
+
+namespace fs = boost::filesystem;
+
+EDBStats::Key EDBStats::getKey(const Literal &query, const int kind) {
+    //Rename the variables in order of appearance
+    VTuple pattern(query.getTupleSize());
+    uint8_t vars[SIZETUPLE];
+    uint8_t nvars = 0;
+    for (uint8_t i = 0; i < query.getTupleSize(); ++i) {
+        const VTerm t = query.getTermAtPos(i);
+        if (t.isVariable()) {
+            uint8_t j = 0;
+            while (j < nvars && vars[j] != t.getId()) {
+                j++;
+            }
+            if (j == nvars) {
+                vars[nvars++] = t.getId();
+            }
+            pattern.set(VTerm(j + 1, 0), i);
+        } else {
+            pattern.set(VTerm(0, t.getValue()), i);
+        }
+    }
+    return Key(query.getPredicate().getId(), kind, pattern);
+}
+
+bool EDBStats::get(const Literal &query, const int kind, uint64_t &value) {
+    const Key key = getKey(query, kind);
+    boost::shared_lock<boost::shared_mutex> lock(mutex);
+    auto itr = entries.find(key);
+    if (itr == entries.end()) {
+        return false;
+    }
+    value = itr->second.value;
+    return true;
+}
+
+void EDBStats::insert(const Key &key, const Entry &entry) {
+    auto itr = entries.find(key);
+    if (itr != entries.end()) {
+        itr->second.value = entry.value;
+        itr->second.persistent |= entry.persistent;
+    } else if (entries.size() < MAX_ENTRIES) {
+        entries.insert(std::make_pair(key, entry));
+    } else {
+        if (!full) {
+            BOOST_LOG_TRIVIAL(warning) << "The catalog of the statistics is full: new entries are not memoized";
+            full = true;
+        }
+        return;
+    }
+    if (entry.persistent) {
+        modified = true;
+    }
+}
+
+void EDBStats::put(const Literal &query, const int kind, const uint64_t value,
+                   const bool persistent) {
+    const Key key = getKey(query, kind);
+    Entry entry;
+    entry.value = value;
+    //The patterns without constants are few, the others are stored only if
+    //they were requested explicitly
+    entry.persistent = persistent || query.getNVars() == query.getTupleSize();
+    boost::unique_lock<boost::shared_mutex> lock(mutex);
+    insert(key, entry);
+}
+
+size_t EDBStats::size() {
+    boost::shared_lock<boost::shared_mutex> lock(mutex);
+    return entries.size();
+}
+
+void EDBStats::clear() {
+    boost::unique_lock<boost::shared_mutex> lock(mutex);
+    entries.clear();
+    full = false;
+    modified = true;
+}
+
+void EDBStats::load(const std::string &file, const std::string &signature,
+                    Dictionary &predicates) {
+    size_t count = 0;
+    boost::unique_lock<boost::shared_mutex> lock(mutex);
+    //Format: predicate <TAB> kind <TAB> pattern <TAB> value
+    const bool valid = CatalogFile::read(file, signature, 4,
+    [&](const std::vector<std::string> &fields) {
+        auto itr = predicates.getMap().find(fields[0]);
+        if (itr == predicates.getMap().end()) {
+            return false;
+        }
+        const std::vector<std::string> terms = CatalogFile::split(fields[2], ',');
+        if (terms.empty() || terms.size() > SIZETUPLE) {
+            throw std::invalid_argument("pattern");
+        }
+        VTuple pattern((uint8_t) terms.size());
+        for (uint8_t i = 0; i < terms.size(); ++i) {
+            if (!terms[i].empty() && terms[i][0] == '?') {
+                pattern.set(VTerm((uint8_t) std::stoi(terms[i].substr(1)), 0), i);
+            } else {
+                pattern.set(VTerm(0, std::stoull(terms[i])), i);
+            }
+        }
+        const int kind = std::stoi(fields[1]);
+        Entry entry;
+        entry.value = std::stoull(fields[3]);
+        entry.persistent = true;
+        insert(Key((PredId_t) itr->second, kind, pattern), entry);
+        return true;
+    }, count);
+    if (!valid) {
+        BOOST_LOG_TRIVIAL(warning) << "The statistics in " << file << " were computed on a different KB. Removing them";
+        boost::system::error_code ec;
+        fs::remove(file, ec);
+        return;
+    }
+    modified = false;
+    BOOST_LOG_TRIVIAL(debug) << "Loaded " << count << " statistics from " << file;
+}
+
+void EDBStats::save(const std::string &file, const std::string &signature,
+                    Dictionary &predicates) {
+    boost::unique_lock<boost::shared_mutex> lock(mutex);
+    size_t count = 0;
+    const bool written = CatalogFile::write(file, signature,
+    [&](std::ostream &out) {
+        for (const auto &entry : entries) {
+            if (!entry.second.persistent) {
+                continue;
+            }
+            count++;
+            const Key &key = entry.first;
+            out << predicates.getRawValue(key.pred) << "\t" << key.kind << "\t";
+            for (uint8_t i = 0; i < key.pattern.getSize(); ++i) {
+                if (i > 0) {
+                    out << ",";
+                }
+                const VTerm t = key.pattern.get(i);
+                if (t.isVariable()) {
+                    out << "?" << (int) t.getId();
+                } else {
+                    out << t.getValue();
+                }
+            }
+            out << "\t" << entry.second.value << std::endl;
+        }
+    });
+    if (!written) {
+        BOOST_LOG_TRIVIAL(warning) << "Cannot write the statistics in " << file;
+        return;
+    }
+    modified = false;
+    BOOST_LOG_TRIVIAL(debug) << "Stored " << count << " statistics in " << file;
+}
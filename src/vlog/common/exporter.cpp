@@ -18,6 +18,7 @@
 
 #include <inttypes.h>
 #include <vector>
+#include <algorithm>
 #include <fstream>
 
 namespace fs = boost::filesystem;
@@ -421,9 +422,22 @@ void Exporter::generateNTTriples(string outputdir, bool decompress) {
     ofstream ntFile;
     boost::iostreams::filtering_stream<boost::iostreams::output> out;
 
-    char supportBuffer[MAX_TERM_SIZE];
+    //The terms are decoded in blocks of triples
+    const size_t blockSize = 100000;
+    std::vector<uint64_t> blockIds;
+    std::vector<string> blockTexts;
     size_t idx = 0;
     for (int i = 0; i < all_s.size(); ++i) {
+        if (decompress && i % blockSize == 0) {
+            const size_t end = std::min(all_s.size(), i + blockSize);
+            blockIds.clear();
+            for (size_t j = i; j < end; ++j) {
+                blockIds.push_back(all_s[j]);
+                blockIds.push_back(all_p[j]);
+                blockIds.push_back(all_o[j]);
+            }
+            edb.getDictTexts(blockIds, blockTexts);
+        }
         if (i % 10000000 == 0) {
             if (i > 0) {
                 BOOST_LOG_TRIVIAL(info) << "So far exported " << i << " triples ...";
@@ -439,22 +453,23 @@ void Exporter::generateNTTriples(string outputdir, bool decompress) {
             out.push(ntFile);
         }
         if (decompress) {
-            if (edb.getDictText(all_s[i], supportBuffer)) {
-                out << supportBuffer << " ";
+            const size_t posText = 3 * (i % blockSize);
+            if (blockTexts[posText] != "") {
+                out << blockTexts[posText] << " ";
             } else {
                 std::string t = sn->getProgram()->getFromAdditional(all_s[i]);
                 if (t == std::string("")) t = std::to_string(all_s[i]);
                 out << t << " ";
             }
-            if (edb.getDictText(all_p[i], supportBuffer)) {
-                out << supportBuffer << " ";
+            if (blockTexts[posText + 1] != "") {
+                out << blockTexts[posText + 1] << " ";
             } else {
                 std::string t = sn->getProgram()->getFromAdditional(all_p[i]);
                 if (t == std::string("")) t = std::to_string(all_p[i]);
                 out << t << " ";
             }
-            if (edb.getDictText(all_o[i], supportBuffer)) {
-                out << supportBuffer << " ." << endl;
+            if (blockTexts[posText + 2] != "") {
+                out << blockTexts[posText + 2] << " ." << endl;
             } else {
                 std::string t = sn->getProgram()->getFromAdditional(all_o[i]);
                 if (t == std::string("")) t = std::to_string(all_o[i]);
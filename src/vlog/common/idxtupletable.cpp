@@ -1,61 +1,330 @@
 #include <vlog/idxtupletable.h>
 
 #include <trident/model/table.h>
+#include <boost/log/trivial.hpp>
 
-IndexedTupleTable::IndexedTupleTable(TupleTable *table) : sizeTuple((uint8_t) table->getSizeRow()) {
+#include <sys/mman.h>
 
+//Returns the indices of the rows, sorted by the given fields. row(i)
+//returns the ith row
+template<typename Row>
+static std::vector<size_t> sortedRows(const size_t nrows,
+                                      const std::vector<uint8_t> &fields,
+                                      Row row) {
+    std::vector<size_t> idx(nrows);
+    for (size_t i = 0; i < nrows; ++i) {
+        idx[i] = i;
+    }
+    std::sort(idx.begin(), idx.end(), [&row, &fields](const size_t a, const size_t b) {
+        for (auto f : fields) {
+            if (row(a)[f] != row(b)[f]) {
+                return row(a)[f] < row(b)[f];
+            }
+        }
+        return false;
+    });
+    return idx;
+}
+
+//Copies the rows of src in out, sorted by the given fields
+static void sortRows(const SortedArray<Term_t> &src, const uint8_t arity,
+                     const std::vector<uint8_t> &fields,
+                     SortedArray<Term_t> &out) {
+    const size_t nrows = src.size() / arity;
+    const Term_t *rows = src.data();
+    std::vector<size_t> idx = sortedRows(nrows, fields, [rows, arity](const size_t i) {
+        return rows + i * arity;
+    });
+    std::vector<Term_t> sorted(src.size());
+    Term_t *o = sorted.data();
+    for (auto i : idx) {
+        std::copy(rows + i * arity, rows + (i + 1) * arity, o);
+        o += arity;
+    }
+    out.assign(sorted);
+}
+
+static bool sortBySecond(const std::pair<Term_t, Term_t>& lhs,
+                         const std::pair<Term_t, Term_t>& rhs) {
+    return lhs.second < rhs.second || (lhs.second == rhs.second && lhs.first < rhs.first);
+}
+
+void IndexedTupleTable::init() {
     singleColumn = NULL;
     twoColumn1 = NULL;
     twoColumn2 = NULL;
+    mapping = NULL;
+    mappingSize = 0;
+    for (auto &set : columnSets) {
+        set.store(NULL);
+    }
 
-    //idx1 = idx2 = NULL;
-    //values1 = values2 = NULL;
-    spo = pos = osp = NULL;
-
-    if (sizeTuple == 0 || sizeTuple > 3) {
+    if (sizeTuple == 0) {
         BOOST_LOG_TRIVIAL(error) << "Not supported";
         throw 10;
     }
+}
+
+template<typename Get>
+void IndexedTupleTable::load(Get get) {
+    init();
+
+    //idx1 = idx2 = NULL;
+    //values1 = values2 = NULL;
 
     if (sizeTuple == 1) {
-        singleColumn = new std::vector<Term_t>();
+        std::vector<Term_t> column;
         //Populate it
-        for (size_t i = 0; i < table->getNRows(); ++i) {
-            singleColumn->push_back(table->getPosAtRow(i, 0));
+        column.reserve(nrows);
+        for (size_t i = 0; i < nrows; ++i) {
+            column.push_back(get(i, 0));
         }
-        std::sort(singleColumn->begin(), singleColumn->end());
+        std::sort(column.begin(), column.end());
+        singleColumn = new SortedArray<Term_t>();
+        singleColumn->assign(column);
     } else if (sizeTuple == 2) {
-        twoColumn1 = new std::vector<std::pair<Term_t, Term_t>>();
-        twoColumn2 = new std::vector<std::pair<Term_t, Term_t>>();
+        std::vector<std::pair<Term_t, Term_t>> pairs1;
+        pairs1.reserve(nrows);
+        for (size_t i = 0; i < nrows; ++i) {
+            pairs1.push_back(std::make_pair(get(i, 0), get(i, 1)));
+        }
+        std::vector<std::pair<Term_t, Term_t>> pairs2 = pairs1;
+        std::sort(pairs1.begin(), pairs1.end());
+        std::sort(pairs2.begin(), pairs2.end(), sortBySecond);
+        twoColumn1 = new SortedArray<std::pair<Term_t, Term_t>>();
+        twoColumn1->assign(pairs1);
+        twoColumn2 = new SortedArray<std::pair<Term_t, Term_t>>();
+        twoColumn2->assign(pairs2);
+    } else {
+        std::vector<Term_t> rows;
+        rows.reserve(nrows * sizeTuple);
+        for (size_t i = 0; i < nrows; ++i) {
+            for (uint8_t j = 0; j < sizeTuple; ++j) {
+                rows.push_back(get(i, j));
+            }
+        }
+        SortedArray<Term_t> unsorted;
+        unsorted.assign(rows);
+        std::unique_ptr<Permutation> perm(new Permutation());
+        for (uint8_t i = 0; i < sizeTuple; ++i) {
+            perm->fields.push_back(i);
+        }
+        sortRows(unsorted, sizeTuple, perm->fields, perm->rows);
+        permutations.push_back(std::move(perm));
+    }
+}
 
-        for (size_t i = 0; i < table->getNRows(); ++i) {
+IndexedTupleTable::IndexedTupleTable(TupleTable *table) : sizeTuple((uint8_t) table->getSizeRow()),
+    columnSets(table->getSizeRow()) {
+    nrows = table->getNRows();
+    load([table](const size_t i, const uint8_t j) {
+        return (Term_t) table->getRow(i)[j];
+    });
+}
+
+size_t IndexedTupleTable::getMappingSize(const uint8_t sizeTuple,
+        const size_t nrows) {
+    //The values of the two sortings of the pairs are stored one after the other
+    static_assert(sizeof(std::pair<Term_t, Term_t>) == 2 * sizeof(Term_t),
+                  "The pairs must not be padded");
+    const size_t nvalues = sizeTuple == 2 ? 4 * nrows : sizeTuple * nrows;
+    return 2 * sizeof(uint64_t) + nvalues * sizeof(Term_t);
+}
+
+void IndexedTupleTable::writeMapping(TupleTable *table, char *mapping) {
+    const uint8_t sizeTuple = (uint8_t) table->getSizeRow();
+    const size_t nrows = table->getNRows();
+    uint64_t *header = (uint64_t*) mapping;
+    header[0] = sizeTuple;
+    header[1] = nrows;
+    Term_t *values = (Term_t*) (header + 2);
+    if (sizeTuple == 1) {
+        for (size_t i = 0; i < nrows; ++i) {
+            values[i] = (Term_t) table->getRow(i)[0];
+        }
+        std::sort(values, values + nrows);
+    } else if (sizeTuple == 2) {
+        std::pair<Term_t, Term_t> *pairs1 = (std::pair<Term_t, Term_t>*) values;
+        std::pair<Term_t, Term_t> *pairs2 = pairs1 + nrows;
+        for (size_t i = 0; i < nrows; ++i) {
             const uint64_t *row = table->getRow(i);
-            twoColumn1->push_back(std::make_pair(row[0], row[1]));
-            twoColumn2->push_back(std::make_pair(row[0], row[1]));
+            pairs1[i] = std::make_pair((Term_t) row[0], (Term_t) row[1]);
         }
-        std::sort(twoColumn1->begin(), twoColumn1->end());
-        std::sort(twoColumn2->begin(), twoColumn2->end(), [](const std::pair<uint64_t, uint64_t>& lhs, const std::pair<uint64_t, uint64_t>& rhs) {
-            return lhs.second < rhs.second || (lhs.second == rhs.second && lhs.first < rhs.first);
-        });
-    } else if (sizeTuple == 3) {
+        std::copy(pairs1, pairs1 + nrows, pairs2);
+        std::sort(pairs1, pairs1 + nrows);
+        std::sort(pairs2, pairs2 + nrows, sortBySecond);
+    } else {
+        //The rows of the first permutation, sorted by all the columns
         std::vector<uint8_t> fields;
-        fields.push_back(0);
-        fields.push_back(1);
-        fields.push_back(2);
-        spo = table->sortBy(fields);
+        for (uint8_t i = 0; i < sizeTuple; ++i) {
+            fields.push_back(i);
+        }
+        std::vector<size_t> idx = sortedRows(nrows, fields, [table](const size_t i) {
+            return table->getRow(i);
+        });
+        for (auto i : idx) {
+            const uint64_t *row = table->getRow(i);
+            for (uint8_t j = 0; j < sizeTuple; ++j) {
+                *values++ = (Term_t) row[j];
+            }
+        }
+    }
+}
+
+IndexedTupleTable::IndexedTupleTable(char *mapping, const size_t size) :
+    sizeTuple((uint8_t) ((uint64_t*) mapping)[0]),
+    columnSets(sizeTuple) {
+    nrows = ((uint64_t*) mapping)[1];
+    init();
+    if (getMappingSize(sizeTuple, nrows) != size) {
+        BOOST_LOG_TRIVIAL(error) << "The size of the mapping does not match the table";
+        throw 10;
+    }
+    this->mapping = mapping;
+    this->mappingSize = size;
+
+    const Term_t *values = (const Term_t*) (mapping + 2 * sizeof(uint64_t));
+    if (sizeTuple == 1) {
+        singleColumn = new SortedArray<Term_t>();
+        singleColumn->adopt(values, nrows);
+    } else if (sizeTuple == 2) {
+        const std::pair<Term_t, Term_t> *pairs =
+            (const std::pair<Term_t, Term_t>*) values;
+        twoColumn1 = new SortedArray<std::pair<Term_t, Term_t>>();
+        twoColumn1->adopt(pairs, nrows);
+        twoColumn2 = new SortedArray<std::pair<Term_t, Term_t>>();
+        twoColumn2->adopt(pairs + nrows, nrows);
+    } else {
+        std::unique_ptr<Permutation> perm(new Permutation());
+        for (uint8_t i = 0; i < sizeTuple; ++i) {
+            perm->fields.push_back(i);
+        }
+        perm->rows.adopt(values, nrows * sizeTuple);
+        permutations.push_back(std::move(perm));
+    }
+}
+
+const IndexedTupleTable::Permutation *IndexedTupleTable::getPermutation(
+    const std::vector<uint8_t> &fields, const uint8_t nfixed) {
+    boost::mutex::scoped_lock lock(mutex);
+    //The first nfixed fields can appear in any order
+    std::vector<uint8_t> fixed(fields.begin(), fields.begin() + nfixed);
+    std::sort(fixed.begin(), fixed.end());
+    for (const auto &perm : permutations) {
+        std::vector<uint8_t> permFixed(perm->fields.begin(),
+                                       perm->fields.begin() + nfixed);
+        std::sort(permFixed.begin(), permFixed.end());
+        if (permFixed == fixed && std::equal(fields.begin() + nfixed,
+                                             fields.end(), perm->fields.begin() + nfixed)) {
+            return perm.get();
+        }
+    }
+
+    //Create a new permutation, sorted by fields and then by the other columns
+    std::unique_ptr<Permutation> perm(new Permutation());
+    perm->fields = fields;
+    for (uint8_t i = 0; i < sizeTuple; ++i) {
+        if (std::find(fields.begin(), fields.end(), i) == fields.end()) {
+            perm->fields.push_back(i);
+        }
+    }
+    BOOST_LOG_TRIVIAL(debug) << "Creating permutation " << permutations.size() <<
+                             " of a temporary relation with " << getNTuples() << " rows";
+    sortRows(permutations[0]->rows, sizeTuple, perm->fields, perm->rows);
+    permutations.push_back(std::move(perm));
+    return permutations.back().get();
+}
+
+GoogleSet *IndexedTupleTable::getColumnSet(const uint8_t colid) {
+    GoogleSet *set = columnSets[colid].load(std::memory_order_acquire);
+    if (set != NULL) {
+        return set;
+    }
+    boost::mutex::scoped_lock lock(mutex);
+    set = columnSets[colid].load(std::memory_order_relaxed);
+    if (set == NULL) {
+        std::unique_ptr<GoogleSet> newSet;
+        if (sizeTuple == 1) {
+            newSet = fillSet(*singleColumn);
+        } else if (sizeTuple == 2) {
+            newSet = fillSet(*twoColumn1, colid);
+        } else {
+            newSet = std::unique_ptr<GoogleSet>(new GoogleSet());
+            newSet->set_empty_key((Term_t) -1);
+            const SortedArray<Term_t> &rows = permutations[0]->rows;
+            for (const Term_t *v = rows.begin() + colid; v < rows.end(); v += sizeTuple) {
+                newSet->insert(*v);
+            }
+        }
+        set = newSet.release();
+        columnSets[colid].store(set, std::memory_order_release);
+    }
+    return set;
+}
 
-        fields.clear();
-        fields.push_back(1);
-        fields.push_back(2);
-        fields.push_back(0);
-        pos = table->sortBy(fields);
+void IndexedTupleTable::getRows(
+    const std::vector<std::pair<uint8_t, Term_t>> &constants,
+    const std::vector<uint8_t> &sortFields,
+    const Term_t *&begin, const Term_t *&end) {
+    std::vector<uint8_t> fields;
+    for (const auto &c : constants) {
+        fields.push_back(c.first);
+    }
+    for (auto f : sortFields) {
+        if (std::find(fields.begin(), fields.end(), f) == fields.end()) {
+            fields.push_back(f);
+        }
+    }
+    const Permutation *perm = getPermutation(fields, (uint8_t) constants.size());
+    const Term_t *rows = perm->rows.data();
+    begin = rows;
+    end = rows + nrows * sizeTuple;
+    if (constants.empty()) {
+        return;
+    }
 
-        fields.clear();
-        fields.push_back(2);
-        fields.push_back(0);
-        fields.push_back(1);
-        osp = table->sortBy(fields);
+    //The values to search, in the order of the permutation
+    std::vector<Term_t> key;
+    for (uint8_t i = 0; i < constants.size(); ++i) {
+        for (const auto &c : constants) {
+            if (c.first == perm->fields[i]) {
+                key.push_back(c.second);
+                break;
+            }
+        }
     }
+    //Returns -1, 0, 1 if the row is smaller, equal or bigger than the key
+    auto cmp = [&](const size_t row) {
+        const Term_t *r = rows + row * sizeTuple;
+        for (uint8_t i = 0; i < key.size(); ++i) {
+            const Term_t v = r[perm->fields[i]];
+            if (v != key[i]) {
+                return v < key[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    };
+    size_t lo = 0, hi = nrows;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (cmp(mid) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    size_t first = lo;
+    hi = nrows;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (cmp(mid) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    begin = rows + first * sizeTuple;
+    end = rows + lo * sizeTuple;
 }
 
 /*void IndexedTupleTable::query(QSQQuery *query, std::vector<uint8_t> *posToFilter,
@@ -82,6 +351,9 @@ IndexedTupleTable::IndexedTupleTable(TupleTable *table) : sizeTuple((uint8_t) ta
 }*/
 
 IndexedTupleTable::~IndexedTupleTable() {
+    for (auto &set : columnSets) {
+        delete set.load();
+    }
     if (singleColumn != NULL) {
         delete singleColumn;
     }
@@ -91,14 +363,8 @@ IndexedTupleTable::~IndexedTupleTable() {
     if (twoColumn2 != NULL) {
         delete twoColumn2;
     }
-    if (spo != NULL) {
-        delete spo;
-    }
-    if (pos != NULL) {
-        delete pos;
-    }
-    if (osp != NULL) {
-        delete osp;
+    if (mapping != NULL) {
+        munmap(mapping, mappingSize);
     }
 }
 
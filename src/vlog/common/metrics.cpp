@@ -0,0 +1,112 @@
+#include <vlog/metrics.h>
+
+#include <sys/resource.h>
+
+const double Histogram::bounds[Histogram::NBUCKETS] = {
+    0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 5, 10, 60
+};
+
+Histogram::Histogram() : sumMicros(0) {
+    for (int i = 0; i <= NBUCKETS; ++i) {
+        counts[i] = 0;
+    }
+}
+
+void Histogram::observe(const double sec) {
+    int i = 0;
+    while (i < NBUCKETS && sec > bounds[i]) {
+        i++;
+    }
+    counts[i].fetch_add(1, std::memory_order_relaxed);
+    sumMicros.fetch_add((uint64_t) (sec * 1000000), std::memory_order_relaxed);
+}
+
+void Histogram::write(std::ostream &out, const std::string &name,
+                      const std::string &labels) const {
+    const std::string sep = labels.empty() ? "" : ",";
+    //The buckets are cumulative
+    uint64_t count = 0;
+    for (int i = 0; i < NBUCKETS; ++i) {
+        count += counts[i].load(std::memory_order_relaxed);
+        out << name << "_bucket{" << labels << sep << "le=\"" << bounds[i] <<
+            "\"} " << count << "\n";
+    }
+    count += counts[NBUCKETS].load(std::memory_order_relaxed);
+    out << name << "_bucket{" << labels << sep << "le=\"+Inf\"} " << count << "\n";
+    const std::string braces = labels.empty() ? "" : "{" + labels + "}";
+    out << name << "_sum" << braces << " " <<
+        sumMicros.load(std::memory_order_relaxed) / 1000000.0 << "\n";
+    out << name << "_count" << braces << " " << count << "\n";
+}
+
+Metrics::Metrics() : rulesExecuted(0), rulesProductive(0), derivations(0),
+    retainMicros(0), consolidationMicros(0) {
+    for (int i = 0; i < N_JOIN_ALGOS; ++i) {
+        joins[i] = 0;
+        joinMicros[i] = 0;
+    }
+}
+
+Metrics &Metrics::get() {
+    static Metrics metrics;
+    return metrics;
+}
+
+void Metrics::writeHeader(std::ostream &out, const std::string &name,
+                          const std::string &type, const std::string &help) {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " " << type << "\n";
+}
+
+void Metrics::write(std::ostream &out) const {
+    writeHeader(out, "vlog_rules_executed_total", "counter",
+                "Executions of rules, including those of the magic programs.");
+    out << "vlog_rules_executed_total " << rulesExecuted.load() << "\n";
+    writeHeader(out, "vlog_rules_productive_total", "counter",
+                "Executions of rules that derived new tuples.");
+    out << "vlog_rules_productive_total " << rulesProductive.load() << "\n";
+    writeHeader(out, "vlog_derivations_total", "counter",
+                "New tuples derived by the rules.");
+    out << "vlog_derivations_total " << derivations.load() << "\n";
+
+    static const char *algos[] = {"verificative", "twotoone", "hash", "merge"};
+    writeHeader(out, "vlog_joins_total", "counter",
+                "Joins executed, by algorithm.");
+    for (int i = 0; i < N_JOIN_ALGOS; ++i) {
+        out << "vlog_joins_total{algorithm=\"" << algos[i] << "\"} " <<
+            joins[i].load() << "\n";
+    }
+    writeHeader(out, "vlog_join_seconds_total", "counter",
+                "Time spent in the joins, by algorithm.");
+    for (int i = 0; i < N_JOIN_ALGOS; ++i) {
+        out << "vlog_join_seconds_total{algorithm=\"" << algos[i] << "\"} " <<
+            joinMicros[i].load() / 1000000.0 << "\n";
+    }
+    writeHeader(out, "vlog_retain_seconds_total", "counter",
+                "Time spent removing the derivations that were already known.");
+    out << "vlog_retain_seconds_total " << retainMicros.load() / 1000000.0 << "\n";
+    writeHeader(out, "vlog_consolidation_seconds_total", "counter",
+                "Time spent removing the duplicates in the results of the joins.");
+    out << "vlog_consolidation_seconds_total " <<
+        consolidationMicros.load() / 1000000.0 << "\n";
+
+    writeHeader(out, "vlog_reasoner_query_seconds", "histogram",
+                "Latency of the queries answered by the reasoner.");
+    reasonerLatency[0].write(out, "vlog_reasoner_query_seconds",
+                             "algorithm=\"qsqr\"");
+    reasonerLatency[1].write(out, "vlog_reasoner_query_seconds",
+                             "algorithm=\"magic\"");
+    writeHeader(out, "vlog_sparql_query_seconds", "histogram",
+                "Latency of the SPARQL queries.");
+    sparqlLatency.write(out, "vlog_sparql_query_seconds", "");
+
+    //Divided by the number of threads, its rate gives the utilization
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        writeHeader(out, "process_cpu_seconds_total", "counter",
+                    "User and system CPU time of the process.");
+        const double cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+        out << "process_cpu_seconds_total " << cpu << "\n";
+    }
+}
@@ -0,0 +1,226 @@
+#include <vlog/sqliterator.h>
+#include <vlog/sqltable.h>
+
+#include <boost/log/trivial.hpp>
+
+SQLIterator::SQLIterator(const Literal &query, SQLTable *table) :
+    table(table), fetchSize(table->getFetchSize()) {
+    connection = table->checkoutConnection();
+    holdsConnection = true;
+    conMutex = table->getConnectionMutex(connection);
+    predid = query.getPredicate().getId();
+    ready[0] = ready[1] = false;
+    currentBatch = 0;
+    currentRow = 0;
+    started = false;
+    stop = false;
+    failed = false;
+    fetching = false;
+    hasNextChecked = false;
+    hasNextValue = false;
+    isFirst = true;
+    skipDuplicatedFirst = false;
+    lastFirstVar = 0;
+    posFirstVar = -1;
+}
+
+void SQLIterator::initPosFirstVar(const Literal &query,
+                                  const std::vector<uint8_t> *sortingFieldIdx) {
+    posFirstVar = -1;
+    if (sortingFieldIdx != NULL && sortingFieldIdx->size() > 0) {
+        //Cannot consider the constants
+        int var = sortingFieldIdx->at(0);
+        int idxVar = -1;
+        for (int j = 0; j < query.getTupleSize(); ++j) {
+            if (query.getTermAtPos(j).isVariable()) {
+                idxVar++;
+            }
+            if (idxVar == var) {
+                posFirstVar = j;
+                break;
+            }
+        }
+    }
+
+    int count = 0;
+    for (int i = 0; i < query.getTupleSize(); ++i) {
+	if (query.getTermAtPos(i).isVariable()) {
+	    count++;
+	    if (posFirstVar == -1) {
+		posFirstVar = i;
+	    }
+	}
+    }
+    if (count <= 1) {
+	// If there is at most one variable, reset posFirstVar to -1, because in that case
+	// skipDuplicatedFirstColumn can be a no-op.
+	posFirstVar = -1;
+    }
+}
+
+void SQLIterator::startFetching(const uint8_t ncolumns) {
+    for (int i = 0; i < 2; ++i) {
+        batches[i].columns.resize(ncolumns);
+        for (auto &column : batches[i].columns) {
+            column.reserve(fetchSize);
+        }
+        batches[i].nrows = 0;
+        batches[i].last = false;
+    }
+    currentValues.resize(ncolumns);
+    fetching = true;
+    fetcher = boost::thread(&SQLIterator::fetchLoop, this);
+}
+
+void SQLIterator::stopFetching() {
+    if (fetching) {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            stop = true;
+        }
+        cond.notify_all();
+        fetcher.join();
+        fetching = false;
+    }
+}
+
+void SQLIterator::releaseConnection() {
+    if (holdsConnection) {
+        table->releaseConnection(connection);
+        holdsConnection = false;
+    }
+}
+
+void SQLIterator::fetchLoop() {
+    int b = 0;
+    while (true) {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while (ready[b] && !stop) {
+                cond.wait(lock);
+            }
+            if (stop) {
+                return;
+            }
+        }
+
+        Batch &batch = batches[b];
+        for (auto &column : batch.columns) {
+            column.clear();
+        }
+        bool error = false;
+        try {
+            boost::recursive_mutex::scoped_lock lock(*conMutex);
+            batch.nrows = fetchRows(batch.columns, fetchSize);
+        } catch (...) {
+            error = true;
+            batch.nrows = 0;
+        }
+        batch.last = error || batch.nrows < fetchSize;
+
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            failed = error;
+            ready[b] = true;
+        }
+        cond.notify_all();
+        if (batch.last) {
+            return;
+        }
+        b = 1 - b;
+    }
+}
+
+bool SQLIterator::nextRow() {
+    if (!started) {
+        started = true;
+        currentRow = 0;
+    } else {
+        currentRow++;
+    }
+    while (true) {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while (!ready[currentBatch]) {
+                cond.wait(lock);
+            }
+            if (failed) {
+                BOOST_LOG_TRIVIAL(error) << "Failed fetching the results of the SQL query";
+                throw 10;
+            }
+        }
+        const Batch &batch = batches[currentBatch];
+        if (currentRow < batch.nrows) {
+            return true;
+        }
+        if (batch.last) {
+            //Stay on the last row
+            if (currentRow > 0) {
+                currentRow--;
+            }
+            return false;
+        }
+        //Give the batch back to the fetcher and move to the other one
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            ready[currentBatch] = false;
+        }
+        cond.notify_all();
+        currentBatch = 1 - currentBatch;
+        currentRow = 0;
+    }
+}
+
+bool SQLIterator::hasNext() {
+    if (hasNextChecked) {
+	return hasNextValue;
+    }
+    if (!fetching) {
+        hasNextValue = false;
+    } else {
+        hasNextValue = nextRow();
+        if (!isFirst && skipDuplicatedFirst) {
+            while (hasNextValue && getNextElementAt(posFirstVar) == lastFirstVar) {
+                hasNextValue = nextRow();
+            }
+        }
+    }
+    hasNextChecked = true;
+    return hasNextValue;
+}
+
+void SQLIterator::next() {
+    if (! hasNextChecked) {
+	BOOST_LOG_TRIVIAL(error) << "SQLIterator::next called without hasNext check";
+	throw 10;
+    }
+    if (!hasNextValue) {
+        BOOST_LOG_TRIVIAL(error) << "SQLIterator::next called after the last row";
+        throw 10;
+    }
+    if (isFirst) {
+        isFirst = false;
+    }
+    for (uint8_t i = 0; i < currentValues.size(); ++i) {
+        currentValues[i] = getNextElementAt(i);
+    }
+    if (skipDuplicatedFirst) {
+        lastFirstVar = currentValues[posFirstVar];
+    }
+    hasNextChecked = false;
+}
+
+void SQLIterator::skipDuplicatedFirstColumn() {
+    if (posFirstVar != -1) {
+	skipDuplicatedFirst = true;
+    }
+}
+
+Term_t SQLIterator::getElementAt(const uint8_t p) {
+    return currentValues[p];
+}
+
+SQLIterator::~SQLIterator() {
+    stopFetching();
+    releaseConnection();
+}
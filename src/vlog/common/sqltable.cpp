@@ -1,7 +1,10 @@
 #include <sstream>
 #include <string>
+#include <algorithm>
+#include <unordered_map>
 
 #include <vlog/sqltable.h>
+#include <vlog/qsqquery.h>
 
 
 std::vector<std::shared_ptr<Column>> SQLTable::checkNewIn(const Literal &l1,
@@ -261,44 +264,295 @@ std::shared_ptr<Column> SQLTable::checkIn(
     uint8_t posInL,
     size_t &sizeOutput) {
 
-    if (l.getNVars() == 0 || l.getNVars() == l.getTupleSize()) {
-	BOOST_LOG_TRIVIAL(error) << "SQLTable::checkIn() with getNVars() == " << l.getNVars() << " is not supported.";
+    if (l.getNVars() == 0) {
+	BOOST_LOG_TRIVIAL(error) << "SQLTable::checkIn() with getNVars() == 0 is not supported.";
 	throw 10;
     }
 
+    //All the statements must use the same connection, which has the
+    //temporary table
+    PooledConnection connection(this, false);
+
     std::vector<uint8_t> posVars = l.getPosVars();
-    std::vector<uint8_t> fieldsToSort;
-    fieldsToSort.push_back(posVars[posInL]);
-    EDBIterator *iter = getSortedIterator(l, fieldsToSort);
+    const uint8_t varIndex = posVars[posInL];
+    std::vector<string> fields;
+    fields.push_back(fieldTables[varIndex]);
+    std::vector<Term_t> distinctValues = uniqueTuples(values, 1);
+
+    //Only ask the database for the values to check, in batches
+    string sqlQuery = "SELECT * FROM " + tablename + " WHERE ";
+    string cond = getConditions(l);
+    if (cond != "") {
+	sqlQuery += cond + " AND ";
+    }
+    const bool useTempTable = distinctValues.size() > TEMP_TABLE_THRESHOLD;
+    if (useTempTable) {
+	loadTempTable(1, distinctValues);
+	std::vector<uint8_t> posToFilter;
+	posToFilter.push_back(varIndex);
+	sqlQuery += tempTableToSQLQuery(posToFilter);
+    }
 
     //Output
     std::unique_ptr<ColumnWriter> col(new ColumnWriter());
-    size_t idx1 = 0;
-    const uint8_t varIndex = posVars[posInL];
     sizeOutput = 0;
-    while (iter->hasNext()) {
-	iter->next();
-	const Term_t v2 = iter->getElementAt(varIndex);
-	while (values[idx1] < v2) {
-	    idx1++;
-	    if (idx1 == values.size()) {
-		break;
-	    }
+    size_t start = 0;
+    while (start < distinctValues.size()) {
+	string batchQuery = sqlQuery;
+	size_t end = distinctValues.size();
+	if (!useTempTable) {
+	    end = min(start + SQL_BATCH_SIZE, distinctValues.size());
+	    batchQuery += filterToSQLQuery(fields, distinctValues.begin() + start,
+		    distinctValues.begin() + end);
 	}
-	if (values[idx1] == v2) {
-	    col->add(v2);
-	    sizeOutput++;
-	    idx1++;
-	    if (idx1 == values.size()) {
-		break;
+	batchQuery += " ORDER BY " + fieldTables[varIndex];
+
+	EDBIterator *iter = executeQuery(batchQuery, l);
+	bool first = true;
+	Term_t prev = 0;
+	while (iter->hasNext()) {
+	    iter->next();
+	    const Term_t v = iter->getElementAt(varIndex);
+	    if (first || v != prev) {
+		col->add(v);
+		sizeOutput++;
+		prev = v;
+		first = false;
 	    }
 	}
+	iter->clear();
+	delete iter;
+	start = end;
+    }
+
+    if (useTempTable) {
+	BOOST_LOG_TRIVIAL(debug) << "DROP TABLE temp";
+	executeUpdate("DROP TABLE temp");
     }
-    iter->clear();
-    delete iter;
     return col->getColumn();
 }
 
+void SQLTable::query(QSQQuery *query, TupleTable *outputTable,
+                     std::vector<uint8_t> *posToFilter,
+                     std::vector<Term_t> *valuesToFilter) {
+    const Literal *l = query->getLiteral();
+    const uint8_t npos = query->getNPosToCopy();
+    uint8_t *pos = query->getPosToCopy();
+    uint64_t row[SIZETUPLE];
+    int count = 0;
+
+    PooledConnection connection(this, false);
+    //Every cursor is opened only after the previous one is drained, so that
+    //at most one is open on the connection
+    auto copyRows = [&](EDBIterator *iter) {
+	while (iter->hasNext()) {
+	    iter->next();
+	    for (int i = 0; i < npos; i++) {
+		row[i] = iter->getElementAt(pos[i]);
+	    }
+	    outputTable->addRow(row);
+	    count++;
+	}
+	iter->clear();
+	delete iter;
+    };
+    bool useTempTable = false;
+    if (posToFilter == NULL || posToFilter->size() == 0) {
+	copyRows(getIterator(*l));
+    } else {
+	//Create first part of query.
+	string sqlQuery = "SELECT * FROM " + tablename + " WHERE ";
+	string cond = getConditions(*l);
+	if (cond != "") {
+	    sqlQuery += cond + " AND ";
+	}
+
+	const uint8_t nfields = posToFilter->size();
+	std::vector<Term_t> tuples = uniqueTuples(*valuesToFilter, nfields);
+	if (tuples.size() / nfields > TEMP_TABLE_THRESHOLD) {
+	    // Somewhat arbitrary threshold
+	    useTempTable = true;
+	    loadTempTable(nfields, tuples);
+	    copyRows(executeQuery(sqlQuery +
+			tempTableToSQLQuery(*posToFilter), *l));
+	} else {
+	    //One query per batch of tuples
+	    std::vector<string> fields;
+	    for (int i = 0; i < nfields; i++) {
+		fields.push_back(fieldTables[posToFilter->at(i)]);
+	    }
+	    for (size_t start = 0; start < tuples.size();
+		    start += SQL_BATCH_SIZE * nfields) {
+		size_t end = min(start + SQL_BATCH_SIZE * nfields, tuples.size());
+		copyRows(executeQuery(sqlQuery + filterToSQLQuery(fields,
+				tuples.begin() + start, tuples.begin() + end), *l));
+	    }
+	}
+    }
+    BOOST_LOG_TRIVIAL(debug) << "query gave " << count << " results";
+
+    if (useTempTable) {
+	BOOST_LOG_TRIVIAL(debug) << "DROP TABLE temp";
+	executeUpdate("DROP TABLE temp");
+    }
+}
+
+bool SQLTable::getDictTexts(const std::vector<uint64_t> &ids,
+	std::vector<string> &texts) {
+    std::vector<Term_t> distinctIds = uniqueTuples(std::vector<Term_t>(
+		ids.begin(), ids.end()), 1);
+    std::vector<string> fields;
+    fields.push_back("id");
+
+    std::unordered_map<uint64_t, string> decoded;
+    std::vector<std::pair<uint64_t, string>> output;
+    for (size_t start = 0; start < distinctIds.size(); start += SQL_BATCH_SIZE) {
+	size_t end = min(start + SQL_BATCH_SIZE, distinctIds.size());
+	string sqlQuery = "SELECT id, value from dict where " +
+	    filterToSQLQuery(fields, distinctIds.begin() + start,
+		    distinctIds.begin() + end);
+	output.clear();
+	executeDictQuery(sqlQuery, output);
+	for (const auto &p : output) {
+	    decoded[p.first] = p.second;
+	}
+    }
+
+    bool allFound = true;
+    texts.clear();
+    for (const auto id : ids) {
+	auto itr = decoded.find(id);
+	if (itr != decoded.end()) {
+	    texts.push_back(itr->second);
+	} else {
+	    texts.push_back("");
+	    allFound = false;
+	}
+    }
+    return allFound;
+}
+
+string SQLTable::getConditions(const Literal &q) {
+    string cond = literalConstraintsToSQLQuery(q, fieldTables);
+    string cond1 = repeatedToSQLQuery(q, fieldTables);
+    if (cond1 != "") {
+	if (cond != "") {
+	    cond += " AND ";
+	}
+	cond += cond1;
+    }
+    return cond;
+}
+
+void SQLTable::loadTempTable(const uint8_t nfields,
+	const std::vector<Term_t> &tuples) {
+    // Create temporary table. The tuples are unique, so they can be used
+    // as primary key.
+    string sqlCreateTable = "CREATE TEMPORARY TABLE temp (";
+    for (int i = 0; i < nfields; i++) {
+	if (i > 0) {
+	    sqlCreateTable += ", ";
+	}
+	sqlCreateTable += "x" + to_string(i) + " BIGINT";
+    }
+    sqlCreateTable += ", PRIMARY KEY (";
+    for (int i = 0; i < nfields; i++) {
+	if (i > 0) {
+	    sqlCreateTable += ", ";
+	}
+	sqlCreateTable += "x" + to_string(i);
+    }
+    sqlCreateTable += "))";
+    BOOST_LOG_TRIVIAL(debug) << "SQL create temp table: " << sqlCreateTable;
+    executeUpdate(sqlCreateTable);
+
+    // Insert values into table, many rows per statement
+    BOOST_LOG_TRIVIAL(debug) << "START TRANSACTION";
+    executeUpdate("START TRANSACTION");
+    std::vector<Term_t>::const_iterator itr = tuples.begin();
+    while (itr != tuples.end()) {
+	string addition = "INSERT INTO temp VALUES ";
+	for (int row = 0; row < SQL_BATCH_SIZE && itr != tuples.end(); row++) {
+	    addition += row > 0 ? ", (" : "(";
+	    for (int i = 0; i < nfields; i++, itr++) {
+		string pref = i > 0 ? ", " : "";
+		addition += pref + to_string(*itr);
+	    }
+	    addition += ")";
+	}
+	executeUpdate(addition);
+    }
+    BOOST_LOG_TRIVIAL(debug) << "COMMIT";
+    executeUpdate("COMMIT");
+    BOOST_LOG_TRIVIAL(debug) << "Loaded " << tuples.size() / nfields << " tuples in temp table";
+}
+
+string SQLTable::tempTableToSQLQuery(const std::vector<uint8_t> &posToFilter) {
+    string sqlQuery = "EXISTS (SELECT * FROM temp WHERE ";
+    for (int i = 0; i < posToFilter.size(); i++) {
+	if (i != 0) {
+	    sqlQuery += " AND ";
+	}
+	sqlQuery += tablename + "." + fieldTables[posToFilter[i]] + " = temp.x" + to_string(i);
+    }
+    sqlQuery += ")";
+    return sqlQuery;
+}
+
+string SQLTable::filterToSQLQuery(const std::vector<string> &fields,
+	std::vector<Term_t>::const_iterator begin,
+	std::vector<Term_t>::const_iterator end) {
+    string cond = "";
+    if (fields.size() == 1) {
+	cond = fields[0] + " IN (";
+	for (std::vector<Term_t>::const_iterator itr = begin; itr != end; itr++) {
+	    if (itr != begin) {
+		cond += ", ";
+	    }
+	    cond += to_string(*itr);
+	}
+	return cond + ")";
+    }
+
+    bool first = true;
+    cond += "(";
+    for (std::vector<Term_t>::const_iterator itr = begin; itr != end;) {
+	if (! first) {
+	    cond += " OR ";
+	}
+	cond += "(";
+	for (int i = 0; i < fields.size(); i++, itr++) {
+	    string pref = i > 0 ? " AND " : "";
+	    cond += pref + fields[i] + " = " + to_string(*itr);
+	}
+	cond += ")";
+	first = false;
+    }
+    return cond + ")";
+}
+
+std::vector<Term_t> SQLTable::uniqueTuples(const std::vector<Term_t> &values,
+	const uint8_t nfields) {
+    if (nfields == 1) {
+	std::vector<Term_t> output(values);
+	std::sort(output.begin(), output.end());
+	output.erase(std::unique(output.begin(), output.end()), output.end());
+	return output;
+    }
+    std::vector<std::vector<Term_t>> tuples;
+    for (size_t i = 0; i + nfields <= values.size(); i += nfields) {
+	tuples.push_back(std::vector<Term_t>(values.begin() + i,
+		    values.begin() + i + nfields));
+    }
+    std::sort(tuples.begin(), tuples.end());
+    auto last = std::unique(tuples.begin(), tuples.end());
+    std::vector<Term_t> output;
+    for (auto itr = tuples.begin(); itr != last; itr++) {
+	output.insert(output.end(), itr->begin(), itr->end());
+    }
+    return output;
+}
+
 string SQLTable::literalConstraintsToSQLQuery(const Literal &q,
         const std::vector<string> &fieldTables) {
     string cond = "";
@@ -329,6 +583,113 @@ string SQLTable::repeatedToSQLQuery(const Literal &q,
     return cond;
 }
 
+void SQLTable::initPool(const size_t poolSize) {
+    freeConnections.clear();
+    refCounts.resize(poolSize);
+    owners.resize(poolSize);
+    conMutexes.clear();
+    for (size_t i = 0; i < poolSize; ++i) {
+        freeConnections.push_back(poolSize - i - 1);
+        refCounts[i] = 0;
+        conMutexes.push_back(std::unique_ptr<boost::recursive_mutex>(
+                                 new boost::recursive_mutex()));
+    }
+}
+
+size_t SQLTable::checkoutConnection() {
+    boost::mutex::scoped_lock lock(poolMutex);
+    const boost::thread::id me = boost::this_thread::get_id();
+    for (size_t i = 0; i < owners.size(); ++i) {
+        if (refCounts[i] > 0 && owners[i] == me) {
+            refCounts[i]++;
+            return i;
+        }
+    }
+    const boost::chrono::steady_clock::time_point deadline =
+        boost::chrono::steady_clock::now() + boost::chrono::seconds(SQL_POOL_TIMEOUT);
+    while (freeConnections.empty()) {
+        if (poolCond.wait_until(lock, deadline) == boost::cv_status::timeout &&
+                freeConnections.empty()) {
+            BOOST_LOG_TRIVIAL(error) << "No connection to the table " << tablename <<
+                                     " was released in " << SQL_POOL_TIMEOUT <<
+                                     " seconds. The pool may be too small";
+            throw 10;
+        }
+    }
+    const size_t idx = freeConnections.back();
+    freeConnections.pop_back();
+    owners[idx] = me;
+    refCounts[idx] = 1;
+    return idx;
+}
+
+void SQLTable::releaseConnection(const size_t idx) {
+    {
+        boost::mutex::scoped_lock lock(poolMutex);
+        if (--refCounts[idx] > 0) {
+            return;
+        }
+        freeConnections.push_back(idx);
+    }
+    poolCond.notify_one();
+}
+
+SQLTable::PooledConnection::PooledConnection(SQLTable *table, bool exclusive) :
+    table(table), idx(table->checkoutConnection()),
+    lock(*table->getConnectionMutex(idx), boost::defer_lock) {
+    if (exclusive) {
+        lock.lock();
+    }
+}
+
+SQLTable::PooledConnection::~PooledConnection() {
+    if (lock.owns_lock()) {
+        lock.unlock();
+    }
+    table->releaseConnection(idx);
+}
+
+string SQLTable::selectToSQLQuery(const string &tablename,
+        const Literal &q,
+        const std::vector<string> &fieldTables,
+        const std::vector<uint8_t> *sortingFieldIdx) {
+    string sqlQuery = "SELECT * FROM " + tablename;
+    string cond = literalConstraintsToSQLQuery(q, fieldTables);
+    string cond1 = repeatedToSQLQuery(q, fieldTables);
+    if (cond1 != "") {
+	if (cond != "") {
+	    cond += " AND ";
+	}
+	cond += cond1;
+    }
+    if (cond != "") {
+        sqlQuery += " WHERE " + cond;
+    }
+
+    //set the order clause
+    if (sortingFieldIdx != NULL && sortingFieldIdx->size() > 0) {
+        string sortString = " ORDER BY ";
+        for (int i = 0; i < sortingFieldIdx->size(); ++i) {
+            if (i != 0)
+                sortString += ",";
+            //Cannot consider the constants
+            int var = sortingFieldIdx->at(i);
+            int j = 0;
+            int idxVar = -1;
+            for(; j < q.getTupleSize(); ++j) {
+                if (q.getTermAtPos(j).isVariable()) {
+                    idxVar++;
+                }
+                if (idxVar == var)
+                    break;
+            }
+            sortString += fieldTables[j];
+        }
+        sqlQuery += sortString;
+    }
+    return sqlQuery;
+}
+
 size_t SQLTable::estimateCardinality(const Literal &query) {
     //TODO: This should be improved
     return getCardinality(query);
@@ -338,3 +699,28 @@ void SQLTable::releaseIterator(EDBIterator *itr) {
     delete itr;
 }
 
+string SQLTable::getSignature() {
+    string sqlQuery = "SELECT COUNT(*)";
+    for (const auto &field : fieldTables) {
+        sqlQuery += ", COALESCE(MIN(" + field + "), 0), COALESCE(MAX(" +
+                    field + "), 0)";
+    }
+    sqlQuery += " FROM " + tablename;
+
+    //The literal only provides the predicate of the iterator
+    VTuple t(1);
+    t.set(VTerm(1, 0), 0);
+    const Literal l(Predicate(0, 0, EDB, 1), t);
+    EDBIterator *itr = executeQuery(sqlQuery, l);
+    string signature;
+    if (itr->hasNext()) {
+        itr->next();
+        signature = to_string(itr->getElementAt(0));
+        for (size_t i = 0; i < 2 * fieldTables.size(); i++) {
+            signature += "," + to_string(itr->getElementAt(i + 1));
+        }
+    }
+    releaseIterator(itr);
+    return signature;
+}
+
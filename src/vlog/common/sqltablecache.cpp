@@ -0,0 +1,157 @@
+#include <vlog/sqltablecache.h>
+#include <vlog/edbiterator.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <functional>
+
+namespace fs = boost::filesystem;
+
+static string getColumnFile(const string &dir, const uint8_t column) {
+    return (fs::path(dir) / ("col" + to_string(column))).string();
+}
+
+SQLTableCache::SQLTableCache(PredId_t predid, std::shared_ptr<SQLTable> table,
+                             string cacheDir, string source) :
+    InmemoryTable(predid), table(table) {
+    string key = source + "/" + table->tablename;
+    for (const auto &field : table->fieldTables) {
+        key += "," + field;
+    }
+    std::stringstream ss;
+    ss << std::hex << std::hash<string>()(key);
+    const string dir = (fs::path(cacheDir) / (table->tablename + "-" +
+                        ss.str())).string();
+
+    signature = table->getSignature();
+    size_t nrows = 0;
+    if (!isValid(dir, key, signature, nrows)) {
+        BOOST_LOG_TRIVIAL(info) << "Copying the table " << table->tablename <<
+                                " in " << dir;
+        snapshot(dir, key, signature);
+        if (!isValid(dir, key, signature, nrows)) {
+            BOOST_LOG_TRIVIAL(error) << "Failed copying the table " <<
+                                     table->tablename << " in " << dir;
+            throw 10;
+        }
+    } else {
+        BOOST_LOG_TRIVIAL(debug) << "Using the copy of the table " <<
+                                 table->tablename << " in " << dir;
+    }
+    map(dir, nrows);
+}
+
+bool SQLTableCache::isValid(const string &dir, const string &key,
+                            const string &signature, size_t &nrows) {
+    std::ifstream ifs((fs::path(dir) / "meta").string());
+    if (!ifs.good()) {
+        return false;
+    }
+    string metaKey, metaSignature;
+    int arity = 0;
+    nrows = 0;
+    string line;
+    while (std::getline(ifs, line)) {
+        const size_t pos = line.find('=');
+        if (pos == string::npos) {
+            continue;
+        }
+        const string name = line.substr(0, pos);
+        const string value = line.substr(pos + 1);
+        if (name == "key") {
+            metaKey = value;
+        } else if (name == "signature") {
+            metaSignature = value;
+        } else if (name == "arity") {
+            arity = std::stoi(value);
+        } else if (name == "rows") {
+            nrows = std::stoull(value);
+        }
+    }
+    if (metaKey != key || metaSignature != signature ||
+            arity != table->fieldTables.size()) {
+        return false;
+    }
+    for (uint8_t i = 0; i < arity; ++i) {
+        const string file = getColumnFile(dir, i);
+        if (!fs::exists(file) || fs::file_size(file) != nrows * sizeof(Term_t)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SQLTableCache::snapshot(const string &dir, const string &key,
+                             const string &signature) {
+    const uint8_t arity = (uint8_t) table->fieldTables.size();
+    if (arity > SIZETUPLE) {
+        BOOST_LOG_TRIVIAL(error) << "Cached tables support at most " << SIZETUPLE << " fields";
+        throw 10;
+    }
+    fs::create_directories(dir);
+    fs::remove(fs::path(dir) / "meta");
+
+    std::vector<std::unique_ptr<std::ofstream>> outs;
+    for (uint8_t i = 0; i < arity; ++i) {
+        outs.push_back(std::unique_ptr<std::ofstream>(new std::ofstream(
+                           getColumnFile(dir, i), std::ios::binary | std::ios::trunc)));
+    }
+
+    //Read the whole table sorted by all the fields
+    VTuple t(arity);
+    std::vector<uint8_t> fields;
+    for (uint8_t i = 0; i < arity; ++i) {
+        t.set(VTerm(i + 1, 0), i);
+        fields.push_back(i);
+    }
+    const Literal l(Predicate(0, 0, EDB, arity), t);
+    EDBIterator *itr = table->getSortedIterator(l, fields);
+    size_t nrows = 0;
+    while (itr->hasNext()) {
+        itr->next();
+        for (uint8_t i = 0; i < arity; ++i) {
+            const Term_t v = itr->getElementAt(i);
+            outs[i]->write((const char*) &v, sizeof(Term_t));
+        }
+        nrows++;
+    }
+    table->releaseIterator(itr);
+    for (auto &out : outs) {
+        out->close();
+        if (out->fail()) {
+            BOOST_LOG_TRIVIAL(error) << "Failed writing the copy of the table " << table->tablename;
+            throw 10;
+        }
+    }
+
+    //The metadata is written last, so that an interrupted copy is not used
+    const string tmpMeta = (fs::path(dir) / "meta.tmp").string();
+    {
+        std::ofstream meta(tmpMeta, std::ios::trunc);
+        meta << "key=" << key << std::endl;
+        meta << "signature=" << signature << std::endl;
+        meta << "arity=" << (int) arity << std::endl;
+        meta << "rows=" << nrows << std::endl;
+    }
+    fs::rename(tmpMeta, fs::path(dir) / "meta");
+}
+
+void SQLTableCache::map(const string &dir, const size_t nrows) {
+    const uint8_t arity = (uint8_t) table->fieldTables.size();
+    const Term_t *columns[SIZETUPLE];
+    files.resize(arity);
+    for (uint8_t i = 0; i < arity; ++i) {
+        columns[i] = NULL;
+        //Empty files cannot be mapped
+        if (nrows > 0) {
+            files[i].open(getColumnFile(dir, i));
+            columns[i] = (const Term_t*) files[i].data();
+        }
+    }
+    setColumns(arity, nrows, columns);
+    BOOST_LOG_TRIVIAL(debug) << "Mapped " << nrows << " rows of the table " << table->tablename;
+}
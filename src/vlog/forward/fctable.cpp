@@ -1,5 +1,6 @@
 #include <vlog/filterer.h>
 #include <vlog/fctable.h>
+#include <vlog/metrics.h>
 #include <vlog/joinprocessor.h>
 #include <vlog/concepts.h>
 
@@ -283,6 +284,7 @@ std::shared_ptr<const Segment> FCTable::retainFrom(
     }
     boost::chrono::duration<double> sec = boost::chrono::system_clock::now() - start;
     BOOST_LOG_TRIVIAL(debug) << "Time retainFrom = " << sec.count() * 1000;
+    Metrics::addTime(Metrics::get().retainMicros, sec);
 
     return t;
 }
@@ -2,6 +2,7 @@
 #include <vlog/joinprocessor.h>
 #include <vlog/seminaiver.h>
 #include <vlog/filterhashjoin.h>
+#include <vlog/metrics.h>
 #include <trident/model/table.h>
 
 #include <google/dense_hash_map>
@@ -657,14 +658,19 @@ void JoinExecutor::join(SemiNaiver * naiver, const FCInternalTable * t1,
                         const int currentLiteral,
                         const int nthreads) {
 
+    boost::chrono::system_clock::time_point start = boost::chrono::system_clock::now();
+    Metrics::JoinAlgo algo;
+
     //First I calculate whether the join is verificative or explorative.
     if (JoinExecutor::isJoinVerificative(t1, plan, currentLiteral)) {
         BOOST_LOG_TRIVIAL(debug) << "Executing verificativeJoin. t1->getNRows()=" << t1->getNRows();
+        algo = Metrics::JOIN_VERIFICATIVE;
         verificativeJoin(naiver, t1, literal, min, max, output, plan,
                          currentLiteral, nthreads);
     } else if (JoinExecutor::isJoinTwoToOneJoin(plan, currentLiteral)) {
         //Is the join of the like (A),(A,B)=>(A|B). Then we can speed up the merge join
         BOOST_LOG_TRIVIAL(debug) << "Executing joinTwoToOne";
+        algo = Metrics::JOIN_TWO_TO_ONE;
         joinTwoToOne(naiver, t1, literal, min, max, output, plan,
                      currentLiteral, nthreads);
     } else {
@@ -676,6 +682,7 @@ void JoinExecutor::join(SemiNaiver * naiver, const FCInternalTable * t1,
                     joinsCoordinates[0].first != joinsCoordinates[0].second ||
                     joinsCoordinates[0].first != 0)) {
             BOOST_LOG_TRIVIAL(debug) << "Executing hashjoin. t1->getNRows()=" << t1->getNRows();
+            algo = Metrics::JOIN_HASH;
             hashjoin(t1, naiver, outputLiteral, literal, min, max, filterValueVars,
                      joinsCoordinates, output,
                      lastLiteral, ruleDetails, plan, processedTables, nthreads);
@@ -684,6 +691,7 @@ void JoinExecutor::join(SemiNaiver * naiver, const FCInternalTable * t1,
 #endif
         } else {
             BOOST_LOG_TRIVIAL(debug) << "Executing mergejoin. t1->getNRows()=" << t1->getNRows();
+            algo = Metrics::JOIN_MERGE;
             mergejoin(t1, naiver, outputLiteral, literal, min, max,
                       joinsCoordinates, output, nthreads);
 #ifdef DEBUG
@@ -691,6 +699,11 @@ void JoinExecutor::join(SemiNaiver * naiver, const FCInternalTable * t1,
 #endif
         }
     }
+
+    Metrics &metrics = Metrics::get();
+    Metrics::add(metrics.joins[algo], 1);
+    Metrics::addTime(metrics.joinMicros[algo],
+                     boost::chrono::system_clock::now() - start);
 }
 
 bool JoinExecutor::isJoinSelective(JoinHashMap & map, const Literal & literal,
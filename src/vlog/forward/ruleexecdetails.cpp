@@ -302,6 +302,25 @@ void RuleExecutionDetails::checkWhetherEDBsRedundantHead(RuleExecutionPlan &p, c
     }
 }
 
+RuleExecutionDetails::RuleExecutionDetails(const RuleExecutionDetails &other) :
+    rule(other.rule), ruleid(other.ruleid), bodyLiterals(other.bodyLiterals),
+    lastExecution(other.lastExecution),
+    failedBecauseEmpty(other.failedBecauseEmpty), atomFailure(NULL),
+    nIDBs(other.nIDBs), orderExecutions(other.orderExecutions),
+    posEDBVarsInHead(other.posEDBVarsInHead),
+    occEDBVarsInHead(other.occEDBVarsInHead),
+    edbLiteralPerHeadVars(other.edbLiteralPerHeadVars) {
+    for (auto &p : orderExecutions) {
+        for (auto &l : p.plan) {
+            l = bodyLiterals.data() + (l - other.bodyLiterals.data());
+        }
+    }
+    if (other.atomFailure != NULL) {
+        atomFailure = bodyLiterals.data() + (other.atomFailure -
+                                             other.bodyLiterals.data());
+    }
+}
+
 void RuleExecutionDetails::createExecutionPlans() {
     //Init
     std::vector<Literal> bl = rule.getBody();
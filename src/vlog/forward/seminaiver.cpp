@@ -4,6 +4,7 @@
 #include <vlog/fctable.h>
 #include <vlog/fcinttable.h>
 #include <vlog/filterer.h>
+#include <vlog/metrics.h>
 #include <trident/model/table.h>
 #include <kognac/consts.h>
 
@@ -77,6 +78,7 @@ string set_to_string(std::unordered_set<int> s) {
 SemiNaiver::SemiNaiver(std::vector<Rule> ruleset, EDBLayer &layer,
                        Program *program, bool opt_intersect, bool opt_filtering,
                        bool multithreaded, int nthreads, bool shuffle) :
+    rulesPrepared(false),
     opt_intersect(opt_intersect),
     opt_filtering(opt_filtering),
     multithreaded(multithreaded),
@@ -195,6 +197,44 @@ SemiNaiver::SemiNaiver(std::vector<Rule> ruleset, EDBLayer &layer,
 }
 
 
+void SemiNaiver::prepareRules() {
+    if (rulesPrepared) {
+        return;
+    }
+    for (std::vector<RuleExecutionDetails>::iterator itr = ruleset.begin(); itr != ruleset.end();
+            ++itr) {
+        BOOST_LOG_TRIVIAL(debug) << "Optimizing rule " << itr->rule.tostring(NULL, NULL);
+        itr->createExecutionPlans();
+        itr->calculateNVarsInHeadFromEDB();
+
+        for (int i = 0; i < itr->orderExecutions.size(); ++i) {
+            string plan = "";
+            for (int j = 0; j < itr->orderExecutions[i].plan.size(); ++j) {
+                plan += string(" ") + itr->orderExecutions[i].plan[j]->tostring(program, &layer);
+            }
+            BOOST_LOG_TRIVIAL(debug) << "-->" << plan;
+        }
+    }
+    for (std::vector<RuleExecutionDetails>::iterator itr = edbRuleset.begin(); itr != edbRuleset.end();
+            ++itr) {
+        itr->createExecutionPlans();
+    }
+    rulesPrepared = true;
+}
+
+void SemiNaiver::copyPreparedRules(const SemiNaiver &other) {
+    //RuleExecutionDetails cannot be assigned
+    ruleset.clear();
+    for (const auto &details : other.ruleset) {
+        ruleset.push_back(details);
+    }
+    edbRuleset.clear();
+    for (const auto &details : other.edbRuleset) {
+        edbRuleset.push_back(details);
+    }
+    rulesPrepared = other.rulesPrepared;
+}
+
 void SemiNaiver::run(size_t lastExecution, size_t it) {
     running = true;
     iteration = it;
@@ -211,24 +251,10 @@ void SemiNaiver::run(size_t lastExecution, size_t it) {
     boost::chrono::system_clock::time_point start = boost::chrono::system_clock::now();
     BOOST_LOG_TRIVIAL(debug) << "Optimizing ruleset...";
 #endif
+    prepareRules();
     for (std::vector<RuleExecutionDetails>::iterator itr = ruleset.begin(); itr != ruleset.end();
             ++itr) {
-        BOOST_LOG_TRIVIAL(debug) << "Optimizing rule " << itr->rule.tostring(NULL, NULL);
-        itr->createExecutionPlans();
-        itr->calculateNVarsInHeadFromEDB();
         itr->lastExecution = lastExecution;
-
-        for (int i = 0; i < itr->orderExecutions.size(); ++i) {
-            string plan = "";
-            for (int j = 0; j < itr->orderExecutions[i].plan.size(); ++j) {
-                plan += string(" ") + itr->orderExecutions[i].plan[j]->tostring(program, &layer);
-            }
-            BOOST_LOG_TRIVIAL(debug) << "-->" << plan;
-        }
-    }
-    for (std::vector<RuleExecutionDetails>::iterator itr = edbRuleset.begin(); itr != edbRuleset.end();
-            ++itr) {
-        itr->createExecutionPlans();
     }
 #if DEBUG
     boost::chrono::duration<double> sec = boost::chrono::system_clock::now() - start;
@@ -247,9 +273,6 @@ void SemiNaiver::run(size_t lastExecution, size_t it) {
     for (auto el : ruleset)
         BOOST_LOG_TRIVIAL(debug) << el.rule.tostring(program, &layer);
 
-    //Used for statistics
-    std::vector<StatIteration> costRules;
-
     if (ruleset.size() > 0) {
         executeUntilSaturation(costRules);
     }
@@ -1023,6 +1046,14 @@ bool SemiNaiver::executeRule(RuleExecutionDetails &ruleDetails,
         boost::chrono::system_clock::now() - startRule;
     double td = totalDuration.count() * 1000;
 
+    Metrics &metrics = Metrics::get();
+    Metrics::add(metrics.rulesExecuted, 1);
+    if (prodDer) {
+        Metrics::add(metrics.rulesProductive, 1);
+        Metrics::add(metrics.derivations, endTable->getNRows(iteration));
+    }
+    Metrics::addTime(metrics.consolidationMicros, durationConsolidation);
+
 #ifdef WEBINTERFACE
     StatsRule stats;
     stats.iteration = iteration;
@@ -1250,6 +1281,25 @@ size_t SemiNaiver::countAllIDBs() {
     return c;
 }
 
+std::vector<StatsSizePredicate> SemiNaiver::getSizePredicates() {
+    std::vector<StatsSizePredicate> out;
+    for (PredId_t i = 0; i < MAX_NPREDS; ++i) {
+#ifdef WEBINTERFACE
+        if (i == currentPredicate) {
+            continue;
+        }
+#endif
+        if (predicatesTables[i] != NULL && program->isPredicateIDB(i)) {
+            StatsSizePredicate s;
+            s.name = program->getPredicateName(i);
+            s.rows = predicatesTables[i]->getNAllRows();
+            s.card = predicatesTables[i]->getSizeRow();
+            out.push_back(s);
+        }
+    }
+    return out;
+}
+
 #ifdef WEBINTERFACE
 std::vector<std::pair<string, std::vector<StatsSizeIDB>>> SemiNaiver::getSizeIDBs() {
     std::vector<std::pair<string, std::vector<StatsSizeIDB>>> out;
@@ -1326,6 +1376,33 @@ size_t SemiNaiver::getCurrentIteration() {
     return iteration;
 }
 
+std::vector<StatsRuleCost> SemiNaiver::getRuleCosts() const {
+    std::vector<StatsRuleCost> out;
+    std::unordered_map<const Rule*, size_t> positions;
+    for (const auto &stat : costRules) {
+        auto itr = positions.find(stat.rule);
+        if (itr == positions.end()) {
+            StatsRuleCost cost;
+            cost.rule = stat.rule;
+            cost.executions = cost.productive = 0;
+            cost.timems = 0;
+            itr = positions.insert(std::make_pair(stat.rule, out.size())).first;
+            out.push_back(cost);
+        }
+        StatsRuleCost &cost = out[itr->second];
+        cost.executions++;
+        if (stat.derived) {
+            cost.productive++;
+        }
+        cost.timems += stat.time;
+    }
+    std::sort(out.begin(), out.end(), [](const StatsRuleCost & a,
+    const StatsRuleCost & b) {
+        return a.timems > b.timems;
+    });
+    return out;
+}
+
 #ifdef WEBINTERFACE
 string SemiNaiver::getCurrentRule() {
     return currentRule;
@@ -0,0 +1,89 @@
+#include <vlog/inmemory/inmemoryiterator.h>
+
+#include <boost/log/trivial.hpp>
+
+InmemoryIterator::InmemoryIterator(const Term_t * const *columns,
+                                   std::shared_ptr<const std::vector<size_t>> idx,
+                                   const size_t start, const size_t end,
+                                   const Literal &query,
+                                   const std::vector<uint8_t> &order) :
+    predid(query.getPredicate().getId()), columns(columns), idx(idx),
+    current(start), nextIdx(start), end(end) {
+    repeated = query.getRepeatedVars();
+    hasNextChecked = false;
+    hasNextValue = false;
+    isFirst = true;
+    skipDuplicatedFirst = false;
+
+    //The first variable in the sort order is the one after the constants
+    posFirstVar = -1;
+    int count = 0;
+    for (int i = 0; i < order.size(); ++i) {
+        if (query.getTermAtPos(order[i]).isVariable()) {
+            count++;
+            if (posFirstVar == -1) {
+                posFirstVar = order[i];
+            }
+        }
+    }
+    if (count <= 1) {
+        // If there is at most one variable, reset posFirstVar to -1, because in that case
+        // skipDuplicatedFirstColumn can be a no-op.
+        posFirstVar = -1;
+    }
+}
+
+bool InmemoryIterator::hasNext() {
+    if (hasNextChecked) {
+        return hasNextValue;
+    }
+    size_t candidate = isFirst ? current : current + 1;
+    while (candidate < end) {
+        const size_t row = (*idx)[candidate];
+        if (!isFirst && skipDuplicatedFirst &&
+                columns[posFirstVar][row] ==
+                columns[posFirstVar][(*idx)[current]]) {
+            candidate++;
+            continue;
+        }
+        bool valid = true;
+        for (const auto &r : repeated) {
+            if (columns[r.first][row] != columns[r.second][row]) {
+                valid = false;
+                break;
+            }
+        }
+        if (valid) {
+            break;
+        }
+        candidate++;
+    }
+    nextIdx = candidate;
+    hasNextValue = candidate < end;
+    hasNextChecked = true;
+    return hasNextValue;
+}
+
+void InmemoryIterator::next() {
+    if (! hasNextChecked) {
+        BOOST_LOG_TRIVIAL(error) << "InmemoryIterator::next called without hasNext check";
+        throw 10;
+    }
+    current = nextIdx;
+    isFirst = false;
+    hasNextChecked = false;
+}
+
+void InmemoryIterator::clear() {
+    idx.reset();
+}
+
+void InmemoryIterator::skipDuplicatedFirstColumn() {
+    if (posFirstVar != -1) {
+        skipDuplicatedFirst = true;
+    }
+}
+
+Term_t InmemoryIterator::getElementAt(const uint8_t p) {
+    return columns[p][(*idx)[current]];
+}
@@ -0,0 +1,793 @@
+#include <vlog/inmemory/inmemorytable.h>
+#include <vlog/inmemory/inmemoryiterator.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstring>
+
+namespace fs = boost::filesystem;
+
+//Size of the portions of the input that are parsed by a single task
+#define INMEMORY_CHUNK_SIZE (4 * 1024 * 1024)
+
+struct InmemoryChunk {
+    const char *begin;
+    const char *end;
+    int arity;
+    size_t nrows;
+    std::vector<Term_t> values; //row-major, encoded with the local dictionary
+    std::unique_ptr<Dictionary> dict;
+    std::vector<Term_t> localToGlobal;
+    //Line of the chunk with an empty field, or NULL
+    const char *emptyField;
+
+    InmemoryChunk(const char *begin, const char *end) : begin(begin),
+        end(end), arity(-1), nrows(0), emptyField(NULL) {
+    }
+};
+
+//Reads the CSV field that starts with a quote. Returns false if the field
+//does not end with a quote followed by the separator or by the end of the line
+static bool readQuotedField(const char *field, const char *endContent,
+                            const char separator, std::string &value,
+                            const char *&endField) {
+    value.clear();
+    const char *c = field + 1;
+    while (c < endContent) {
+        if (*c == '"') {
+            if (c + 1 < endContent && c[1] == '"') {
+                value.push_back('"');
+                c += 2;
+                continue;
+            }
+            c++;
+            if (c == endContent || *c == separator) {
+                endField = c;
+                return true;
+            }
+            return false;
+        }
+        value.push_back(*c);
+        c++;
+    }
+    return false;
+}
+
+struct ParseChunks {
+    std::vector<InmemoryChunk> &chunks;
+    const std::vector<char> &separators;
+
+    ParseChunks(std::vector<InmemoryChunk> &chunks,
+                const std::vector<char> &separators) : chunks(chunks),
+        separators(separators) {
+    }
+
+    void operator()(const tbb::blocked_range<size_t>& r) const {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            InmemoryChunk &chunk = chunks[i];
+            const char separator = separators[i];
+            chunk.dict = std::unique_ptr<Dictionary>(new Dictionary((uint64_t) 0));
+            const char *line = chunk.begin;
+            while (line < chunk.end) {
+                const char *endLine = (const char*) memchr(line, '\n',
+                                      chunk.end - line);
+                if (endLine == NULL) {
+                    endLine = chunk.end;
+                }
+                const char *endContent = endLine;
+                if (endContent > line && endContent[-1] == '\r') {
+                    endContent--;
+                }
+                if (endContent > line) {
+                    int fields = 0;
+                    const char *field = line;
+                    std::string value;
+                    while (true) {
+                        const char *endField;
+                        if (separator != ',' || field == endContent ||
+                                *field != '"' ||
+                                !readQuotedField(field, endContent, separator,
+                                                 value, endField)) {
+                            endField = (const char*) memchr(field, separator,
+                                                            endContent - field);
+                            if (endField == NULL) {
+                                endField = endContent;
+                            }
+                            value.assign(field, endField - field);
+                        }
+                        if (value.empty()) {
+                            //Reported later
+                            if (chunk.emptyField == NULL) {
+                                chunk.emptyField = line;
+                            }
+                            value = " ";
+                        }
+                        chunk.values.push_back(chunk.dict->getOrAdd(value));
+                        fields++;
+                        if (endField == endContent) {
+                            break;
+                        }
+                        field = endField + 1;
+                    }
+                    if (chunk.arity == -1) {
+                        chunk.arity = fields;
+                    } else if (chunk.arity != fields) {
+                        //Inconsistent number of fields. Reported later.
+                        chunk.arity = 0;
+                    }
+                    chunk.nrows++;
+                }
+                line = endLine + 1;
+            }
+        }
+    }
+};
+
+struct EncodeChunks {
+    std::vector<InmemoryChunk> &chunks;
+    const std::vector<size_t> &offsets;
+    std::vector<Term_t> *columns;
+
+    EncodeChunks(std::vector<InmemoryChunk> &chunks,
+                 const std::vector<size_t> &offsets,
+                 std::vector<Term_t> *columns) : chunks(chunks),
+        offsets(offsets), columns(columns) {
+    }
+
+    void operator()(const tbb::blocked_range<size_t>& r) const {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            InmemoryChunk &chunk = chunks[i];
+            size_t row = offsets[i];
+            std::vector<Term_t>::const_iterator itr = chunk.values.begin();
+            for (size_t j = 0; j < chunk.nrows; ++j) {
+                for (int c = 0; c < chunk.arity; ++c) {
+                    columns[c][row] = chunk.localToGlobal[*itr];
+                    itr++;
+                }
+                row++;
+            }
+            std::vector<Term_t>().swap(chunk.values);
+        }
+    }
+};
+
+struct InmemoryRowComparator {
+    const Term_t * const *columns;
+    const std::vector<uint8_t> &order;
+
+    InmemoryRowComparator(const Term_t * const *columns,
+                          const std::vector<uint8_t> &order) :
+        columns(columns), order(order) {
+    }
+
+    bool operator()(const size_t r1, const size_t r2) const {
+        for (uint8_t i = 0; i < order.size(); ++i) {
+            const Term_t v1 = columns[order[i]][r1];
+            const Term_t v2 = columns[order[i]][r2];
+            if (v1 != v2) {
+                return v1 < v2;
+            }
+        }
+        return false;
+    }
+};
+
+char InmemoryTable::getSeparator(const string &file, const string &param) {
+    if (param == "tab") {
+        return '\t';
+    } else if (param == "comma") {
+        return ',';
+    } else if (param.size() == 1) {
+        return param[0];
+    } else if (param != "") {
+        BOOST_LOG_TRIVIAL(error) << "Separator " << param << " is not supported";
+        throw 10;
+    }
+    return fs::extension(file) == ".tsv" ? '\t' : ',';
+}
+
+InmemoryTable::InmemoryTable(PredId_t predid, string repository,
+                             string tablename, string separator,
+                             std::shared_ptr<Dictionary> dict) :
+    predid(predid), arity(0), nrows(0), dict(dict) {
+    //Collect the files to load
+    std::vector<string> files;
+    fs::path path = fs::path(repository) / tablename;
+    if (fs::is_directory(path)) {
+        for (fs::directory_iterator itr(path); itr != fs::directory_iterator();
+                ++itr) {
+            if (fs::is_regular_file(itr->path())) {
+                files.push_back(itr->path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+    } else if (fs::exists(path)) {
+        files.push_back(path.string());
+    } else if (fs::exists(path.string() + ".csv")) {
+        files.push_back(path.string() + ".csv");
+    } else if (fs::exists(path.string() + ".tsv")) {
+        files.push_back(path.string() + ".tsv");
+    }
+    if (files.empty()) {
+        BOOST_LOG_TRIVIAL(error) << "The table " << path.string() <<
+                                 " does not exist. Check the edb.conf file.";
+        throw 10;
+    }
+    for (const auto &file : files) {
+        boost::system::error_code ec;
+        const uintmax_t size = fs::file_size(file, ec);
+        const std::time_t lastWrite = fs::last_write_time(file, ec);
+        if (!ec) {
+            version += to_string(size) + "/" + to_string(lastWrite) + ";";
+        }
+    }
+    load(files, separator);
+}
+
+InmemoryTable::InmemoryTable(PredId_t predid) : predid(predid), arity(0),
+    nrows(0) {
+}
+
+void InmemoryTable::setColumns(const uint8_t arity, const size_t nrows,
+                               const Term_t * const *columns) {
+    this->arity = arity;
+    this->nrows = nrows;
+    for (uint8_t i = 0; i < arity; ++i) {
+        this->columns[i] = columns[i];
+    }
+}
+
+void InmemoryTable::load(const std::vector<string> &files,
+                         const string &separator) {
+    //Read the files and split them in chunks that end with a newline
+    std::vector<std::string> contents(files.size());
+    std::vector<InmemoryChunk> chunks;
+    std::vector<char> separators;
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::ifstream ifs(files[i], std::ios::binary);
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        contents[i] = ss.str();
+        const char sep = getSeparator(files[i], separator);
+        const char *start = contents[i].c_str();
+        const char *end = start + contents[i].size();
+        while (start < end) {
+            const char *chunkEnd = start + INMEMORY_CHUNK_SIZE;
+            if (chunkEnd >= end) {
+                chunkEnd = end;
+            } else {
+                chunkEnd = (const char*) memchr(chunkEnd, '\n', end - chunkEnd);
+                chunkEnd = chunkEnd == NULL ? end : chunkEnd + 1;
+            }
+            chunks.push_back(InmemoryChunk(start, chunkEnd));
+            separators.push_back(sep);
+            start = chunkEnd;
+        }
+    }
+
+    //Parse the chunks in parallel, each with its own dictionary
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size(), 1),
+                      ParseChunks(chunks, separators));
+    for (const auto &chunk : chunks) {
+        if (chunk.emptyField != NULL) {
+            const char *endLine = (const char*) memchr(chunk.emptyField, '\n',
+                                  chunk.end - chunk.emptyField);
+            BOOST_LOG_TRIVIAL(error) << "The in-memory tables do not support empty fields: " <<
+                                     std::string(chunk.emptyField, endLine == NULL ?
+                                             chunk.end - chunk.emptyField :
+                                             endLine - chunk.emptyField);
+            throw 10;
+        }
+    }
+    std::vector<std::string>().swap(contents);
+
+    //Check the arity and compute the offset of every chunk
+    std::vector<size_t> offsets;
+    for (const auto &chunk : chunks) {
+        offsets.push_back(nrows);
+        if (chunk.nrows == 0) {
+            continue;
+        }
+        if (chunk.arity <= 0 || (arity != 0 && chunk.arity != arity)) {
+            BOOST_LOG_TRIVIAL(error) << "The rows of the in-memory table do not have the same number of fields";
+            throw 10;
+        }
+        if (chunk.arity > SIZETUPLE) {
+            BOOST_LOG_TRIVIAL(error) << "In-memory tables support at most " << SIZETUPLE << " fields";
+            throw 10;
+        }
+        arity = chunk.arity;
+        nrows += chunk.nrows;
+    }
+
+    //Merge the local dictionaries in the global one
+    for (auto &chunk : chunks) {
+        chunk.localToGlobal.resize(chunk.dict->size());
+        for (const auto &el : chunk.dict->getMap()) {
+            chunk.localToGlobal[el.second] = dict->getOrAdd(el.first);
+        }
+        chunk.dict.reset();
+    }
+
+    //Write the columns
+    for (uint8_t i = 0; i < arity; ++i) {
+        ownedColumns[i].resize(nrows);
+        columns[i] = ownedColumns[i].data();
+    }
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size(), 1),
+                      EncodeChunks(chunks, offsets, ownedColumns));
+    BOOST_LOG_TRIVIAL(debug) << "Loaded in-memory table with " << nrows <<
+                             " rows and " << (int) arity << " columns";
+}
+
+std::vector<uint8_t> InmemoryTable::getSortOrder(const Literal &query,
+        const std::vector<uint8_t> &posFields) const {
+    if (query.getTupleSize() != arity) {
+        BOOST_LOG_TRIVIAL(error) << "Literal " << query.tostring() <<
+                                 " does not match the arity of the table";
+        throw 10;
+    }
+    //First the constants, then the requested fields and then the remaining
+    //variables
+    std::vector<uint8_t> order;
+    for (uint8_t i = 0; i < arity; ++i) {
+        if (!query.getTermAtPos(i).isVariable()) {
+            order.push_back(i);
+        }
+    }
+    for (const auto pos : posFields) {
+        if (std::find(order.begin(), order.end(), pos) == order.end()) {
+            order.push_back(pos);
+        }
+    }
+    for (uint8_t i = 0; i < arity; ++i) {
+        if (std::find(order.begin(), order.end(), i) == order.end()) {
+            order.push_back(i);
+        }
+    }
+    return order;
+}
+
+std::shared_ptr<const std::vector<size_t>> InmemoryTable::getSortedIdx(
+            const std::vector<uint8_t> &order) {
+    boost::mutex::scoped_lock lock(mutex);
+    auto itr = sortedIdxs.find(order);
+    if (itr != sortedIdxs.end()) {
+        return itr->second;
+    }
+    std::vector<size_t> *idx = new std::vector<size_t>();
+    idx->reserve(nrows);
+    for (size_t i = 0; i < nrows; ++i) {
+        idx->push_back(i);
+    }
+    InmemoryRowComparator cmp(columns, order);
+    //The rows might already be stored in this order
+    if (!std::is_sorted(idx->begin(), idx->end(), cmp)) {
+        if (nrows > 1000) {
+            tbb::parallel_sort(idx->begin(), idx->end(), cmp);
+        } else {
+            std::sort(idx->begin(), idx->end(), cmp);
+        }
+    }
+    std::shared_ptr<const std::vector<size_t>> ptr(idx);
+    sortedIdxs.insert(std::make_pair(order, ptr));
+    return ptr;
+}
+
+std::pair<size_t, size_t> InmemoryTable::getRange(const Literal &query,
+        const std::vector<uint8_t> &order,
+        const std::vector<size_t> &idx) const {
+    //The constants are at the beginning of the sort order
+    uint8_t nconsts = 0;
+    Term_t values[SIZETUPLE];
+    while (nconsts < order.size() &&
+            !query.getTermAtPos(order[nconsts]).isVariable()) {
+        values[nconsts] = query.getTermAtPos(order[nconsts]).getValue();
+        nconsts++;
+    }
+    if (nconsts == 0) {
+        return std::make_pair((size_t) 0, idx.size());
+    }
+    const Term_t * const *cols = columns;
+    auto lower = std::lower_bound(idx.begin(), idx.end(), values,
+    [cols, &order, nconsts](const size_t row, const Term_t *v) {
+        for (uint8_t i = 0; i < nconsts; ++i) {
+            const Term_t t = cols[order[i]][row];
+            if (t != v[i]) {
+                return t < v[i];
+            }
+        }
+        return false;
+    });
+    auto upper = std::upper_bound(lower, idx.end(), values,
+    [cols, &order, nconsts](const Term_t *v, const size_t row) {
+        for (uint8_t i = 0; i < nconsts; ++i) {
+            const Term_t t = cols[order[i]][row];
+            if (t != v[i]) {
+                return v[i] < t;
+            }
+        }
+        return false;
+    });
+    return std::make_pair((size_t) (lower - idx.begin()),
+                          (size_t) (upper - idx.begin()));
+}
+
+InmemoryIterator *InmemoryTable::getInmemoryIterator(const Literal &query,
+        const std::vector<uint8_t> &posFields) {
+    std::vector<uint8_t> order = getSortOrder(query, posFields);
+    std::shared_ptr<const std::vector<size_t>> idx = getSortedIdx(order);
+    std::pair<size_t, size_t> range = getRange(query, order, *idx);
+    return new InmemoryIterator(columns, idx, range.first, range.second,
+                                query, order);
+}
+
+bool InmemoryTable::exists(const Literal &query) {
+    std::unique_ptr<InmemoryIterator> itr(getInmemoryIterator(query,
+                                          std::vector<uint8_t>()));
+    return itr->hasNext();
+}
+
+std::vector<std::shared_ptr<Column>> InmemoryTable::checkNewIn(
+                                      const Literal &l1,
+                                      std::vector<uint8_t> &posInL1,
+                                      const Literal &l2,
+std::vector<uint8_t> &posInL2) {
+    std::vector<uint8_t> posVars1 = l1.getPosVars();
+    std::vector<uint8_t> fields1;
+    for (const auto p : posInL1) {
+        fields1.push_back(posVars1[p]);
+    }
+    std::vector<uint8_t> posVars2 = l2.getPosVars();
+    std::vector<uint8_t> fields2;
+    for (const auto p : posInL2) {
+        fields2.push_back(posVars2[p]);
+    }
+    std::unique_ptr<InmemoryIterator> itr1(getInmemoryIterator(l1, fields1));
+    std::unique_ptr<InmemoryIterator> itr2(getInmemoryIterator(l2, fields2));
+
+    std::vector<std::shared_ptr<ColumnWriter>> cols;
+    for (uint8_t i = 0; i < fields1.size(); ++i) {
+        cols.push_back(std::shared_ptr<ColumnWriter>(new ColumnWriter()));
+    }
+
+    //Output the (distinct) tuples of l1 that do not appear in l2
+    const uint8_t n = (uint8_t) fields1.size();
+    Term_t prev[SIZETUPLE];
+    bool isFirst = true;
+    bool has2 = itr2->hasNext();
+    if (has2) {
+        itr2->next();
+    }
+    while (itr1->hasNext()) {
+        itr1->next();
+        Term_t cv[SIZETUPLE];
+        for (uint8_t i = 0; i < n; ++i) {
+            cv[i] = itr1->getElementAt(fields1[i]);
+        }
+        if (!isFirst && ReasoningUtils::cmp(cv, prev, n) == 0) {
+            continue;
+        }
+        isFirst = false;
+        for (uint8_t i = 0; i < n; ++i) {
+            prev[i] = cv[i];
+        }
+        int cmp = -1;
+        while (has2) {
+            cmp = 0;
+            for (uint8_t i = 0; i < n; ++i) {
+                const Term_t v2 = itr2->getElementAt(fields2[i]);
+                if (v2 != prev[i]) {
+                    cmp = v2 < prev[i] ? -1 : 1;
+                    break;
+                }
+            }
+            if (cmp >= 0) {
+                break;
+            }
+            has2 = itr2->hasNext();
+            if (has2) {
+                itr2->next();
+            }
+        }
+        if (!has2 || cmp != 0) {
+            for (uint8_t i = 0; i < n; ++i) {
+                cols[i]->add(prev[i]);
+            }
+        }
+    }
+
+    std::vector<std::shared_ptr<Column>> output;
+    for (auto &writer : cols) {
+        output.push_back(writer->getColumn());
+    }
+    return output;
+}
+
+std::vector<std::shared_ptr<Column>> InmemoryTable::checkNewIn(
+                                      std::vector <
+                                      std::shared_ptr<Column >> &checkValues,
+                                      const Literal &l,
+std::vector<uint8_t> &posInL) {
+    std::vector<uint8_t> posVars = l.getPosVars();
+    std::vector<uint8_t> fields;
+    for (const auto p : posInL) {
+        fields.push_back(posVars[p]);
+    }
+    std::unique_ptr<InmemoryIterator> itr(getInmemoryIterator(l, fields));
+
+    const uint8_t n = (uint8_t) checkValues.size();
+    std::vector<std::unique_ptr<ColumnReader>> readers;
+    std::vector<std::shared_ptr<ColumnWriter>> cols;
+    for (uint8_t i = 0; i < n; ++i) {
+        readers.push_back(checkValues[i]->getReader());
+        cols.push_back(std::shared_ptr<ColumnWriter>(new ColumnWriter()));
+    }
+
+    //Output the (distinct) values to check that do not appear in l
+    Term_t prev[SIZETUPLE];
+    Term_t cv[SIZETUPLE];
+    bool isFirst = true;
+    bool hasItr = itr->hasNext();
+    if (hasItr) {
+        itr->next();
+    }
+    while (true) {
+        bool hasValue = true;
+        for (uint8_t i = 0; i < n; ++i) {
+            if (!readers[i]->hasNext()) {
+                hasValue = false;
+                break;
+            }
+            cv[i] = readers[i]->next();
+        }
+        if (!hasValue) {
+            break;
+        }
+        if (!isFirst && ReasoningUtils::cmp(cv, prev, n) == 0) {
+            continue;
+        }
+        isFirst = false;
+        for (uint8_t i = 0; i < n; ++i) {
+            prev[i] = cv[i];
+        }
+        int cmp = -1;
+        while (hasItr) {
+            cmp = 0;
+            for (uint8_t i = 0; i < n; ++i) {
+                const Term_t v = itr->getElementAt(fields[i]);
+                if (v != cv[i]) {
+                    cmp = v < cv[i] ? -1 : 1;
+                    break;
+                }
+            }
+            if (cmp >= 0) {
+                break;
+            }
+            hasItr = itr->hasNext();
+            if (hasItr) {
+                itr->next();
+            }
+        }
+        if (!hasItr || cmp != 0) {
+            for (uint8_t i = 0; i < n; ++i) {
+                cols[i]->add(cv[i]);
+            }
+        }
+    }
+
+    std::vector<std::shared_ptr<Column>> output;
+    for (auto &writer : cols) {
+        output.push_back(writer->getColumn());
+    }
+    return output;
+}
+
+std::shared_ptr<Column> InmemoryTable::checkIn(
+    std::vector<Term_t> &values,
+    const Literal &l,
+    uint8_t posInL,
+    size_t &sizeOutput) {
+    std::vector<uint8_t> posVars = l.getPosVars();
+    const uint8_t varIndex = posVars[posInL];
+    std::vector<uint8_t> fields;
+    fields.push_back(varIndex);
+    std::unique_ptr<InmemoryIterator> itr(getInmemoryIterator(l, fields));
+    itr->skipDuplicatedFirstColumn();
+
+    //Output
+    std::unique_ptr<ColumnWriter> col(new ColumnWriter());
+    size_t idx1 = 0;
+    sizeOutput = 0;
+    while (idx1 < values.size() && itr->hasNext()) {
+        itr->next();
+        const Term_t v2 = itr->getElementAt(varIndex);
+        while (idx1 < values.size() && values[idx1] < v2) {
+            idx1++;
+        }
+        if (idx1 < values.size() && values[idx1] == v2) {
+            col->add(v2);
+            sizeOutput++;
+            while (idx1 < values.size() && values[idx1] == v2) {
+                idx1++;
+            }
+        }
+    }
+    return col->getColumn();
+}
+
+void InmemoryTable::query(QSQQuery *query, TupleTable *outputTable,
+                          std::vector<uint8_t> *posToFilter,
+                          std::vector<Term_t> *valuesToFilter) {
+    const Literal *l = query->getLiteral();
+    const uint8_t npos = query->getNPosToCopy();
+    uint8_t *pos = query->getPosToCopy();
+    uint64_t row[SIZETUPLE];
+
+    if (posToFilter == NULL || posToFilter->size() == 0) {
+        std::unique_ptr<InmemoryIterator> itr(getInmemoryIterator(*l,
+                                              std::vector<uint8_t>()));
+        while (itr->hasNext()) {
+            itr->next();
+            for (uint8_t i = 0; i < npos; ++i) {
+                row[i] = itr->getElementAt(pos[i]);
+            }
+            outputTable->addRow(row);
+        }
+        return;
+    }
+
+    //Collect the distinct tuples to filter and do a lookup for each of them
+    const size_t nfilter = posToFilter->size();
+    std::vector<std::vector<Term_t>> filters;
+    for (size_t i = 0; i + nfilter <= valuesToFilter->size(); i += nfilter) {
+        filters.push_back(std::vector<Term_t>(valuesToFilter->begin() + i,
+                                              valuesToFilter->begin() + i + nfilter));
+    }
+    std::sort(filters.begin(), filters.end());
+    auto last = std::unique(filters.begin(), filters.end());
+
+    for (auto itrFilter = filters.begin(); itrFilter != last; ++itrFilter) {
+        VTuple t = l->getTuple();
+        for (size_t i = 0; i < nfilter; ++i) {
+            t.set(VTerm(0, (*itrFilter)[i]), posToFilter->at(i));
+        }
+        const Literal filtered(l->getPredicate(), t);
+        std::unique_ptr<InmemoryIterator> itr(getInmemoryIterator(filtered,
+                                              std::vector<uint8_t>()));
+        while (itr->hasNext()) {
+            itr->next();
+            bool valid = true;
+            for (size_t i = 0; i < nfilter && valid; ++i) {
+                //Repeated variables must be consistent with the filter
+                const VTerm term = l->getTermAtPos(posToFilter->at(i));
+                for (uint8_t j = 0; j < arity; ++j) {
+                    if (l->getTermAtPos(j).isVariable() &&
+                            l->getTermAtPos(j).getId() == term.getId() &&
+                            itr->getElementAt(j) != (*itrFilter)[i]) {
+                        valid = false;
+                        break;
+                    }
+                }
+            }
+            if (!valid) {
+                continue;
+            }
+            for (uint8_t i = 0; i < npos; ++i) {
+                row[i] = itr->getElementAt(pos[i]);
+            }
+            outputTable->addRow(row);
+        }
+    }
+}
+
+size_t InmemoryTable::estimateCardinality(const Literal &query) {
+    std::vector<uint8_t> order = getSortOrder(query, std::vector<uint8_t>());
+    if (query.getNVars() == query.getTupleSize()) {
+        return nrows;
+    }
+    std::shared_ptr<const std::vector<size_t>> idx = getSortedIdx(order);
+    std::pair<size_t, size_t> range = getRange(query, order, *idx);
+    return range.second - range.first;
+}
+
+size_t InmemoryTable::getCardinality(const Literal &query) {
+    if (!query.hasRepeatedVars()) {
+        return estimateCardinality(query);
+    }
+    std::unique_ptr<InmemoryIterator> itr(getInmemoryIterator(query,
+                                          std::vector<uint8_t>()));
+    size_t count = 0;
+    while (itr->hasNext()) {
+        itr->next();
+        count++;
+    }
+    return count;
+}
+
+size_t InmemoryTable::getCardinalityColumn(const Literal &query,
+        uint8_t posColumn) {
+    if (!query.getTermAtPos(posColumn).isVariable()) {
+        return exists(query) ? 1 : 0;
+    }
+    std::vector<uint8_t> fields;
+    fields.push_back(posColumn);
+    std::unique_ptr<InmemoryIterator> itr(getInmemoryIterator(query, fields));
+    itr->skipDuplicatedFirstColumn();
+    size_t count = 0;
+    Term_t prev = 0;
+    while (itr->hasNext()) {
+        itr->next();
+        const Term_t v = itr->getElementAt(posColumn);
+        if (count == 0 || v != prev) {
+            count++;
+            prev = v;
+        }
+    }
+    return count;
+}
+
+bool InmemoryTable::isEmpty(const Literal &query,
+                            std::vector<uint8_t> *posToFilter,
+                            std::vector<Term_t> *valuesToFilter) {
+    if (posToFilter == NULL || posToFilter->size() == 0) {
+        return !exists(query);
+    }
+    //Replace variables with constants
+    VTuple t = query.getTuple();
+    for (int i = 0; i < posToFilter->size(); ++i) {
+        t.set(VTerm(0, valuesToFilter->at(i)), posToFilter->at(i));
+    }
+    const Literal filtered(query.getPredicate(), t);
+    return !exists(filtered);
+}
+
+EDBIterator *InmemoryTable::getIterator(const Literal &query) {
+    return getInmemoryIterator(query, std::vector<uint8_t>());
+}
+
+EDBIterator *InmemoryTable::getSortedIterator(const Literal &query,
+        const std::vector<uint8_t> &fields) {
+    //fields contains the indices of the variables, not their positions
+    std::vector<uint8_t> posVars = query.getPosVars();
+    std::vector<uint8_t> posFields;
+    for (const auto f : fields) {
+        posFields.push_back(posVars[f]);
+    }
+    return getInmemoryIterator(query, posFields);
+}
+
+void InmemoryTable::releaseIterator(EDBIterator *itr) {
+    delete itr;
+}
+
+bool InmemoryTable::getDictNumber(const char *text, const size_t sizeText,
+                                  uint64_t &id) {
+    auto itr = dict->getMap().find(std::string(text, sizeText));
+    if (itr == dict->getMap().end()) {
+        return false;
+    }
+    id = itr->second;
+    return true;
+}
+
+bool InmemoryTable::getDictText(const uint64_t id, char *text) {
+    if (id >= dict->size()) {
+        return false;
+    }
+    std::string value = dict->getRawValue(id);
+    memcpy(text, value.c_str(), value.size());
+    text[value.size()] = 0;
+    return true;
+}
+
+uint64_t InmemoryTable::getNTerms() {
+    return dict->size();
+}
@@ -3,193 +3,64 @@
 
 #include <stdio.h>
 
-MAPIIterator::MAPIIterator(Mapi con, string tableName,
+MAPIIterator::MAPIIterator(MAPITable *table,
 	const Literal &query,
-	const std::vector<string> &fieldsTable,
-	const std::vector<uint8_t> *sortingFieldIdx) {
-    predid = query.getPredicate().getId();
-    isFirst = true;
-    posFirstVar = -1;
-    skipDuplicatedFirst = false;
-
-    string projections = "*";
-    /*
-    if (query.getNVars() == query.getTupleSize()) {
-	projections = "*";
-    } else {
-	for (int i = 0; i < query.getTupleSize(); ++i) {
-	    if (query.getTermAtPos(i).isVariable()) {
-		if (projections != "")
-		    projections += ",";
-		projections += fieldsTable[i];
-	    }
-	}
-    }
-    */
-
-    //Read the query
-    string sqlQuery = "SELECT " + projections + " FROM " + tableName;
-    string cond = SQLTable::literalConstraintsToSQLQuery(query, fieldsTable);
-    if (cond != "") {
-	sqlQuery += " WHERE " + cond;
-    }
-
-    string cond1 = SQLTable::repeatedToSQLQuery(query, fieldsTable);
-    if (cond1 != "") {
-	if (cond != "") {
-	    sqlQuery += " AND ";
-	}
-	sqlQuery += cond1;
-    }
-
-    //set the order clause
-    if (sortingFieldIdx != NULL && sortingFieldIdx->size() > 0) {
-	string sortString = " ORDER BY ";
-	for (int i = 0; i < sortingFieldIdx->size(); ++i) {
-	    if (i != 0)
-		sortString += ",";
-	    //Cannot consider the constants
-	    int var = sortingFieldIdx->at(i);
-	    int j = 0;
-	    int idxVar = -1;
-	    for(; j < query.getTupleSize(); ++j) {
-		if (query.getTermAtPos(j).isVariable()) {
-		    idxVar++;
-		}
-		if (idxVar == var)
-		    break;
-	    }
-	    sortString += fieldsTable[j];
-	    if (posFirstVar == -1) {
-		posFirstVar = j;
-	    }
-	}
-	sqlQuery += sortString;
-    }
-
-    int count = 0;
-    for (int i = 0; i < query.getTupleSize(); ++i) {
-	if (query.getTermAtPos(i).isVariable()) {
-	    count++;
-	    if (posFirstVar == -1) {
-		posFirstVar = i;
-	    }
-	}
-    }
-    if (count <= 1) {
-	// If there is at most one variable, reset posFirstVar to -1, because in that case 
-	// skipDuplicatedFirstColumn can be a no-op.
-	posFirstVar = -1;
-    }
-
-    BOOST_LOG_TRIVIAL(debug) << "SQL query: " << sqlQuery;
-
-    handle = MAPITable::doquery(con, sqlQuery);
-
-    columns = fieldsTable.size();
-    values = new uint64_t[columns];
-    for (int i = 0; i < columns; i++) {
-	mapi_bind_var(handle, i, MAPI_ULONGLONG, &values[i]); 
-    }
-    hasNextChecked = false;
+	const std::vector<uint8_t> *sortingFieldIdx) :
+    SQLIterator(query, table), values(NULL) {
+    initPosFirstVar(query, sortingFieldIdx);
+    init(table->getConnection(connection),
+	    SQLTable::selectToSQLQuery(table->tablename, query,
+		table->fieldTables, sortingFieldIdx));
 }
 
+MAPIIterator::MAPIIterator(MAPITable *table,
+	string sqlQuery,
+	const Literal &query) :
+    SQLIterator(query, table), values(NULL) {
+    initPosFirstVar(query, NULL);
+    init(table->getConnection(connection), sqlQuery);
+}
 
-MAPIIterator::MAPIIterator(Mapi con, string sqlQuery,
-	const std::vector<string> &fieldsTable,
-	const Literal &query) {
-    predid = query.getPredicate().getId();
-    isFirst = true;
-    posFirstVar = -1;
-    skipDuplicatedFirst = false;
-
-    int count = 0;
-    for (int i = 0; i < query.getTupleSize(); ++i) {
-	if (query.getTermAtPos(i).isVariable()) {
-	    count++;
-	    if (posFirstVar == -1) {
-		posFirstVar = i;
-	    }
-	}
-    }
-    if (count <= 1) {
-	// If there is at most one variable, reset posFirstVar to -1, because in that case 
-	// skipDuplicatedFirstColumn can be a no-op.
-	posFirstVar = -1;
-    }
-
+void MAPIIterator::init(Mapi con, string sqlQuery) {
     BOOST_LOG_TRIVIAL(debug) << "SQL query: " << sqlQuery;
 
+    boost::recursive_mutex::scoped_lock lock(*conMutex);
     handle = MAPITable::doquery(con, sqlQuery);
 
-    columns = fieldsTable.size();
+    columns = mapi_get_field_count(handle);
     values = new uint64_t[columns];
     for (int i = 0; i < columns; i++) {
 	mapi_bind_var(handle, i, MAPI_ULONGLONG, &values[i]); 
     }
-    hasNextChecked = false;
+    startFetching(columns);
 }
 
-
-
-bool MAPIIterator::hasNext() {
-    if (hasNextChecked) {
-	return hasNextValue;
-    }
-    if (isFirst || ! skipDuplicatedFirst) {
-	hasNextValue = mapi_fetch_row(handle) != 0;
-    } else {
-	Term_t oldval = getElementAt(posFirstVar);
-	bool stop = false;
-	while (! stop) {
-	    hasNextValue = mapi_fetch_row(handle) != 0;
-	    if (hasNextValue) {
-		if (getElementAt(posFirstVar) != oldval) {
-		    stop = true;
-		}
-	    } else {
-		break;
-	    }
+size_t MAPIIterator::fetchRows(std::vector<std::vector<Term_t>> &output,
+	const size_t maxRows) {
+    size_t n = 0;
+    while (n < maxRows && mapi_fetch_row(handle) != 0) {
+	for (int i = 0; i < columns; i++) {
+	    output[i].push_back(values[i]);
 	}
-	hasNextValue = stop;
-    }
-    hasNextChecked = true;
-    // BOOST_LOG_TRIVIAL(debug) << "MAPIIterator::hasNext(): skipDuplicatedFirst = " << skipDuplicatedFirst << ", returns " << hasNextValue;
-    return hasNextValue;
-}
-
-void MAPIIterator::next() {
-    if (! hasNextChecked) {
-	BOOST_LOG_TRIVIAL(error) << "MAPIIterator::next called without hasNext check";
-	throw 10;
-    }
-    // BOOST_LOG_TRIVIAL(debug) << "MAPIIterator::next()";
-    if (isFirst) {
-	isFirst = false;
+	n++;
     }
-    hasNextChecked = false;
+    return n;
 }
 
 void MAPIIterator::clear() {
-    if (handle != NULL) {
-	mapi_close_handle(handle);
-	handle = NULL;
-    }
-    if (values != NULL) {
-	delete values;
-	values = NULL;
-    }
-}
-
-void MAPIIterator::skipDuplicatedFirstColumn() {
-    if (posFirstVar != -1) {
-	skipDuplicatedFirst = true;
+    stopFetching();
+    {
+	boost::recursive_mutex::scoped_lock lock(*conMutex);
+	if (handle != NULL) {
+	    mapi_close_handle(handle);
+	    handle = NULL;
+	}
+	if (values != NULL) {
+	    delete[] values;
+	    values = NULL;
+	}
     }
-}
-
-Term_t MAPIIterator::getElementAt(const uint8_t p) {
-    // BOOST_LOG_TRIVIAL(debug) << "MAPIIterator::getElementAt()";
-    return values[p];
+    releaseConnection();
 }
 
 MAPIIterator::~MAPIIterator() {
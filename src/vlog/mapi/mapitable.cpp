@@ -48,16 +48,46 @@ void MAPITable::update(Mapi dbh, string q) {
     }
 }
 
+void MAPITable::checkPrepared(Mapi dbh, MapiHdl hdl) {
+    if (hdl == NULL || mapi_error(dbh) != MOK) {
+	if (hdl != NULL) {
+	    mapi_explain_query(hdl, stderr);
+	    mapi_close_handle(hdl);
+	} else {
+	    mapi_explain(dbh, stderr);
+	}
+	mapi_destroy(dbh);
+	throw 10;
+    }
+}
+
 MAPITable::MAPITable(string host, int port, string user, string pwd, string dbname,
-                       string tablename, string tablefields) {
+                       string tablename, string tablefields, size_t fetchSize,
+                       size_t poolSize) {
 
     this->tablename = tablename;
-    con = mapi_connect(host.c_str(), port, user.c_str(), pwd.c_str(), "sql", dbname.c_str()); 
-    if (mapi_error(con)) {
-	mapi_explain(con, stderr); 
-	mapi_destroy(con); 
-	throw 10;
+    this->fetchSize = fetchSize;
+    for (size_t i = 0; i < poolSize; i++) {
+	Connection *c = new Connection();
+	cons.push_back(std::unique_ptr<Connection>(c));
+	Mapi con = mapi_connect(host.c_str(), port, user.c_str(), pwd.c_str(), "sql", dbname.c_str()); 
+	if (mapi_error(con)) {
+	    mapi_explain(con, stderr); 
+	    mapi_destroy(con); 
+	    throw 10;
+	}
+	c->con = con;
+	//Number of rows that the server sends at once
+	mapi_cache_limit(con, fetchSize);
+
+	c->dictTextHdl = mapi_prepare(con, "SELECT value from dict where id=?");
+	checkPrepared(con, c->dictTextHdl);
+	mapi_param_type(c->dictTextHdl, 0, MAPI_ULONGLONG, MAPI_ULONGLONG, &c->dictTextParam);
+	c->dictNumberHdl = mapi_prepare(con, "SELECT id from revdict where value=?");
+	checkPrepared(con, c->dictNumberHdl);
+	mapi_param_string(c->dictNumberHdl, 0, MAPI_VARCHAR, c->dictNumberParam, &c->dictNumberParamSize);
     }
+    initPool(poolSize);
 
     //Extract fields
     std::stringstream ss(tablefields);
@@ -67,153 +97,34 @@ MAPITable::MAPITable(string host, int port, string user, string pwd, string dbna
     }
 }
 
-// If valuesToFilter is larger than this, use a temporary table instead of a test on the individual values
-#define TEMP_TABLE_THRESHOLD (2*3*4*5*7*11)
-
-void MAPITable::query(QSQQuery *query, TupleTable *outputTable,
-                       std::vector<uint8_t> *posToFilter,
-                       std::vector<Term_t> *valuesToFilter) {
-    const Literal *l = query->getLiteral();
-    const uint8_t npos = query->getNPosToCopy();
-    uint8_t *pos = query->getPosToCopy();
-    uint64_t row[npos];
-    EDBIterator *iter;
-
-    if (posToFilter == NULL || posToFilter->size() == 0) {
-	iter = getIterator(*l);
-    } else {
-	//Create first part of query.
-	string sqlQuery = "SELECT * FROM " + tablename;
-	if (valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
-	    // sqlQuery += " t1";
-	}
-	sqlQuery += " WHERE ";
-	string cond = literalConstraintsToSQLQuery(*l, fieldTables);
-	if (cond != "") {
-	    sqlQuery += cond;
-	}
-
-	string cond1 = repeatedToSQLQuery(*l, fieldTables);
-	if (cond1 != "") {
-	    if (cond != "") {
-		sqlQuery += " AND ";
-	    }
-	    sqlQuery += cond1;
-	}
-     
-	if (cond1 != "" || cond != "") {
-	    sqlQuery += " AND ";
-	}
-
-	if (valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
-	    // Somewhat arbitrary threshold
-	    // Create temporary table
-	    string sqlCreateTable = "CREATE TEMPORARY TABLE temp (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i) + " BIGINT";
-	    }
-	    sqlCreateTable += ", PRIMARY KEY (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i);
-	    }
-	    sqlCreateTable += ")";
-	    sqlCreateTable += ")";
-	    BOOST_LOG_TRIVIAL(debug) << "SQL create temp table: " << sqlCreateTable;
-	    update(con, sqlCreateTable);
-
-	    // Insert values into table
-	    BOOST_LOG_TRIVIAL(debug) << "START TRANSACTION";
-	    update(con, "START TRANSACTION");
-
-	    for (std::vector<Term_t>::iterator itr = valuesToFilter->begin();
-		    itr != valuesToFilter->end();) {
-		string addition = "INSERT INTO temp VALUES (";
-		for (int i = 0; i < posToFilter->size(); i++, itr++) {
-		    string pref = i > 0 ? ", " : "";
-		    addition += pref + to_string(*itr);
-		}
-		addition += ")";
-		BOOST_LOG_TRIVIAL(debug) << "SQL insert into temp table: " << addition;
-		update(con, addition);
-	    }
-
-	    BOOST_LOG_TRIVIAL(debug) << "COMMIT";
-	    update(con, "COMMIT");
-	    
-	    /*
-	    sqlCreateTable = "ALTER TABLE temp ADD CONSTRAINT pkey PRIMARY KEY (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i);
-	    }
-	    sqlCreateTable += ")";
-	    BOOST_LOG_TRIVIAL(debug) << "alter table: add primary key: " << sqlCreateTable;
-	    update(con, sqlCreateTable);
-	    */
-
-	    // Finish the query.
-	    sqlQuery += "EXISTS (SELECT * FROM temp WHERE ";
-
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i != 0) {
-		    sqlQuery += " AND ";
-		}
-		sqlQuery += tablename + "." + fieldTables[posToFilter->at(i)] + " = temp.x" + to_string(i);
-	    }
-
-	    sqlQuery += ")";
-	} else {
-	    bool first = true;
-	    sqlQuery += "(";
-	    for (std::vector<Term_t>::iterator itr = valuesToFilter->begin();
-		    itr != valuesToFilter->end();) {
-		if (! first) {
-		    sqlQuery += " OR ";
-		}
-		sqlQuery += "(";
-		for (int i = 0; i < posToFilter->size(); i++, itr++) {
-		    string pref = i > 0 ? " AND " : "";
-		    sqlQuery += pref + fieldTables[posToFilter->at(i)] + " = " + to_string(*itr);
-		}
-		sqlQuery += ")";
-		first = false;
-	    }
-	    sqlQuery += ")";
-	}
-
-	// sqlQuery += " ORDER BY " + fieldTables[0] + ", " + fieldTables[1];	// TO BE REMOVED
-
-	iter = new MAPIIterator(con, sqlQuery, fieldTables, *l);
-    }
+void MAPITable::executeUpdate(const string &sqlQuery) {
+    PooledConnection connection(this);
+    Mapi con = cons[connection.idx]->con;
+    update(con, sqlQuery);
+}
 
-    int count = 0;
-    while (iter->hasNext()) {
-	iter->next();
-	for (int i = 0; i < npos; i++) {
-	    row[i] = iter->getElementAt(pos[i]);
-	}
-	outputTable->addRow(row);
-	count++;
-    }
-    iter->clear();
-    delete iter;
-    BOOST_LOG_TRIVIAL(debug) << "query gave " << count << " results";
+EDBIterator *MAPITable::executeQuery(const string &sqlQuery,
+	const Literal &query) {
+    return new MAPIIterator(this, sqlQuery, query);
+}
 
-    if (valuesToFilter != NULL && valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
-	BOOST_LOG_TRIVIAL(debug) << "DROP TABLE temp";
-	update(con, "DROP TABLE temp");
+void MAPITable::executeDictQuery(const string &sqlQuery,
+	std::vector<std::pair<uint64_t, string>> &output) {
+    PooledConnection connection(this);
+    Mapi con = cons[connection.idx]->con;
+    BOOST_LOG_TRIVIAL(debug) << "SQL Query: " << sqlQuery;
+    MapiHdl handle = doquery(con, sqlQuery);
+    while (mapi_fetch_row(handle)) {
+	char *p;
+	uint64_t id = strtoull(mapi_fetch_field(handle, 0), &p, 10);
+	output.push_back(std::make_pair(id, string(mapi_fetch_field(handle, 1))));
     }
+    mapi_close_handle(handle);
 }
 
 size_t MAPITable::getCardinality(const Literal &q) {
+    PooledConnection connection(this);
+    Mapi con = cons[connection.idx]->con;
     string query = "SELECT COUNT(*) as c from " + tablename;
 
     string cond = literalConstraintsToSQLQuery(q, fieldTables);
@@ -234,6 +145,8 @@ size_t MAPITable::getCardinality(const Literal &q) {
 }
 
 size_t MAPITable::getCardinalityColumn(const Literal &q, uint8_t posColumn) {
+    PooledConnection connection(this);
+    Mapi con = cons[connection.idx]->con;
     
     string query = "SELECT COUNT(DISTINCT " + fieldTables[posColumn] + ") as c from " + tablename;
 
@@ -255,6 +168,8 @@ size_t MAPITable::getCardinalityColumn(const Literal &q, uint8_t posColumn) {
 
 bool MAPITable::isEmpty(const Literal &q, std::vector<uint8_t> *posToFilter,
                          std::vector<Term_t> *valuesToFilter) {
+    PooledConnection connection(this);
+    Mapi con = cons[connection.idx]->con;
 
     if (posToFilter == NULL) {
         return getCardinality(q) == 0;
@@ -288,43 +203,54 @@ bool MAPITable::isEmpty(const Literal &q, std::vector<uint8_t> *posToFilter,
 }
 
 EDBIterator *MAPITable::getIterator(const Literal &query) {
-    return new MAPIIterator(con, tablename, query, fieldTables, NULL);
+    return new MAPIIterator(this, query, NULL);
 }
 
 EDBIterator *MAPITable::getSortedIterator(const Literal &query,
         const std::vector<uint8_t> &fields) {
-    return new MAPIIterator(con, tablename, query, fieldTables, &fields);
+    return new MAPIIterator(this, query, &fields);
 }
 
 bool MAPITable::getDictNumber(const char *text, const size_t sizeText,
                                uint64_t &id) {
-    string query = "SELECT id from revdict where value='" + string(text, sizeText) + "'";
-    MapiHdl handle = doquery(con, query);
-    if (mapi_fetch_row(handle)) {
-	char *res = mapi_fetch_field(handle, 0);
+    if (sizeText >= MAX_TERM_SIZE) {
+	return false;
+    }
+    PooledConnection connection(this);
+    Connection *c = cons[connection.idx].get();
+    memcpy(c->dictNumberParam, text, sizeText);
+    c->dictNumberParam[sizeText] = 0;
+    c->dictNumberParamSize = sizeText;
+    if (mapi_execute(c->dictNumberHdl) != MOK) {
+	checkPrepared(c->con, c->dictNumberHdl);
+    }
+    if (mapi_fetch_row(c->dictNumberHdl)) {
+	char *res = mapi_fetch_field(c->dictNumberHdl, 0);
 	char *p;
 	id = strtol(res, &p, 10);
-	mapi_close_handle(handle);
 	return true;
     }
-    mapi_close_handle(handle);
     return false;
 }
 
 bool MAPITable::getDictText(const uint64_t id, char *text) {
-    string query = "SELECT value from dict where id=" + to_string(id);
-    MapiHdl handle = doquery(con, query);
-    if (mapi_fetch_row(handle)) {
-	char *res = mapi_fetch_field(handle, 0);
+    PooledConnection connection(this);
+    Connection *c = cons[connection.idx].get();
+    c->dictTextParam = id;
+    if (mapi_execute(c->dictTextHdl) != MOK) {
+	checkPrepared(c->con, c->dictTextHdl);
+    }
+    if (mapi_fetch_row(c->dictTextHdl)) {
+	char *res = mapi_fetch_field(c->dictTextHdl, 0);
 	strcpy(text, res);
-	mapi_close_handle(handle);
 	return true;
     }
-    mapi_close_handle(handle);
     return false;
 }
 
 uint64_t MAPITable::getNTerms() {
+    PooledConnection connection(this);
+    Mapi con = cons[connection.idx]->con;
     string query = "SELECT COUNT(*) as c from dict";
     MapiHdl handle = doquery(con, query);
     mapi_fetch_row(handle);
@@ -336,5 +262,9 @@ uint64_t MAPITable::getNTerms() {
 }
 
 MAPITable::~MAPITable() {
-    mapi_destroy(con);
+    for (auto &c : cons) {
+	mapi_close_handle(c->dictTextHdl);
+	mapi_close_handle(c->dictNumberHdl);
+	mapi_destroy(c->con);
+    }
 }
@@ -7,18 +7,26 @@
 #include <cppconn/exception.h>
 #include <cppconn/resultset.h>
 #include <cppconn/statement.h>
+#include <cppconn/prepared_statement.h>
 
 #include <sstream>
 #include <string>
 
 
 MySQLTable::MySQLTable(string host, string user, string pwd, string dbname,
-                       string tablename, string tablefields) {
-    con = NULL;
+                       string tablename, string tablefields, size_t fetchSize,
+                       size_t poolSize) {
     this->tablename = tablename;
+    this->fetchSize = fetchSize;
     driver = get_driver_instance();
-    con = driver->connect(host, user, pwd);
-    con->setSchema(dbname);
+    for (size_t i = 0; i < poolSize; i++) {
+        sql::Connection *con = driver->connect(host, user, pwd);
+        con->setSchema(dbname);
+        cons.push_back(con);
+        dictTextStmts.push_back(con->prepareStatement("SELECT value from dict where id=?"));
+        dictNumberStmts.push_back(con->prepareStatement("SELECT id from revdict where value=?"));
+    }
+    initPool(poolSize);
 
     //Extract fields
     std::stringstream ss(tablefields);
@@ -28,152 +36,36 @@ MySQLTable::MySQLTable(string host, string user, string pwd, string dbname,
     }
 }
 
-// If valuesToFilter is larger than this, use a temporary table instead of a test on the individual values
-#define TEMP_TABLE_THRESHOLD (2*3*4*5*7*11)
-
-void MySQLTable::query(QSQQuery *query, TupleTable *outputTable,
-                       std::vector<uint8_t> *posToFilter,
-                       std::vector<Term_t> *valuesToFilter) {
-    const Literal *l = query->getLiteral();
-    const uint8_t npos = query->getNPosToCopy();
-    uint8_t *pos = query->getPosToCopy();
-    uint64_t row[npos];
-    int count = 0;
-    EDBIterator *iter;
-    if (posToFilter == NULL || posToFilter->size() == 0) {
-	iter = getIterator(*l);
-    } else {
-	//Create first part of query.
-	string sqlQuery = "SELECT * FROM " + tablename + " WHERE ";
-	string cond = SQLTable::literalConstraintsToSQLQuery(*l, fieldTables);
-	if (cond != "") {
-	    sqlQuery += cond;
-	}
-
-	string cond1 = SQLTable::repeatedToSQLQuery(*l, fieldTables);
-	if (cond1 != "") {
-	    if (cond != "") {
-		sqlQuery += " AND ";
-	    }
-	    sqlQuery += cond1;
-	}
-
-	if (cond1 != "" || cond != "") {
-	    sqlQuery += " AND ";
-	}
-
-	if (valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
-	    // Somewhat arbitrary threshold
-	    // Create temporary table
-	    string sqlCreateTable = "CREATE TEMPORARY TABLE temp (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i) + " BIGINT";
-	    }
-	    sqlCreateTable += ")";
-	    sql::Statement *stmt;
-	    stmt = con->createStatement();
-	    BOOST_LOG_TRIVIAL(debug) << "SQL create temp table: " << sqlCreateTable;
-	    MYSQLCALL(stmt->execute(sqlCreateTable))
-	    delete stmt;
-
-	    // Insert values into table
-	    stmt = con->createStatement();
-	    BOOST_LOG_TRIVIAL(debug) << "START TRANSACTION";
-	    stmt->execute("START TRANSACTION");
-	    delete stmt;
-
-	    for (std::vector<Term_t>::iterator itr = valuesToFilter->begin();
-		    itr != valuesToFilter->end();) {
-		string addition = "INSERT INTO temp VALUES (";
-		for (int i = 0; i < posToFilter->size(); i++, itr++) {
-		    string pref = i > 0 ? ", " : "";
-		    addition += pref + to_string(*itr);
-		}
-		addition += ")";
-		BOOST_LOG_TRIVIAL(debug) << "SQL insert into temp table: " << addition;
-		stmt = con->createStatement();
-		stmt->execute(addition);
-		delete stmt;
-	    }
-
-	    stmt = con->createStatement();
-	    BOOST_LOG_TRIVIAL(debug) << "COMMIT";
-	    stmt->execute("COMMIT");
-	    delete stmt;
-	    
-	    sqlCreateTable = "ALTER TABLE temp ADD CONSTRAINT pkey PRIMARY KEY (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i);
-	    }
-	    sqlCreateTable += ")";
-	    stmt = con->createStatement();
-	    BOOST_LOG_TRIVIAL(debug) << "alter table: add primary key";
-	    stmt->execute(sqlCreateTable);
-	    delete stmt;
-
-
-	    // Finish the query.
-	    sqlQuery += "EXISTS (SELECT * FROM temp WHERE ";
-
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i != 0) {
-		    sqlQuery += " AND ";
-		}
-		sqlQuery += tablename + "." + fieldTables[posToFilter->at(i)] + " = temp.x" + to_string(i);
-	    }
-
-	    sqlQuery += ")";
-	} else {
-	    bool first = true;
-	    sqlQuery += "(";
-	    for (std::vector<Term_t>::iterator itr = valuesToFilter->begin();
-		    itr != valuesToFilter->end();) {
-		if (! first) {
-		    sqlQuery += " OR ";
-		}
-		sqlQuery += "(";
-		for (int i = 0; i < posToFilter->size(); i++, itr++) {
-		    string pref = i > 0 ? " AND " : "";
-		    sqlQuery += pref + fieldTables[posToFilter->at(i)] + " = " + to_string(*itr);
-		}
-		sqlQuery += ")";
-		first = false;
-	    }
-	    sqlQuery += ")";
-	}
-	
-	// sqlQuery += " ORDER BY " + fieldTables[0] + ", " + fieldTables[1];	// TO BE REMOVED
-
-	iter = new MySQLIterator(con, sqlQuery, *l);
-    }
+void MySQLTable::executeUpdate(const string &sqlQuery) {
+    PooledConnection connection(this);
+    sql::Connection *con = cons[connection.idx];
+    sql::Statement *stmt = con->createStatement();
+    MYSQLCALL(stmt->execute(sqlQuery))
+    delete stmt;
+}
 
-    while (iter->hasNext()) {
-	iter->next();
-	for (int i = 0; i < npos; i++) {
-	    row[i] = iter->getElementAt(pos[i]);
-	}
-	outputTable->addRow(row);
-	count++;
-    }
-    iter->clear();
-    delete iter;
-    BOOST_LOG_TRIVIAL(debug) << "query gave " << count << " results";
+EDBIterator *MySQLTable::executeQuery(const string &sqlQuery,
+	const Literal &query) {
+    return new MySQLIterator(this, sqlQuery, query);
+}
 
-    if (valuesToFilter != NULL && valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
-	sql::Statement *stmt = con->createStatement();
-	BOOST_LOG_TRIVIAL(debug) << "DROP TABLE temp";
-	stmt->execute("DROP TABLE temp");
-	delete stmt;
+void MySQLTable::executeDictQuery(const string &sqlQuery,
+	std::vector<std::pair<uint64_t, string>> &output) {
+    PooledConnection connection(this);
+    sql::Connection *con = cons[connection.idx];
+    BOOST_LOG_TRIVIAL(debug) << "SQL Query: " << sqlQuery;
+    sql::Statement *stmt = con->createStatement();
+    sql::ResultSet *res = stmt->executeQuery(sqlQuery);
+    while (res->next()) {
+	output.push_back(std::make_pair(res->getUInt64(1), res->getString(2)));
     }
+    delete res;
+    delete stmt;
 }
 
 size_t MySQLTable::getCardinality(const Literal &q) {
+    PooledConnection connection(this);
+    sql::Connection *con = cons[connection.idx];
     string query = "SELECT COUNT(*) as c from " + tablename;
 
     string cond = literalConstraintsToSQLQuery(q, fieldTables);
@@ -195,6 +87,8 @@ size_t MySQLTable::getCardinality(const Literal &q) {
 }
 
 size_t MySQLTable::getCardinalityColumn(const Literal &q, uint8_t posColumn) {
+    PooledConnection connection(this);
+    sql::Connection *con = cons[connection.idx];
     
     string query = "SELECT COUNT(DISTINCT " + fieldTables[posColumn] + ") as c from " + tablename;
 
@@ -218,6 +112,8 @@ size_t MySQLTable::getCardinalityColumn(const Literal &q, uint8_t posColumn) {
 
 bool MySQLTable::isEmpty(const Literal &q, std::vector<uint8_t> *posToFilter,
                          std::vector<Term_t> *valuesToFilter) {
+    PooledConnection connection(this);
+    sql::Connection *con = cons[connection.idx];
 
     if (posToFilter == NULL) {
         return getCardinality(q) == 0;
@@ -252,20 +148,20 @@ bool MySQLTable::isEmpty(const Literal &q, std::vector<uint8_t> *posToFilter,
 }
 
 EDBIterator *MySQLTable::getIterator(const Literal &query) {
-    return new MySQLIterator(con, tablename, query, fieldTables, NULL);
+    return new MySQLIterator(this, query, NULL);
 }
 
 EDBIterator *MySQLTable::getSortedIterator(const Literal &query,
         const std::vector<uint8_t> &fields) {
-    return new MySQLIterator(con, tablename, query, fieldTables, &fields);
+    return new MySQLIterator(this, query, &fields);
 }
 
 bool MySQLTable::getDictNumber(const char *text, const size_t sizeText,
                                uint64_t &id) {
-    string query = "SELECT id from revdict where value='" + string(text, sizeText) + "'";
-    sql::Statement *stmt;
-    stmt = con->createStatement();
-    sql::ResultSet *res = stmt->executeQuery(query);
+    PooledConnection connection(this);
+    sql::PreparedStatement *dictNumberStmt = dictNumberStmts[connection.idx];
+    dictNumberStmt->setString(1, string(text, sizeText));
+    sql::ResultSet *res = dictNumberStmt->executeQuery();
     bool resp = false;
     if (res->first()) {
         id = res->getUInt64(1);
@@ -273,16 +169,15 @@ bool MySQLTable::getDictNumber(const char *text, const size_t sizeText,
     }
     //BOOST_LOG_TRIVIAL(debug) << "Value=" << string(text, sizeText) << " ID=" << id;
     delete res;
-    delete stmt;
     return resp;
 
 }
 
 bool MySQLTable::getDictText(const uint64_t id, char *text) {
-    string query = "SELECT value from dict where id=" + to_string(id);
-    sql::Statement *stmt;
-    stmt = con->createStatement();
-    sql::ResultSet *res = stmt->executeQuery(query);
+    PooledConnection connection(this);
+    sql::PreparedStatement *dictTextStmt = dictTextStmts[connection.idx];
+    dictTextStmt->setUInt64(1, id);
+    sql::ResultSet *res = dictTextStmt->executeQuery();
     bool resp = false;
     if (res->first()) {
         string t = res->getString(1);
@@ -291,11 +186,12 @@ bool MySQLTable::getDictText(const uint64_t id, char *text) {
         resp = true;
     }
     delete res;
-    delete stmt;
     return resp;
 }
 
 uint64_t MySQLTable::getNTerms() {
+    PooledConnection connection(this);
+    sql::Connection *con = cons[connection.idx];
     string query = "SELECT COUNT(*) as c from dict";
     sql::Statement *stmt;
     stmt = con->createStatement();
@@ -308,3 +204,12 @@ uint64_t MySQLTable::getNTerms() {
     delete stmt;
     return card;
 }
+
+MySQLTable::~MySQLTable() {
+    for (size_t i = 0; i < cons.size(); i++) {
+        delete dictTextStmts[i];
+        delete dictNumberStmts[i];
+        cons[i]->close();
+        delete cons[i];
+    }
+}
@@ -1,204 +1,104 @@
 #include <vlog/odbc/odbciterator.h>
 #include <vlog/odbc/odbctable.h>
 
-ODBCIterator::ODBCIterator(SQLHANDLE con, string tableName,
-                             const Literal &query,
-                             const std::vector<string> &fieldsTable,
-                             const std::vector<uint8_t> *sortingFieldIdx) {
-    predid = query.getPredicate().getId();
-    isFirst = true;
-    posFirstVar = -1;
-    skipDuplicatedFirst = false;
-
-    string projections = "*";
-    /*if (query.getNVars() == query.getTupleSize()) {
-        projections = "*";
-    } else {
-        for (int i = 0; i < query.getTupleSize(); ++i) {
-            if (query.getTermAtPos(i).isVariable()) {
-                if (projections != "")
-                    projections += ",";
-                projections += fieldsTable[i];
-            }
-        }
-    }*/
-
-    //Read the query
-    string sqlQuery = "SELECT " + projections + " FROM " + tableName;
-    string cond = ODBCTable::literalConstraintsToSQLQuery(query, fieldsTable);
-    if (cond != "") {
-        sqlQuery += " WHERE " + cond;
-    }
-
-    string cond1 = ODBCTable::repeatedToSQLQuery(query, fieldsTable);
-    if (cond1 != "") {
-	if (cond != "") {
-	    sqlQuery += " AND ";
-	}
-	sqlQuery += cond1;
-    }
-
-    //set the order clause
-    if (sortingFieldIdx != NULL && sortingFieldIdx->size() > 0) {
-        string sortString = " ORDER BY ";
-        for (int i = 0; i < sortingFieldIdx->size(); ++i) {
-            if (i != 0)
-                sortString += ",";
-            //Cannot consider the constants
-            int var = sortingFieldIdx->at(i);
-            int j = 0;
-            int idxVar = -1;
-            for(; j < query.getTupleSize(); ++j) {
-                if (query.getTermAtPos(j).isVariable()) {
-                    idxVar++;
-                }
-                if (idxVar == var)
-                    break;
-            }
-            sortString += fieldsTable[j];
-	    if (posFirstVar == -1) {
-		posFirstVar = j;
-	    }
-        }
-        sqlQuery += sortString;
-    }
-
-    int count = 0;
-    for (int i = 0; i < query.getTupleSize(); ++i) {
-	if (query.getTermAtPos(i).isVariable()) {
-	    count++;
-	    if (posFirstVar == -1) {
-		posFirstVar = i;
-	    }
-	}
-    }
-    if (count <= 1) {
-	// If there is at most one variable, reset posFirstVar to -1, because in that case 
-	// skipDuplicatedFirstColumn can be a no-op.
-	posFirstVar = -1;
-    }
-
-    BOOST_LOG_TRIVIAL(debug) << "SQL query: " << sqlQuery;
+#include <algorithm>
 
-    ODBCTable::check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-    ODBCTable::check(SQLExecDirectA(stmt, (SQLCHAR *) sqlQuery.c_str(), SQL_NTS), "execute query");
-    SQLNumResultCols(stmt, &columns);
-    indicator = new SQLLEN[columns];
-    values = new SQLUBIGINT[columns];
-    for (int i = 0; i < columns; i++) {
-	ODBCTable::check(SQLBindCol(stmt, i + 1, SQL_C_UBIGINT, &values[i], sizeof(SQLUBIGINT), &indicator[i]), "SQLBindCol");
-    }
-    SQLRETURN ret = SQLFetch(stmt);
-    ODBCTable::check(ret, "SQLFetch");
-    hasNextValue = ret != SQL_NO_DATA;
-    hasNextChecked = true;
+ODBCIterator::ODBCIterator(ODBCTable *table,
+                             const Literal &query,
+                             const std::vector<uint8_t> *sortingFieldIdx) :
+    SQLIterator(query, table), indicator(NULL), values(NULL) {
+    initPosFirstVar(query, sortingFieldIdx);
+    init(table->getConnection(connection),
+	    SQLTable::selectToSQLQuery(table->tablename, query,
+		table->fieldTables, sortingFieldIdx));
 }
 
+ODBCIterator::ODBCIterator(ODBCTable *table,
+                             string sqlQuery,
+                             const Literal &query) :
+    SQLIterator(query, table), indicator(NULL), values(NULL) {
+    initPosFirstVar(query, NULL);
+    init(table->getConnection(connection), sqlQuery);
+}
 
-ODBCIterator::ODBCIterator(SQLHANDLE con, string sqlQuery,
-                             const Literal &query) {
-    predid = query.getPredicate().getId();
-    isFirst = true;
-    posFirstVar = -1;
-    skipDuplicatedFirst = false;
-
-    int count = 0;
-    for (int i = 0; i < query.getTupleSize(); ++i) {
-	if (query.getTermAtPos(i).isVariable()) {
-	    count++;
-	    if (posFirstVar == -1) {
-		posFirstVar = i;
-	    }
-	}
-    }
-    if (count <= 1) {
-	// If there is at most one variable, reset posFirstVar to -1, because in that case 
-	// skipDuplicatedFirstColumn can be a no-op.
-	posFirstVar = -1;
-    }
-
+void ODBCIterator::init(SQLHANDLE con, string sqlQuery) {
     BOOST_LOG_TRIVIAL(debug) << "SQL query: " << sqlQuery;
 
+    boost::recursive_mutex::scoped_lock lock(*conMutex);
     ODBCTable::check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
     ODBCTable::check(SQLExecDirectA(stmt, (SQLCHAR *) sqlQuery.c_str(), SQL_NTS), "execute query");
     SQLNumResultCols(stmt, &columns);
-    indicator = new SQLLEN[columns];
-    values = new SQLUBIGINT[columns];
+
+    //Fetch a batch of the iterator with a single call
+    rowSetSize = fetchSize;
+    rowsFetched = 0;
+    rowsConsumed = 0;
+    noMoreData = false;
+    ODBCTable::check(SQLSetStmtAttr(stmt, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER) SQL_BIND_BY_COLUMN, 0), "set row bind type");
+    ODBCTable::check(SQLSetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER) rowSetSize, 0), "set row array size");
+    ODBCTable::check(SQLSetStmtAttr(stmt, SQL_ATTR_ROWS_FETCHED_PTR, &rowsFetched, 0), "set rows fetched pointer");
+    indicator = new SQLLEN[columns * rowSetSize];
+    values = new SQLUBIGINT[columns * rowSetSize];
     for (int i = 0; i < columns; i++) {
-	ODBCTable::check(SQLBindCol(stmt, i + 1, SQL_C_UBIGINT, &values[i], sizeof(SQLUBIGINT), &indicator[i]), "SQLBindCol");
+	ODBCTable::check(SQLBindCol(stmt, i + 1, SQL_C_UBIGINT, values + i * rowSetSize, sizeof(SQLUBIGINT), indicator + i * rowSetSize), "SQLBindCol");
     }
-    SQLRETURN ret = SQLFetch(stmt);
-    ODBCTable::check(ret, "SQLFetch");
-    hasNextValue = ret != SQL_NO_DATA;
-    hasNextChecked = true;
+    startFetching(columns);
 }
 
-
-
-bool ODBCIterator::hasNext() {
-    if (hasNextChecked) {
-	return hasNextValue;
-    }
-    if (isFirst || ! skipDuplicatedFirst) {
-	SQLRETURN ret = SQLFetch(stmt);
-	ODBCTable::check(ret, "SQLFetch");
-	hasNextValue = ret != SQL_NO_DATA;
-    } else {
-	Term_t oldval = getElementAt(posFirstVar);
-	bool stop = false;
-	while (! stop) {
+size_t ODBCIterator::fetchRows(std::vector<std::vector<Term_t>> &output,
+	const size_t maxRows) {
+    size_t n = 0;
+    while (n < maxRows) {
+	if (rowsConsumed == rowsFetched) {
+	    if (noMoreData) {
+		break;
+	    }
 	    SQLRETURN ret = SQLFetch(stmt);
 	    ODBCTable::check(ret, "SQLFetch");
-	    hasNextValue = ret != SQL_NO_DATA;
-	    if (hasNextValue) {
-		if (getElementAt(posFirstVar) != oldval) {
-		    stop = true;
-		}
-	    } else {
+	    if (ret == SQL_NO_DATA) {
+		noMoreData = true;
+		break;
+	    }
+	    rowsConsumed = 0;
+	    //A partial row set is the last one
+	    noMoreData = rowsFetched < rowSetSize;
+	    if (rowsFetched == 0) {
 		break;
 	    }
 	}
-	hasNextValue = stop;
-    }
-    hasNextChecked = true;
-    // BOOST_LOG_TRIVIAL(debug) << "ODBCIterator::hasNext(): skipDuplicatedFirst = " << skipDuplicatedFirst << ", returns " << hasNextValue;
-    return hasNextValue;
-}
 
-void ODBCIterator::next() {
-    if (! hasNextChecked) {
-	BOOST_LOG_TRIVIAL(error) << "ODBCIterator::next called without hasNext check";
-	throw 10;
-    }
-    // BOOST_LOG_TRIVIAL(debug) << "ODBCIterator::next()";
-    if (isFirst) {
-        isFirst = false;
+	const size_t count = std::min((size_t) (rowsFetched - rowsConsumed),
+		maxRows - n);
+	for (int i = 0; i < columns; i++) {
+	    const SQLLEN *ind = indicator + i * rowSetSize + rowsConsumed;
+	    for (size_t j = 0; j < count; j++) {
+		if (ind[j] == SQL_NULL_DATA) {
+		    BOOST_LOG_TRIVIAL(error) << "NULL values are not supported";
+		    throw 10;
+		}
+	    }
+	    const SQLUBIGINT *col = values + i * rowSetSize + rowsConsumed;
+	    output[i].insert(output[i].end(), col, col + count);
+	}
+	rowsConsumed += count;
+	n += count;
     }
-    hasNextChecked = false;
+    return n;
 }
 
 void ODBCIterator::clear() {
-    if (indicator != NULL) {
-	delete indicator;
-	delete values;
-	SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-    }
-    indicator = NULL;
-    values = NULL;
-}
-
-void ODBCIterator::skipDuplicatedFirstColumn() {
-    if (posFirstVar != -1) {
-	skipDuplicatedFirst = true;
-    }
-}
-
-Term_t ODBCIterator::getElementAt(const uint8_t p) {
-    // BOOST_LOG_TRIVIAL(debug) << "ODBCIterator::getElementAt()";
-    if (indicator[p] != SQL_NULL_DATA) {
-	return values[p];
+    stopFetching();
+    {
+	boost::recursive_mutex::scoped_lock lock(*conMutex);
+	if (indicator != NULL) {
+	    delete[] indicator;
+	    delete[] values;
+	    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+	}
+	indicator = NULL;
+	values = NULL;
     }
-    throw 10;
+    releaseConnection();
 }
 
 ODBCIterator::~ODBCIterator() {
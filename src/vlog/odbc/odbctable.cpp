@@ -3,6 +3,8 @@
 
 #include <unistd.h>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
 #include <string>
 
 
@@ -17,14 +19,56 @@ void ODBCTable::check(SQLRETURN rc, string msg) {
     throw 10;
 }
 
+//Reads a text column of the current row. A value longer than the buffer is
+//read with several calls. Returns false if the value is NULL.
+static bool getTextData(SQLHANDLE stmt, SQLUSMALLINT column, string &value) {
+    char buffer[MAX_TERM_SIZE];
+    value.clear();
+    while (true) {
+	SQLLEN numBytes;
+	SQLRETURN res = SQLGetData(stmt, column, SQL_C_CHAR, buffer,
+		sizeof(buffer), &numBytes);
+	if (res == SQL_NO_DATA) {
+	    //The previous calls read everything
+	    break;
+	}
+	ODBCTable::check(res, "get text");
+	if (numBytes == SQL_NULL_DATA) {
+	    return false;
+	}
+	if (res == SQL_SUCCESS_WITH_INFO && (numBytes == SQL_NO_TOTAL ||
+		    numBytes >= (SQLLEN) sizeof(buffer))) {
+	    //Truncated: the buffer is full, except the null terminator
+	    value.append(buffer, sizeof(buffer) - 1);
+	} else {
+	    value.append(buffer, std::min((size_t) numBytes, sizeof(buffer) - 1));
+	    break;
+	}
+    }
+    return true;
+}
+
 ODBCTable::ODBCTable(string user, string pwd, string dbname,
-                       string tablename, string tablefields) {
+                       string tablename, string tablefields, size_t fetchSize,
+                       size_t poolSize) {
 
     this->tablename = tablename;
+    this->fetchSize = fetchSize;
     check(SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env), "allocate environment handle");
     check(SQLSetEnvAttr(env, SQL_ATTR_ODBC_VERSION, (SQLPOINTER) SQL_OV_ODBC3, 0), "setting ODBC version");
-    check(SQLAllocHandle(SQL_HANDLE_DBC, env, &con), "allocate connection handle");
-    check(SQLConnectA(con, (SQLCHAR *) dbname.c_str(), SQL_NTS, (SQLCHAR *) user.c_str(), SQL_NTS, (SQLCHAR *) pwd.c_str(), SQL_NTS), "connect");
+    for (size_t i = 0; i < poolSize; i++) {
+	SQLHANDLE con, dictTextStmt, dictNumberStmt;
+	check(SQLAllocHandle(SQL_HANDLE_DBC, env, &con), "allocate connection handle");
+	check(SQLConnectA(con, (SQLCHAR *) dbname.c_str(), SQL_NTS, (SQLCHAR *) user.c_str(), SQL_NTS, (SQLCHAR *) pwd.c_str(), SQL_NTS), "connect");
+	check(SQLAllocHandle(SQL_HANDLE_STMT, con, &dictTextStmt), "allocate statement handle");
+	check(SQLPrepareA(dictTextStmt, (SQLCHAR *) "SELECT value from dict where id=?", SQL_NTS), "prepare dict query");
+	check(SQLAllocHandle(SQL_HANDLE_STMT, con, &dictNumberStmt), "allocate statement handle");
+	check(SQLPrepareA(dictNumberStmt, (SQLCHAR *) "SELECT id from revdict where value=?", SQL_NTS), "prepare revdict query");
+	cons.push_back(con);
+	dictTextStmts.push_back(dictTextStmt);
+	dictNumberStmts.push_back(dictNumberStmt);
+    }
+    initPool(poolSize);
 
     //Extract fields
     std::stringstream ss(tablefields);
@@ -34,167 +78,47 @@ ODBCTable::ODBCTable(string user, string pwd, string dbname,
     }
 }
 
-// If valuesToFilter is larger than this, use a temporary table instead of a test on the individual values
-#define TEMP_TABLE_THRESHOLD (2*3*4*5*7*11)
-
-void ODBCTable::query(QSQQuery *query, TupleTable *outputTable,
-                       std::vector<uint8_t> *posToFilter,
-                       std::vector<Term_t> *valuesToFilter) {
-    const Literal *l = query->getLiteral();
-    const uint8_t npos = query->getNPosToCopy();
-    uint8_t *pos = query->getPosToCopy();
-    uint64_t row[npos];
-    EDBIterator *iter;
-
-    if (posToFilter == NULL || posToFilter->size() == 0) {
-	iter = getIterator(*l);
-    } else {
-	//Create first part of query.
-	string sqlQuery = "SELECT * FROM " + tablename;
-	if (valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
-	    // sqlQuery += " t1";
-	}
-	sqlQuery += " WHERE ";
-	string cond = literalConstraintsToSQLQuery(*l, fieldTables);
-	if (cond != "") {
-	    sqlQuery += cond;
-	}
-
-	string cond1 = repeatedToSQLQuery(*l, fieldTables);
-	if (cond1 != "") {
-	    if (cond != "") {
-		sqlQuery += " AND ";
-	    }
-	    sqlQuery += cond1;
-	}
-     
-	if (cond1 != "" || cond != "") {
-	    sqlQuery += " AND ";
-	}
-
-	if (valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
-	    // Somewhat arbitrary threshold
-	    // Create temporary table
-	    string sqlCreateTable = "CREATE TEMPORARY TABLE temp (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i) + " BIGINT";
-	    }
-	    sqlCreateTable += ", PRIMARY KEY (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i);
-	    }
-	    sqlCreateTable += ")";
-	    sqlCreateTable += ")";
-	    SQLHANDLE stmt;
-	    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-	    BOOST_LOG_TRIVIAL(debug) << "SQL create temp table: " << sqlCreateTable;
-	    check(SQLExecDirectA(stmt, (SQLCHAR *) sqlCreateTable.c_str(), SQL_NTS), "create temp table");
-	    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-
-	    // Insert values into table
-	    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-	    BOOST_LOG_TRIVIAL(debug) << "START TRANSACTION";
-	    check(SQLExecDirectA(stmt, (SQLCHAR *) "START TRANSACTION", SQL_NTS), "start transaction");
-	    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-
-	    for (std::vector<Term_t>::iterator itr = valuesToFilter->begin();
-		    itr != valuesToFilter->end();) {
-		string addition = "INSERT INTO temp VALUES (";
-		for (int i = 0; i < posToFilter->size(); i++, itr++) {
-		    string pref = i > 0 ? ", " : "";
-		    addition += pref + to_string(*itr);
-		}
-		addition += ")";
-		BOOST_LOG_TRIVIAL(debug) << "SQL insert into temp table: " << addition;
-		check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-		check(SQLExecDirectA(stmt, (SQLCHAR *) addition.c_str(), SQL_NTS), "addition");
-		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-	    }
-
-	    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-	    BOOST_LOG_TRIVIAL(debug) << "COMMIT";
-	    check(SQLExecDirectA(stmt, (SQLCHAR *) "COMMIT", SQL_NTS), "commit");
-	    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-	    
-	    /*
-	    sqlCreateTable = "ALTER TABLE temp ADD CONSTRAINT pkey PRIMARY KEY (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i);
-	    }
-	    sqlCreateTable += ")";
-	    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-	    BOOST_LOG_TRIVIAL(debug) << "alter table: add primary key: " << sqlCreateTable;
-	    check(SQLExecDirectA(stmt, (SQLCHAR *) sqlCreateTable.c_str(), SQL_NTS), "alter table");
-	    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-	    */
-
-	    // Finish the query.
-	    sqlQuery += "EXISTS (SELECT * FROM temp WHERE ";
-
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i != 0) {
-		    sqlQuery += " AND ";
-		}
-		sqlQuery += tablename + "." + fieldTables[posToFilter->at(i)] + " = temp.x" + to_string(i);
-	    }
-
-	    sqlQuery += ")";
-	} else {
-	    bool first = true;
-	    sqlQuery += "(";
-	    for (std::vector<Term_t>::iterator itr = valuesToFilter->begin();
-		    itr != valuesToFilter->end();) {
-		if (! first) {
-		    sqlQuery += " OR ";
-		}
-		sqlQuery += "(";
-		for (int i = 0; i < posToFilter->size(); i++, itr++) {
-		    string pref = i > 0 ? " AND " : "";
-		    sqlQuery += pref + fieldTables[posToFilter->at(i)] + " = " + to_string(*itr);
-		}
-		sqlQuery += ")";
-		first = false;
-	    }
-	    sqlQuery += ")";
-	}
-
-	// sqlQuery += " ORDER BY " + fieldTables[0] + ", " + fieldTables[1];	// TO BE REMOVED
+void ODBCTable::executeUpdate(const string &sqlQuery) {
+    PooledConnection connection(this);
+    SQLHANDLE con = cons[connection.idx];
+    SQLHANDLE stmt;
+    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
+    check(SQLExecDirectA(stmt, (SQLCHAR *) sqlQuery.c_str(), SQL_NTS), "execute update");
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+}
 
-	iter = new ODBCIterator(con, sqlQuery, *l);
-    }
+EDBIterator *ODBCTable::executeQuery(const string &sqlQuery,
+	const Literal &query) {
+    return new ODBCIterator(this, sqlQuery, query);
+}
 
-    int count = 0;
-    while (iter->hasNext()) {
-	iter->next();
-	for (int i = 0; i < npos; i++) {
-	    row[i] = iter->getElementAt(pos[i]);
+void ODBCTable::executeDictQuery(const string &sqlQuery,
+	std::vector<std::pair<uint64_t, string>> &output) {
+    PooledConnection connection(this);
+    SQLHANDLE con = cons[connection.idx];
+    BOOST_LOG_TRIVIAL(debug) << "SQL Query: " << sqlQuery;
+    SQLHANDLE stmt;
+    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
+    check(SQLExecDirectA(stmt, (SQLCHAR *) sqlQuery.c_str(), SQL_NTS), "execute query");
+    string text;
+    while (true) {
+	SQLRETURN res = SQLFetch(stmt);
+	check(res, "fetch result");
+	if (! SQL_SUCCEEDED(res)) {
+	    break;
 	}
-	outputTable->addRow(row);
-	count++;
-    }
-    iter->clear();
-    delete iter;
-    BOOST_LOG_TRIVIAL(debug) << "query gave " << count << " results";
-
-    if (valuesToFilter != NULL && valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
-	SQLHANDLE stmt;
-	check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-	BOOST_LOG_TRIVIAL(debug) << "DROP TABLE temp";
-	check(SQLExecDirectA(stmt, (SQLCHAR *) "DROP TABLE temp", SQL_NTS), "drop temp table");
-	SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+	SQLLEN numBytes;
+	SQLUBIGINT id;
+	check(SQLGetData(stmt, 1, SQL_C_UBIGINT, &id, sizeof(SQLUBIGINT), &numBytes), "get id");
+	getTextData(stmt, 2, text);
+	output.push_back(std::make_pair((uint64_t) id, text));
     }
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
 }
 
 size_t ODBCTable::getCardinality(const Literal &q) {
+    PooledConnection connection(this);
+    SQLHANDLE con = cons[connection.idx];
     string query = "SELECT COUNT(*) as c from " + tablename;
 
     string cond = literalConstraintsToSQLQuery(q, fieldTables);
@@ -216,6 +140,8 @@ size_t ODBCTable::getCardinality(const Literal &q) {
 }
 
 size_t ODBCTable::getCardinalityColumn(const Literal &q, uint8_t posColumn) {
+    PooledConnection connection(this);
+    SQLHANDLE con = cons[connection.idx];
     
     string query = "SELECT COUNT(DISTINCT " + fieldTables[posColumn] + ") as c from " + tablename;
 
@@ -239,6 +165,8 @@ size_t ODBCTable::getCardinalityColumn(const Literal &q, uint8_t posColumn) {
 
 bool ODBCTable::isEmpty(const Literal &q, std::vector<uint8_t> *posToFilter,
                          std::vector<Term_t> *valuesToFilter) {
+    PooledConnection connection(this);
+    SQLHANDLE con = cons[connection.idx];
 
     if (posToFilter == NULL) {
         return getCardinality(q) == 0;
@@ -273,48 +201,56 @@ bool ODBCTable::isEmpty(const Literal &q, std::vector<uint8_t> *posToFilter,
 }
 
 EDBIterator *ODBCTable::getIterator(const Literal &query) {
-    return new ODBCIterator(con, tablename, query, fieldTables, NULL);
+    return new ODBCIterator(this, query, NULL);
 }
 
 EDBIterator *ODBCTable::getSortedIterator(const Literal &query,
         const std::vector<uint8_t> &fields) {
-    return new ODBCIterator(con, tablename, query, fieldTables, &fields);
+    return new ODBCIterator(this, query, &fields);
 }
 
 bool ODBCTable::getDictNumber(const char *text, const size_t sizeText,
                                uint64_t &id) {
-    string query = "SELECT id from revdict where value='" + string(text, sizeText) + "'";
-    SQLHANDLE stmt;
-    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-    check(SQLExecDirectA(stmt, (SQLCHAR *) query.c_str(), SQL_NTS), "execute query");
-    SQLRETURN res = SQLFetch(stmt);
+    PooledConnection connection(this);
+    SQLHANDLE dictNumberStmt = dictNumberStmts[connection.idx];
+    SQLLEN length = sizeText;
+    check(SQLBindParameter(dictNumberStmt, 1, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, sizeText, 0, (SQLPOINTER) text, sizeText, &length), "bind parameter");
+    check(SQLExecute(dictNumberStmt), "execute query");
+    SQLRETURN res = SQLFetch(dictNumberStmt);
     if (SQL_SUCCEEDED(res)) {
 	SQLLEN numBytes;
 	SQLUBIGINT result;
-	check(SQLGetData(stmt, 1, SQL_C_UBIGINT, &result, sizeof(SQLUBIGINT), &numBytes), "get result");
+	check(SQLGetData(dictNumberStmt, 1, SQL_C_UBIGINT, &result, sizeof(SQLUBIGINT), &numBytes), "get result");
 	id = (uint64_t) result;
     }
-    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    SQLCloseCursor(dictNumberStmt);
     return SQL_SUCCEEDED(res);
 
 }
 
 bool ODBCTable::getDictText(const uint64_t id, char *text) {
-    string query = "SELECT value from dict where id=" + to_string(id);
-    SQLHANDLE stmt;
-    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-    check(SQLExecDirectA(stmt, (SQLCHAR *) query.c_str(), SQL_NTS), "execute query");
-    SQLRETURN res = SQLFetch(stmt);
+    PooledConnection connection(this);
+    SQLHANDLE dictTextStmt = dictTextStmts[connection.idx];
+    SQLUBIGINT param = id;
+    check(SQLBindParameter(dictTextStmt, 1, SQL_PARAM_INPUT, SQL_C_UBIGINT, SQL_BIGINT, 0, 0, &param, 0, NULL), "bind parameter");
+    check(SQLExecute(dictTextStmt), "execute query");
+    SQLRETURN res = SQLFetch(dictTextStmt);
     if (SQL_SUCCEEDED(res)) {
-	SQLLEN numBytes;
-	check(SQLGetData(stmt, 1, SQL_C_CHAR, text, 8192, &numBytes), "get result");
-	text[numBytes] = 0;
+	string value;
+	getTextData(dictTextStmt, 1, value);
+	if (value.size() >= MAX_TERM_SIZE) {
+	    BOOST_LOG_TRIVIAL(warning) << "The text of the term " << id << " is truncated";
+	    value.resize(MAX_TERM_SIZE - 1);
+	}
+	memcpy(text, value.c_str(), value.size() + 1);
     }
-    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    SQLCloseCursor(dictTextStmt);
     return SQL_SUCCEEDED(res);
 }
 
 uint64_t ODBCTable::getNTerms() {
+    PooledConnection connection(this);
+    SQLHANDLE con = cons[connection.idx];
     string query = "SELECT COUNT(*) as c from dict";
     SQLHANDLE stmt;
     check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
@@ -329,7 +265,11 @@ uint64_t ODBCTable::getNTerms() {
 }
 
 ODBCTable::~ODBCTable() {
-    SQLDisconnect(con);
-    SQLFreeHandle(SQL_HANDLE_DBC, con);
+    for (size_t i = 0; i < cons.size(); i++) {
+	SQLFreeHandle(SQL_HANDLE_STMT, dictTextStmts[i]);
+	SQLFreeHandle(SQL_HANDLE_STMT, dictNumberStmts[i]);
+	SQLDisconnect(cons[i]);
+	SQLFreeHandle(SQL_HANDLE_DBC, cons[i]);
+    }
     SQLFreeHandle(SQL_HANDLE_ENV, env);
 }
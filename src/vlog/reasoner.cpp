@@ -6,6 +6,8 @@
 #include <vlog/edb.h>
 #include <vlog/qsqquery.h>
 #include <vlog/qsqr.h>
+#include <vlog/metrics.h>
+#include <vlog/trident/tupletableblockitr.h>
 
 #include <trident/kb/consts.h>
 #include <trident/model/table.h>
@@ -13,6 +15,7 @@
 #include <boost/log/trivial.hpp>
 #include <boost/thread.hpp>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -215,6 +218,7 @@ size_t Reasoner::estimate(Literal &query, std::vector<uint8_t> *posBindings,
     QSQQuery rootQuery(query);
     std::unique_ptr<QSQR> evaluator = std::unique_ptr<QSQR>(
                                           new QSQR(layer, &program));
+    evaluator->setParallel(parallelQSQR && layer.isMultithreaded());
     TupleTable *cardTable = NULL;
     cardTable = evaluator->evaluateQuery(QSQR_EST, &rootQuery,
                                          posBindings, valueBindings, true);
@@ -303,22 +307,146 @@ TupleIterator *Reasoner::getIterator(Literal &query,
 	*/
     }
     if (posJoins == NULL || posJoins->size() < query.getNVars() || returnOnlyVars || posJoins->size() > 1) {
-	ReasoningMode mode = chooseMostEfficientAlgo(query, edb, program, posJoins, possibleValuesJoins);
-	if (mode == MAGIC) {
-	    BOOST_LOG_TRIVIAL(info) << "Using magic for " << query.tostring(&program, &edb);
-	    return Reasoner::getMagicIterator(
-					query, posJoins, possibleValuesJoins, edb, program,
-					returnOnlyVars, sortByFields);
+	if (!answers.isEnabled() || query.getPredicate().getType() != IDB) {
+	    return getMagicOrTopDownIterator(query, posJoins, possibleValuesJoins,
+					     edb, program, returnOnlyVars, sortByFields);
 	}
+
+	std::shared_ptr<const AnswerCache::Answers> a = getAnswers(query,
+		posJoins, possibleValuesJoins, edb, program);
+	//Project and sort the answers as requested
+	TupleTable *finalTable;
+	std::vector<uint8_t> posVars;
+	if (returnOnlyVars) {
+	    posVars = query.getPosVars();
+	} else {
+	    for (uint8_t i = 0; i < query.getTupleSize(); ++i) {
+		posVars.push_back(i);
+	    }
+	}
+	finalTable = new TupleTable(posVars.size());
+	const size_t nrows = a->getNRows();
+	for (size_t i = 0; i < nrows; ++i) {
+	    const Term_t *row = a->getRow(i);
+	    for (uint8_t j = 0; j < posVars.size(); ++j) {
+		finalTable->addValue(row[posVars[j]]);
+	    }
+	}
+	std::shared_ptr<TupleTable> pFinalTable(finalTable);
+	if (sortByFields != NULL && !sortByFields->empty()) {
+	    std::shared_ptr<TupleTable> sortTab = std::shared_ptr<TupleTable>(
+		    pFinalTable->sortBy(*sortByFields));
+	    return new TupleTableBlockItr(sortTab);
+	} else {
+	    return new TupleTableBlockItr(pFinalTable);
+	}
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "Using incremental reasoning for " << query.tostring(&program, &edb);
+    return getIncrReasoningIterator(query, posJoins, possibleValuesJoins, edb, program, returnOnlyVars, sortByFields); 
+}
+
+TupleIterator *Reasoner::getMagicOrTopDownIterator(Literal &query,
+        std::vector<uint8_t> *posJoins,
+        std::vector<Term_t> *possibleValuesJoins,
+        EDBLayer &edb, Program &program, bool returnOnlyVars,
+        std::vector<uint8_t> *sortByFields) {
+    //Computed before the evaluation, which may change the bindings
+    const AlgoCosts::Shape shape = getShape(query, posJoins, possibleValuesJoins,
+                                            program);
+    ReasoningMode mode = chooseMostEfficientAlgo(query, edb, program, posJoins, possibleValuesJoins);
+    boost::chrono::system_clock::time_point start = boost::chrono::system_clock::now();
+    TupleIterator *itr;
+    if (mode == MAGIC) {
+	BOOST_LOG_TRIVIAL(info) << "Using magic for " << query.tostring(&program, &edb);
+	itr = Reasoner::getMagicIterator(
+				    query, posJoins, possibleValuesJoins, edb, program,
+				    returnOnlyVars, sortByFields);
+    } else {
 	//top-down
 	BOOST_LOG_TRIVIAL(info) << "Using top-down for " << query.tostring(&program, &edb);
-	return Reasoner::getTopDownIterator(
+	itr = Reasoner::getTopDownIterator(
 		       query, posJoins, possibleValuesJoins, edb, program,
 		       returnOnlyVars, sortByFields);
     }
+    //Both algorithms compute all the answers before returning
+    boost::chrono::duration<double> sec = boost::chrono::system_clock::now() - start;
+    costs.record(shape, mode, sec.count() * 1000);
+    Metrics::get().reasonerLatency[mode].observe(sec.count());
+    return itr;
+}
 
-    BOOST_LOG_TRIVIAL(info) << "Using incremental reasoning for " << query.tostring(&program, &edb);
-    return getIncrReasoningIterator(query, posJoins, possibleValuesJoins, edb, program, returnOnlyVars, sortByFields); 
+AlgoCosts::Shape Reasoner::getShape(Literal &query,
+                                    std::vector<uint8_t> *posBindings,
+                                    std::vector<Term_t> *valueBindings,
+                                    Program &program) {
+    //The bindings refer to the variables of the query
+    VTuple t = query.getTuple();
+    size_t nbindings = 0;
+    if (posBindings != NULL && !posBindings->empty()) {
+        uint8_t idxVar = 0;
+        for (uint8_t i = 0; i < t.getSize(); ++i) {
+            if (t.get(i).isVariable()) {
+                if (std::find(posBindings->begin(), posBindings->end(), idxVar)
+                        != posBindings->end()) {
+                    t.set(VTerm(0, 0), i);
+                }
+                idxVar++;
+            }
+        }
+        nbindings = valueBindings->size() / posBindings->size();
+    }
+    return AlgoCosts::getShape(program.getPredicateName(
+                                   query.getPredicate().getId()),
+                               Predicate::calculateAdornment(t), nbindings);
+}
+
+std::shared_ptr<const AnswerCache::Answers> Reasoner::getAnswers(Literal &query,
+        std::vector<uint8_t> *posJoins,
+        std::vector<Term_t> *possibleValuesJoins,
+        EDBLayer &edb, Program &program) {
+    //The cache wants the positions of the bindings in the literal
+    std::vector<uint8_t> newPosJoins;
+    if (posJoins != NULL) {
+        newPosJoins = *posJoins;
+        for (int j = 0; j < query.getTupleSize(); ++j) {
+            if (!query.getTermAtPos(j).isVariable()) {
+                for (int m = 0; m < newPosJoins.size(); ++m) {
+                    if (newPosJoins[m] >= j)
+                        newPosJoins[m]++;
+                }
+            }
+        }
+    }
+    std::vector<uint8_t> *posBindings = posJoins != NULL ? &newPosJoins : NULL;
+
+    answers.setSource(program, edb);
+    std::shared_ptr<const AnswerCache::Answers> cached = answers.get(query,
+            posBindings, possibleValuesJoins);
+    if (cached != NULL) {
+        BOOST_LOG_TRIVIAL(info) << "Using cached answers for " << query.tostring(&program, &edb);
+        return cached;
+    }
+
+    //The evaluation may change the bindings
+    std::vector<Term_t> bindings;
+    if (possibleValuesJoins != NULL) {
+        bindings = *possibleValuesJoins;
+    }
+    TupleIterator *itr = getMagicOrTopDownIterator(query, posJoins,
+                         possibleValuesJoins, edb, program, false, NULL);
+    std::shared_ptr<AnswerCache::Answers> computed(
+        new AnswerCache::Answers(query.getTupleSize()));
+    while (itr->hasNext()) {
+        itr->next();
+        for (uint8_t i = 0; i < query.getTupleSize(); ++i) {
+            computed->rows.push_back(itr->getElementAt(i));
+        }
+    }
+    delete itr;
+    answers.put(query, posBindings, possibleValuesJoins != NULL ? &bindings : NULL,
+                computed);
+    return computed;
 }
 
 TupleIterator *Reasoner::getIncrReasoningIterator(Literal &query,
@@ -505,12 +633,73 @@ TupleIterator *Reasoner::getIncrReasoningIterator(Literal &query,
     if (sortByFields != NULL && !sortByFields->empty()) {
         std::shared_ptr<TupleTable> sortTab = std::shared_ptr<TupleTable>(
                 pFinalTable->sortBy(*sortByFields));
-        return new TupleTableItr(sortTab);
+        return new TupleTableBlockItr(sortTab);
     } else {
-        return new TupleTableItr(pFinalTable);
+        return new TupleTableBlockItr(pFinalTable);
     }
 }
 
+std::shared_ptr<const Reasoner::MagicProgram> Reasoner::getMagicProgram(
+    Literal &query, EDBLayer &edb, Program &program) {
+    const uint64_t key = ((uint64_t) query.getPredicate().getId() << 16) +
+                         query.getPredicate().getAdorment();
+    {
+        boost::mutex::scoped_lock lock(magicProgramsMutex);
+        //Rules can be added to a program, e.g., by the prematerialization
+        if (magicSource != &program || magicLayer != &edb ||
+                magicSourceRules != program.getNRules()) {
+            magicPrograms.clear();
+            magicSource = &program;
+            magicLayer = &edb;
+            magicSourceRules = program.getNRules();
+        }
+        auto itr = magicPrograms.find(key);
+        if (itr != magicPrograms.end()) {
+            BOOST_LOG_TRIVIAL(debug) << "Reusing the magic program for " << query.tostring(&program, &edb);
+            return itr->second;
+        }
+    }
+
+    std::shared_ptr<MagicProgram> magic(new MagicProgram());
+
+    //Get all adorned rules
+    std::unique_ptr<Wizard> wizard = std::unique_ptr<Wizard>(new Wizard());
+    magic->adornedProgram = wizard->getAdornedProgram(query, program);
+    //Print all rules
+#if DEBUG
+    BOOST_LOG_TRIVIAL(debug) << "Adorned program:";
+    std::vector<Rule> newRules = magic->adornedProgram->getAllRules();
+    for (std::vector<Rule>::iterator itr = newRules.begin(); itr != newRules.end(); ++itr) {
+        BOOST_LOG_TRIVIAL(debug) << itr->tostring(magic->adornedProgram.get(), &edb);
+    }
+#endif
+
+    //Rewrite and add the rules
+    magic->magicProgram = wizard->doMagic(query, magic->adornedProgram,
+                                          magic->inputOutputRelIDs);
+
+#if DEBUG
+    BOOST_LOG_TRIVIAL(debug) << "Magic program:";
+    newRules = magic->magicProgram->getAllRules();
+    for (std::vector<Rule>::iterator itr = newRules.begin(); itr != newRules.end(); ++itr) {
+        BOOST_LOG_TRIVIAL(debug) << itr->tostring(magic->magicProgram.get(), &edb);
+    }
+#endif
+
+    magic->plans = std::unique_ptr<SemiNaiver>(new SemiNaiver(
+                       magic->magicProgram->getAllRules(), edb,
+                       magic->magicProgram.get(), true, true, false, -1, false));
+    magic->plans->prepareRules();
+
+    boost::mutex::scoped_lock lock(magicProgramsMutex);
+    if (magicSource != &program) {
+        //The program has changed in the meantime
+        return magic;
+    }
+    //If another thread was faster, use its program
+    return magicPrograms.insert(std::make_pair(key, magic)).first->second;
+}
+
 TupleIterator *Reasoner::getMagicIterator(Literal &query,
         std::vector<uint8_t> *posJoins,
         std::vector<Term_t> *possibleValuesJoins,
@@ -564,33 +753,16 @@ TupleIterator *Reasoner::getMagicIterator(Literal &query,
     Predicate pred1(query.getPredicate(), Predicate::calculateAdornment(boundTuple));
     Literal query1(pred1, boundTuple);
 
-    //Get all adorned rules
-    std::unique_ptr<Wizard> wizard = std::unique_ptr<Wizard>(new Wizard());
-    std::shared_ptr<Program> adornedProgram = wizard->getAdornedProgram(query1, program);
-    //Print all rules
-#if DEBUG
-    BOOST_LOG_TRIVIAL(debug) << "Adorned program:";
-    std::vector<Rule> newRules = adornedProgram->getAllRules();
-    for (std::vector<Rule>::iterator itr = newRules.begin(); itr != newRules.end(); ++itr) {
-        BOOST_LOG_TRIVIAL(debug) << itr->tostring(adornedProgram.get(), &edb);
-    }
-#endif
-
-    //Rewrite and add the rules
-    std::pair<PredId_t, PredId_t> inputOutputRelIDs;
-    std::shared_ptr<Program> magicProgram = wizard->doMagic(query1, adornedProgram,
-                                            inputOutputRelIDs);
+    //Get the rewritten program. Only the input tuples depend on the query
+    std::shared_ptr<const MagicProgram> magic = getMagicProgram(query1, edb,
+            program);
+    std::shared_ptr<Program> magicProgram = magic->magicProgram;
+    const std::pair<PredId_t, PredId_t> inputOutputRelIDs =
+        magic->inputOutputRelIDs;
 
-#if DEBUG
-    BOOST_LOG_TRIVIAL(debug) << "Magic program:";
-    newRules = magicProgram->getAllRules();
-    for (std::vector<Rule>::iterator itr = newRules.begin(); itr != newRules.end(); ++itr) {
-        BOOST_LOG_TRIVIAL(debug) << itr->tostring(magicProgram.get(), &edb);
-    }
-#endif
-
-    SemiNaiver *naiver = new SemiNaiver(magicProgram->getAllRules(),
+    SemiNaiver *naiver = new SemiNaiver(std::vector<Rule>(),
                                         edb, magicProgram.get(), true, true, false, -1, false) ;
+    naiver->copyPreparedRules(*magic->plans);
 
     //Add all the input tuples in the input relation
     Predicate pred = magicProgram->getPredicate(inputOutputRelIDs.first);
@@ -667,10 +839,10 @@ TupleIterator *Reasoner::getMagicIterator(Literal &query,
     if (sortByFields != NULL && !sortByFields->empty()) {
         std::shared_ptr<TupleTable> sortTab = std::shared_ptr<TupleTable>(
                 pFinalTable->sortBy(*sortByFields));
-        return new TupleTableItr(sortTab);
+        return new TupleTableBlockItr(sortTab);
 
     } else {
-        return new TupleTableItr(pFinalTable);
+        return new TupleTableBlockItr(pFinalTable);
     }
 }
 
@@ -678,6 +850,16 @@ ReasoningMode Reasoner::chooseMostEfficientAlgo(Literal &query,
         EDBLayer &layer, Program &program,
         std::vector<uint8_t> *posBindings,
         std::vector<Term_t> *valueBindings) {
+    //Prefer the runtimes that were observed on similar queries
+    ReasoningMode learnedMode;
+    if (costs.choose(getShape(query, posBindings, valueBindings, program),
+                     learnedMode)) {
+        BOOST_LOG_TRIVIAL(debug) << "Resolving " << query.tostring(&program, &layer) <<
+                                 " with " << (learnedMode == MAGIC ? "magic" : "QSQR") <<
+                                 " according to the observed runtimes";
+        return learnedMode;
+    }
+
     uint64_t cost = 0;
     if (posBindings != NULL) {
         //Create a new query with the values substituted
@@ -751,6 +933,7 @@ TupleIterator *Reasoner::getTopDownIterator(Literal &query,
     QSQQuery rootQuery(query);
     BOOST_LOG_TRIVIAL(debug) << "QSQQuery = " << rootQuery.tostring();
     std::unique_ptr<QSQR> evaluator = std::unique_ptr<QSQR>(new QSQR(edb, &program));
+    evaluator->setParallel(parallelQSQR && edb.isMultithreaded());
     TupleTable *finalTable;
     finalTable = evaluator->evaluateQuery(QSQR_EVAL, &rootQuery, newPosJoins.size() > 0 ? &newPosJoins : NULL,
                                           possibleValuesJoins, returnOnlyVars);
@@ -762,9 +945,9 @@ TupleIterator *Reasoner::getTopDownIterator(Literal &query,
     if (sortByFields != NULL && !sortByFields->empty()) {
         std::shared_ptr<TupleTable> sortTab = std::shared_ptr<TupleTable>(
                 pFinalTable->sortBy(*sortByFields));
-        return new TupleTableItr(sortTab);
+        return new TupleTableBlockItr(sortTab);
     } else {
-        return new TupleTableItr(pFinalTable);
+        return new TupleTableBlockItr(pFinalTable);
     }
 
 }
@@ -3,6 +3,10 @@
 #include <trident/sparql/sparqloperators.h>
 #include <trident/binarytables/newcolumntable.h>
 
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
 void antiJoinOneColumn(int posJoin1, int posJoin2,
                        NewColumnTable *pitr1, NewColumnTable *pitr2,
                        std::shared_ptr<ColumnWriter> col) {
@@ -83,6 +87,7 @@ std::vector<std::shared_ptr<Column>> TridentTable::performAntiJoin(
                                       std::vector<uint8_t> &pos1,
                                       const Literal &l2,
 std::vector<uint8_t> &pos2) {
+    QuerierSlot *slot = getSlot();
 
     TridentTupleItr itr1, itr2;
 
@@ -93,13 +98,13 @@ std::vector<uint8_t> &pos2) {
     if (pos1.size() == 2) {
         fieldToSort.push_back(l1.getPosVars()[pos1[1]]);
     }
-    itr1.init(q, &t1, &fieldToSort, true, multithreaded ? &mutex : NULL);
+    itr1.init(slot->q, &t1, &fieldToSort, true, multithreaded ? &slot->mutex : NULL);
     VTuple t2 = l2.getTuple();
     fieldToSort.clear();
     fieldToSort.push_back(l2.getPosVars()[pos2[0]]);
     if (pos2.size() == 2)
         fieldToSort.push_back(l2.getPosVars()[pos2[1]]);
-    itr2.init(q, &t2, &fieldToSort, true, multithreaded ? &mutex : NULL);
+    itr2.init(slot->q, &t2, &fieldToSort, true, multithreaded ? &slot->mutex : NULL);
 
     //Output
     std::vector<std::shared_ptr<ColumnWriter>> cols;
@@ -149,6 +154,7 @@ std::vector<std::shared_ptr<Column>> TridentTable::performAntiJoin(
                                       std::shared_ptr<Column >> &valuesToCheck,
                                       const Literal &l,
 std::vector<uint8_t> &pos) {
+    QuerierSlot *slot = getSlot();
 
     VTuple t = l.getTuple();
     assert(l.getNVars() < l.getTupleSize());
@@ -157,7 +163,7 @@ std::vector<uint8_t> &pos) {
     if (pos.size() == 2)
         fieldToSort.push_back(l.getPosVars()[pos[1]]);
     TridentTupleItr itr;
-    itr.init(q, &t, &fieldToSort, true, multithreaded ? &mutex : NULL);
+    itr.init(slot->q, &t, &fieldToSort, true, multithreaded ? &slot->mutex : NULL);
 
     //Output
     std::vector<std::shared_ptr<ColumnWriter>> cols;
@@ -368,10 +374,11 @@ std::vector<uint8_t> &pos) {
 // Local
 void TridentTable::getQueryFromEDBRelation0(QSQQuery *query,
         TupleTable *outputTable) {
+    QuerierSlot *slot = getSlot();
     //No join to perform. Simply execute the query using TupleKBIterator
     VTuple tuple = query->getLiteral()->getTuple();
     TridentTupleItr itr;
-    itr.init(q, &tuple, NULL, multithreaded ? &mutex : NULL);
+    itr.init(slot->q, &tuple, NULL, multithreaded ? &slot->mutex : NULL);
     uint64_t row[3];
     uint8_t *pos = query->getPosToCopy();
     const uint8_t npos = query->getNPosToCopy();
@@ -388,6 +395,7 @@ void TridentTable::getQueryFromEDBRelation0(QSQQuery *query,
 void TridentTable::getQueryFromEDBRelation3(QSQQuery *query,
         TupleTable *outputTable,
         std::vector<Term_t> *valuesToFilter) {
+    QuerierSlot *slot = getSlot();
     //Group by predicate
     std::unordered_map<uint64_t, std::vector<std::pair<uint64_t, uint64_t>>*> map;
     for (std::vector<Term_t>::iterator itr = valuesToFilter->begin();
@@ -438,19 +446,19 @@ void TridentTable::getQueryFromEDBRelation3(QSQQuery *query,
         std::vector<std::pair<uint64_t, uint64_t>> *pairs = itr->second;
         std::sort(pairs->begin(), pairs->end());
         if (multithreaded) {
-            mutex.lock();
+            slot->mutex.lock();
         }
-        ArrayItr *firstItr = q->getArrayIterator();
+        ArrayItr *firstItr = slot->q->getArrayIterator();
         std::shared_ptr<std::vector<std::pair<uint64_t, uint64_t>>> spairs = std::shared_ptr<std::vector<std::pair<uint64_t, uint64_t>>>(pairs);
         firstItr->init(spairs, -1, -1);
         firstItr->setKey(itr->first);
         p2.predicate(itr->first);
 
-        std::shared_ptr<NestedJoinPlan> plan(new NestedJoinPlan(p2, q,
+        std::shared_ptr<NestedJoinPlan> plan(new NestedJoinPlan(p2, slot->q,
                                              posToCopy, joins, posVarsToReturn));
-        NestedMergeJoinItr join(q, plan, firstItr, outputTable, LONG_MAX);
+        NestedMergeJoinItr join(slot->q, plan, firstItr, outputTable, LONG_MAX);
         if (multithreaded) {
-            mutex.unlock();
+            slot->mutex.unlock();
         }
         if (join.hasNext()) {
             //Calling hasNext() of NWayJoin should populate the entire outputTable
@@ -562,6 +570,7 @@ void TridentTable::getQueryFromEDBRelation12(VTerm s, VTerm p, VTerm o,
         std::vector<int> &posVarsToReturn,
         std::vector<std::pair<int, int>> &joins,
         std::vector<std::vector<int>> &posToCopy) {
+    QuerierSlot *slot = getSlot();
     //Sort pairs
     std::sort(pairs->begin(), pairs->end());
 
@@ -602,20 +611,20 @@ void TridentTable::getQueryFromEDBRelation12(VTerm s, VTerm p, VTerm o,
         p2.object(o.getValue());
     }
     if (multithreaded) {
-        mutex.lock();
+        slot->mutex.lock();
     }
-    ArrayItr *firstItr = q->getArrayIterator();
+    ArrayItr *firstItr = slot->q->getArrayIterator();
     std::shared_ptr<std::vector<std::pair<uint64_t, uint64_t>>> spairs =
         std::shared_ptr <
         std::vector<std::pair<uint64_t, uint64_t> >> (pairs, dummydeleter);
     firstItr->init(spairs, -1, -1);
-    std::shared_ptr<NestedJoinPlan> plan(new NestedJoinPlan(p2, q, posToCopy,
+    std::shared_ptr<NestedJoinPlan> plan(new NestedJoinPlan(p2, slot->q, posToCopy,
                                          joins, posVarsToReturn));
 
     //execute the plan and copy the results in the table
-    NestedMergeJoinItr join(q, plan, firstItr, outputTable, LONG_MAX);
+    NestedMergeJoinItr join(slot->q, plan, firstItr, outputTable, LONG_MAX);
     if (multithreaded) {
-        mutex.unlock();
+        slot->mutex.unlock();
     }
     if (join.hasNext()) {
         //Calling hasNext() of NWayJoin should populate the entire outputTable
@@ -632,6 +641,7 @@ std::shared_ptr<Column> TridentTable::checkIn(
     const Literal &l,
     uint8_t posInL,
     size_t &sizeOutput) {
+    QuerierSlot *slot = getSlot();
 
 //Do some checks
     if (l.getNVars() == 0 || l.getNVars() == 3) {
@@ -647,7 +657,7 @@ std::shared_ptr<Column> TridentTable::checkIn(
     std::vector<uint8_t> fieldToSort;
     fieldToSort.push_back(l.getPosVars()[posInL]);
     TridentTupleItr itr1;
-    itr1.init(q, &t, &fieldToSort, true, multithreaded ? &mutex : NULL);
+    itr1.init(slot->q, &t, &fieldToSort, true, multithreaded ? &slot->mutex : NULL);
     PairItr *pitrO = itr1.getPhysicalIterator();
 
     NewColumnTable *pitr = (NewColumnTable*)pitrO;
@@ -705,6 +715,7 @@ std::vector<uint8_t> &posInL) {
 }
 
 size_t TridentTable::getCardinality(const Literal &query) {
+    QuerierSlot *slot = getSlot();
     const Literal *literal = &query;
     long s, p, o;
     VTerm t = literal->getTermAtPos(0);
@@ -726,11 +737,11 @@ size_t TridentTable::getCardinality(const Literal &query) {
         o = t.getValue();
     }
     if (multithreaded) {
-        mutex.lock();
+        slot->mutex.lock();
     }
-    size_t result = q->getCard(s, p, o);
+    size_t result = slot->q->getCard(s, p, o);
     if (multithreaded) {
-        mutex.unlock();
+        slot->mutex.unlock();
     }
     if (query.getNUniqueVars() < query.getNVars()) {
         result = result / 10;   // ???
@@ -741,6 +752,7 @@ size_t TridentTable::getCardinality(const Literal &query) {
 
 //same as above
 size_t TridentTable::estimateCardinality(const Literal &query) {
+    QuerierSlot *slot = getSlot();
     const Literal *literal = &query;
     long s, p, o;
     VTerm t = literal->getTermAtPos(0);
@@ -762,11 +774,11 @@ size_t TridentTable::estimateCardinality(const Literal &query) {
         o = t.getValue();
     }
     if (multithreaded) {
-        mutex.lock();
+        slot->mutex.lock();
     }
-    size_t result = q->getCard(s, p, o);
+    size_t result = slot->q->getCard(s, p, o);
     if (multithreaded) {
-        mutex.unlock();
+        slot->mutex.unlock();
     }
     if (query.getNUniqueVars() < query.getNVars()) {
         result = result / 10;   // ???
@@ -778,6 +790,7 @@ size_t TridentTable::estimateCardinality(const Literal &query) {
 bool TridentTable::isEmpty(const Literal &query,
                            std::vector<uint8_t> *posToFilter,
                            std::vector<Term_t> *valuesToFilter) {
+    QuerierSlot *slot = getSlot();
     const Literal *literal = &query;
     long s, p, o;
     VTerm t = literal->getTermAtPos(0);
@@ -815,11 +828,11 @@ bool TridentTable::isEmpty(const Literal &query,
     }
 
     if (multithreaded) {
-        mutex.lock();
+        slot->mutex.lock();
     }
-    bool retval = q->isEmpty(s, p, o);
+    bool retval = slot->q->isEmpty(s, p, o);
     if (multithreaded) {
-        mutex.unlock();
+        slot->mutex.unlock();
     }
     /*
     BOOST_LOG_TRIVIAL(debug) << "isEmpty, query = " << query.tostring(NULL, NULL)
@@ -831,17 +844,13 @@ bool TridentTable::isEmpty(const Literal &query,
 
 void TridentTable::releaseIterator(EDBIterator * itr) {
     ((TridentIterator*)itr)->clear();
-    if (multithreaded) {
-        mutex.lock();
-    }
-    kbItrFactory.release((TridentIterator*)itr);
-    if (multithreaded) {
-        mutex.unlock();
-    }
+    //The iterator is recycled by the factory of the current thread
+    getSlot()->kbItrFactory.release((TridentIterator*)itr);
 }
 
 size_t TridentTable::getCardinalityColumn(const Literal &query,
         uint8_t posColumn) {
+    QuerierSlot *slot = getSlot();
     const Literal *literal = &query;
     long s, p, o;
     VTerm t = literal->getTermAtPos(0);
@@ -863,11 +872,11 @@ size_t TridentTable::getCardinalityColumn(const Literal &query,
         o = t.getValue();
     }
     if (multithreaded) {
-        mutex.lock();
+        slot->mutex.lock();
     }
-    size_t result = q->getCard(s, p, o, posColumn);
+    size_t result = slot->q->getCard(s, p, o, posColumn);
     if (multithreaded) {
-        mutex.unlock();
+        slot->mutex.unlock();
     }
     // BOOST_LOG_TRIVIAL(debug) << "getCardinalityColumn, query = " << query.tostring(NULL, NULL)
     //                          << ", posColumn = " << (int) posColumn << ", result = " << result;
@@ -896,22 +905,52 @@ void TridentTable::query(QSQQuery *query, TupleTable *outputTable,
     //                          << ", result size = " << outputTable->getNRows();
 }
 
-TridentIterator *TridentTable::getTridentIter() {
-    if (multithreaded) {
-        mutex.lock();
+void TridentTable::releaseThreadSlot(ThreadSlot *threadSlot) {
+    std::shared_ptr<SlotPool> pool = threadSlot->pool.lock();
+    if (pool) {
+        boost::mutex::scoped_lock lock(pool->mutex);
+        pool->freeSlots.push_back(threadSlot->slot);
     }
-    TridentIterator *retval = kbItrFactory.get();
-    if (multithreaded) {
-        mutex.unlock();
+    delete threadSlot;
+}
+
+TridentTable::QuerierSlot *TridentTable::getSlot() {
+    if (!multithreaded) {
+        return pool->slots[0].get();
+    }
+    ThreadSlot *threadSlot = this->threadSlot.get();
+    //A slot of an expired pool was left by a table deleted before
+    if (threadSlot == NULL || threadSlot->pool.expired()) {
+        //First access of this thread
+        ThreadSlot *newSlot = new ThreadSlot();
+        newSlot->pool = pool;
+        {
+            boost::mutex::scoped_lock lock(pool->mutex);
+            if (!pool->freeSlots.empty()) {
+                newSlot->slot = pool->freeSlots.back();
+                pool->freeSlots.pop_back();
+            } else {
+                newSlot->slot = new QuerierSlot(kb->query());
+                pool->slots.push_back(std::unique_ptr<QuerierSlot>(newSlot->slot));
+            }
+        }
+        this->threadSlot.reset(newSlot);
+        threadSlot = newSlot;
     }
-    return retval;
+    return threadSlot->slot;
+}
+
+TridentIterator *TridentTable::getTridentIter(QuerierSlot *slot) {
+    //Only the thread of the slot uses its factory
+    return slot->kbItrFactory.get();
 }
 
 EDBIterator *TridentTable::getIterator(const Literal &query) {
     const Literal *literal = &query;
     // BOOST_LOG_TRIVIAL(debug) << "Get iterator for query " << literal->tostring(NULL, NULL);
-    TridentIterator *itr = getTridentIter();
-    itr->init(query.getPredicate().getId(), q, *literal, multithreaded ? &mutex : NULL);
+    QuerierSlot *slot = getSlot();
+    TridentIterator *itr = getTridentIter(slot);
+    itr->init(query.getPredicate().getId(), slot->q, *literal, multithreaded ? &slot->mutex : NULL);
     return itr;
 }
 
@@ -919,8 +958,9 @@ EDBIterator *TridentTable::getSortedIterator(const Literal &query,
         const std::vector<uint8_t> &fields) {
     const Literal *literal = &query;
     // BOOST_LOG_TRIVIAL(debug) << "Get sorted iterator for query " << literal->tostring(NULL, NULL);
-    TridentIterator *itr = getTridentIter();
-    itr->init(query.getPredicate().getId(), q, *literal, fields, multithreaded ? &mutex : NULL);
+    QuerierSlot *slot = getSlot();
+    TridentIterator *itr = getTridentIter(slot);
+    itr->init(query.getPredicate().getId(), slot->q, *literal, fields, multithreaded ? &slot->mutex : NULL);
     return itr;
 }
 
@@ -936,3 +976,28 @@ bool TridentTable::getDictText(const uint64_t id, char *text) {
 uint64_t TridentTable::getNTerms() {
     return kb->getNTerms();
 }
+
+string TridentTable::getVersion() {
+    //Every triple is stored in the first permutation, so its files change
+    //also when the new triples do not add terms. The other files in the
+    //directory (e.g., the statistics of VLog) are not considered.
+    uint64_t size = 0;
+    std::time_t lastWrite = 0;
+    boost::system::error_code ec;
+    for (fs::recursive_directory_iterator itr(fs::path(kbDir) / "p0", ec);
+            !ec && itr != fs::recursive_directory_iterator(); itr.increment(ec)) {
+        boost::system::error_code ecFile;
+        if (fs::is_regular_file(itr->path(), ecFile)) {
+            const uintmax_t fileSize = fs::file_size(itr->path(), ecFile);
+            if (!ecFile) {
+                size += fileSize;
+            }
+            const std::time_t fileWrite = fs::last_write_time(itr->path(), ecFile);
+            if (!ecFile) {
+                lastWrite = std::max(lastWrite, fileWrite);
+            }
+        }
+    }
+    return to_string(getNTerms()) + "/" + to_string(size) + "/" +
+           to_string(lastWrite);
+}
@@ -0,0 +1,16 @@
+#include <vlog/trident/tupletableblockitr.h>
+
+size_t TupleTableBlockItr::nextBlock(const uint8_t *positions,
+                                     const uint8_t ncolumns, Term_t **columns,
+                                     const size_t maxRows) {
+    const size_t nrows = table->getNRows();
+    const size_t n = nrows - blockRow < maxRows ? nrows - blockRow : maxRows;
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t *row = table->getRow(blockRow + i);
+        for (uint8_t j = 0; j < ncolumns; ++j) {
+            columns[j][i] = row[positions[j]];
+        }
+    }
+    blockRow += n;
+    return n;
+}
@@ -2,6 +2,7 @@
 
 #include <vlog/webinterface.h>
 #include <vlog/materialization.h>
+#include <vlog/metrics.h>
 
 #include <launcher/vloglayer.h>
 #include <cts/parser/SPARQLLexer.hpp>
@@ -15,6 +16,7 @@
 
 #include <kognac/utils.h>
 
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/lexical_cast.hpp>
@@ -25,6 +27,7 @@
 
 #include <curl/curl.h>
 
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <chrono>
@@ -37,7 +40,7 @@ using boost::property_tree::write_json;
 WebInterface::WebInterface(std::shared_ptr<SemiNaiver> sn, string htmlfiles,
         string cmdArgs, string edbfile) : sn(sn),
     dirhtmlfiles(htmlfiles), cmdArgs(cmdArgs),
-    acceptor(io), resolver(io), isActive(false),
+    acceptor(io), resolver(io), nthreads(1), nworkers(1), nactive(0), busyMicros(0),
     edbFile(edbfile) {
         //Setup the EDB layer
         EDBConf conf(edbFile);
@@ -61,6 +64,31 @@ void WebInterface::setupTridentLayer() {
     }
 }
 
+std::unique_ptr<WebInterface::QueryLayers> WebInterface::getQueryLayers() {
+    boost::mutex::scoped_lock lock(layersMutex);
+    if (!freeLayers.empty()) {
+        std::unique_ptr<QueryLayers> layers = std::move(freeLayers.back());
+        freeLayers.pop_back();
+        return layers;
+    }
+    //At most one set of layers for each worker is created
+    std::unique_ptr<QueryLayers> layers(new QueryLayers());
+    if (vloglayer) {
+        layers->vloglayer = vloglayer->newWorkerLayer();
+    }
+    if (tridentlayer) {
+        layers->tridentlayer = std::unique_ptr<TridentLayer>(
+                new TridentLayer(*tridentlayer->getKB()));
+        layers->tridentlayer->disableBifocalSampling();
+    }
+    return layers;
+}
+
+void WebInterface::releaseQueryLayers(std::unique_ptr<QueryLayers> layers) {
+    boost::mutex::scoped_lock lock(layersMutex);
+    freeLayers.push_back(std::move(layers));
+}
+
 void WebInterface::startThread(string address, string port) {
     this->webport = port;
     boost::asio::ip::tcp::resolver::query query(address, port);
@@ -70,21 +98,42 @@ void WebInterface::startThread(string address, string port) {
     acceptor.bind(endpoint);
     acceptor.listen();
     connect();
+    //This thread is one of the threads that serve the connections
+    for (int i = 1; i < nthreads; ++i) {
+        ioThreads.create_thread([this]() {
+                io.run();
+                });
+    }
     io.run();
 }
 
+void WebInterface::setNThreads(int nthreads, int nworkers) {
+    this->nthreads = std::max(nthreads, 1);
+    this->nworkers = std::max(nworkers, 1);
+}
+
 void WebInterface::start(string address, string port) {
+    workersWork = std::unique_ptr<boost::asio::io_service::work>(
+            new boost::asio::io_service::work(workers));
+    for (int i = 0; i < nworkers; ++i) {
+        workerThreads.create_thread([this]() {
+                workers.run();
+                });
+    }
     t = boost::thread(&WebInterface::startThread, this, address, port);
 }
 
 void WebInterface::stop() {
     BOOST_LOG_TRIVIAL(info) << "Stopping server ...";
-    while (isActive) {
+    while (nactive > 0) {
         std::this_thread::sleep_for(chrono::milliseconds(100));
     }
     acceptor.cancel();
     acceptor.close();
     io.stop();
+    workersWork.reset();
+    workers.stop();
+    workerThreads.join_all();
     BOOST_LOG_TRIVIAL(info) << "Done";
 }
 
@@ -102,14 +151,22 @@ void WebInterface::connect() {
 };
 
 void WebInterface::Server::acceptHandler(const boost::system::error_code &err) {
+    //Accept the next connection while this one is served
+    if (inter->acceptor.is_open()) {
+        inter->connect();
+    }
     if (err == boost::system::errc::success) {
-        socket.async_read_some(boost::asio::buffer(data_.get(), 4096),
-                boost::bind(&Server::readHeader, shared_from_this(),
-                    boost::asio::placeholders::error,
-                    boost::asio::placeholders::bytes_transferred));
+        read();
     }
 }
 
+void WebInterface::Server::read() {
+    socket.async_read_some(boost::asio::buffer(data_.get(), 4096),
+            boost::bind(&Server::readHeader, shared_from_this(),
+                boost::asio::placeholders::error,
+                boost::asio::placeholders::bytes_transferred));
+}
+
 string _getValueParam(string req, string param) {
     int pos = req.find(param);
     if (pos == string::npos) {
@@ -266,10 +323,18 @@ void WebInterface::execSPARQLQuery(string sparqlquery,
 
 void WebInterface::Server::readHeader(boost::system::error_code const &err,
         size_t bytes) {
-    inter->setActive();
+    if (err) {
+        //The client has closed the connection
+        return;
+    }
 
     ss << string(data_.get(), bytes);
     string tmpstring = ss.str();
+    if (tmpstring.find("\r\n\r\n") == string::npos) {
+        //The header is not complete
+        read();
+        return;
+    }
     int pos = tmpstring.find("Content-Length:");
     if (pos != string::npos) {
         int endpos = tmpstring.find("\r\n\r\n", pos);
@@ -278,16 +343,39 @@ void WebInterface::Server::readHeader(boost::system::error_code const &err,
         int remsize = tmpstring.size() - endpos - 4;
         if (remsize < lenparams) {
             //I must keep reading ...
-            acceptHandler(err);
+            read();
             return;
         }
     }
 
-    req = ss.str();
+    req = tmpstring;
+    ss.str("");
+    ss.clear();
+
+    //HTTP/1.1 keeps the connection open unless the client asks otherwise
+    string header = req.substr(0, req.find("\r\n\r\n"));
+    boost::algorithm::to_lower(header);
+    if (header.find("connection: close") != string::npos) {
+        keepAlive = false;
+    } else {
+        keepAlive = header.find("http/1.1") != string::npos ||
+            header.find("connection: keep-alive") != string::npos;
+    }
+
+    //The request is executed by a worker, so that this thread can serve
+    //other connections in the meantime
+    inter->workers.post(boost::bind(&Server::processRequest,
+                shared_from_this()));
+}
+
+void WebInterface::Server::processRequest() {
+    inter->setActive();
+    boost::chrono::system_clock::time_point startRequest = boost::chrono::system_clock::now();
     //Get the page
-    string page;
+    page = "";
     string message = "";
-    bool isjson = false;
+    isjson = false;
+    ismetrics = false;
 
     if (boost::starts_with(req, "POST")) {
         int pos = req.find("HTTP");
@@ -319,12 +407,15 @@ void WebInterface::Server::readHeader(boost::system::error_code const &err,
             ptree bindings;
             ptree stats;
             bool jsonoutput = printresults == string("true");
+            boost::chrono::system_clock::time_point startQuery = boost::chrono::system_clock::now();
+            boost::shared_lock<boost::shared_mutex> lock(inter->kbMutex);
+            std::unique_ptr<QueryLayers> layers = inter->getQueryLayers();
             if (inter->program) {
                 BOOST_LOG_TRIVIAL(info) << "Answering the SPARQL query with VLog ...";
                 WebInterface::execSPARQLQuery(sparqlquery,
                         false,
                         inter->edb->getNTerms(),
-                        *(inter->vloglayer.get()),
+                        *(layers->vloglayer.get()),
                         false,
                         jsonoutput,
                         &vars,
@@ -335,13 +426,16 @@ void WebInterface::Server::readHeader(boost::system::error_code const &err,
                 WebInterface::execSPARQLQuery(sparqlquery,
                         false,
                         inter->edb->getNTerms(),
-                        *(inter->tridentlayer.get()),
+                        *(layers->tridentlayer.get()),
                         false,
                         jsonoutput,
                         &vars,
                         &bindings,
                         &stats);
             }
+            inter->releaseQueryLayers(std::move(layers));
+            boost::chrono::duration<double> secQuery = boost::chrono::system_clock::now() - startQuery;
+            Metrics::get().sparqlLatency.observe(secQuery.count());
             pt.add_child("head.vars", vars);
             pt.add_child("results.bindings", bindings);
             pt.add_child("stats", stats);
@@ -354,7 +448,10 @@ void WebInterface::Server::readHeader(boost::system::error_code const &err,
             string form = req.substr(req.find("application/x-www-form-urlencoded"));
             string id = _getValueParam(form, "id");
             //Lookup the value
-            string value = lookup(id, *(inter->tridentlayer.get()));
+            boost::shared_lock<boost::shared_mutex> lock(inter->kbMutex);
+            std::unique_ptr<QueryLayers> layers = inter->getQueryLayers();
+            string value = lookup(id, *(layers->tridentlayer.get()));
+            inter->releaseQueryLayers(std::move(layers));
             ptree pt;
             pt.put("value", value);
             std::ostringstream buf;
@@ -391,6 +488,10 @@ void WebInterface::Server::readHeader(boost::system::error_code const &err,
             curl_easy_cleanup(curl);
 
             BOOST_LOG_TRIVIAL(info) << "Setting up the KB with the given rules ...";
+            boost::unique_lock<boost::shared_mutex> lock(inter->kbMutex);
+
+            //The layers of the workers refer to the old program and KB
+            inter->freeLayers.clear();
 
             //Cleanup and install the EDB layer
             EDBConf conf(inter->edbFile);
@@ -510,6 +611,7 @@ void WebInterface::Server::readHeader(boost::system::error_code const &err,
             long totmem = Utils::getSystemMemory() / 1024 / 1024;
             pt.put("totmem", to_string(totmem));
             pt.put("commandline", inter->getCommandLineArgs());
+            boost::shared_lock<boost::shared_mutex> lock(inter->kbMutex);
             if (inter->tridentlayer.get()) {
                 pt.put("tripleskb", to_string(inter->tridentlayer->getKB()->getSize()));
                 pt.put("termskb", to_string(inter->tridentlayer->getKB()->getNTerms()));
@@ -525,6 +627,7 @@ void WebInterface::Server::readHeader(boost::system::error_code const &err,
 
         } else if (path == "/getprograminfo") {
             ptree pt;
+            boost::shared_lock<boost::shared_mutex> lock(inter->kbMutex);
             if (inter->program) {
                 pt.put("nrules", inter->program->getNRules());
                 pt.put("nedb", inter->program->getNEDBPredicates());
@@ -563,6 +666,10 @@ void WebInterface::Server::readHeader(boost::system::error_code const &err,
             page = buf.str();
             isjson = true;
 
+        } else if (path == "/metrics") {
+            page = inter->getMetrics();
+            ismetrics = true;
+
         } else if (path.size() > 1) {
             page = inter->getPage(path);
         }
@@ -572,32 +679,107 @@ void WebInterface::Server::readHeader(boost::system::error_code const &err,
         //return the main page
         page = inter->getDefaultPage();
     }
+    Metrics::addTime(inter->busyMicros,
+            boost::chrono::system_clock::now() - startRequest);
+    writeResponse();
+    inter->setInactive();
+}
+
+void WebInterface::Server::writeResponse() {
+    res = "HTTP/1.1 200 OK\r\n";
     if (isjson) {
-        res = "HTTP/1.1 200 OK\r\nContent-Type: application/json\nContent-Length: " + to_string(page.size()) + "\r\n\r\n" + page;
-    } else {    res = "HTTP/1.1 200 OK\r\nContent-Length: " + to_string(page.size()) + "\r\n\r\n" + page;
+        res += "Content-Type: application/json\r\n";
+    } else if (ismetrics) {
+        res += "Content-Type: text/plain; version=0.0.4\r\n";
     }
-
-    boost::asio::async_write(socket, boost::asio::buffer(res),
+    res += keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    //The page is complete at this point, so it is written with its length
+    res += "Content-Length: " + to_string(page.size()) + "\r\n\r\n";
+    std::vector<boost::asio::const_buffer> buffers;
+    buffers.push_back(boost::asio::buffer(res));
+    buffers.push_back(boost::asio::buffer(page));
+    boost::asio::async_write(socket, buffers,
             boost::asio::transfer_all(),
             boost::bind(&Server::writeHandler,
                 shared_from_this(),
                 boost::asio::placeholders::error,
                 boost::asio::placeholders::bytes_transferred));
-
-    inter->setInactive();
 }
 
 void WebInterface::Server::writeHandler(const boost::system::error_code &err,
         std::size_t bytes) {
-    socket.close();
-    inter->connect();
+    if (err || !keepAlive) {
+        socket.close();
+        return;
+    }
+    //Wait for the next request on the same connection
+    page.clear();
+    res.clear();
+    read();
 };
 
+static string _escapeLabel(string value) {
+    boost::algorithm::replace_all(value, "\\", "\\\\");
+    boost::algorithm::replace_all(value, "\"", "\\\"");
+    boost::algorithm::replace_all(value, "\n", "\\n");
+    return value;
+}
+
+string WebInterface::getMetrics() {
+    std::ostringstream out;
+    if (sn) {
+        Metrics::writeHeader(out, "vlog_materialization_running", "gauge",
+                "Whether the materialization is running.");
+        out << "vlog_materialization_running " << (sn->isRunning() ? 1 : 0) << "\n";
+        Metrics::writeHeader(out, "vlog_materialization_iteration", "gauge",
+                "Current iteration of the materialization.");
+        out << "vlog_materialization_iteration " << sn->getCurrentIteration() << "\n";
+        const double sec = getDurationExecMs() / 1000.0;
+        Metrics::writeHeader(out, "vlog_materialization_seconds", "gauge",
+                "Time since the start of the materialization.");
+        out << "vlog_materialization_seconds " << sec << "\n";
+        Metrics::writeHeader(out, "vlog_materialization_threads", "gauge",
+                "Threads used by the materialization.");
+        out << "vlog_materialization_threads " << std::max(sn->getNThreads(), 1) << "\n";
+
+        //The predicate that is being derived is skipped
+        std::vector<StatsSizePredicate> sizes = sn->getSizePredicates();
+        size_t totalRows = 0;
+        Metrics::writeHeader(out, "vlog_idb_rows", "gauge",
+                "Rows derived for each IDB predicate.");
+        for (const auto &s : sizes) {
+            out << "vlog_idb_rows{predicate=\"" << _escapeLabel(s.name) << "\"} " <<
+                s.rows << "\n";
+            totalRows += s.rows;
+        }
+        Metrics::writeHeader(out, "vlog_idb_bytes", "gauge",
+                "Uncompressed size of the rows derived for each IDB predicate.");
+        for (const auto &s : sizes) {
+            out << "vlog_idb_bytes{predicate=\"" << _escapeLabel(s.name) << "\"} " <<
+                s.rows * s.card * sizeof(Term_t) << "\n";
+        }
+        Metrics::writeHeader(out, "vlog_derivations_per_second", "gauge",
+                "Rows derived per second since the start of the materialization.");
+        out << "vlog_derivations_per_second " << (sec > 0 ? totalRows / sec : 0) << "\n";
+    }
+
+    Metrics::get().write(out);
+
+    Metrics::writeHeader(out, "vlog_web_workers", "gauge",
+            "Threads that execute the requests to the web interface.");
+    out << "vlog_web_workers " << nworkers << "\n";
+    Metrics::writeHeader(out, "vlog_web_worker_busy_seconds_total", "counter",
+            "Time spent by the workers executing requests.");
+    out << "vlog_web_worker_busy_seconds_total " << busyMicros.load() / 1000000.0 << "\n";
+    return out.str();
+}
+
 string WebInterface::getDefaultPage() {
     return getPage("/index.html");
 }
 
 string WebInterface::getPage(string f) {
+    boost::mutex::scoped_lock lock(cachehtmlMutex);
     if (cachehtml.count(f)) {
         return cachehtml.find(f)->second;
     }